@@ -0,0 +1,65 @@
+#ifndef NK_ARENA_H
+#define NK_ARENA_H
+
+#include <stddef.h>
+
+/* Overflow chunk; the first chunk is caller-provided memory */
+typedef struct nk_arena_chunk {
+    struct nk_arena_chunk *next;
+} nk_arena_chunk_t;
+
+/* Bump allocator: allocations are only released all at once */
+typedef struct nk_arena {
+    char *ptr;                     /* Next free byte in the current chunk */
+    char *end;                     /* End of the current chunk */
+    nk_arena_chunk_t *chunks;      /* malloc'd overflow chunks, newest first */
+} nk_arena_t;
+
+/**
+ * nk_arena_init - Start an arena in caller-provided memory
+ * @arena: Arena to initialize
+ * @buf: Initial chunk (may be NULL if @len is 0)
+ * @len: Size of @buf in bytes
+ *
+ * @buf stays owned by the caller; it typically sits in the same
+ * allocation as the object the arena belongs to.
+ */
+void nk_arena_init(nk_arena_t *arena, void *buf, size_t len);
+
+/**
+ * nk_arena_alloc - Allocate zeroed, pointer-aligned memory
+ * @arena: Arena
+ * @size: Bytes to allocate (0 yields a valid, non-NULL pointer)
+ *
+ * Returns: Memory valid until nk_arena_release(), or NULL if out of memory
+ */
+void *nk_arena_alloc(nk_arena_t *arena, size_t size);
+
+/**
+ * nk_arena_strndup - Copy at most @len bytes of @s as a NUL-terminated string
+ * @arena: Arena
+ * @s: Source (need not be NUL-terminated)
+ * @len: Maximum bytes to copy
+ *
+ * Returns: Copy in the arena, or NULL if out of memory
+ */
+char *nk_arena_strndup(nk_arena_t *arena, const char *s, size_t len);
+
+/**
+ * nk_arena_strdup - Copy a NUL-terminated string into the arena
+ * @arena: Arena
+ * @s: String to copy, or NULL
+ *
+ * Returns: Copy in the arena, or NULL if @s is NULL or out of memory
+ */
+char *nk_arena_strdup(nk_arena_t *arena, const char *s);
+
+/**
+ * nk_arena_release - Free every overflow chunk
+ * @arena: Arena
+ *
+ * The caller-provided first chunk is left alone.
+ */
+void nk_arena_release(nk_arena_t *arena);
+
+#endif /* NK_ARENA_H */
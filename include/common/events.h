@@ -0,0 +1,33 @@
+#ifndef NK_EVENTS_H
+#define NK_EVENTS_H
+
+#include <stdio.h>
+
+/*
+ * Default PSI trigger: 200 ms of "some" stall within any 2 s window. Without
+ * CAP_SYS_RESOURCE the kernel only accepts windows in multiples of 2 s.
+ */
+#define NK_EVENTS_PSI_STALL_MS 200
+#define NK_EVENTS_PSI_WINDOW_MS 2000
+
+/**
+ * nk_events_run - Stream OOM, pids.max and pressure events of containers
+ * @out: Stream for one JSON object per event (NDJSON)
+ * @container_id: Container to watch, or NULL for every container
+ * @stall_ms: PSI trigger threshold (0: NK_EVENTS_PSI_STALL_MS)
+ * @window_ms: PSI trigger window, 500-10000 (0: NK_EVENTS_PSI_WINDOW_MS)
+ *
+ * Registers a PSI trigger on memory.pressure, cpu.pressure and io.pressure
+ * and watches memory.events and pids.events of each container cgroup, all
+ * on one epoll instance; events are never found by polling. Event types are
+ * "oom", "oom_kill", "pids_max" (with the count since the last event) and
+ * "pressure" (with the resource and its avg10 values). Without
+ * @container_id the container list is re-read once a second; a single
+ * container is checked once a second and the stream ends when its cgroup
+ * is removed.
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_events_run(FILE *out, const char *container_id, unsigned stall_ms, unsigned window_ms);
+
+#endif /* NK_EVENTS_H */
@@ -0,0 +1,20 @@
+#ifndef NK_LIST_H
+#define NK_LIST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * nk_list_print - Print every container with its live state
+ * @out: Stream to print to
+ * @json: One JSON object per line (NDJSON) instead of a table
+ *
+ * A container recorded as running (or parked) whose init process is gone
+ * is reported as stopped; the stored state is left alone. Liveness comes
+ * from one sweep of /proc, not a probe per container.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_list_print(FILE *out, bool json);
+
+#endif /* NK_LIST_H */
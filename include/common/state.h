@@ -36,4 +36,64 @@ int nk_state_delete(const char *container_id);
  */
 bool nk_state_exists(const char *container_id);
 
+/**
+ * nk_state_file_path - Build the path of a file in a container's state dir
+ * @container_id: Container ID
+ * @name: File name inside <state_dir>/<container_id>/
+ *
+ * Returns: Newly allocated path (caller frees), or NULL on error
+ */
+char *nk_state_file_path(const char *container_id, const char *name);
+
+/**
+ * nk_state_list - Load every container in the state directory
+ * @out: Set to a malloc'd array of containers, sorted by ID
+ * @count: Set to the number of entries in @out
+ *
+ * Reads both stores without migrating anything and without taking
+ * container locks, so it never blocks on a running lifecycle command.
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_state_list(nk_container_t ***out, size_t *count);
+
+/**
+ * nk_state_list_free - Free a list returned by nk_state_list()
+ * @list: List (may be NULL when @count is 0)
+ * @count: Number of entries
+ */
+void nk_state_list_free(nk_container_t **list, size_t count);
+
+/**
+ * nk_state_lock - Take the per-container lock that serializes state transitions
+ * @container_id: Container ID (need not exist yet)
+ * @wait: Block until the lock is free; otherwise fail with EAGAIN
+ *
+ * Hold it across a load-check-save sequence only. Readers that just load
+ * state never take it. A waiter that wakes up on a lock file unlinked by
+ * nk_state_unlock() retries on the new one.
+ *
+ * Returns: Lock descriptor for nk_state_unlock(), or -1 with errno set
+ */
+int nk_state_lock(const char *container_id, bool wait);
+
+/**
+ * nk_state_unlock - Release a lock taken by nk_state_lock()
+ * @container_id: Container ID the lock was taken for
+ * @lock_fd: Descriptor returned by nk_state_lock(); -1 is ignored
+ *
+ * Removes the lock file if the container no longer exists.
+ */
+void nk_state_unlock(const char *container_id, int lock_fd);
+
+/**
+ * nk_state_cache_enable - Keep loaded container state in memory
+ * @enabled: true to enable the cache, false to disable and drop it
+ *
+ * Intended for long-lived processes (ns-runtimed). Cached entries are
+ * revalidated against state.json identity (inode, size, mtime) on every
+ * load, so updates written by other processes are still observed.
+ */
+void nk_state_cache_enable(bool enabled);
+
 #endif /* NK_STATE_H */
@@ -0,0 +1,78 @@
+#ifndef NK_STATE_TABLE_H
+#define NK_STATE_TABLE_H
+
+#include <stdbool.h>
+
+#include "nk.h"
+
+/*
+ * Memory-mapped container state table: <state_dir>/state.tbl holds a
+ * header, an open-addressed array of 64-byte records and an append-only
+ * string heap. Readers never lock (per-record sequence counters); writers
+ * serialize on flock() of the table file and update records in place.
+ */
+
+#define NK_STATE_TABLE_FILE "state.tbl"
+
+/**
+ * nk_state_table_load - Look up a container in the state table
+ * @state_dir: State root directory
+ * @container_id: Container ID
+ *
+ * Returns: Newly allocated container (state_file set to the table path),
+ *          or NULL with errno set (ENOENT if there is no such record).
+ *          Never prints.
+ */
+nk_container_t *nk_state_table_load(const char *state_dir, const char *container_id);
+
+/**
+ * nk_state_table_exists - Check for a container record without copying it
+ * @state_dir: State root directory
+ * @container_id: Container ID
+ *
+ * Returns: true if the table has a live record for @container_id
+ */
+bool nk_state_table_exists(const char *state_dir, const char *container_id);
+
+/**
+ * nk_state_table_save - Insert or update a container record
+ * @state_dir: State root directory (created if missing)
+ * @container: Container to store
+ *
+ * Grows and compacts the table (write to a new file, rename over) when
+ * records or string heap run out.
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_state_table_save(const char *state_dir, const nk_container_t *container);
+
+/**
+ * nk_state_table_delete - Remove a container record
+ * @state_dir: State root directory
+ * @container_id: Container ID
+ *
+ * Returns: 0 if a record was removed, -1 with errno set (ENOENT if there
+ *          was none)
+ */
+int nk_state_table_delete(const char *state_dir, const char *container_id);
+
+/**
+ * nk_state_table_list - Copy out every live record
+ * @state_dir: State root directory
+ * @out: Set to a malloc'd array of newly allocated containers
+ * @count: Set to the number of entries in @out
+ *
+ * Returns: 0 on success (an empty list if there is no table), -1 with
+ *          errno set. Never prints.
+ */
+int nk_state_table_list(const char *state_dir, nk_container_t ***out, size_t *count);
+
+/**
+ * nk_state_table_sync - Flush the table's dirty pages to disk
+ * @state_dir: State root directory
+ *
+ * Returns: 0 on success, -1 with errno set
+ */
+int nk_state_table_sync(const char *state_dir);
+
+#endif /* NK_STATE_TABLE_H */
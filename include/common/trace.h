@@ -0,0 +1,106 @@
+#ifndef NK_TRACE_H
+#define NK_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Start phases, in the order they normally run. Timestamps are
+ * CLOCK_MONOTONIC, which the container shares with us (no time namespace),
+ * so child and parent spans line up on one timeline.
+ */
+typedef enum {
+    NK_TRACE_SPEC_LOAD,       /* parent: nk_oci_spec_load() */
+    NK_TRACE_CGROUP_OPEN,     /* parent: create + open the container cgroup */
+    NK_TRACE_CGROUP_LIMITS,   /* parent: nk_cgroup_apply() of linux.resources */
+    NK_TRACE_CPUSET,          /* parent: nk_placement_apply() cpuset placement */
+    NK_TRACE_CLONE,           /* parent: clone3()/clone() of the init process */
+    NK_TRACE_CGROUP_ATTACH,   /* parent: attach by pid when CLONE_INTO_CGROUP failed */
+    NK_TRACE_OVERLAY,         /* child: overlay rootfs mount (NS_ROOTFS_MODE=overlay*) */
+    NK_TRACE_MAKE_PRIVATE,    /* child: nk_mount_make_private() on the rootfs */
+    NK_TRACE_DEFAULT_MOUNTS,  /* child: /proc, /sys, /dev, ... */
+    NK_TRACE_SETUP_DEV,       /* child: nk_mount_setup_dev() */
+    NK_TRACE_PIVOT_ROOT,      /* child: pivot_root() and old root detach */
+    NK_TRACE_CHILD_READY,     /* parent: clone returned until the child reported ready */
+    NK_TRACE_RELEASE,         /* parent: release of a child parked by create --park */
+    NK_TRACE_STATE_SAVE,      /* parent: nk_state_save() of the running state */
+    NK_TRACE_PHASES
+} nk_trace_phase_t;
+
+/* One phase; zero timestamps mean the phase did not run */
+typedef struct nk_trace_span {
+    uint64_t begin_ns;
+    uint64_t end_ns;
+} nk_trace_span_t;
+
+/* Phase timestamps of one container start */
+typedef struct nk_trace {
+    nk_trace_span_t span[NK_TRACE_PHASES];
+} nk_trace_t;
+
+/**
+ * nk_trace_now - Current CLOCK_MONOTONIC time
+ *
+ * Returns: Nanoseconds
+ */
+uint64_t nk_trace_now(void);
+
+/**
+ * nk_trace_begin - Mark the start of a phase
+ * @trace: Trace to record into, or NULL to record nothing
+ * @phase: Phase
+ */
+void nk_trace_begin(nk_trace_t *trace, nk_trace_phase_t phase);
+
+/**
+ * nk_trace_end - Mark the end of a phase started with nk_trace_begin()
+ * @trace: Trace to record into, or NULL to record nothing
+ * @phase: Phase
+ */
+void nk_trace_end(nk_trace_t *trace, nk_trace_phase_t phase);
+
+/**
+ * nk_trace_phase_in_child - Whether a phase is recorded by the container child
+ * @phase: Phase
+ *
+ * Returns: true for phases the child sends back over the sync pipe
+ */
+bool nk_trace_phase_in_child(nk_trace_phase_t phase);
+
+/**
+ * nk_trace_save - Persist a trace as <state_dir>/<container_id>/trace.json
+ * @container_id: Container ID
+ * @trace: Trace to save
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_trace_save(const char *container_id, const nk_trace_t *trace);
+
+/**
+ * nk_trace_load - Load a trace saved by nk_trace_save()
+ * @container_id: Container ID
+ * @trace: Filled with the saved phases (others zeroed)
+ *
+ * Returns: 0 on success, -1 if there is no readable trace
+ */
+int nk_trace_load(const char *container_id, nk_trace_t *trace);
+
+/**
+ * nk_trace_delete - Remove a container's saved trace, if any
+ * @container_id: Container ID
+ */
+void nk_trace_delete(const char *container_id);
+
+/**
+ * nk_trace_print - Print the phase breakdown of a trace
+ * @out: Stream to print to
+ * @container_id: Container ID (included in JSON output)
+ * @trace: Trace to print
+ * @json: Emit one JSON object instead of a table
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_trace_print(FILE *out, const char *container_id, const nk_trace_t *trace, bool json);
+
+#endif /* NK_TRACE_H */
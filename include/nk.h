@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* nano-sandbox version */
 #define NK_VERSION_MAJOR 0
@@ -32,13 +33,14 @@ typedef struct nk_container {
     nk_container_state_t state;     /* Current state */
     nk_execution_mode_t mode;       /* Execution mode */
     pid_t init_pid;                 /* PID of container init process */
+    int64_t started_at;             /* Wall-clock time of the last start (s), 0 if never */
     char *state_file;               /* Path to state file */
     int control_fd;                 /* Control pipe for container */
 } nk_container_t;
 
 /* Command-line options */
 typedef struct nk_options {
-    char *command;                  /* create|start|run|exec|delete|state */
+    char *command;                  /* create|start|run|exec|delete|kill|update|state|trace|list|batch */
     char *container_id;             /* Container ID */
     char *bundle_path;              /* Bundle path */
     char *pid_file;                 /* PID file path */
@@ -47,6 +49,28 @@ typedef struct nk_options {
     bool attach;                    /* Attach to container process */
     bool detach;                    /* Run detached from terminal */
     bool rm;                        /* Remove container after run exits */
+    bool park;                      /* create: park init process on exec.fifo */
+    bool json;                      /* trace/list/batch/stats: emit JSON */
+    bool all;                       /* kill: signal every process in the cgroup; stats/events: every container */
+    bool prometheus;                /* stats: Prometheus text format */
+    bool no_stream;                 /* stats: print one sample and exit */
+    unsigned interval_ms;           /* stats: time between samples (0: default) */
+    unsigned psi_stall_ms;          /* events: PSI trigger threshold (0: default) */
+    unsigned psi_window_ms;         /* events: PSI trigger window (0: default) */
+    int signal;                     /* kill: signal number (default SIGTERM) */
+    char *manifest;                 /* batch: NDJSON manifest path, "-" for stdin */
+    size_t workers;                 /* batch: worker processes (0: one per CPU) */
+    size_t warm_pool;               /* daemon: parked children per bundle */
+    size_t warm_refill;             /* daemon: children spawned per refill pass */
+    size_t cgroup_pool;             /* daemon: pre-created container cgroups */
+    char *cpuset;                   /* create/run: cpuset policy overriding the annotation */
+    uint64_t cpu_shares;            /* update: CPU shares (0: unchanged) */
+    int64_t cpu_quota;              /* update: cpu.max quota, -1 for max (0: unchanged) */
+    uint64_t cpu_period;            /* update: cpu.max period (0: unchanged) */
+    int64_t cpu_burst;              /* update: cpu.max.burst (if cpu_burst_set) */
+    int64_t cpu_idle;               /* update: cpu.idle (if cpu_idle_set) */
+    bool cpu_burst_set;             /* update: --cpu-burst was given, even as 0 */
+    bool cpu_idle_set;              /* update: --cpu-idle was given, even as 0 */
 } nk_options_t;
 
 /* Core API functions */
@@ -100,10 +124,35 @@ int nk_container_resume(const char *container_id, const char *exec_cmd);
  * nk_container_delete - Delete a container
  * @container_id: Container ID
  *
+ * A running container gets SIGTERM and NS_STOP_TIMEOUT_MS (default 10 s)
+ * to exit before its cgroup is killed.
+ *
  * Returns: 0 on success, -1 on error
  */
 int nk_container_delete(const char *container_id);
 
+/**
+ * nk_container_kill - Send a signal to a container
+ * @container_id: Container ID
+ * @sig: Signal number
+ * @all: Also signal every other process in the container cgroup
+ *
+ * Returns: 0 on success, -1 on error (including a container that is not
+ *          running)
+ */
+int nk_container_kill(const char *container_id, int sig, bool all);
+
+/**
+ * nk_container_update - Change the CPU limits of a live container
+ * @opts: Options with container_id and the cpu_* values to change
+ *
+ * Writes through the container cgroup fd, like the limits set at start.
+ * The spec is not changed, so a restart goes back to its limits.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_container_update(const nk_options_t *opts);
+
 /**
  * nk_container_state - Query container state
  * @container_id: Container ID
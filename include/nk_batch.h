@@ -0,0 +1,58 @@
+#ifndef NK_BATCH_H
+#define NK_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Upper bound for --workers */
+#define NK_BATCH_MAX_WORKERS 256
+
+/* Lifecycle operations a batch manifest may contain */
+typedef enum {
+    NK_BATCH_CREATE,
+    NK_BATCH_START,
+    NK_BATCH_DELETE
+} nk_batch_kind_t;
+
+/* One manifest line */
+typedef struct nk_batch_op {
+    nk_batch_kind_t kind;
+    char *id;                       /* Container ID */
+    char *bundle;                   /* create: "bundle", or the -b default */
+    bool park;                      /* create: "park": true */
+} nk_batch_op_t;
+
+/**
+ * nk_batch_exec_fn - Run one manifest operation
+ * @op: Operation to run
+ *
+ * Called in a worker process; may print like the matching CLI command.
+ *
+ * Returns: 0 on success, non-zero on failure
+ */
+typedef int (*nk_batch_exec_fn)(const nk_batch_op_t *op);
+
+/**
+ * nk_batch_run - Run a manifest of lifecycle operations on a worker pool
+ * @out: Stream for the report
+ * @manifest: NDJSON manifest path, or "-" for stdin
+ * @default_bundle: Bundle for create lines without a "bundle" key
+ * @workers: Worker processes (0: one per online CPU)
+ * @json: Report one JSON object per operation plus a summary line
+ * @exec: Runs one operation
+ *
+ * Each line is {"op":"create|start|delete","id":...} with optional
+ * "bundle" and "park" for create. The whole manifest is validated before
+ * anything runs. Operations are sharded over forked workers by container
+ * ID, so operations on one container run in manifest order. Specs of all
+ * known bundles, container state and the cgroup parent are loaded once in
+ * the parent and inherited by every worker.
+ *
+ * Returns: 0 if every operation succeeded, 1 if any failed, -1 if the
+ *          manifest could not be read or the workers not started
+ */
+int nk_batch_run(FILE *out, const char *manifest, const char *default_bundle,
+                 size_t workers, bool json, nk_batch_exec_fn exec);
+
+#endif /* NK_BATCH_H */
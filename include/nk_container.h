@@ -2,7 +2,10 @@
 #define NK_CONTAINER_H
 
 #include "nk_oci.h"
+#include "common/trace.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
 
 /* Container namespaces */
 typedef enum {
@@ -22,32 +25,101 @@ typedef struct nk_namespace_config {
     bool enable;     /* Whether to create this namespace */
 } nk_namespace_config_t;
 
-/* cgroup configuration */
+/* Annotation with per-device io.latency targets: "<dev>=<us>[,<dev>=<us>...]" */
+#define NK_IO_LATENCY_ANNOTATION "org.nano-sandbox.io.latency"
+
+/* io controller settings of one block device (0: not set, -1: unlimited) */
+typedef struct nk_cgroup_io_device {
+    uint32_t major;
+    uint32_t minor;
+    uint64_t weight;             /* blkio weight 10..1000, mapped onto io.weight */
+    int64_t rbps;                /* io.max read bytes per second */
+    int64_t wbps;                /* io.max write bytes per second */
+    int64_t riops;               /* io.max read IOs per second */
+    int64_t wiops;               /* io.max write IOs per second */
+    uint64_t latency_us;         /* io.latency target, microseconds */
+} nk_cgroup_io_device_t;
+
+/* cgroup configuration, in linux.resources units (0: not set, -1: unlimited) */
 typedef struct nk_cgroup_config {
-    char *path;              /* Cgroup path */
-    uint64_t memory_limit;   /* Memory limit in bytes */
-    uint64_t cpu_shares;     /* CPU shares */
-    uint64_t pids_limit;     /* Max processes */
+    char *path;                  /* Cgroup path */
+    int64_t memory_limit;        /* memory.max, bytes */
+    int64_t memory_reservation;  /* memory.low, bytes */
+    int64_t memory_swap;         /* Memory plus swap; memory.swap.max gets the difference */
+    uint64_t cpu_shares;         /* CPU shares, mapped onto cpu.weight */
+    int64_t cpu_quota;           /* cpu.max quota, microseconds per period */
+    uint64_t cpu_period;         /* cpu.max period, microseconds */
+    int64_t cpu_burst;           /* cpu.max.burst, microseconds (if cpu_burst_set) */
+    int64_t cpu_idle;            /* cpu.idle: 1 for SCHED_IDLE (if cpu_idle_set) */
+    bool cpu_burst_set;          /* Write cpu.max.burst, even when it is 0 */
+    bool cpu_idle_set;           /* Write cpu.idle, even when it is 0 */
+    int64_t pids_limit;          /* pids.max */
+    uint64_t io_weight;          /* blkio weight 10..1000, mapped onto io.weight */
+    nk_cgroup_io_device_t *io_devices;  /* One entry per major:minor */
+    size_t io_devices_len;
 } nk_cgroup_config_t;
 
+/* cpuset placement policy (org.nano-sandbox.cpuset annotation, --cpuset) */
+typedef enum {
+    NK_CPUSET_NONE,          /* "none": cpuset and mempolicy are left alone (default) */
+    NK_CPUSET_PACKED,        /* "packed": least-loaded CPUs of the least-loaded NUMA node */
+    NK_CPUSET_SPREAD,        /* "spread": CPUs round-robin over nodes, memory interleaved */
+    NK_CPUSET_EXCLUSIVE      /* "exclusive": CPUs no other container is placed on */
+} nk_cpuset_policy_t;
+
+/* Where the container root filesystem comes from (NS_ROOTFS_MODE) */
+typedef enum {
+    NK_ROOTFS_BIND,          /* "bind": bundle rootfs used in place (default) */
+    NK_ROOTFS_OVERLAY,       /* "overlay": bundle rootfs is the lowerdir, upper in the state dir */
+    NK_ROOTFS_OVERLAY_TMPFS  /* "overlay-tmpfs": upper on a tmpfs private to the container */
+} nk_rootfs_mode_t;
+
 /* Container execution context */
 typedef struct nk_container_ctx {
     char *rootfs;                    /* Root filesystem path */
+    bool rootfs_readonly;            /* root.readonly: remount / read-only after pivot */
+    nk_rootfs_mode_t rootfs_mode;
+    char *overlay_dir;               /* Overlay modes: holds upper/, work/ and merged/ */
     char **mounts;                   /* Mount entries */
     size_t mounts_len;
     nk_namespace_config_t *namespaces;
     size_t namespaces_len;
     nk_cgroup_config_t *cgroup;
+    int cgroup_fd;                   /* Container cgroup dir for CLONE_INTO_CGROUP, or -1 */
+    nk_cpuset_policy_t cpuset_policy;
+    unsigned cpuset_cpus;            /* CPUs to place (0: derived from cpu.max) */
+    int mempolicy;                   /* set_mempolicy() mode for init, 0 to leave it */
+    unsigned long mempolicy_nodes;   /* Node mask for @mempolicy */
+    bool pin_cpus;                   /* No cpuset controller: sched_setaffinity(@cpus) */
+    cpu_set_t cpus;
     char **env;                      /* Environment variables */
     size_t env_len;
     char *cwd;                       /* Working directory */
     char **args;                     /* Process arguments */
     size_t args_len;
     bool terminal;                   /* Attach terminal */
+    nk_trace_t *trace;               /* Start phase timestamps, or NULL */
 } nk_container_ctx_t;
 
 /* Container API */
 
+/**
+ * nk_container_ctx_init - Build an execution context from an OCI spec
+ * @ctx: Context to fill
+ * @bundle_path: Bundle directory the spec was loaded from
+ * @spec: Parsed OCI spec (must outlive @ctx; args/env/cwd are borrowed)
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_container_ctx_init(nk_container_ctx_t *ctx, const char *bundle_path,
+                          const nk_oci_spec_t *spec);
+
+/**
+ * nk_container_ctx_release - Free memory owned by an execution context
+ * @ctx: Context initialized by nk_container_ctx_init()
+ */
+void nk_container_ctx_release(nk_container_ctx_t *ctx);
+
 /**
  * nk_namespace_get_clone_flags - Get clone flags from namespace config
  * @namespaces: Array of namespace configurations
@@ -103,10 +175,54 @@ int nk_container_setup_cgroups(const nk_container_ctx_t *ctx, const char *contai
  * nk_container_setup_rootfs - Setup root filesystem
  * @ctx: Container context
  *
+ * Runs in the container child. Mounts the overlay first in the overlay
+ * modes, and remounts the new root read-only when @ctx->rootfs_readonly.
+ *
  * Returns: 0 on success, -1 on error
  */
 int nk_container_setup_rootfs(const nk_container_ctx_t *ctx);
 
+/**
+ * nk_mount_template_prepare - Build the /dev mount template for this process
+ *
+ * Creates a tmpfs with fsopen()/fsmount(), fills it with the device nodes,
+ * /dev symlinks and mount points once, and makes its superblock read-only.
+ * Container children spawned afterwards attach their own clone of it
+ * (open_tree(OPEN_TREE_CLONE) + move_mount()) instead of mounting and
+ * populating /dev. proc, sysfs, devpts, /dev/shm and /dev/mqueue are still
+ * mounted per container. Building it costs more than one start saves, so
+ * only long-lived processes (ns-runtimed, batch) call this. Tried once per
+ * process; NS_NO_MOUNT_TEMPLATE=1 disables it.
+ *
+ * Returns: 0 if the template is in use, -1 if /dev is set up per container
+ */
+int nk_mount_template_prepare(void);
+
+/**
+ * nk_container_rootfs_prepare - Pick the rootfs mode for a container
+ * @ctx: Context from nk_container_ctx_init()
+ * @container_id: Container ID
+ *
+ * Reads NS_ROOTFS_MODE ("bind", "overlay" or "overlay-tmpfs"; unset or
+ * unknown means "bind"). The overlay modes mount the bundle rootfs as the
+ * read-only lowerdir of an overlay in <state_dir>/<container_id>/rootfs,
+ * so containers of one bundle share its files and page cache and nothing
+ * is copied per container. "overlay" creates upper/ and work/ there; with
+ * "overlay-tmpfs" the child mounts a tmpfs over that directory first, and
+ * writes vanish with the container's mount namespace.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_container_rootfs_prepare(nk_container_ctx_t *ctx, const char *container_id);
+
+/**
+ * nk_container_rootfs_remove - Remove a container's overlay directories
+ * @container_id: Container ID
+ *
+ * Returns: 0 on success or if there was nothing to remove, -1 on error
+ */
+int nk_container_rootfs_remove(const char *container_id);
+
 /**
  * nk_container_mount_custom - Mount custom mounts from OCI spec
  * @mounts: Array of mounts
@@ -126,6 +242,202 @@ int nk_container_mount_custom(const nk_oci_mount_t *mounts, size_t len,
  */
 pid_t nk_container_exec(const nk_container_ctx_t *ctx);
 
+/**
+ * nk_container_exec_parked - Prepare a container process without exec'ing
+ * @ctx: Container context (namespaces and rootfs are applied immediately)
+ * @launch_fd: Output for the parent end of the launch channel
+ *
+ * The child runs the full namespace/rootfs setup, then parks just before
+ * execve() until nk_container_launch() hands it args/env/cwd and stdio.
+ *
+ * Returns: PID of the parked child, or -1 on error
+ */
+pid_t nk_container_exec_parked(const nk_container_ctx_t *ctx, int *launch_fd);
+
+/**
+ * nk_container_exec_fifo - Prepare a container process parked on a FIFO
+ * @ctx: Container context (namespaces and rootfs are applied immediately)
+ * @exec_fifo: FIFO path to create; the child execs once it is read
+ *
+ * Returns: PID of the parked child, or -1 on error
+ */
+pid_t nk_container_exec_fifo(const nk_container_ctx_t *ctx, const char *exec_fifo);
+
+/**
+ * nk_container_release_fifo - Release a child parked on its exec FIFO
+ * @exec_fifo: FIFO path passed to nk_container_exec_fifo() (unlinked on success)
+ * @pid: PID of the parked child
+ * @timeout_ms: Maximum wait, or -1 to wait as long as the child is alive
+ *
+ * Returns: 0 once the child has been released, -1 on error
+ */
+int nk_container_release_fifo(const char *exec_fifo, pid_t pid, int timeout_ms);
+
+/**
+ * nk_container_launch - Release a parked child into the container process
+ * @pid: PID returned by nk_container_exec_parked()
+ * @launch_fd: Launch channel returned by nk_container_exec_parked() (closed)
+ * @ctx: Context supplying args, env and cwd
+ *
+ * The caller's current stdin/stdout/stderr become the process's stdio.
+ *
+ * Returns: 0 once the child has exec'd, -1 on error (child is not reaped)
+ */
+int nk_container_launch(pid_t pid, int launch_fd, const nk_container_ctx_t *ctx);
+
+/**
+ * nk_container_spawn - Clone the container init process
+ * @ctx: Container execution context
+ * @pidfd: Optional out pidfd for the child (-1 if unavailable), may be NULL
+ *
+ * Uses clone3() so the child starts inside ctx->cgroup_fd (when >= 0)
+ * and a pidfd comes back from the same syscall; falls back to clone()
+ * plus a cgroup.procs write on kernels without clone3().
+ *
+ * Returns: PID of container process, or -1 on error
+ */
+pid_t nk_container_spawn(const nk_container_ctx_t *ctx, int *pidfd);
+
+/**
+ * nk_cgroup_path - Path of a container's cgroup directory
+ * @container_id: Container ID
+ * @buf: Output buffer
+ * @len: Size of @buf
+ *
+ * The directory is named after the container, or after the pool slot it
+ * claimed (recorded in <state_dir>/<id>/cgroup). Does not check that the
+ * cgroup exists.
+ *
+ * Returns: 0 on success, -1 with errno ENAMETOOLONG if @buf is too small
+ */
+int nk_cgroup_path(const char *container_id, char *buf, size_t len);
+
+/**
+ * nk_cgroup_prepare - Create the nano-sandbox parent cgroup and open it
+ *
+ * Enables the controllers once and caches the directory fd, so later
+ * nk_cgroup_open() calls (including in forked children) skip that work.
+ * Controllers already enabled on the parent are not written again.
+ *
+ * Returns: 0 on success, -1 if cgroups v2 is unavailable
+ */
+int nk_cgroup_prepare(void);
+
+/**
+ * nk_cgroup_open - Create the container cgroup and open it
+ * @container_id: Container ID for cgroup naming
+ *
+ * The nano-sandbox parent cgroup is created and has its controllers
+ * enabled only once per process. With a cgroup pool, a pre-created slot
+ * is claimed instead of creating a cgroup; nk_cgroup_path() resolves it.
+ *
+ * Returns: O_DIRECTORY fd of the container cgroup, or -1 if unavailable
+ */
+int nk_cgroup_open(const char *container_id);
+
+/**
+ * nk_cgroup_pool_configure - Keep pre-created cgroups for nk_cgroup_open()
+ * @target: Free slots to keep (0 disables the pool)
+ *
+ * Only meaningful in a long-lived process (ns-runtimed): slots are handed
+ * out by the process that holds their directory fds. Slots whose owning
+ * process is gone (e.g. a SIGKILLed daemon) are removed first.
+ */
+void nk_cgroup_pool_configure(size_t target);
+
+/**
+ * nk_cgroup_pool_enabled - Check whether the cgroup pool is active
+ *
+ * Returns: true if nk_cgroup_pool_configure() set a non-zero target
+ */
+bool nk_cgroup_pool_enabled(void);
+
+/**
+ * nk_cgroup_pool_refill - Create one slot if the pool is below target
+ *
+ * Returns: true if a slot was created (call again), false otherwise
+ */
+bool nk_cgroup_pool_refill(void);
+
+/**
+ * nk_cgroup_pool_print_stats - Print pool size and hit/miss counters
+ */
+void nk_cgroup_pool_print_stats(void);
+
+/**
+ * nk_cgroup_pool_drain - Remove every unclaimed pool slot
+ */
+void nk_cgroup_pool_drain(void);
+
+/**
+ * nk_cgroup_apply - Write resource limits into a container cgroup
+ * @cgroup_fd: fd returned by nk_cgroup_open()
+ * @cfg: Limits to apply
+ *
+ * Every knob is opened with openat() on @cgroup_fd and written once; no
+ * cgroup path is rebuilt. All knobs are attempted, and each one that fails
+ * is reported on its own. Also used for live updates, so knobs are written
+ * in an order the kernel accepts from any previous setting: cpu.idle is
+ * cleared before cpu.weight, cpu.max.burst before cpu.max, and a period
+ * without a quota keeps the current quota. Each io device gets one
+ * io.weight, io.max and io.latency line, keyed by its major:minor.
+ *
+ * Returns: 0 if every set limit was written, -1 otherwise
+ */
+int nk_cgroup_apply(int cgroup_fd, const nk_cgroup_config_t *cfg);
+
+/**
+ * nk_cgroup_write - Write one knob of a cgroup
+ * @cgroup_fd: fd returned by nk_cgroup_open()
+ * @knob: File name inside the cgroup, opened with openat()
+ * @value: Value to write
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_cgroup_write(int cgroup_fd, const char *knob, const char *value);
+
+/**
+ * nk_cgroup_attach_fd - Move a process into a cgroup by directory fd
+ * @cgroup_fd: fd returned by nk_cgroup_open()
+ * @pid: Process ID
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int nk_cgroup_attach_fd(int cgroup_fd, pid_t pid);
+
+/**
+ * nk_cgroup_has_pid - Check that a process lives in a container's cgroup
+ * @container_id: Container ID
+ * @pid: Process ID
+ *
+ * Used to tell a container's init from an unrelated process that reused
+ * its PID. Nested cgroups below the container's count as inside.
+ *
+ * Returns: 1 if it does, 0 if it does not (or is gone), -1 if the
+ *          container has no cgroup to check against
+ */
+int nk_cgroup_has_pid(const char *container_id, pid_t pid);
+
+/**
+ * nk_cgroup_oom_kills - Count OOM kills inside a container's cgroup
+ * @container_id: Container ID
+ *
+ * Returns: oom_kill from memory.events, or -1 without a memory controller
+ */
+long long nk_cgroup_oom_kills(const char *container_id);
+
+/**
+ * nk_cgroup_kill - Signal every process in a container's cgroup
+ * @container_id: Container ID
+ * @sig: Signal number
+ *
+ * SIGKILL is delivered through cgroup.kill where the kernel supports it;
+ * otherwise (and for other signals) each PID in cgroup.procs is signalled.
+ *
+ * Returns: 0 on success, -1 with errno set (ENOENT if there is no cgroup)
+ */
+int nk_cgroup_kill(const char *container_id, int sig);
+
 /**
  * nk_container_add_to_cgroup - Add process to container cgroup
  * @container_id: Container ID
@@ -153,10 +465,54 @@ int nk_container_wait(pid_t pid, int *status);
  */
 int nk_container_signal(pid_t pid, int sig);
 
+/**
+ * nk_container_pidfd - Open a pidfd for a container's init process
+ * @container_id: Container ID, or NULL to skip the cgroup check
+ * @pid: Recorded init PID
+ *
+ * Once open, the pidfd pins the process: signals sent through it cannot
+ * reach a later process that reuses @pid. The process is checked against
+ * the container cgroup after opening, so a PID already reused is refused.
+ *
+ * Returns: pidfd, or -1 with errno set (ESRCH if the init process is gone
+ *          or has exited and awaits reaping, ENOSYS if the kernel has no
+ *          pidfd_open)
+ */
+int nk_container_pidfd(const char *container_id, pid_t pid);
+
+/**
+ * nk_container_pidfd_signal - Send a signal through a pidfd
+ * @pidfd: fd returned by nk_container_pidfd()
+ * @sig: Signal number
+ *
+ * Returns: 0 on success, -1 with errno set
+ */
+int nk_container_pidfd_signal(int pidfd, int sig);
+
+/**
+ * nk_container_stop - Stop a container's processes
+ * @container_id: Container ID
+ * @pid: Recorded init PID
+ * @grace_ms: How long init gets to exit after SIGTERM; 0 skips SIGTERM
+ *
+ * Sends SIGTERM through a pidfd and waits for it to become readable (init
+ * exited) for at most @grace_ms, then SIGKILLs the whole cgroup through
+ * cgroup.kill. SIGTERM is skipped when init would ignore it (a PID
+ * namespace init without a handler), so such containers do not sit out
+ * the grace period. Falls back to kill() and polling without pidfds.
+ *
+ * Returns: 0 once init is gone, -1 if it could not be stopped
+ */
+int nk_container_stop(const char *container_id, pid_t pid, int grace_ms);
+
 /**
  * nk_cgroup_cleanup - Cleanup cgroup resources
  * @container_id: Container ID
  *
+ * Call before nk_state_delete(): the claimed pool slot is looked up in the
+ * state directory. A cgroup whose processes are still exiting is removed
+ * by a detached helper once it empties, so this does not wait for them.
+ *
  * Returns: 0 on success, -1 on error
  */
 int nk_cgroup_cleanup(const char *container_id);
@@ -0,0 +1,72 @@
+#ifndef NK_DAEMON_H
+#define NK_DAEMON_H
+
+#include <stdbool.h>
+
+/* Socket file name, created inside the runtime state directory */
+#define NK_DAEMON_SOCKET_NAME "ns-runtimed.sock"
+
+/* Environment variable that forces the CLI to bypass a running daemon */
+#define NK_DAEMON_BYPASS_ENV "NS_NO_DAEMON"
+
+/**
+ * nk_daemon_handler_t - Command handler invoked by the daemon per request
+ * @argc: Argument count of the forwarded CLI invocation
+ * @argv: Argument vector of the forwarded CLI invocation
+ *
+ * Returns: Process exit code the CLI client should report
+ */
+typedef int (*nk_daemon_handler_t)(int argc, char *argv[]);
+
+/**
+ * nk_daemon_idle_fn - Background work run between requests
+ *
+ * Called repeatedly while no client is waiting, after every request and
+ * whenever the daemon has been idle for its poll interval.
+ *
+ * Returns: true if more work is pending and it should be called again
+ */
+typedef bool (*nk_daemon_idle_fn)(void);
+
+/**
+ * nk_daemon_set_idle_handler - Install background work for ns-runtimed
+ * @fn: Callback, or NULL to remove
+ */
+void nk_daemon_set_idle_handler(nk_daemon_idle_fn fn);
+
+/**
+ * nk_daemon_serve - Run the long-lived lifecycle daemon (ns-runtimed)
+ * @state_dir: Runtime state directory (socket is created inside it)
+ * @handler: Command handler used to serve forwarded CLI invocations
+ *
+ * Listens on <state_dir>/ns-runtimed.sock and serves requests one at a
+ * time until SIGINT/SIGTERM. Container state and parsed OCI specs are
+ * kept in memory for the lifetime of the daemon.
+ *
+ * Returns: 0 on clean shutdown, -1 on error
+ */
+int nk_daemon_serve(const char *state_dir, nk_daemon_handler_t handler);
+
+/**
+ * nk_daemon_forward - Forward a CLI invocation to a running daemon
+ * @state_dir: Runtime state directory used to locate the socket
+ * @argc: Argument count
+ * @argv: Argument vector
+ * @exit_code: Output for the exit code reported by the daemon
+ *
+ * The caller's stdin/stdout/stderr are passed to the daemon so command
+ * output is identical to a local invocation.
+ *
+ * Returns: 0 if the daemon served the request, 1 if no daemon is
+ *          listening (caller should run the command locally), -1 on error
+ */
+int nk_daemon_forward(const char *state_dir, int argc, char *argv[], int *exit_code);
+
+/**
+ * nk_daemon_is_bypassed - Check whether daemon forwarding is disabled
+ *
+ * Returns: true if NS_NO_DAEMON is set to a non-empty, non-"0" value
+ */
+bool nk_daemon_is_bypassed(void);
+
+#endif /* NK_DAEMON_H */
@@ -12,6 +12,14 @@ typedef enum {
     NK_LOG_ERROR
 } nk_log_level_t;
 
+/*
+ * Call sites below this level are compiled out (0=debug .. 3=error).
+ * Set with make LOG_MIN_LEVEL=debug|info|warn|error.
+ */
+#ifndef NK_LOG_MIN_LEVEL
+#define NK_LOG_MIN_LEVEL 0
+#endif
+
 /* Log role (originating process context) */
 typedef enum {
     NK_LOG_ROLE_HOST = 0,
@@ -61,11 +69,17 @@ void nk_log_set_role(nk_log_role_t role);
 /**
  * nk_log_at - Log a message at specified level with call-site source location
  * @level: Log level
- * @file: Source file
+ * @file: Source file (must outlive the next flush, e.g. __FILE__)
  * @line: Source line
- * @fmt: Printf-style format string
+ * @fmt: Printf-style format string (must outlive the next flush, e.g. a literal)
+ *
+ * Appends a binary record (timestamp, level, role, call site, raw arguments)
+ * to the per-process log ring; formatting happens in nk_log_flush(). String
+ * arguments are copied, everything else by value. ERROR records, and
+ * records whose arguments do not fit, flush immediately.
  */
-void nk_log_at(nk_log_level_t level, const char *file, int line, const char *fmt, ...);
+void nk_log_at(nk_log_level_t level, const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
 
 /**
  * nk_log_explain_at - Log an educational explanation with source location
@@ -73,6 +87,8 @@ void nk_log_at(nk_log_level_t level, const char *file, int line, const char *fmt
  * @line: Source line
  * @what: What operation is being performed
  * @why: Why it's needed (educational context)
+ *
+ * Queued in the log ring like nk_log_at(), in order with the other records.
  */
 void nk_log_explain_at(const char *file, int line, const char *what, const char *why);
 
@@ -81,20 +97,31 @@ void nk_log_explain_at(const char *file, int line, const char *what, const char
  * @file: Source file
  * @line: Source line
  * @fmt: Printf-style format string
+ *
+ * User-facing output: flushes the log ring, then prints synchronously.
+ */
+void nk_log_stderr_at(const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * nk_log_flush - Format queued log records and write them to stderr
+ *
+ * Runs at exit, when the ring fills up, and wherever buffered records
+ * would otherwise be lost or misordered: before clone()/fork(), before
+ * execve(), before blocking waits and around ns-runtimed stdio swaps.
  */
-void nk_log_stderr_at(const char *file, int line, const char *fmt, ...);
+void nk_log_flush(void);
 
-/* Convenience macros */
+/* Convenience macros; levels below NK_LOG_MIN_LEVEL compile to nothing */
 #define nk_log(level, fmt, ...) \
-    nk_log_at((level), __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define nk_log_debug(fmt, ...) \
-    nk_log_at(NK_LOG_DEBUG, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define nk_log_info(fmt, ...) \
-    nk_log_at(NK_LOG_INFO, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define nk_log_warn(fmt, ...) \
-    nk_log_at(NK_LOG_WARN, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
-#define nk_log_error(fmt, ...) \
-    nk_log_at(NK_LOG_ERROR, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+    do { \
+        if ((int)(level) >= NK_LOG_MIN_LEVEL) \
+            nk_log_at((level), __FILE__, __LINE__, (fmt), ##__VA_ARGS__); \
+    } while (0)
+#define nk_log_debug(fmt, ...) nk_log(NK_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define nk_log_info(fmt, ...)  nk_log(NK_LOG_INFO, fmt, ##__VA_ARGS__)
+#define nk_log_warn(fmt, ...)  nk_log(NK_LOG_WARN, fmt, ##__VA_ARGS__)
+#define nk_log_error(fmt, ...) nk_log(NK_LOG_ERROR, fmt, ##__VA_ARGS__)
 #define nk_log_explain(what, why) \
     nk_log_explain_at(__FILE__, __LINE__, (what), (why))
 #define nk_stderr(fmt, ...) \
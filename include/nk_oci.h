@@ -43,27 +43,54 @@ typedef struct nk_oci_namespace {
     char *path;                    /* Namespace path (for joining) */
 } nk_oci_namespace_t;
 
-/* OCI runtime spec - Linux resource limits */
+/* OCI runtime spec - linux.resources.blockIO device lists */
+typedef enum {
+    NK_OCI_BLKIO_WEIGHT_DEVICE,    /* weightDevice, value is the weight */
+    NK_OCI_BLKIO_READ_BPS,         /* throttleReadBpsDevice, value is the rate */
+    NK_OCI_BLKIO_WRITE_BPS,        /* throttleWriteBpsDevice */
+    NK_OCI_BLKIO_READ_IOPS,        /* throttleReadIOPSDevice */
+    NK_OCI_BLKIO_WRITE_IOPS,       /* throttleWriteIOPSDevice */
+    NK_OCI_BLKIO_LISTS
+} nk_oci_blkio_list_t;
+
+/* OCI runtime spec - one blockIO device entry */
+typedef struct nk_oci_blkio_device {
+    int64_t major;
+    int64_t minor;
+    int64_t value;                 /* weight or rate, by list */
+} nk_oci_blkio_device_t;
+
+/* OCI runtime spec - Linux resource limits (0: not set, -1: unlimited) */
 typedef struct nk_oci_resources {
-    /* Memory limits */
+    /* Memory limits, in bytes */
     struct {
-        uint64_t limit;
-        uint64_t reservation;
-        uint64_t swap;
-        bool kernel;
+        int64_t limit;
+        int64_t reservation;
+        int64_t swap;              /* Memory plus swap */
+        int64_t kernel;            /* Deprecated; no cgroup v2 equivalent */
     } memory;
 
     /* CPU limits */
     struct {
         uint64_t shares;
-        uint64_t quota;
-        uint64_t period;
-        int realtime_runtime;
-        int realtime_period;
+        int64_t quota;             /* Microseconds per period */
+        uint64_t period;           /* Microseconds */
+        uint64_t burst;            /* Microseconds above quota a period may borrow */
+        int64_t idle;              /* 1: SCHED_IDLE cgroup */
+        int64_t realtime_runtime;  /* No cgroup v2 equivalent */
+        uint64_t realtime_period;  /* No cgroup v2 equivalent */
     } cpu;
 
     /* Process limits */
-    uint64_t pids_limit;
+    int64_t pids_limit;
+
+    /* Block IO limits */
+    struct {
+        uint64_t weight;           /* 10..1000 */
+        int64_t leaf_weight;       /* No cgroup v2 equivalent */
+        nk_oci_blkio_device_t *devices[NK_OCI_BLKIO_LISTS];
+        size_t devices_len[NK_OCI_BLKIO_LISTS];
+    } blkio;
 } nk_oci_resources_t;
 
 /* OCI runtime spec - Linux configuration */
@@ -85,6 +112,8 @@ typedef struct nk_oci_spec {
     nk_oci_linux_t *linux_config;  /* Linux-specific config */
     char **annotations;            /* Annotations (key=value) */
     size_t annotations_len;
+    void *image;                   /* Compiled image mapping backing this spec, or NULL */
+    size_t image_len;
 } nk_oci_spec_t;
 
 /* OCI spec API */
@@ -120,4 +149,26 @@ bool nk_oci_spec_validate(const nk_oci_spec_t *spec);
  */
 const char *nk_oci_spec_get_annotation(const nk_oci_spec_t *spec, const char *key);
 
+/**
+ * nk_oci_spec_cache_enable - Keep parsed specs in memory between loads
+ * @enabled: true to enable the cache, false to disable and drop it
+ *
+ * Intended for long-lived processes (ns-runtimed). Entries are keyed by
+ * bundle path and revalidated against config.json identity (inode, size,
+ * mtime); nk_oci_spec_load() then returns a private copy of the cached
+ * spec instead of re-reading and re-parsing the file.
+ */
+void nk_oci_spec_cache_enable(bool enabled);
+
+/**
+ * nk_oci_spec_image_dir - Keep compiled binary images of parsed specs
+ * @dir: Directory for images (created on first use), or NULL to disable
+ *
+ * nk_oci_spec_load() then maps a flat image of the previously parsed spec,
+ * keyed by bundle path and config.json identity (device, inode, size,
+ * mtime), instead of re-reading and re-parsing config.json. Images are
+ * rewritten whenever config.json changes.
+ */
+void nk_oci_spec_image_dir(const char *dir);
+
 #endif /* NK_OCI_H */
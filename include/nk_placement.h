@@ -0,0 +1,63 @@
+#ifndef NK_PLACEMENT_H
+#define NK_PLACEMENT_H
+
+#include "nk_container.h"
+
+/* Annotations selecting the cpuset policy and the number of CPUs */
+#define NK_CPUSET_ANNOTATION "org.nano-sandbox.cpuset"
+#define NK_CPUSET_CPUS_ANNOTATION "org.nano-sandbox.cpuset.cpus"
+
+/* NUMA nodes the placement engine tracks (bits of a node mask) */
+#define NK_PLACEMENT_MAX_NODES 64
+
+/**
+ * nk_cpuset_policy_parse - Parse a policy name
+ * @name: "none", "packed", "spread" or "exclusive"
+ * @policy: Set to the parsed policy
+ *
+ * Returns: 0 on success, -1 if @name is not a policy
+ */
+int nk_cpuset_policy_parse(const char *name, nk_cpuset_policy_t *policy);
+
+/**
+ * nk_placement_request - Record a policy that overrides the annotation
+ * @container_id: Container ID
+ * @policy: Policy chosen on the command line (create/run --cpuset)
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_placement_request(const char *container_id, nk_cpuset_policy_t policy);
+
+/**
+ * nk_placement_apply - Place a container on CPUs and NUMA nodes
+ * @container_id: Container ID
+ * @cgroup_fd: fd returned by nk_cgroup_open()
+ * @ctx: Context with the policy and CPU count; receives the mempolicy
+ *
+ * Reads the CPU and node topology from sysfs, limited to the CPUs the
+ * parent cgroup may use, and picks CPUs against the allocations of every
+ * other container. The allocation table in the state directory is locked
+ * for the whole read-pick-write, so concurrent starts never pick from the
+ * same snapshot. The result is written to cpuset.cpus and cpuset.mems;
+ * without a cpuset controller, init is pinned with sched_setaffinity()
+ * instead. Does nothing for NK_CPUSET_NONE.
+ *
+ * Returns: 0 on success, -1 after printing an error
+ */
+int nk_placement_apply(const char *container_id, int cgroup_fd, nk_container_ctx_t *ctx);
+
+/**
+ * nk_placement_release - Return a container's CPUs to the allocator
+ * @container_id: Container ID
+ */
+void nk_placement_release(const char *container_id);
+
+/**
+ * nk_placement_set_mempolicy - Apply the context's mempolicy and pinning
+ * @ctx: Context filled by nk_placement_apply()
+ *
+ * Called in the container init before execve(). Failures only warn.
+ */
+void nk_placement_set_mempolicy(const nk_container_ctx_t *ctx);
+
+#endif /* NK_PLACEMENT_H */
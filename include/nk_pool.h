@@ -0,0 +1,68 @@
+#ifndef NK_POOL_H
+#define NK_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "nk_container.h"
+
+/* Maximum number of bundles the warm pool keeps children for */
+#define NK_POOL_MAX_BUNDLES 16
+
+/**
+ * nk_pool_configure - Enable the warm pool of pre-cloned container children
+ * @target: Parked children to keep per bundle (0 disables the pool)
+ * @refill_rate: Maximum children spawned per second (0 means @target)
+ *
+ * Only meaningful in a long-lived process (ns-runtimed): parked children
+ * are children of the process that spawned them.
+ */
+void nk_pool_configure(size_t target, size_t refill_rate);
+
+/**
+ * nk_pool_enabled - Check whether the warm pool is active
+ *
+ * Returns: true if nk_pool_configure() set a non-zero target
+ */
+bool nk_pool_enabled(void);
+
+/**
+ * nk_pool_track - Register a bundle so refill keeps children parked for it
+ * @bundle_path: Bundle directory (resolved with realpath)
+ */
+void nk_pool_track(const char *bundle_path);
+
+/**
+ * nk_pool_claim - Take a parked child for a bundle and launch it
+ * @bundle_path: Bundle directory of the container being started
+ * @ctx: Execution context supplying args, env and cwd
+ *
+ * Children parked before config.json last changed are discarded. Overlay
+ * rootfs modes always miss: parked children use the bundle rootfs in place.
+ *
+ * Returns: PID of the launched container process, or -1 on a pool miss
+ */
+pid_t nk_pool_claim(const char *bundle_path, const nk_container_ctx_t *ctx);
+
+/**
+ * nk_pool_refill - Spawn one parked child for a tracked bundle below target
+ *
+ * Spawning is capped at the configured refill rate per second, so callers
+ * can invoke this in a loop while they are otherwise idle.
+ *
+ * Returns: true if a child was spawned and more may be needed
+ */
+bool nk_pool_refill(void);
+
+/**
+ * nk_pool_print_stats - Print pool size, refill rate and hit/miss counters
+ */
+void nk_pool_print_stats(void);
+
+/**
+ * nk_pool_drain - Kill and reap every parked child, forget all bundles
+ */
+void nk_pool_drain(void);
+
+#endif /* NK_POOL_H */
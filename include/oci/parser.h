@@ -0,0 +1,71 @@
+#ifndef NK_OCI_PARSER_H
+#define NK_OCI_PARSER_H
+
+#include <stddef.h>
+
+#include "nk_oci.h"
+#include "common/arena.h"
+
+/* Required fields the parsers found missing (reported after parsing) */
+#define NK_OCI_MISSING_ARGS       (1u << 0)   /* process.args absent or not an array */
+#define NK_OCI_MISSING_ROOT_PATH  (1u << 1)   /* root.path absent or not a string */
+
+/**
+ * nk_oci_spec_new - Allocate an empty spec with its own arena
+ * @size_hint: Arena bytes to reserve in the same allocation as the spec
+ *
+ * Every string and array of the spec must come from nk_oci_spec_arena();
+ * nk_oci_spec_free() then releases it all at once.
+ *
+ * Returns: Zeroed spec, or NULL if out of memory
+ */
+nk_oci_spec_t *nk_oci_spec_new(size_t size_hint);
+
+/**
+ * nk_oci_spec_arena - Arena backing a spec from nk_oci_spec_new()
+ * @spec: Spec
+ *
+ * Returns: The spec's arena
+ */
+nk_arena_t *nk_oci_spec_arena(nk_oci_spec_t *spec);
+
+/**
+ * nk_oci_stream_parse - Single-pass config.json parser for the fields we use
+ * @json: config.json contents (need not be NUL-terminated)
+ * @len: Length of @json in bytes
+ * @spec_out: Receives the parsed spec on success
+ * @missing: Receives NK_OCI_MISSING_* flags on success
+ *
+ * Decodes straight into nk_oci_spec_t without building a DOM. Anything it
+ * does not handle byte-for-byte like jansson (syntax errors, duplicate keys,
+ * out-of-range numbers, non-object top level, ...) is left to the jansson
+ * parser, so the caller sees identical results either way. Never prints.
+ *
+ * Returns: 0 with *spec_out set, or -1 when the caller must parse @json
+ *          with nk_oci_jansson_parse() instead
+ */
+int nk_oci_stream_parse(const char *json, size_t len, nk_oci_spec_t **spec_out,
+                        unsigned *missing);
+
+/**
+ * nk_oci_jansson_parse - Parse config.json through a jansson DOM
+ * @json: NUL-terminated config.json contents
+ *
+ * Returns: Parsed spec, or NULL after printing the parse error
+ */
+nk_oci_spec_t *nk_oci_jansson_parse(const char *json);
+
+/**
+ * nk_oci_spec_parse - Parse config.json contents with the configured parser
+ * @json: config.json contents (need not be NUL-terminated)
+ * @len: Length of @json in bytes
+ *
+ * Uses nk_oci_stream_parse() and falls back to nk_oci_jansson_parse();
+ * builds with NK_OCI_JANSSON_ONLY always use jansson. Output, including
+ * error messages, is identical to nk_oci_jansson_parse() on the same bytes.
+ *
+ * Returns: Parsed spec, or NULL after printing the parse error
+ */
+nk_oci_spec_t *nk_oci_spec_parse(const char *json, size_t len);
+
+#endif /* NK_OCI_PARSER_H */
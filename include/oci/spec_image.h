@@ -0,0 +1,40 @@
+#ifndef NK_SPEC_IMAGE_H
+#define NK_SPEC_IMAGE_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "nk_oci.h"
+
+/**
+ * nk_spec_image_enabled - Check whether a compiled image directory is set
+ *
+ * Returns: true if nk_oci_spec_image_dir() configured a directory
+ */
+bool nk_spec_image_enabled(void);
+
+/**
+ * nk_spec_image_load - Map the compiled image of a bundle's config.json
+ * @bundle_path: Bundle directory the spec was loaded from
+ * @config_st: Current stat() of the bundle's config.json
+ *
+ * The image is used in place: its offsets are relocated to pointers in a
+ * private mapping, and nk_oci_spec_free() unmaps it.
+ *
+ * Returns: Spec backed by the mapping, or NULL if there is no valid image
+ *          for this exact config.json identity
+ */
+nk_oci_spec_t *nk_spec_image_load(const char *bundle_path, const struct stat *config_st);
+
+/**
+ * nk_spec_image_store - Write the compiled image of a freshly parsed spec
+ * @bundle_path: Bundle directory the spec was loaded from
+ * @config_st: stat() of config.json taken before it was parsed
+ * @spec: Parsed spec
+ *
+ * Best effort: failures are logged at debug level and otherwise ignored.
+ */
+void nk_spec_image_store(const char *bundle_path, const struct stat *config_st,
+                         const nk_oci_spec_t *spec);
+
+#endif /* NK_SPEC_IMAGE_H */
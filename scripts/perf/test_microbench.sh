@@ -8,7 +8,40 @@ SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 source "$SCRIPT_DIR/common.sh"
 
 ITERATIONS="${ITERATIONS:-20}"
+PATH_DEPTH="${PATH_DEPTH:-32}"
 TEST_PREFIX="nk-micro"
+LONG_BUNDLE_ROOT=""
+
+cleanup() {
+    if [ -n "$LONG_BUNDLE_ROOT" ]; then
+        "${PERF_SUDO[@]}" rm -rf "$LONG_BUNDLE_ROOT"
+    fi
+}
+trap cleanup EXIT
+
+# Sum of the child-side trace phases (mounts, /dev, pivot) of one container
+child_setup_us() {
+    "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" trace "$1" 2>/dev/null |
+        awk '$2 == "child" { sum += $4 } END { printf "%.0f\n", sum }'
+}
+
+# Average child setup time over ITERATIONS containers from one bundle
+measure_setup() {
+    local bundle="$1"
+    local tag="$2"
+    local sum=0
+
+    for i in $(seq 1 "$ITERATIONS"); do
+        local id="${TEST_PREFIX}-${tag}-${i}-$$"
+
+        "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" create --bundle="$bundle" "$id" >/dev/null 2>&1
+        "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" start "$id" >/dev/null 2>&1
+        sum=$((sum + $(child_setup_us "$id")))
+        "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" delete "$id" >/dev/null 2>&1
+    done
+
+    echo $((sum / ITERATIONS))
+}
 
 perf_header "nano-sandbox Microbenchmark"
 echo "Quick lifecycle test (${ITERATIONS} iterations)"
@@ -51,3 +84,22 @@ elif [ "$avg_us" -lt 100000 ]; then
 else
     echo -e "${RED}✗ Slow (> 100ms avg lifecycle)${NC}"
 fi
+
+echo
+perf_section "Setup path vs bundle path length (${PATH_DEPTH} components)"
+
+LONG_BUNDLE_ROOT=$(mktemp -d /tmp/nk-micro-path.XXXXXX)
+long_bundle="$LONG_BUNDLE_ROOT"
+for i in $(seq 1 "$PATH_DEPTH"); do
+    long_bundle="${long_bundle}/nested-bundle-directory-level-$(printf '%02d' "$i")"
+done
+"${PERF_SUDO[@]}" mkdir -p "$long_bundle"
+"${PERF_SUDO[@]}" cp -a "$NS_TEST_BUNDLE/." "$long_bundle/"
+
+short_us=$(measure_setup "$NS_TEST_BUNDLE" short)
+long_us=$(measure_setup "$long_bundle" long)
+
+echo "  Bundle path length:   ${#NS_TEST_BUNDLE} / ${#long_bundle} bytes"
+echo "  Child setup (short):  $(perf_ms_from_us "$short_us") ms"
+echo "  Child setup (long):   $(perf_ms_from_us "$long_us") ms"
+echo "  Long-path overhead:   $(perf_ms_from_us $((long_us - short_us))) ms"
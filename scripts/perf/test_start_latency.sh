@@ -12,9 +12,11 @@ WARMUP_RUNS="${WARMUP_RUNS:-20}"
 START_RUNS="${START_RUNS:-500}"
 VERIFY_RUNNING="${VERIFY_RUNNING:-1}"
 PROGRESS_STEP="${PROGRESS_STEP:-50}"
+TRACE_PHASES="${TRACE_PHASES:-1}"
 
 SAMPLES_FILE="$(mktemp -t ns-start-latency.XXXXXX)"
-trap 'rm -f "$SAMPLES_FILE"' EXIT
+PHASES_FILE="$(mktemp -t ns-start-phases.XXXXXX)"
+trap 'rm -f "$SAMPLES_FILE" "$PHASES_FILE"' EXIT
 
 calc_stats() {
     awk '
@@ -94,13 +96,38 @@ calc_trimmed_mean() {
     '
 }
 
+# Per-phase mean and p50 from "<phase> <us>" lines, in first-seen order
+calc_phase_stats() {
+    awk '
+    {
+        if (!($1 in n)) order[count++] = $1
+        vals[$1, n[$1]++] = $2
+        sum[$1] += $2
+    }
+    END {
+        printf "  %-16s %10s %10s\n", "Phase", "Mean(us)", "p50(us)"
+        for (i = 0; i < count; i++) {
+            p = order[i]
+            m = n[p]
+            for (a = 0; a < m; a++) sorted[a] = vals[p, a]
+            for (a = 1; a < m; a++) {
+                v = sorted[a]
+                for (b = a - 1; b >= 0 && sorted[b] > v; b--) sorted[b + 1] = sorted[b]
+                sorted[b + 1] = v
+            }
+            printf "  %-16s %10.1f %10.1f\n", p, sum[p] / m, sorted[int((m - 1) * 0.50)]
+        }
+    }
+    '
+}
+
 cleanup_container() {
     local id="$1"
     "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" delete "$id" >/dev/null 2>&1 || true
 }
 
 perf_header "nano-sandbox Start Latency Benchmark"
-echo "Configuration: warmup=${WARMUP_RUNS}, runs=${START_RUNS}, verify_running=${VERIFY_RUNNING}"
+echo "Configuration: warmup=${WARMUP_RUNS}, runs=${START_RUNS}, verify_running=${VERIFY_RUNNING}, trace_phases=${TRACE_PHASES}"
 
 perf_require_env
 
@@ -150,6 +177,10 @@ for i in $(seq 1 "$START_RUNS"); do
     fi
 
     echo "$start_us" >>"$SAMPLES_FILE"
+    if [ "$TRACE_PHASES" = "1" ]; then
+        "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" trace "$id" 2>/dev/null |
+            awk 'NR > 1 && $1 != "total" { print $1, $4 }' >>"$PHASES_FILE" || true
+    fi
     success=$((success + 1))
     cleanup_container "$id"
     perf_progress_dot "$i" "$PROGRESS_STEP"
@@ -170,5 +201,11 @@ echo "  Successful:  ${success}"
 echo "  Failed:      ${failed}"
 echo
 
+if [ -s "$PHASES_FILE" ]; then
+    echo -e "${GREEN}Start Phase Breakdown (ns-runtime trace):${NC}"
+    calc_phase_stats <"$PHASES_FILE"
+    echo
+fi
+
 mean_us="$(awk '{sum+=$1} END {if (NR>0) print sum/NR; else print 0}' "$SAMPLES_FILE")"
 echo -e "${GREEN}Average start latency over ${success} successful runs: $(perf_ms_from_us "$mean_us") ms${NC}"
@@ -12,12 +12,25 @@ ITERATIONS="${ITERATIONS:-100}"
 STRESS_COUNT="${STRESS_COUNT:-300}"
 QUERY_COUNT="${QUERY_COUNT:-1000}"
 CONCURRENT_COUNTS=(10 50 100)
+SYNC_ITERATIONS="${SYNC_ITERATIONS:-50}"
+SYNC_CONCURRENT="${SYNC_CONCURRENT:-50}"
+STATE_SYNC_MODES="${STATE_SYNC_MODES:-none always group}"
+LIST_COUNT="${LIST_COUNT:-1000}"
+LIST_RUNS="${LIST_RUNS:-10}"
+BATCH_WORKERS="${BATCH_WORKERS:-0}"
+USE_DAEMON="${USE_DAEMON:-0}"
+WARM_POOL="${WARM_POOL:-0}"
+DAEMON_PID=""
 
 cleanup() {
     echo -e "\n${YELLOW}Cleaning up stress containers...${NC}"
     for i in $(seq 1 "$STRESS_COUNT"); do
         "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" delete "${TEST_NAME}-stress-${i}-$$" >/dev/null 2>&1 || true
     done
+    if [ -n "$DAEMON_PID" ]; then
+        "${PERF_SUDO[@]}" kill "$DAEMON_PID" >/dev/null 2>&1 || true
+        wait "$DAEMON_PID" 2>/dev/null || true
+    fi
     echo -e "${GREEN}✓ Cleanup complete${NC}"
 }
 trap cleanup EXIT
@@ -31,6 +44,13 @@ ns_elapsed_us() {
 perf_header "nano-sandbox Throughput & Stress"
 perf_require_env
 
+if [ "$USE_DAEMON" = "1" ]; then
+    echo "Starting ns-runtimed (USE_DAEMON=1, WARM_POOL=${WARM_POOL})"
+    "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" daemon --warm-pool="$WARM_POOL" >/dev/null 2>&1 &
+    DAEMON_PID=$!
+    sleep 0.5
+fi
+
 perf_section "Test 1: Sequential Lifecycle Throughput"
 echo "Running ${ITERATIONS} create/start/delete cycles..."
 
@@ -57,6 +77,7 @@ echo "  Throughput:  ${seq_tput} containers/sec"
 
 echo
 perf_section "Test 2: Concurrent Lifecycle Throughput"
+conc_summary=()
 
 for n in "${CONCURRENT_COUNTS[@]}"; do
     echo "Concurrent count: ${n}"
@@ -82,6 +103,7 @@ for n in "${CONCURRENT_COUNTS[@]}"; do
     echo "  Avg latency: ${avg_ms} ms"
     echo "  Throughput:  ${tput} ops/sec"
     echo
+    conc_summary+=("${n}=${tput}/s")
 
 done
 
@@ -138,8 +160,120 @@ echo "  Total time:  ${query_total_s} s"
 echo "  Avg latency: ${query_avg_ms} ms"
 echo "  Query rate:  ${query_qps} qps"
 
+echo
+perf_section "Test 5: State Write Durability (NS_STATE_SYNC)"
+echo "Sequential: ${SYNC_ITERATIONS} create/start/delete cycles; concurrent: ${SYNC_CONCURRENT} at once"
+if [ "$USE_DAEMON" = "1" ]; then
+    echo "  (ns-runtimed serves these with its own NS_STATE_SYNC; set USE_DAEMON=0 to compare modes)"
+fi
+
+sync_summary=()
+for mode in $STATE_SYNC_MODES; do
+    sync_cmd=("${PERF_CMD_PREFIX[@]}" NS_STATE_SYNC="$mode")
+
+    start_ns=$(date +%s%N)
+    for i in $(seq 1 "$SYNC_ITERATIONS"); do
+        id="${TEST_NAME}-sync-${mode}-${i}-$$"
+        "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" create --bundle="$NS_TEST_BUNDLE" "$id" >/dev/null 2>&1
+        "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" start "$id" >/dev/null 2>&1
+        "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" delete "$id" >/dev/null 2>&1 || true
+    done
+    end_ns=$(date +%s%N)
+    seq_us=$(ns_elapsed_us "$start_ns" "$end_ns")
+    seq_rate=$(echo "scale=1; $SYNC_ITERATIONS * 1000000 / $seq_us" | bc)
+
+    start_ns=$(date +%s%N)
+    for i in $(seq 1 "$SYNC_CONCURRENT"); do
+        id="${TEST_NAME}-sync-${mode}-conc-${i}-$$"
+        (
+            "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" create --bundle="$NS_TEST_BUNDLE" "$id" >/dev/null 2>&1 &&
+            "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" start "$id" >/dev/null 2>&1 &&
+            "${PERF_SUDO[@]}" "${sync_cmd[@]}" "$NS_RUNTIME_BIN" delete "$id" >/dev/null 2>&1
+        ) &
+    done
+    wait
+    end_ns=$(date +%s%N)
+    conc_us=$(ns_elapsed_us "$start_ns" "$end_ns")
+    conc_rate=$(echo "scale=1; $SYNC_CONCURRENT * 1000000 / $conc_us" | bc)
+
+    printf "  %-8s sequential: %8s containers/sec   concurrent: %8s ops/sec\n" "$mode" "$seq_rate" "$conc_rate"
+    sync_summary+=("$(printf "%s=%s/%s" "$mode" "$seq_rate" "$conc_rate")")
+done
+
+echo
+perf_section "Test 6: List (${LIST_COUNT} containers per state backend)"
+list_summary=()
+for backend in json table; do
+    list_cmd=("${PERF_CMD_PREFIX[@]}" NS_STATE_BACKEND="$backend")
+
+    for i in $(seq 1 "$LIST_COUNT"); do
+        "${PERF_SUDO[@]}" "${list_cmd[@]}" "$NS_RUNTIME_BIN" create --bundle="$NS_TEST_BUNDLE" \
+            "${TEST_NAME}-list-${backend}-${i}-$$" >/dev/null 2>&1 || true
+        perf_progress_dot "$i" 100
+    done
+    echo
+
+    list_total_us=0
+    for _ in $(seq 1 "$LIST_RUNS"); do
+        t=$(perf_time_us "${list_cmd[@]}" "$NS_RUNTIME_BIN" list --json)
+        list_total_us=$((list_total_us + t))
+    done
+    list_avg_ms=$(perf_ms_from_us $((list_total_us / LIST_RUNS)))
+    listed=$("${list_cmd[@]}" "$NS_RUNTIME_BIN" list --json 2>/dev/null | grep -c "\"${TEST_NAME}-list-${backend}-" || true)
+    printf "  %-6s listed %6s   avg: %8s ms\n" "$backend" "$listed" "$list_avg_ms"
+    list_summary+=("${backend}=${list_avg_ms}ms")
+
+    for i in $(seq 1 "$LIST_COUNT"); do
+        "${PERF_SUDO[@]}" "${list_cmd[@]}" "$NS_RUNTIME_BIN" delete "${TEST_NAME}-list-${backend}-${i}-$$" >/dev/null 2>&1 || true
+    done
+done
+
+perf_section "Test 7: Batch Lifecycle (same waves as Test 2, one ns-runtime batch each)"
+batch_args=()
+if [ "$BATCH_WORKERS" != "0" ]; then
+    batch_args+=(--workers="$BATCH_WORKERS")
+fi
+echo "Workers: $([ "$BATCH_WORKERS" = "0" ] && echo "one per CPU" || echo "$BATCH_WORKERS")"
+
+batch_summary=()
+batch_manifest=$(mktemp)
+batch_report=$(mktemp)
+for n in "${CONCURRENT_COUNTS[@]}"; do
+    : > "$batch_manifest"
+    for op in create start delete; do
+        for i in $(seq 1 "$n"); do
+            id="${TEST_NAME}-batch-${n}-${i}-$$"
+            if [ "$op" = "create" ]; then
+                printf '{"op":"create","id":"%s","bundle":"%s"}\n' "$id" "$NS_TEST_BUNDLE"
+            else
+                printf '{"op":"%s","id":"%s"}\n' "$op" "$id"
+            fi
+        done
+    done >> "$batch_manifest"
+
+    start_ns=$(date +%s%N)
+    "${PERF_SUDO[@]}" "${PERF_CMD_PREFIX[@]}" "$NS_RUNTIME_BIN" batch "${batch_args[@]}" --json \
+        "$batch_manifest" > "$batch_report" 2>/dev/null || true
+    end_ns=$(date +%s%N)
+
+    total_us=$(ns_elapsed_us "$start_ns" "$end_ns")
+    total_s=$(echo "scale=3; $total_us / 1000000" | bc)
+    tput=$(echo "scale=1; $n / $total_s" | bc)
+    failed=$(grep -o '"failed":[0-9]*' "$batch_report" | head -1 | cut -d: -f2)
+    start_p99=$(grep -o '"start":{[^}]*}' "$batch_report" | grep -o '"p99_us":[0-9.]*' | cut -d: -f2)
+
+    printf "  %4s containers: %6s s   %8s containers/sec   start p99: %8s us   failed ops: %s\n" \
+        "$n" "$total_s" "$tput" "${start_p99:--}" "${failed:-?}"
+    batch_summary+=("${n}=${tput}/s")
+done
+rm -f "$batch_manifest" "$batch_report"
+
 echo
 perf_header "Stress Summary"
 echo "  Sequential throughput: ${seq_tput} containers/sec"
 echo "  Stress create rate:    ${stress_tput} containers/sec"
 echo "  State query rate:      ${query_qps} qps"
+echo "  State sync (seq/conc): ${sync_summary[*]}"
+echo "  List (${LIST_COUNT} containers): ${list_summary[*]}"
+echo "  Waves, CLI per container: ${conc_summary[*]}"
+echo "  Waves, one batch:         ${batch_summary[*]}"
@@ -22,8 +22,19 @@ RUN_CONTAINER="${TEST_CONTAINER}-run"
 RESUME_CONTAINER="${TEST_CONTAINER}-resume"
 STALE_CONTAINER="${TEST_CONTAINER}-stale"
 BLOCK_CONTAINER="${TEST_CONTAINER}-block"
+DAEMON_CONTAINER="${TEST_CONTAINER}-daemon"
+PARK_CONTAINER="${TEST_CONTAINER}-park"
+TABLE_CONTAINER="${TEST_CONTAINER}-table"
+RACE_CONTAINER="${TEST_CONTAINER}-race"
+EVENTS_ALL_CONTAINERS="${TEST_CONTAINER}-ev1 ${TEST_CONTAINER}-ev2 ${TEST_CONTAINER}-ev3"
+SPEC_CONTAINER="${TEST_CONTAINER}-spec"
+DAEMON_PID=""
 RESUME_BUNDLE=""
 RUN_BUNDLE=""
+SPEC_BUNDLE=""
+IO_BUNDLE=""
+IO_LOOP=""
+IO_LOOP_FILE=""
 RESUME_CAN_EXEC=true
 RESUME_CONTAINER_READY=false
 
@@ -265,6 +276,43 @@ setup_run_bundle() {
 EOF
 }
 
+# Bundle throttling reads from $1 (major:minor) with a latency target on $2 (device path)
+setup_io_bundle() {
+    local majmin="$1"
+    local dev="$2"
+
+    IO_BUNDLE="$(mktemp -d)"
+    cp -a "$TEST_BUNDLE/rootfs" "$IO_BUNDLE/rootfs"
+    cat > "$IO_BUNDLE/config.json" <<EOF
+{
+  "ociVersion": "1.0.2",
+  "process": {
+    "terminal": false,
+    "user": { "uid": 0, "gid": 0 },
+    "args": ["/bin/sh", "-c", "exec 1>&- 2>&-; while :; do sleep 1; done"],
+    "env": ["PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin"],
+    "cwd": "/"
+  },
+  "root": { "path": "rootfs", "readonly": false },
+  "mounts": [
+    { "destination": "/proc", "type": "proc", "source": "proc" }
+  ],
+  "linux": {
+    "namespaces": [ { "type": "pid" }, { "type": "mount" } ],
+    "resources": {
+      "blockIO": {
+        "throttleReadBpsDevice": [ { "major": ${majmin%%:*}, "minor": ${majmin##*:}, "rate": 1048576 } ],
+        "throttleWriteIOPSDevice": [ { "major": ${majmin%%:*}, "minor": ${majmin##*:}, "rate": 500 } ]
+      }
+    }
+  },
+  "annotations": {
+    "org.nano-sandbox.io.latency": "$dev=5000"
+  }
+}
+EOF
+}
+
 get_container_pid_from_state() {
     local container_id="$1"
     local state_file="$NS_RUN_DIR/$container_id/state.json"
@@ -278,6 +326,21 @@ get_container_pid_from_state() {
 # Cleanup function
 cleanup() {
     echo -e "\n${YELLOW}Cleaning up...${NC}"
+    if [ -n "$DAEMON_PID" ]; then
+        $SUDO kill "$DAEMON_PID" >/dev/null 2>&1 || true
+    fi
+    $SUDO NS_NO_DAEMON=1 $RUNTIME delete $DAEMON_CONTAINER >/dev/null 2>&1 || true
+    $SUDO rm -rf "$NS_RUN_DIR/$DAEMON_CONTAINER" >/dev/null 2>&1 || true
+    $SUDO $RUNTIME delete $PARK_CONTAINER >/dev/null 2>&1 || true
+    $SUDO rm -rf "$NS_RUN_DIR/$PARK_CONTAINER" >/dev/null 2>&1 || true
+    $SUDO NS_STATE_BACKEND=table $RUNTIME delete $TABLE_CONTAINER >/dev/null 2>&1 || true
+    $SUDO rm -rf "$NS_RUN_DIR/$TABLE_CONTAINER" >/dev/null 2>&1 || true
+    $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1 || true
+    $SUDO rm -rf "$NS_RUN_DIR/$RACE_CONTAINER" >/dev/null 2>&1 || true
+    for c in $EVENTS_ALL_CONTAINERS; do
+        $SUDO $RUNTIME delete $c >/dev/null 2>&1 || true
+        $SUDO rm -rf "$NS_RUN_DIR/$c" >/dev/null 2>&1 || true
+    done
     $SUDO $RUNTIME delete $TEST_CONTAINER >/dev/null 2>&1 || true
     $SUDO $RUNTIME delete $RUN_CONTAINER >/dev/null 2>&1 || true
     $SUDO $RUNTIME delete $RESUME_CONTAINER >/dev/null 2>&1 || true
@@ -288,12 +351,26 @@ cleanup() {
     $SUDO rm -rf "$NS_RUN_DIR/$RESUME_CONTAINER" >/dev/null 2>&1 || true
     $SUDO rm -rf "$NS_RUN_DIR/$STALE_CONTAINER" >/dev/null 2>&1 || true
     $SUDO rm -rf "$NS_RUN_DIR/$BLOCK_CONTAINER" >/dev/null 2>&1 || true
+    $SUDO $RUNTIME delete $SPEC_CONTAINER >/dev/null 2>&1 || true
+    $SUDO rm -rf "$NS_RUN_DIR/$SPEC_CONTAINER" >/dev/null 2>&1 || true
     if [ -n "$RESUME_BUNDLE" ] && [ -d "$RESUME_BUNDLE" ]; then
         rm -rf "$RESUME_BUNDLE" >/dev/null 2>&1 || true
     fi
     if [ -n "$RUN_BUNDLE" ] && [ -d "$RUN_BUNDLE" ]; then
         rm -rf "$RUN_BUNDLE" >/dev/null 2>&1 || true
     fi
+    if [ -n "$SPEC_BUNDLE" ] && [ -d "$SPEC_BUNDLE" ]; then
+        rm -rf "$SPEC_BUNDLE" >/dev/null 2>&1 || true
+    fi
+    if [ -n "$IO_BUNDLE" ] && [ -d "$IO_BUNDLE" ]; then
+        rm -rf "$IO_BUNDLE" >/dev/null 2>&1 || true
+    fi
+    if [ -n "$IO_LOOP" ]; then
+        $SUDO losetup -d "$IO_LOOP" >/dev/null 2>&1 || true
+    fi
+    if [ -n "$IO_LOOP_FILE" ]; then
+        rm -f "$IO_LOOP_FILE" >/dev/null 2>&1 || true
+    fi
 }
 
 trap cleanup EXIT
@@ -507,6 +584,21 @@ else
     test_pass "Container state transitioned to 'running'"
 fi
 
+# Test 11b: Start phase trace recorded by start
+test_start "Start phase trace"
+set +e
+TRACE_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $RUNTIME trace --json $TEST_CONTAINER)
+TRACE_RET=$?
+set -e
+if [ $TRACE_RET -ne 0 ]; then
+    test_fail "Trace query failed (exit code: $TRACE_RET)" "$TRACE_OUTPUT"
+elif ! echo "$TRACE_OUTPUT" | grep -q '"name": "clone"' ||
+     ! echo "$TRACE_OUTPUT" | grep -q '"name": "pivot_root"'; then
+    test_fail "Trace is missing parent or child phases" "$TRACE_OUTPUT"
+else
+    test_pass "Start trace has parent and child phases"
+fi
+
 # Test 12: Verify cgroup created (only if we have PID)
 if [ -n "$PID" ] && [ -d "/proc/$PID" ]; then
     test_start "Cgroup creation"
@@ -617,6 +709,79 @@ else
     test_pass "Run --rm removed container state"
 fi
 
+# Test 18b: Compiled spec images must never outlive the config.json they came from
+test_start "Compiled spec image invalidation"
+SPEC_CACHE_DIR="$NS_RUN_DIR/.spec-cache"
+SPEC_BUNDLE="$(mktemp -d)"
+cp -a "$RUN_BUNDLE/rootfs" "$SPEC_BUNDLE/rootfs"
+sed 's/"exit 0"/"echo spec-image-v1"/' "$RUN_BUNDLE/config.json" > "$SPEC_BUNDLE/config.json"
+$SUDO rm -rf "$SPEC_CACHE_DIR" >/dev/null 2>&1 || true
+
+# Print the container's output for one attached run of $SPEC_BUNDLE
+spec_image_run() {
+    run_with_timeout $TIMEOUT_START $SUDO env "$@" $RUNTIME run --rm \
+        --bundle=$SPEC_BUNDLE $SPEC_CONTAINER 2>&1
+}
+
+set +e
+SPEC_OUTPUT=$(spec_image_run)
+SPEC_RET=$?
+SPEC_IMAGE=$($SUDO find "$SPEC_CACHE_DIR" -name '*.spec' 2>/dev/null | head -n 1)
+set -e
+if [ $SPEC_RET -ne 0 ] || ! echo "$SPEC_OUTPUT" | grep -q "spec-image-v1"; then
+    test_fail "Run with a fresh spec cache failed (exit code: $SPEC_RET)" "$SPEC_OUTPUT"
+elif [ -z "$SPEC_IMAGE" ]; then
+    test_fail "No compiled spec image was written to $SPEC_CACHE_DIR"
+else
+    sed -i 's/spec-image-v1/spec-image-edited/' "$SPEC_BUNDLE/config.json"
+    set +e
+    SPEC_OUTPUT=$(spec_image_run)
+    SPEC_RET=$?
+    set -e
+    if [ $SPEC_RET -ne 0 ] || ! echo "$SPEC_OUTPUT" | grep -q "spec-image-edited"; then
+        test_fail "Edited config.json was shadowed by a stale spec image" "$SPEC_OUTPUT"
+    else
+        test_pass "Editing config.json invalidates its compiled spec image"
+    fi
+fi
+
+test_start "Corrupt compiled spec image is ignored"
+SPEC_IMAGE=$($SUDO find "$SPEC_CACHE_DIR" -name '*.spec' 2>/dev/null | head -n 1)
+if [ -z "$SPEC_IMAGE" ]; then
+    test_fail "No compiled spec image to corrupt in $SPEC_CACHE_DIR"
+else
+    set +e
+    $SUDO truncate -s 16 "$SPEC_IMAGE"
+    SPEC_TRUNC_OUTPUT=$(spec_image_run)
+    SPEC_TRUNC_RET=$?
+    printf 'not-a-spec-image' | $SUDO dd of="$SPEC_IMAGE" conv=notrunc status=none
+    SPEC_GARBAGE_OUTPUT=$(spec_image_run)
+    SPEC_GARBAGE_RET=$?
+    set -e
+    if [ $SPEC_TRUNC_RET -ne 0 ] || ! echo "$SPEC_TRUNC_OUTPUT" | grep -q "spec-image-edited"; then
+        test_fail "Run with a truncated spec image failed (exit code: $SPEC_TRUNC_RET)" "$SPEC_TRUNC_OUTPUT"
+    elif [ $SPEC_GARBAGE_RET -ne 0 ] || ! echo "$SPEC_GARBAGE_OUTPUT" | grep -q "spec-image-edited"; then
+        test_fail "Run with a garbage spec image header failed (exit code: $SPEC_GARBAGE_RET)" "$SPEC_GARBAGE_OUTPUT"
+    else
+        test_pass "Truncated and garbage spec images fall back to config.json"
+    fi
+fi
+
+test_start "NS_NO_SPEC_IMAGE bypasses the spec cache"
+$SUDO rm -rf "$SPEC_CACHE_DIR" >/dev/null 2>&1 || true
+set +e
+SPEC_OUTPUT=$(spec_image_run NS_NO_SPEC_IMAGE=1)
+SPEC_RET=$?
+SPEC_IMAGE=$($SUDO find "$SPEC_CACHE_DIR" -name '*.spec' 2>/dev/null | head -n 1)
+set -e
+if [ $SPEC_RET -ne 0 ] || ! echo "$SPEC_OUTPUT" | grep -q "spec-image-edited"; then
+    test_fail "Run with NS_NO_SPEC_IMAGE=1 failed (exit code: $SPEC_RET)" "$SPEC_OUTPUT"
+elif [ -n "$SPEC_IMAGE" ]; then
+    test_fail "NS_NO_SPEC_IMAGE=1 still wrote a compiled spec image" "$SPEC_IMAGE"
+else
+    test_pass "NS_NO_SPEC_IMAGE=1 neither reads nor writes spec images"
+fi
+
 # Test 19: Run attached keepalive bundle should block until timeout
 test_start "Run attached keepalive blocks"
 set +e
@@ -864,6 +1029,678 @@ else
     test_pass "Exec test containers cleaned up"
 fi
 
+# ============================================================================
+# Parked Create Tests (create --park / exec.fifo)
+# ============================================================================
+
+test_start "Parked create"
+set +e
+PARK_CREATE_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --park --bundle=$TEST_BUNDLE $PARK_CONTAINER)
+PARK_CREATE_RET=$?
+set -e
+PARK_PID=$(get_container_pid_from_state "$PARK_CONTAINER" || true)
+
+if [ $PARK_CREATE_RET -ne 0 ]; then
+    test_fail "create --park failed" "$PARK_CREATE_OUTPUT"
+elif [ -z "$PARK_PID" ] || [ "$PARK_PID" = "0" ] || ! $SUDO kill -0 "$PARK_PID" 2>/dev/null; then
+    test_fail "Parked init PID missing from state.json or not alive" "$(cat "$NS_RUN_DIR/$PARK_CONTAINER/state.json" 2>/dev/null)"
+elif [ ! -p "$NS_RUN_DIR/$PARK_CONTAINER/exec.fifo" ]; then
+    test_fail "exec.fifo not created for parked container"
+elif [ "$($RUNTIME state $PARK_CONTAINER 2>/dev/null)" != "created" ]; then
+    test_fail "Parked container should report 'created'"
+else
+    test_pass "create --park left init process $PARK_PID blocked on exec.fifo"
+fi
+
+test_start "Parked start releases exec"
+set +e
+PARK_START_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $PARK_CONTAINER)
+PARK_START_RET=$?
+set -e
+sleep 0.2
+PARK_RUN_PID=$(get_container_pid_from_state "$PARK_CONTAINER" || true)
+
+if [ $PARK_START_RET -ne 0 ]; then
+    test_fail "start of parked container failed" "$PARK_START_OUTPUT"
+elif [ "$PARK_RUN_PID" != "$PARK_PID" ]; then
+    test_fail "start spawned a new process instead of releasing parked PID $PARK_PID" "pid=$PARK_RUN_PID"
+elif [ -e "$NS_RUN_DIR/$PARK_CONTAINER/exec.fifo" ]; then
+    test_fail "exec.fifo should be removed after start"
+elif [ "$($RUNTIME state $PARK_CONTAINER 2>/dev/null)" != "running" ]; then
+    test_fail "Released container should report 'running'"
+else
+    test_pass "start released parked PID $PARK_PID"
+fi
+
+test_start "Parked delete"
+$SUDO $RUNTIME delete $PARK_CONTAINER >/dev/null 2>&1 || true
+set +e
+PARK_CREATE_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --park --bundle=$TEST_BUNDLE $PARK_CONTAINER)
+PARK_CREATE_RET=$?
+PARK_PID=$(get_container_pid_from_state "$PARK_CONTAINER")
+PARK_DEL_OUTPUT=$(run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $PARK_CONTAINER)
+PARK_DEL_RET=$?
+set -e
+sleep 0.2
+
+if [ $PARK_CREATE_RET -ne 0 ] || [ $PARK_DEL_RET -ne 0 ]; then
+    test_fail "create --park/delete failed" "$PARK_CREATE_OUTPUT"$'\n'"$PARK_DEL_OUTPUT"
+elif [ -n "$PARK_PID" ] && $SUDO kill -0 "$PARK_PID" 2>/dev/null && \
+     ! grep -q '^State:.*Z' "/proc/$PARK_PID/status" 2>/dev/null; then
+    test_fail "delete left parked PID $PARK_PID running"
+elif [ -d "$NS_RUN_DIR/$PARK_CONTAINER" ]; then
+    test_fail "delete left $NS_RUN_DIR/$PARK_CONTAINER behind"
+else
+    test_pass "delete killed parked process and removed exec.fifo"
+fi
+
+# ============================================================================
+# State Table Backend Tests (NS_STATE_BACKEND=table)
+# ============================================================================
+
+test_start "State table backend"
+set +e
+TABLE_CREATE_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO NS_STATE_BACKEND=table $RUNTIME create --bundle=$TEST_BUNDLE $TABLE_CONTAINER)
+TABLE_CREATE_RET=$?
+TABLE_STATE_OUTPUT=$(NS_STATE_BACKEND=table run_with_timeout $TIMEOUT_STATE $RUNTIME state $TABLE_CONTAINER)
+set -e
+
+if [ $TABLE_CREATE_RET -ne 0 ]; then
+    test_fail "create with the state table failed" "$TABLE_CREATE_OUTPUT"
+elif [ ! -f "$NS_RUN_DIR/state.tbl" ] || [ -e "$NS_RUN_DIR/$TABLE_CONTAINER/state.json" ]; then
+    test_fail "State table backend should write state.tbl and no state.json"
+elif [ "$TABLE_STATE_OUTPUT" != "created" ]; then
+    test_fail "State table reports '$TABLE_STATE_OUTPUT', expected 'created'" "$TABLE_STATE_OUTPUT"
+else
+    test_pass "create/state through $NS_RUN_DIR/state.tbl"
+fi
+
+test_start "State backend migration"
+set +e
+TABLE_JSON_STATE=$(run_with_timeout $TIMEOUT_STATE $RUNTIME state $TABLE_CONTAINER)
+TABLE_BACK_STATE=$(NS_STATE_BACKEND=table run_with_timeout $TIMEOUT_STATE $RUNTIME state $TABLE_CONTAINER)
+TABLE_DEL_OUTPUT=$(run_with_timeout $TIMEOUT_DELETE $SUDO NS_STATE_BACKEND=table $RUNTIME delete $TABLE_CONTAINER)
+TABLE_DEL_RET=$?
+set -e
+
+if [ "$TABLE_JSON_STATE" != "created" ] || [ "$TABLE_BACK_STATE" != "created" ]; then
+    test_fail "Container lost when switching backends" "json=$TABLE_JSON_STATE table=$TABLE_BACK_STATE"
+elif [ -e "$NS_RUN_DIR/$TABLE_CONTAINER/state.json" ]; then
+    test_fail "Moving back to the table left state.json behind"
+elif [ $TABLE_DEL_RET -ne 0 ] || [ -d "$NS_RUN_DIR/$TABLE_CONTAINER" ]; then
+    test_fail "delete with the state table failed" "$TABLE_DEL_OUTPUT"
+else
+    test_pass "Records move between state.json and state.tbl on first access"
+fi
+
+test_start "Concurrent create/start of one container"
+RACE_DIR=$(mktemp -d)
+for i in 1 2 3 4; do
+    ( run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER \
+        >/dev/null 2>&1 && touch "$RACE_DIR/create.$i" ) &
+done
+wait
+for i in 1 2 3 4; do
+    ( run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER \
+        >/dev/null 2>&1 && touch "$RACE_DIR/start.$i" ) &
+done
+wait
+RACE_CREATES=$(ls "$RACE_DIR" | grep -c '^create\.' || true)
+RACE_STARTS=$(ls "$RACE_DIR" | grep -c '^start\.' || true)
+rm -rf "$RACE_DIR"
+set +e
+RACE_DEL_OUTPUT=$(run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER 2>&1)
+RACE_DEL_RET=$?
+set -e
+
+if [ "$RACE_CREATES" -ne 1 ] || [ "$RACE_STARTS" -ne 1 ]; then
+    test_fail "Expected exactly one winner" "creates=$RACE_CREATES starts=$RACE_STARTS"
+elif [ $RACE_DEL_RET -ne 0 ] || [ -e "$NS_RUN_DIR/.locks/$RACE_CONTAINER.lock" ]; then
+    test_fail "delete after the race failed or left its lock file" "$RACE_DEL_OUTPUT"
+else
+    test_pass "Per-container lock lets one create and one start win"
+fi
+
+test_start "List containers"
+set +e
+LIST_CREATE_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER 2>&1)
+LIST_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $RUNTIME list 2>&1)
+LIST_RET=$?
+LIST_JSON=$(run_with_timeout $TIMEOUT_STATE $RUNTIME ps --json 2>&1)
+LIST_JSON_RET=$?
+$SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+set -e
+
+if [ $LIST_RET -ne 0 ] || [ $LIST_JSON_RET -ne 0 ]; then
+    test_fail "list failed" "$LIST_CREATE_OUTPUT $LIST_OUTPUT $LIST_JSON"
+elif ! echo "$LIST_OUTPUT" | grep -qE "^$RACE_CONTAINER +created "; then
+    test_fail "list does not show $RACE_CONTAINER as created" "$LIST_OUTPUT"
+elif echo "$LIST_OUTPUT" | grep -qE "^\.(locks|spec-cache) "; then
+    test_fail "list shows state directory internals" "$LIST_OUTPUT"
+elif ! echo "$LIST_JSON" | grep -q "^{\"id\":\"$RACE_CONTAINER\",\"state\":\"created\""; then
+    test_fail "ps --json is missing $RACE_CONTAINER" "$LIST_JSON"
+else
+    test_pass "list/ps report containers as a table and NDJSON"
+fi
+
+test_start "Container stats"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+    test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+else
+    set +e
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+    run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >/dev/null 2>&1
+    STATS_JSON=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME stats --json --no-stream --interval=200 $RACE_CONTAINER 2>&1)
+    STATS_JSON_RET=$?
+    STATS_PROM=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME stats --prometheus --no-stream --interval=200 --all 2>&1)
+    STATS_PROM_RET=$?
+    $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+    set -e
+
+    if [ $STATS_JSON_RET -ne 0 ] || ! echo "$STATS_JSON" | grep -q "^{\"id\":\"$RACE_CONTAINER\",.*\"cpu_percent\":[0-9]"; then
+        test_fail "stats --json did not sample $RACE_CONTAINER" "$STATS_JSON"
+    elif [ $STATS_PROM_RET -ne 0 ] || ! echo "$STATS_PROM" | grep -q "^nk_container_cpu_usage_seconds_total{id=\"$RACE_CONTAINER\"} "; then
+        test_fail "stats --prometheus --all is missing $RACE_CONTAINER" "$STATS_PROM"
+    else
+        test_pass "stats samples the container cgroup as NDJSON and Prometheus text"
+    fi
+fi
+
+test_start "cpuset placement"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+    test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+else
+    set +e
+    CPUSET_BAD=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --cpuset=bogus --bundle=$TEST_BUNDLE $RACE_CONTAINER 2>&1)
+    CPUSET_BAD_RET=$?
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --cpuset=packed --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+    CPUSET_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER 2>&1)
+    CPUSET_RET=$?
+    CPUSET_LINE=$($SUDO cat "$NS_RUN_DIR/.placement/cpuset" 2>/dev/null | grep "^$RACE_CONTAINER ")
+    CPUSET_PID=$($SUDO $RUNTIME list --json 2>/dev/null | grep "\"id\":\"$RACE_CONTAINER\"" | sed -n 's/.*"pid":\([0-9]*\).*/\1/p')
+    CPUSET_ALLOWED=$(sed -n 's/^Cpus_allowed_list:[[:space:]]*//p' /proc/$CPUSET_PID/status 2>/dev/null)
+    $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+    CPUSET_LEFT=$($SUDO cat "$NS_RUN_DIR/.placement/cpuset" 2>/dev/null | grep -c "^$RACE_CONTAINER ")
+    set -e
+
+    CPUSET_CPUS=$(echo "$CPUSET_LINE" | awk '{print $3}')
+    if [ $CPUSET_BAD_RET -eq 0 ]; then
+        test_fail "create accepted --cpuset=bogus" "$CPUSET_BAD"
+    elif [ $CPUSET_RET -ne 0 ]; then
+        test_fail "start with --cpuset=packed failed (exit code: $CPUSET_RET)" "$CPUSET_OUTPUT"
+    elif ! echo "$CPUSET_LINE" | grep -q "^$RACE_CONTAINER packed [0-9]"; then
+        test_fail "cpuset allocation of $RACE_CONTAINER was not recorded" "$CPUSET_LINE"
+    elif [ "$CPUSET_ALLOWED" != "$CPUSET_CPUS" ]; then
+        test_fail "init may run on CPUs '$CPUSET_ALLOWED', placed on '$CPUSET_CPUS'" "$CPUSET_LINE"
+    elif [ "$CPUSET_LEFT" != "0" ]; then
+        test_fail "delete did not release the cpuset of $RACE_CONTAINER" "$CPUSET_LINE"
+    else
+        test_pass "packed placement confines init to the recorded CPUs and delete releases them"
+    fi
+fi
+
+test_start "CPU limit update"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+    test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+else
+    set +e
+    UPDATE_MISSING=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME update --cpu-quota=50000 nonexistent-update-xyz 2>&1)
+    UPDATE_MISSING_RET=$?
+    UPDATE_BAD=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME update --cpu-period=10 $RACE_CONTAINER 2>&1)
+    UPDATE_BAD_RET=$?
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+    run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >/dev/null 2>&1
+    UPDATE_NEGATIVE=""
+    for arg in --cpu-shares=-1 --cpu-period=-1 --cpu-idle=-1 --cpu-burst=-1 --cpu-quota=-1junk; do
+        if ! run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME update $arg $RACE_CONTAINER 2>&1 | \
+                grep -q "invalid"; then
+            UPDATE_NEGATIVE="$UPDATE_NEGATIVE $arg"
+        fi
+    done
+    UPDATE_CGROUP=$($SUDO $RUNTIME list --json 2>/dev/null | grep "\"id\":\"$RACE_CONTAINER\"" | sed -n 's/.*"cgroup":"\([^"]*\)".*/\1/p')
+    UPDATE_HAS_CPU=0
+    if [ -n "$UPDATE_CGROUP" ] && $SUDO test -f "$UPDATE_CGROUP/cpu.max"; then
+        UPDATE_HAS_CPU=1
+        UPDATE_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME update --cpu-quota=50000 --cpu-period=100000 $RACE_CONTAINER 2>&1)
+        UPDATE_RET=$?
+        UPDATE_MAX=$($SUDO cat "$UPDATE_CGROUP/cpu.max" 2>/dev/null)
+        run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME update --cpu-period=200000 $RACE_CONTAINER >/dev/null 2>&1
+        UPDATE_PERIOD=$($SUDO cat "$UPDATE_CGROUP/cpu.max" 2>/dev/null)
+    fi
+    $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+    set -e
+
+    if [ $UPDATE_MISSING_RET -eq 0 ]; then
+        test_fail "update of a missing container succeeded" "$UPDATE_MISSING"
+    elif [ $UPDATE_BAD_RET -eq 0 ]; then
+        test_fail "update accepted --cpu-period=10" "$UPDATE_BAD"
+    elif [ -n "$UPDATE_NEGATIVE" ]; then
+        test_fail "update did not reject out-of-range values:$UPDATE_NEGATIVE"
+    elif [ $UPDATE_HAS_CPU -eq 0 ]; then
+        test_skip "cpu controller is not enabled for the container cgroup"
+    elif [ $UPDATE_RET -ne 0 ]; then
+        test_fail "update of a running container failed (exit code: $UPDATE_RET)" "$UPDATE_OUTPUT"
+    elif [ "$UPDATE_MAX" != "50000 100000" ]; then
+        test_fail "cpu.max is '$UPDATE_MAX' after update, expected '50000 100000'" "$UPDATE_OUTPUT"
+    elif [ "$UPDATE_PERIOD" != "50000 200000" ]; then
+        test_fail "--cpu-period alone did not keep the quota: cpu.max is '$UPDATE_PERIOD'"
+    else
+        test_pass "update rewrites cpu.max of a running container and keeps the quota on a period change"
+    fi
+fi
+
+test_start "Block IO limits on a loop device"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ] || ! grep -qw io /sys/fs/cgroup/cgroup.controllers; then
+    test_skip "cgroup v2 io controller is not available at /sys/fs/cgroup"
+elif ! command -v losetup >/dev/null 2>&1; then
+    test_skip "losetup is not installed"
+else
+    set +e
+    IO_LOOP_FILE="$(mktemp)"
+    truncate -s 16M "$IO_LOOP_FILE"
+    IO_LOOP=$($SUDO losetup -f --show "$IO_LOOP_FILE" 2>/dev/null)
+    set -e
+
+    if [ -z "$IO_LOOP" ]; then
+        test_skip "no free loop device"
+    else
+        set +e
+        IO_MAJMIN=$(printf '%d:%d' "0x$(stat -c %t "$IO_LOOP")" "0x$(stat -c %T "$IO_LOOP")")
+        setup_io_bundle "$IO_MAJMIN" "$IO_LOOP"
+        run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$IO_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+        IO_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER 2>&1)
+        IO_RET=$?
+        IO_CGROUP=$($SUDO $RUNTIME list --json 2>/dev/null | grep "\"id\":\"$RACE_CONTAINER\"" | sed -n 's/.*"cgroup":"\([^"]*\)".*/\1/p')
+        IO_MAX=$($SUDO cat "$IO_CGROUP/io.max" 2>/dev/null | grep "^$IO_MAJMIN ")
+        IO_LATENCY=$($SUDO cat "$IO_CGROUP/io.latency" 2>/dev/null | grep "^$IO_MAJMIN ")
+        $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+        set -e
+
+        if [ $IO_RET -ne 0 ]; then
+            test_fail "start with blockIO limits on $IO_LOOP failed (exit code: $IO_RET)" "$IO_OUTPUT"
+        elif [ "$IO_MAX" != "$IO_MAJMIN rbps=1048576 wbps=max riops=max wiops=500" ]; then
+            test_fail "io.max of $IO_LOOP ($IO_MAJMIN) is '$IO_MAX'" "$IO_OUTPUT"
+        elif [ "$IO_LATENCY" != "$IO_MAJMIN target=5000" ]; then
+            test_fail "io.latency of $IO_LOOP ($IO_MAJMIN) is '$IO_LATENCY'" "$IO_OUTPUT"
+        else
+            test_pass "blockIO throttles land in io.max and the latency annotation in io.latency of $IO_MAJMIN"
+        fi
+    fi
+fi
+
+test_start "Container events"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+    test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+else
+    set +e
+    EVENTS_MISSING=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME events nonexistent-events-container 2>&1)
+    EVENTS_MISSING_RET=$?
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+    run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >/dev/null 2>&1
+    EVENTS_OUT=$(mktemp)
+    timeout 5 $SUDO $RUNTIME events $RACE_CONTAINER >"$EVENTS_OUT" 2>&1 &
+    EVENTS_PID=$!
+    sleep 0.5
+    $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+    wait $EVENTS_PID
+    EVENTS_RET=$?
+    EVENTS_OUTPUT=$(cat "$EVENTS_OUT")
+    rm -f "$EVENTS_OUT"
+    set -e
+
+    if [ $EVENTS_MISSING_RET -eq 0 ]; then
+        test_fail "events accepted a missing container" "$EVENTS_MISSING"
+    elif [ $EVENTS_RET -ne 0 ]; then
+        test_fail "events did not end cleanly when $RACE_CONTAINER was deleted (exit code: $EVENTS_RET)" "$EVENTS_OUTPUT"
+    elif [ -n "$EVENTS_OUTPUT" ] && echo "$EVENTS_OUTPUT" | grep -qv "^{\"type\":\"[a-z_]*\",\"id\":\"$RACE_CONTAINER\""; then
+        test_fail "events printed something other than NDJSON events" "$EVENTS_OUTPUT"
+    else
+        test_pass "events watches the container cgroup and ends with it"
+    fi
+fi
+
+test_start "Container events --all"
+if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+    test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+else
+    set +e
+    for c in $EVENTS_ALL_CONTAINERS; do
+        run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $c >/dev/null 2>&1
+        run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $c >/dev/null 2>&1
+    done
+    EVENTS_OUT=$(mktemp)
+    # --all re-reads the container list once a second: delete one container
+    # between rescans, so later rescans keep some entries and drop others
+    timeout 4 $SUDO $RUNTIME events --all >"$EVENTS_OUT" 2>&1 &
+    EVENTS_PID=$!
+    sleep 1.5
+    $SUDO $RUNTIME delete ${TEST_CONTAINER}-ev2 >/dev/null 2>&1
+    wait $EVENTS_PID
+    EVENTS_RET=$?
+    EVENTS_OUTPUT=$(cat "$EVENTS_OUT")
+    rm -f "$EVENTS_OUT"
+    for c in $EVENTS_ALL_CONTAINERS; do
+        $SUDO $RUNTIME delete $c >/dev/null 2>&1
+    done
+    set -e
+
+    if [ $EVENTS_RET -ne 124 ]; then
+        test_fail "events --all ended before the timeout (exit code: $EVENTS_RET)" "$EVENTS_OUTPUT"
+    elif [ -n "$EVENTS_OUTPUT" ] && echo "$EVENTS_OUTPUT" | grep -qv '^{"type":"[a-z_]*","id":"'; then
+        test_fail "events --all printed something other than NDJSON events" "$EVENTS_OUTPUT"
+    else
+        test_pass "events --all keeps streaming across rescans while containers come and go"
+    fi
+fi
+
+test_start "Kill container"
+set +e
+run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >/dev/null 2>&1
+KILL_BAD_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME kill $RACE_CONTAINER NOSUCHSIG 2>&1)
+KILL_BAD_RET=$?
+KILL_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME kill $RACE_CONTAINER KILL 2>&1)
+KILL_RET=$?
+sleep 0.2
+KILL_AGAIN_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME kill $RACE_CONTAINER 2>&1)
+KILL_AGAIN_RET=$?
+$SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+set -e
+
+if [ $KILL_BAD_RET -eq 0 ]; then
+    test_fail "kill accepted an unknown signal" "$KILL_BAD_OUTPUT"
+elif [ $KILL_RET -ne 0 ]; then
+    test_fail "kill KILL failed (exit code: $KILL_RET)" "$KILL_OUTPUT"
+elif [ $KILL_AGAIN_RET -eq 0 ] || ! echo "$KILL_AGAIN_OUTPUT" | grep -q "is not running"; then
+    test_fail "kill of an exited container did not report it as not running" "$KILL_AGAIN_OUTPUT"
+else
+    test_pass "kill signals init through its pidfd and refuses exited containers"
+fi
+
+test_start "Delete stops without a fixed grace sleep"
+set +e
+run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >/dev/null 2>&1
+STOP_T0=$(date +%s%N)
+STOP_OUTPUT=$(run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER 2>&1)
+STOP_RET=$?
+STOP_MS=$(( ($(date +%s%N) - STOP_T0) / 1000000 ))
+set -e
+
+# PID 1 of the test bundle is a shell without a SIGTERM handler, which a
+# PID namespace init never receives: delete should go straight to the kill.
+if [ $STOP_RET -ne 0 ]; then
+    test_fail "delete of a running container failed (exit code: $STOP_RET)" "$STOP_OUTPUT"
+elif [ $STOP_MS -ge 2000 ]; then
+    test_fail "delete took ${STOP_MS}ms; it waited out the SIGTERM grace period" "$STOP_OUTPUT"
+else
+    test_pass "Running container deleted in ${STOP_MS}ms"
+fi
+
+test_start "Overlay rootfs"
+OVL_ROOTFS="$TEST_BUNDLE/rootfs"
+set +e
+OVL_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO NS_ROOTFS_MODE=overlay $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER 2>&1)
+OVL_RET=$?
+if [ $OVL_RET -eq 0 ]; then
+    OVL_LOG=$(mktemp)
+    run_with_timeout $TIMEOUT_START $SUDO NS_ROOTFS_MODE=overlay $RUNTIME start $RACE_CONTAINER >"$OVL_LOG" 2>&1
+    OVL_RET=$?
+    OVL_OUTPUT=$(cat "$OVL_LOG")
+    rm -f "$OVL_LOG"
+fi
+OVL_PID=$(get_container_pid_from_state "$RACE_CONTAINER" || true)
+OVL_ROOT_LINE=$($SUDO grep " / / " "/proc/$OVL_PID/mountinfo" 2>/dev/null)
+$SUDO touch "/proc/$OVL_PID/root/.nk-overlay-probe" 2>/dev/null
+OVL_UPPER_HIT=$($SUDO ls "$NS_RUN_DIR/$RACE_CONTAINER/rootfs/upper/.nk-overlay-probe" 2>/dev/null)
+run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+set -e
+
+if [ $OVL_RET -ne 0 ]; then
+    if echo "$OVL_OUTPUT" | grep -q "Failed to mount overlay"; then
+        test_skip "overlayfs not usable here: $OVL_OUTPUT"
+    else
+        test_fail "create/start with NS_ROOTFS_MODE=overlay failed" "$OVL_OUTPUT"
+    fi
+elif ! echo "$OVL_ROOT_LINE" | grep -q " - overlay "; then
+    test_fail "container root is not an overlay mount" "$OVL_ROOT_LINE"
+elif [ -z "$OVL_UPPER_HIT" ] || [ -e "$OVL_ROOTFS/.nk-overlay-probe" ]; then
+    $SUDO rm -f "$OVL_ROOTFS/.nk-overlay-probe"
+    test_fail "container write did not land in its upper dir"
+elif [ -d "$NS_RUN_DIR/$RACE_CONTAINER/rootfs" ]; then
+    test_fail "delete left the overlay upper/work dirs behind"
+else
+    test_pass "Bundle rootfs shared read-only; writes went to the container's upper dir"
+fi
+
+test_start "Rootfs symlinks resolve inside the rootfs"
+SYM_BUNDLE=$(mktemp -d)
+set +e
+$SUDO cp -a "$TEST_BUNDLE/." "$SYM_BUNDLE/"
+$SUDO rm -rf "$SYM_BUNDLE/rootfs/sys"
+$SUDO mkdir -p "$SYM_BUNDLE/rootfs/nk-sys"
+$SUDO ln -s /nk-sys "$SYM_BUNDLE/rootfs/sys"
+SYM_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle="$SYM_BUNDLE" $RACE_CONTAINER 2>&1)
+SYM_RET=$?
+if [ $SYM_RET -eq 0 ]; then
+    SYM_LOG=$(mktemp)
+    run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >"$SYM_LOG" 2>&1
+    SYM_RET=$?
+    SYM_OUTPUT=$(cat "$SYM_LOG")
+    rm -f "$SYM_LOG"
+fi
+SYM_PID=$(get_container_pid_from_state "$RACE_CONTAINER" || true)
+SYM_SYS_LINE=$($SUDO grep " /nk-sys " "/proc/$SYM_PID/mountinfo" 2>/dev/null)
+run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+$SUDO rm -rf "$SYM_BUNDLE"
+set -e
+
+if [ $SYM_RET -ne 0 ]; then
+    test_fail "create/start with a symlinked /sys failed" "$SYM_OUTPUT"
+elif ! echo "$SYM_SYS_LINE" | grep -q " - sysfs "; then
+    test_fail "sysfs did not land on the symlink's in-rootfs target" "$SYM_SYS_LINE"
+else
+    test_pass "Absolute symlink /sys -> /nk-sys was resolved against the rootfs"
+fi
+
+test_start "Per-container /dev is read-only"
+set +e
+run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $RACE_CONTAINER >/dev/null 2>&1
+DEV_RO_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER 2>&1)
+DEV_RO_RET=$?
+DEV_RO_PID=$(get_container_pid_from_state "$RACE_CONTAINER" || true)
+DEV_RO_MOUNT=$($SUDO awk '$5 == "/dev"' "/proc/$DEV_RO_PID/mountinfo" 2>/dev/null)
+DEV_RO_NULL=$($SUDO stat -c '%F %t,%T' "/proc/$DEV_RO_PID/root/dev/null" 2>/dev/null)
+run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+set -e
+if [ $DEV_RO_RET -ne 0 ]; then
+    test_fail "create/start for the /dev check failed" "$DEV_RO_OUTPUT"
+elif [ "$DEV_RO_NULL" != "character special file 1,3" ]; then
+    test_fail "/dev/null in the container is not the null device" "$DEV_RO_NULL"
+elif ! echo "$DEV_RO_MOUNT" | grep -q " - tmpfs [^ ]* ro,"; then
+    test_fail "/dev without the mount template is writable, unlike under ns-runtimed" "$DEV_RO_MOUNT"
+else
+    test_pass "/dev is a read-only tmpfs, as with the ns-runtimed template"
+fi
+
+test_start "linux.resources limits"
+CG_CONTROLLERS=$(cat /sys/fs/cgroup/cgroup.controllers 2>/dev/null || true)
+if ! echo "$CG_CONTROLLERS" | grep -qw memory || ! echo "$CG_CONTROLLERS" | grep -qw pids; then
+    test_skip "cgroup v2 memory/pids controllers not available"
+else
+    RES_BUNDLE=$(mktemp -d)
+    RES_CG="/sys/fs/cgroup/nano-sandbox/$RACE_CONTAINER"
+    set +e
+    $SUDO cp -a "$TEST_BUNDLE/." "$RES_BUNDLE/"
+    $SUDO sed -i 's/"linux"[[:space:]]*:[[:space:]]*{/&"resources":{"memory":{"limit":268435456,"swap":268435456},"pids":{"limit":64},"cpu":{"quota":50000,"period":100000}},/' \
+        "$RES_BUNDLE/config.json"
+    RES_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle="$RES_BUNDLE" $RACE_CONTAINER 2>&1)
+    RES_RET=$?
+    if [ $RES_RET -eq 0 ]; then
+        RES_LOG=$(mktemp)
+        run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $RACE_CONTAINER >"$RES_LOG" 2>&1
+        RES_RET=$?
+        RES_OUTPUT=$(cat "$RES_LOG")
+        rm -f "$RES_LOG"
+    fi
+    RES_MEM=$(cat "$RES_CG/memory.max" 2>/dev/null)
+    RES_SWAP=$(cat "$RES_CG/memory.swap.max" 2>/dev/null)
+    RES_PIDS=$(cat "$RES_CG/pids.max" 2>/dev/null)
+    RES_CPU=$(cat "$RES_CG/cpu.max" 2>/dev/null)
+    run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $RACE_CONTAINER >/dev/null 2>&1
+    $SUDO rm -rf "$RES_BUNDLE"
+    set -e
+
+    if [ $RES_RET -ne 0 ]; then
+        test_fail "create/start with linux.resources failed" "$RES_OUTPUT"
+    elif [ "$RES_MEM" != "268435456" ] || [ "$RES_PIDS" != "64" ]; then
+        test_fail "limits not written (memory.max=$RES_MEM pids.max=$RES_PIDS)"
+    elif [ -n "$RES_CPU" ] && [ "$RES_CPU" != "50000 100000" ]; then
+        test_fail "cpu.max not written (cpu.max=$RES_CPU)"
+    elif [ -n "$RES_SWAP" ] && [ "$RES_SWAP" != "0" ]; then
+        test_fail "memory.swap equal to memory.limit did not disable swap (memory.swap.max=$RES_SWAP)"
+    else
+        test_pass "memory.max, memory.swap.max, pids.max and cpu.max follow linux.resources"
+    fi
+fi
+
+test_start "Batch manifest"
+BATCH_OUT=$(mktemp)
+set +e
+printf '{"op":"create","id":"%s","bundle":"%s"}\n{"op":"start","id":"%s"}\n{"op":"delete","id":"%s"}\n' \
+    "$RACE_CONTAINER" "$TEST_BUNDLE" "$RACE_CONTAINER" "$RACE_CONTAINER" | \
+    run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME batch --workers=2 - >"$BATCH_OUT" 2>&1
+BATCH_RET=$?
+BATCH_STATE_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME state $RACE_CONTAINER 2>&1)
+BATCH_STATE_RET=$?
+BAD_BATCH_OUTPUT=$(echo '{"op":"pause","id":"x"}' | run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME batch - 2>&1)
+BAD_BATCH_RET=$?
+set -e
+BATCH_OUTPUT=$(cat "$BATCH_OUT")
+rm -f "$BATCH_OUT"
+
+if [ $BATCH_RET -ne 0 ]; then
+    test_fail "batch create/start/delete failed (exit code: $BATCH_RET)" "$BATCH_OUTPUT"
+elif ! echo "$BATCH_OUTPUT" | grep -q "^3 ops, 0 failed"; then
+    test_fail "batch summary missing" "$BATCH_OUTPUT"
+elif [ $BATCH_STATE_RET -eq 0 ]; then
+    test_fail "batch delete left state behind" "$BATCH_STATE_OUTPUT"
+elif [ $BAD_BATCH_RET -eq 0 ]; then
+    test_fail "batch accepted an unknown op" "$BAD_BATCH_OUTPUT"
+else
+    test_pass "Manifest ran in order across workers"
+fi
+
+# ============================================================================
+# Daemon Tests (ns-runtimed)
+# ============================================================================
+
+test_start "ns-runtimed lifecycle"
+DAEMON_SOCK="$NS_RUN_DIR/ns-runtimed.sock"
+$SUDO $RUNTIME daemon -q --warm-pool=1 --cgroup-pool=2 >/dev/null 2>&1 &
+DAEMON_PID=$!
+for _ in $(seq 1 20); do
+    [ -S "$DAEMON_SOCK" ] && break
+    sleep 0.1
+done
+
+if [ ! -S "$DAEMON_SOCK" ]; then
+    test_fail "ns-runtimed did not create $DAEMON_SOCK"
+else
+    set +e
+    DAEMON_CREATE_OUTPUT=$(run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $DAEMON_CONTAINER)
+    DAEMON_CREATE_RET=$?
+    DAEMON_STATE_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $RUNTIME state $DAEMON_CONTAINER)
+    DAEMON_STATE_RET=$?
+    DAEMON_START_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $DAEMON_CONTAINER)
+    DAEMON_START_RET=$?
+    DAEMON_INIT_PID=$(get_container_pid_from_state "$DAEMON_CONTAINER" || true)
+    DAEMON_DEV_NULL=$($SUDO stat -c '%F %t,%T' "/proc/$DAEMON_INIT_PID/root/dev/null" 2>/dev/null)
+    DAEMON_DEV_MOUNT=$($SUDO grep " /dev rw" "/proc/$DAEMON_INIT_PID/mountinfo" 2>/dev/null)
+    DAEMON_POOL_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $SUDO $RUNTIME pool)
+    DAEMON_POOL_RET=$?
+    DAEMON_DEL_OUTPUT=$(run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $DAEMON_CONTAINER)
+    DAEMON_DEL_RET=$?
+    DAEMON_GONE_OUTPUT=$(run_with_timeout $TIMEOUT_STATE $RUNTIME state $DAEMON_CONTAINER)
+    DAEMON_GONE_RET=$?
+    set -e
+
+    if [ $DAEMON_CREATE_RET -ne 0 ] || ! echo "$DAEMON_CREATE_OUTPUT" | grep -q "Status: created"; then
+        test_fail "Create via ns-runtimed failed" "$DAEMON_CREATE_OUTPUT"
+    elif [ $DAEMON_STATE_RET -ne 0 ] || [ "$(echo "$DAEMON_STATE_OUTPUT" | tail -1)" != "created" ]; then
+        test_fail "State via ns-runtimed mismatch" "$DAEMON_STATE_OUTPUT"
+    elif [ $DAEMON_START_RET -ne 0 ]; then
+        test_fail "Start via ns-runtimed failed" "$DAEMON_START_OUTPUT"
+    elif [ "$DAEMON_DEV_NULL" != "character special file 1,3" ]; then
+        test_fail "/dev/null in the container is not the null device" "$DAEMON_DEV_NULL"
+    elif [ $DAEMON_POOL_RET -ne 0 ] || ! echo "$DAEMON_POOL_OUTPUT" | awk '$NF ~ /^\// && $3 >= 1 { found=1 } END { exit !found }'; then
+        test_fail "Start did not claim a warm-pool child" "$DAEMON_POOL_OUTPUT"
+    elif [ $DAEMON_DEL_RET -ne 0 ] || [ -d "$NS_RUN_DIR/$DAEMON_CONTAINER" ]; then
+        test_fail "Delete via ns-runtimed failed" "$DAEMON_DEL_OUTPUT"
+    elif [ $DAEMON_GONE_RET -eq 0 ] || ! echo "$DAEMON_GONE_OUTPUT" | grep -q "not found"; then
+        test_fail "Deleted container still visible through ns-runtimed cache" "$DAEMON_GONE_OUTPUT"
+    else
+        test_pass "create/state/start/delete served by ns-runtimed (warm pool hit)"
+    fi
+
+    test_start "ns-runtimed /dev mount template"
+    KERNEL_MM=$(uname -r | awk -F. '{ printf "%d%03d", $1, $2 }')
+    if echo "$DAEMON_DEV_MOUNT" | grep -q " - tmpfs [^ ]* ro,"; then
+        test_pass "/dev attached from the shared read-only template"
+    elif [ "$KERNEL_MM" -lt 6015 ]; then
+        test_skip "open_tree(OPEN_TREE_CLONE) of detached mounts needs Linux 6.15+"
+    else
+        test_fail "/dev was not attached from the mount template" "$DAEMON_DEV_MOUNT"
+    fi
+
+    test_start "ns-runtimed cgroup pool"
+    if [ ! -f /sys/fs/cgroup/cgroup.controllers ]; then
+        test_skip "cgroup v2 is not mounted at /sys/fs/cgroup"
+    elif echo "$DAEMON_POOL_OUTPUT" | grep -Eq '^cgroup-pool .* hits=[1-9]'; then
+        test_pass "Start claimed a pre-created cgroup"
+    else
+        test_fail "Start did not claim a pooled cgroup" "$DAEMON_POOL_OUTPUT"
+    fi
+fi
+
+test_start "ns-runtimed applies the client's NS_* settings"
+if [ ! -S "$DAEMON_SOCK" ]; then
+    test_skip "ns-runtimed is not running"
+else
+    set +e
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $DAEMON_CONTAINER >/dev/null 2>&1
+    DAEMON_ENV_OUTPUT=$(run_with_timeout $TIMEOUT_START $SUDO env NS_ROOTFS_MODE=overlay $RUNTIME start $DAEMON_CONTAINER 2>&1)
+    DAEMON_ENV_RET=$?
+    DAEMON_ENV_OVERLAY=false
+    $SUDO test -d "$NS_RUN_DIR/$DAEMON_CONTAINER/rootfs" && DAEMON_ENV_OVERLAY=true
+    run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $DAEMON_CONTAINER >/dev/null 2>&1
+    run_with_timeout $TIMEOUT_CREATE $SUDO $RUNTIME create --bundle=$TEST_BUNDLE $DAEMON_CONTAINER >/dev/null 2>&1
+    run_with_timeout $TIMEOUT_START $SUDO $RUNTIME start $DAEMON_CONTAINER >/dev/null 2>&1
+    DAEMON_ENV_LEAKED=false
+    $SUDO test -d "$NS_RUN_DIR/$DAEMON_CONTAINER/rootfs" && DAEMON_ENV_LEAKED=true
+    run_with_timeout $TIMEOUT_DELETE $SUDO $RUNTIME delete $DAEMON_CONTAINER >/dev/null 2>&1
+    set -e
+
+    if [ $DAEMON_ENV_RET -ne 0 ]; then
+        test_fail "Start with NS_ROOTFS_MODE=overlay via ns-runtimed failed" "$DAEMON_ENV_OUTPUT"
+    elif [ "$DAEMON_ENV_OVERLAY" != "true" ]; then
+        test_fail "ns-runtimed ignored the client's NS_ROOTFS_MODE=overlay"
+    elif [ "$DAEMON_ENV_LEAKED" = "true" ]; then
+        test_fail "NS_ROOTFS_MODE from one client leaked into the next request"
+    else
+        test_pass "NS_ROOTFS_MODE is applied per request and not kept by the daemon"
+    fi
+fi
+
+$SUDO kill "$DAEMON_PID" >/dev/null 2>&1 || true
+wait "$DAEMON_PID" 2>/dev/null || true
+DAEMON_PID=""
+if [ -e "$DAEMON_SOCK" ]; then
+    test_fail "ns-runtimed left its socket behind after shutdown"
+else
+    test_pass "ns-runtimed removed its socket on shutdown"
+fi
+
 # ============================================================================
 # Error Handling Tests
 # ============================================================================
@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <jansson.h>
+
+#include "nk.h"
+#include "nk_batch.h"
+#include "nk_container.h"
+#include "nk_log.h"
+#include "nk_oci.h"
+#include "common/state.h"
+#include "common/trace.h"
+
+static const char *const batch_kind_names[] = {
+    [NK_BATCH_CREATE] = "create",
+    [NK_BATCH_START]  = "start",
+    [NK_BATCH_DELETE] = "delete",
+};
+
+#define BATCH_KINDS (sizeof(batch_kind_names) / sizeof(batch_kind_names[0]))
+
+/* Written by the worker that ran the op, read by the parent after waitpid() */
+typedef struct batch_result {
+    uint32_t done;
+    int32_t status;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+} batch_result_t;
+
+typedef struct batch_manifest {
+    nk_batch_op_t *ops;
+    size_t len;
+    size_t cap;
+} batch_manifest_t;
+
+static void batch_manifest_free(batch_manifest_t *m) {
+    for (size_t i = 0; i < m->len; i++) {
+        free(m->ops[i].id);
+        free(m->ops[i].bundle);
+    }
+    free(m->ops);
+}
+
+/* Parse one manifest line; prints and returns -1 on a malformed line */
+static int batch_parse_line(const char *name, size_t lineno, const char *line,
+                            const char *default_bundle, nk_batch_op_t *op) {
+    json_error_t error;
+    json_t *root = json_loads(line, 0, &error);
+    json_t *kind, *id, *bundle, *park;
+    int ret = -1;
+
+    memset(op, 0, sizeof(*op));
+    if (!root) {
+        nk_stderr("Error: %s:%zu: %s\n", name, lineno, error.text);
+        return -1;
+    }
+    if (!json_is_object(root)) {
+        nk_stderr("Error: %s:%zu: expected a JSON object\n", name, lineno);
+        goto out;
+    }
+
+    kind = json_object_get(root, "op");
+    id = json_object_get(root, "id");
+    bundle = json_object_get(root, "bundle");
+    park = json_object_get(root, "park");
+
+    size_t k;
+    for (k = 0; k < BATCH_KINDS && json_is_string(kind); k++) {
+        if (strcmp(json_string_value(kind), batch_kind_names[k]) == 0) {
+            break;
+        }
+    }
+    if (!json_is_string(kind) || k == BATCH_KINDS) {
+        nk_stderr("Error: %s:%zu: \"op\" must be create, start or delete\n", name, lineno);
+        goto out;
+    }
+    if (!json_is_string(id) || json_string_value(id)[0] == '\0' ||
+        strchr(json_string_value(id), '/')) {
+        nk_stderr("Error: %s:%zu: \"id\" must be a non-empty container ID\n", name, lineno);
+        goto out;
+    }
+    if ((bundle && !json_is_string(bundle)) || (park && !json_is_boolean(park))) {
+        nk_stderr("Error: %s:%zu: \"bundle\" must be a string and \"park\" a boolean\n",
+                name, lineno);
+        goto out;
+    }
+    if (k != NK_BATCH_CREATE && (bundle || park)) {
+        nk_stderr("Error: %s:%zu: \"bundle\" and \"park\" only apply to create\n", name, lineno);
+        goto out;
+    }
+
+    op->kind = (nk_batch_kind_t)k;
+    op->id = strdup(json_string_value(id));
+    if (k == NK_BATCH_CREATE) {
+        op->bundle = strdup(bundle ? json_string_value(bundle) : default_bundle);
+        op->park = park && json_is_true(park);
+    }
+    if (!op->id || (k == NK_BATCH_CREATE && !op->bundle)) {
+        nk_stderr("Error: %s:%zu: out of memory\n", name, lineno);
+        free(op->id);
+        free(op->bundle);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    json_decref(root);
+    return ret;
+}
+
+/* Read the whole manifest; blank lines are skipped */
+static int batch_read_manifest(const char *path, const char *default_bundle,
+                               batch_manifest_t *m) {
+    bool is_stdin = strcmp(path, "-") == 0;
+    const char *name = is_stdin ? "<stdin>" : path;
+    FILE *f = is_stdin ? stdin : fopen(path, "re");
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t lineno = 0;
+    ssize_t n;
+    int ret = 0;
+
+    memset(m, 0, sizeof(*m));
+    if (!f) {
+        nk_stderr("Error: Cannot open batch manifest %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while ((n = getline(&line, &line_cap, f)) != -1) {
+        lineno++;
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r' ||
+                         line[n - 1] == ' ' || line[n - 1] == '\t')) {
+            line[--n] = '\0';
+        }
+        if (strspn(line, " \t") == (size_t)n) {
+            continue;
+        }
+
+        if (m->len == m->cap) {
+            size_t cap = m->cap ? m->cap * 2 : 64;
+            nk_batch_op_t *ops = realloc(m->ops, cap * sizeof(*ops));
+            if (!ops) {
+                nk_stderr("Error: Out of memory reading %s\n", name);
+                ret = -1;
+                break;
+            }
+            m->ops = ops;
+            m->cap = cap;
+        }
+        if (batch_parse_line(name, lineno, line, default_bundle, &m->ops[m->len]) == -1) {
+            ret = -1;
+            break;
+        }
+        m->len++;
+    }
+    if (ret == 0 && ferror(f)) {
+        nk_stderr("Error: Failed to read %s: %s\n", name, strerror(errno));
+        ret = -1;
+    }
+
+    free(line);
+    if (!is_stdin) {
+        fclose(f);
+    }
+    if (ret == -1) {
+        batch_manifest_free(m);
+        memset(m, 0, sizeof(*m));
+    }
+    return ret;
+}
+
+static bool batch_bundle_seen(const char **seen, size_t len, const char *bundle) {
+    for (size_t i = 0; i < len; i++) {
+        if (strcmp(seen[i], bundle) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Parse a bundle's config.json into the spec cache, once per bundle */
+static void batch_warm_bundle(const char **seen, size_t *len, const char *bundle) {
+    char config[PATH_MAX];
+    struct stat st;
+    int n;
+
+    if (batch_bundle_seen(seen, *len, bundle)) {
+        return;
+    }
+    seen[(*len)++] = bundle;
+
+    /* A missing bundle is reported by the operation that needs it */
+    n = snprintf(config, sizeof(config), "%s/config.json", bundle);
+    if (n < 0 || (size_t)n >= sizeof(config) || stat(config, &st) == -1) {
+        return;
+    }
+    nk_oci_spec_free(nk_oci_spec_load(bundle));
+}
+
+/*
+ * Everything the workers share is loaded here, before fork(): specs of
+ * every bundle the manifest creates from or starts, state of existing
+ * containers, the nano-sandbox parent cgroup and the /dev mount template.
+ */
+static void batch_warm(const batch_manifest_t *m) {
+    nk_container_t **loaded = calloc(m->len, sizeof(*loaded));
+    const char **seen = calloc(m->len, sizeof(*seen));
+    size_t seen_len = 0;
+
+    nk_oci_spec_cache_enable(true);
+    nk_state_cache_enable(true);
+    (void)nk_cgroup_prepare();
+    (void)nk_mount_template_prepare();
+
+    for (size_t i = 0; i < m->len; i++) {
+        const nk_batch_op_t *op = &m->ops[i];
+        const char *bundle = op->bundle;
+
+        /* Containers that already exist: cache their state, find the bundle */
+        if (loaded && op->kind != NK_BATCH_CREATE && nk_state_exists(op->id)) {
+            loaded[i] = nk_state_load(op->id);
+        }
+        if (op->kind == NK_BATCH_START) {
+            bundle = loaded && loaded[i] ? loaded[i]->bundle_path : NULL;
+        }
+        if (seen && bundle) {
+            batch_warm_bundle(seen, &seen_len, bundle);
+        }
+    }
+    free(seen);
+    if (loaded) {
+        nk_state_list_free(loaded, m->len);
+    }
+}
+
+/* FNV-1a of the container ID: every op on one container lands on one worker */
+static size_t batch_shard(const char *id, size_t workers) {
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++) {
+        h = (h ^ *p) * 0x100000001b3ull;
+    }
+    return (size_t)(h % workers);
+}
+
+static void batch_worker(const batch_manifest_t *m, const size_t *shard, size_t worker,
+                         batch_result_t *results, nk_batch_exec_fn exec) {
+    for (size_t i = 0; i < m->len; i++) {
+        if (shard[i] != worker) {
+            continue;
+        }
+        results[i].begin_ns = nk_trace_now();
+        results[i].status = exec(&m->ops[i]);
+        results[i].end_ns = nk_trace_now();
+        results[i].done = 1;
+    }
+    nk_log_flush();
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
+
+static int batch_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static uint64_t batch_percentile(const uint64_t *sorted, size_t len, unsigned pct) {
+    size_t rank = (len * pct + 99) / 100;
+
+    return len ? sorted[rank ? rank - 1 : 0] : 0;
+}
+
+static void batch_report(FILE *out, const batch_manifest_t *m, const batch_result_t *results,
+                         size_t workers, uint64_t wall_ns, bool json) {
+    uint64_t *lat[BATCH_KINDS] = {0};
+    size_t lat_len[BATCH_KINDS] = {0};
+    size_t failed = 0;
+    int id_width = 2;
+
+    for (size_t k = 0; k < BATCH_KINDS; k++) {
+        lat[k] = calloc(m->len ? m->len : 1, sizeof(uint64_t));
+    }
+    for (size_t i = 0; i < m->len; i++) {
+        int len = (int)strlen(m->ops[i].id);
+        id_width = len > id_width ? len : id_width;
+    }
+
+    if (!json) {
+        fprintf(out, "%-6s  %-*s  %-7s  %12s\n", "OP", id_width, "ID", "STATUS", "LATENCY(us)");
+    }
+    for (size_t i = 0; i < m->len; i++) {
+        const batch_result_t *r = &results[i];
+        const nk_batch_op_t *op = &m->ops[i];
+        const char *status = !r->done ? "not-run" : r->status == 0 ? "ok" : "failed";
+        uint64_t ns = r->done ? r->end_ns - r->begin_ns : 0;
+
+        if (!r->done || r->status != 0) {
+            failed++;
+        } else if (lat[op->kind]) {
+            lat[op->kind][lat_len[op->kind]++] = ns;
+        }
+        if (json) {
+            fprintf(out, "{\"op\":\"%s\",\"id\":", batch_kind_names[op->kind]);
+            json_t *id = json_string(op->id);
+            if (!id || json_dumpf(id, out, JSON_ENCODE_ANY) == -1) {
+                fputs("null", out);
+            }
+            json_decref(id);
+            fprintf(out, ",\"status\":\"%s\",\"latency_us\":%.1f}\n", status, (double)ns / 1000.0);
+        } else {
+            fprintf(out, "%-6s  %-*s  %-7s  %12.1f\n", batch_kind_names[op->kind], id_width,
+                    op->id, status, (double)ns / 1000.0);
+        }
+    }
+
+    double wall_s = (double)wall_ns / 1e9;
+    double rate = wall_ns ? (double)m->len / wall_s : 0.0;
+
+    if (json) {
+        fprintf(out, "{\"summary\":{\"ops\":%zu,\"failed\":%zu,\"workers\":%zu,"
+                "\"wall_us\":%.1f,\"ops_per_s\":%.1f", m->len, failed, workers,
+                (double)wall_ns / 1000.0, rate);
+    } else {
+        fprintf(out, "\n%zu ops, %zu failed, %zu workers, %.3f s wall, %.1f ops/s\n",
+                m->len, failed, workers, wall_s, rate);
+    }
+    for (size_t k = 0; k < BATCH_KINDS; k++) {
+        if (!lat[k] || lat_len[k] == 0) {
+            continue;
+        }
+        qsort(lat[k], lat_len[k], sizeof(uint64_t), batch_cmp_u64);
+        double p50 = (double)batch_percentile(lat[k], lat_len[k], 50) / 1000.0;
+        double p99 = (double)batch_percentile(lat[k], lat_len[k], 99) / 1000.0;
+        double max = (double)lat[k][lat_len[k] - 1] / 1000.0;
+        if (json) {
+            fprintf(out, ",\"%s\":{\"count\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+                    batch_kind_names[k], lat_len[k], p50, p99, max);
+        } else {
+            fprintf(out, "%-6s  n=%-6zu p50=%.1fus p99=%.1fus max=%.1fus\n",
+                    batch_kind_names[k], lat_len[k], p50, p99, max);
+        }
+    }
+    if (json) {
+        fputs("}}\n", out);
+    }
+
+    for (size_t k = 0; k < BATCH_KINDS; k++) {
+        free(lat[k]);
+    }
+}
+
+/**
+ * nk_batch_run - Read, warm up, fork workers, wait, report
+ */
+int nk_batch_run(FILE *out, const char *manifest, const char *default_bundle,
+                 size_t workers, bool json, nk_batch_exec_fn exec) {
+    batch_manifest_t m;
+    batch_result_t *results = MAP_FAILED;
+    size_t *shard = NULL;
+    pid_t *pids = NULL;
+    size_t started = 0;
+    int ret = -1;
+
+    if (batch_read_manifest(manifest, default_bundle, &m) == -1) {
+        return -1;
+    }
+    if (m.len == 0) {
+        batch_report(out, &m, NULL, 0, 0, json);
+        batch_manifest_free(&m);
+        return 0;
+    }
+
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (size_t)cpus : 1;
+    }
+    workers = workers > NK_BATCH_MAX_WORKERS ? NK_BATCH_MAX_WORKERS : workers;
+    workers = workers > m.len ? m.len : workers;
+
+    shard = calloc(m.len, sizeof(*shard));
+    pids = calloc(workers, sizeof(*pids));
+    results = mmap(NULL, m.len * sizeof(*results), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!shard || !pids || results == MAP_FAILED) {
+        nk_stderr("Error: Out of memory for a batch of %zu operations\n", m.len);
+        goto out;
+    }
+
+    batch_warm(&m);
+    for (size_t i = 0; i < m.len; i++) {
+        shard[i] = batch_shard(m.ops[i].id, workers);
+    }
+    nk_log_info("Batch: %zu operations on %zu workers", m.len, workers);
+
+    uint64_t begin = nk_trace_now();
+    nk_log_flush();  /* workers must not inherit queued records */
+    fflush(out);
+    fflush(stderr);
+    for (; started < workers; started++) {
+        pid_t pid = fork();
+
+        if (pid == -1) {
+            nk_stderr("Error: Failed to fork batch worker: %s\n", strerror(errno));
+            break;
+        }
+        if (pid == 0) {
+            batch_worker(&m, shard, started, results, exec);
+        }
+        pids[started] = pid;
+    }
+    for (size_t w = 0; w < started; w++) {
+        int status;
+
+        while (waitpid(pids[w], &status, 0) == -1 && errno == EINTR) {
+        }
+    }
+    uint64_t wall = nk_trace_now() - begin;
+
+    /* Ops of workers that never started (or died) are reported as not-run */
+    batch_report(out, &m, results, started, wall, json);
+    ret = 0;
+    for (size_t i = 0; i < m.len; i++) {
+        if (!results[i].done || results[i].status != 0) {
+            ret = 1;
+            break;
+        }
+    }
+
+out:
+    if (results != MAP_FAILED) {
+        munmap(results, m.len * sizeof(*results));
+    }
+    free(shard);
+    free(pids);
+    batch_manifest_free(&m);
+    return ret;
+}
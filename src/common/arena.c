@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common/arena.h"
+
+#define ARENA_ALIGN sizeof(void *)
+#define ARENA_CHUNK_MIN 4096
+
+static inline size_t arena_pad(const char *p) {
+    return (ARENA_ALIGN - ((uintptr_t)p & (ARENA_ALIGN - 1))) & (ARENA_ALIGN - 1);
+}
+
+/**
+ * nk_arena_init - Start an arena in caller-provided memory
+ */
+void nk_arena_init(nk_arena_t *arena, void *buf, size_t len) {
+    arena->ptr = buf;
+    arena->end = (char *)buf + len;
+    arena->chunks = NULL;
+}
+
+/**
+ * arena_grow - Switch to a new overflow chunk with room for @size aligned bytes
+ */
+static int arena_grow(nk_arena_t *arena, size_t size) {
+    size_t len = size + ARENA_ALIGN;
+
+    if (len < ARENA_CHUNK_MIN) {
+        len = ARENA_CHUNK_MIN;
+    }
+
+    nk_arena_chunk_t *chunk = malloc(sizeof(*chunk) + len);
+    if (!chunk) {
+        return -1;
+    }
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->ptr = (char *)(chunk + 1);
+    arena->end = arena->ptr + len;
+    return 0;
+}
+
+/**
+ * arena_take - Carve @size bytes with the given alignment padding rule
+ */
+static void *arena_take(nk_arena_t *arena, size_t size, bool aligned) {
+    size_t pad = aligned && arena->ptr ? arena_pad(arena->ptr) : 0;
+
+    if (!arena->ptr || (size_t)(arena->end - arena->ptr) < pad + size) {
+        if (arena_grow(arena, size) == -1) {
+            return NULL;
+        }
+        pad = 0;
+    }
+
+    void *p = arena->ptr + pad;
+    arena->ptr += pad + size;
+    return p;
+}
+
+/**
+ * nk_arena_alloc - Allocate zeroed, pointer-aligned memory
+ */
+void *nk_arena_alloc(nk_arena_t *arena, size_t size) {
+    void *p = arena_take(arena, size, true);
+
+    if (p && size > 0) {
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+/**
+ * nk_arena_strndup - Copy at most @len bytes of @s as a NUL-terminated string
+ */
+char *nk_arena_strndup(nk_arena_t *arena, const char *s, size_t len) {
+    len = strnlen(s, len);
+
+    char *p = arena_take(arena, len + 1, false);
+    if (p) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+/**
+ * nk_arena_strdup - Copy a NUL-terminated string into the arena
+ */
+char *nk_arena_strdup(nk_arena_t *arena, const char *s) {
+    return s ? nk_arena_strndup(arena, s, strlen(s)) : NULL;
+}
+
+/**
+ * nk_arena_release - Free every overflow chunk
+ */
+void nk_arena_release(nk_arena_t *arena) {
+    nk_arena_chunk_t *chunk = arena->chunks;
+
+    while (chunk) {
+        nk_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->ptr = NULL;
+    arena->end = NULL;
+}
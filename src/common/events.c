@@ -0,0 +1,440 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <jansson.h>
+
+#include "nk.h"
+#include "nk_container.h"
+#include "nk_log.h"
+#include "common/state.h"
+#include "common/events.h"
+
+/* Container list re-read (--all) or liveness check (single container) */
+#define EVENTS_RESCAN_MS 1000
+#define EVENTS_MAX_BATCH 64
+
+/* Watched files of one container cgroup */
+enum {
+    EVENTS_MEMORY,                  /* memory.events: oom, oom_kill */
+    EVENTS_PIDS,                    /* pids.events: max */
+    EVENTS_MEMORY_PRESSURE,
+    EVENTS_CPU_PRESSURE,
+    EVENTS_IO_PRESSURE,
+    EVENTS_FILES
+};
+
+static const char *const events_files[EVENTS_FILES] = {
+    "memory.events", "pids.events", "memory.pressure", "cpu.pressure", "io.pressure",
+};
+
+/* "memory" for memory.pressure, ... */
+static const char *const events_resources[EVENTS_FILES] = {
+    NULL, NULL, "memory", "cpu", "io",
+};
+
+typedef struct events_entry events_entry_t;
+
+/* epoll payload: one watched file of one container */
+typedef struct events_watch {
+    events_entry_t *entry;
+    int kind;
+    int fd;
+} events_watch_t;
+
+struct events_entry {
+    char *id;
+    events_watch_t watches[EVENTS_FILES];
+    int64_t oom;                    /* counters at the last event */
+    int64_t oom_kill;
+    int64_t pids_max;
+    bool gone;                      /* cgroup removed; fds are closed */
+};
+
+typedef struct events_set {
+    FILE *out;
+    int epfd;
+    char trigger[64];               /* "some <stall_us> <window_us>" */
+    events_entry_t **entries;       /* sorted by ID */
+    size_t count;
+    int failed;                     /* output could not be written */
+    bool trigger_warned;
+} events_set_t;
+
+/* Value of "key value" in a flat-keyed file such as memory.events */
+static int64_t events_key(const char *buf, const char *key) {
+    size_t len = strlen(key);
+
+    for (const char *p = buf; p; p = strchr(p, '\n')) {
+        p += *p == '\n';
+        if (strncmp(p, key, len) == 0 && p[len] == ' ') {
+            return strtoll(p + len + 1, NULL, 10);
+        }
+    }
+    return -1;
+}
+
+/* avg10 of the "some" or "full" line of a PSI file */
+static double events_avg10(const char *buf, const char *line) {
+    const char *p = strstr(buf, line);
+
+    p = p ? strstr(p, "avg10=") : NULL;
+    return p ? strtod(p + 6, NULL) : 0;
+}
+
+static long long events_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void events_emit(events_set_t *set, json_t *obj) {
+    if (!obj) {
+        set->failed = 1;
+        return;
+    }
+    if (json_dumpf(obj, set->out, JSON_COMPACT) == -1 || fputc('\n', set->out) == EOF) {
+        set->failed = 1;
+    }
+    json_decref(obj);
+}
+
+static json_t *events_new(const events_entry_t *e, const char *type) {
+    json_t *obj = json_object();
+
+    if (obj) {
+        json_object_set_new(obj, "type", json_string(type));
+        json_object_set_new(obj, "id", json_string(e->id));
+        json_object_set_new(obj, "timestamp_ms", json_integer(events_now_ms()));
+    }
+    return obj;
+}
+
+/* Emit an event for a counter that went up since the last one */
+static void events_counter(events_set_t *set, events_entry_t *e, const char *type,
+                           int64_t *last, int64_t now) {
+    if (now <= *last) {
+        return;
+    }
+    json_t *obj = events_new(e, type);
+    if (obj) {
+        json_object_set_new(obj, "count", json_integer(now - *last));
+        json_object_set_new(obj, "total", json_integer(now));
+    }
+    *last = now;
+    events_emit(set, obj);
+}
+
+static void events_entry_close(events_entry_t *e) {
+    for (int i = 0; i < EVENTS_FILES; i++) {
+        if (e->watches[i].fd != -1) {
+            close(e->watches[i].fd);    /* also drops it from the epoll set */
+            e->watches[i].fd = -1;
+        }
+    }
+}
+
+static void events_entry_free(events_entry_t *e) {
+    if (e) {
+        events_entry_close(e);
+        free(e->id);
+        free(e);
+    }
+}
+
+/**
+ * events_read - Re-read a watched file; marks the entry gone with its cgroup
+ *
+ * Reading a kernfs file also re-arms its change notification.
+ */
+static ssize_t events_read(events_watch_t *w, char *buf, size_t len) {
+    ssize_t n = pread(w->fd, buf, len - 1, 0);
+
+    if (n < 0) {
+        if (errno == ENODEV || errno == ENOENT) {
+            w->entry->gone = true;
+            events_entry_close(w->entry);
+        }
+        return -1;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+/**
+ * events_handle - Turn one readiness notification into events
+ */
+static void events_handle(events_set_t *set, events_watch_t *w, uint32_t revents) {
+    events_entry_t *e = w->entry;
+    char buf[512];
+
+    if (e->gone || w->fd == -1 || events_read(w, buf, sizeof(buf)) == -1) {
+        return;
+    }
+
+    switch (w->kind) {
+    case EVENTS_MEMORY:
+        events_counter(set, e, "oom", &e->oom, events_key(buf, "oom"));
+        events_counter(set, e, "oom_kill", &e->oom_kill, events_key(buf, "oom_kill"));
+        break;
+    case EVENTS_PIDS:
+        events_counter(set, e, "pids_max", &e->pids_max, events_key(buf, "max"));
+        break;
+    default: {
+        /* Each wakeup of a PSI trigger is one threshold crossing */
+        if (!(revents & EPOLLPRI)) {
+            break;
+        }
+        json_t *obj = events_new(e, "pressure");
+        if (obj) {
+            json_object_set_new(obj, "resource", json_string(events_resources[w->kind]));
+            json_object_set_new(obj, "some_avg10", json_real(events_avg10(buf, "some")));
+            json_object_set_new(obj, "full_avg10", json_real(events_avg10(buf, "full")));
+        }
+        events_emit(set, obj);
+        break;
+    }
+    }
+}
+
+/**
+ * events_entry_open - Open, arm and register every watchable file of a cgroup
+ */
+static events_entry_t *events_entry_open(events_set_t *set, const char *container_id) {
+    char path[PATH_MAX];
+    char buf[512];
+    int watched = 0;
+
+    if (nk_cgroup_path(container_id, path, sizeof(path)) == -1) {
+        return NULL;
+    }
+    int dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir == -1) {
+        return NULL;
+    }
+    events_entry_t *e = calloc(1, sizeof(*e));
+    if (!e || !(e->id = strdup(container_id))) {
+        free(e);
+        close(dir);
+        return NULL;
+    }
+
+    for (int i = 0; i < EVENTS_FILES; i++) {
+        events_watch_t *w = &e->watches[i];
+        bool psi = events_resources[i] != NULL;
+
+        w->entry = e;
+        w->kind = i;
+        w->fd = openat(dir, events_files[i], (psi ? O_RDWR | O_NONBLOCK : O_RDONLY) | O_CLOEXEC);
+        if (w->fd == -1) {
+            continue;               /* controller not enabled, or no PSI */
+        }
+
+        if (psi) {
+            /* The trigger lives as long as this fd */
+            if (write(w->fd, set->trigger, strlen(set->trigger) + 1) == -1) {
+                if (errno == EINVAL && !set->trigger_warned) {
+                    nk_stderr("Warning: PSI trigger \"%s\" rejected; without CAP_SYS_RESOURCE "
+                              "the window must be a multiple of 2000 ms\n", set->trigger);
+                    set->trigger_warned = true;
+                }
+                nk_log_debug("PSI trigger on %s/%s: %s", path, events_files[i], strerror(errno));
+                close(w->fd);
+                w->fd = -1;
+                continue;
+            }
+        } else if (events_read(w, buf, sizeof(buf)) > 0) {
+            /* Baseline: only increases after this point are events */
+            if (i == EVENTS_MEMORY) {
+                e->oom = events_key(buf, "oom");
+                e->oom_kill = events_key(buf, "oom_kill");
+            } else {
+                e->pids_max = events_key(buf, "max");
+            }
+        }
+
+        struct epoll_event ev = { .events = EPOLLPRI, .data.ptr = w };
+        if (epoll_ctl(set->epfd, EPOLL_CTL_ADD, w->fd, &ev) == -1) {
+            close(w->fd);
+            w->fd = -1;
+            continue;
+        }
+        watched++;
+    }
+    close(dir);
+
+    if (watched == 0 || e->gone) {
+        events_entry_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+static int events_entry_cmp(const void *key, const void *elem) {
+    return strcmp((const char *)key, (*(events_entry_t *const *)elem)->id);
+}
+
+/**
+ * events_rescan - Sync the watched set with the container list
+ */
+static int events_rescan(events_set_t *set) {
+    nk_container_t **list;
+    size_t count;
+    size_t kept = 0;
+
+    if (nk_state_list(&list, &count) == -1) {
+        return -1;
+    }
+    events_entry_t **entries = calloc(count ? count : 1, sizeof(*entries));
+    /* set->entries stays sorted and intact for bsearch(); moves are flagged here */
+    bool *moved = calloc(set->count ? set->count : 1, sizeof(*moved));
+    if (!entries || !moved) {
+        free(entries);
+        free(moved);
+        nk_state_list_free(list, count);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        events_entry_t **old = set->count ? bsearch(list[i]->id, set->entries, set->count,
+                                                    sizeof(*set->entries), events_entry_cmp) : NULL;
+        if (old && !(*old)->gone && !moved[old - set->entries]) {
+            entries[kept++] = *old;
+            moved[old - set->entries] = true;
+        } else if ((entries[kept] = events_entry_open(set, list[i]->id)) != NULL) {
+            kept++;
+        }
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        if (!moved[i]) {
+            events_entry_free(set->entries[i]);
+        }
+    }
+    free(moved);
+    free(set->entries);
+    set->entries = entries;
+    set->count = kept;
+    nk_state_list_free(list, count);
+    return 0;
+}
+
+/* Liveness of a single watched container; pending counter changes are emitted */
+static bool events_alive(events_set_t *set, events_entry_t *e) {
+    char buf[512];
+
+    for (int i = 0; i < EVENTS_FILES && !e->gone; i++) {
+        events_watch_t *w = &e->watches[i];
+        if (w->fd == -1) {
+            continue;
+        }
+        if (events_resources[i]) {
+            (void)events_read(w, buf, sizeof(buf));
+        } else {
+            events_handle(set, w, 0);
+        }
+        break;
+    }
+    return !e->gone;
+}
+
+static long long events_monotonic_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * nk_events_run - One epoll loop over every watched file until the end
+ */
+int nk_events_run(FILE *out, const char *container_id, unsigned stall_ms, unsigned window_ms) {
+    events_set_t set = { .out = out, .epfd = -1 };
+    struct epoll_event evs[EVENTS_MAX_BATCH];
+    int ret = 0;
+
+    if (stall_ms == 0) {
+        stall_ms = NK_EVENTS_PSI_STALL_MS;
+    }
+    if (window_ms == 0) {
+        window_ms = NK_EVENTS_PSI_WINDOW_MS;
+    }
+    snprintf(set.trigger, sizeof(set.trigger), "some %llu %llu",
+             (unsigned long long)stall_ms * 1000, (unsigned long long)window_ms * 1000);
+
+    set.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (set.epfd == -1) {
+        nk_stderr("Error: epoll_create1 failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (container_id) {
+        if (!nk_state_exists(container_id)) {
+            nk_stderr("Error: Container '%s' not found\n", container_id);
+            close(set.epfd);
+            return -1;
+        }
+        set.entries = calloc(1, sizeof(*set.entries));
+        if (!set.entries || !(set.entries[0] = events_entry_open(&set, container_id))) {
+            nk_stderr("Error: Container '%s' has no cgroup events to watch (cgroup v2 required)\n",
+                      container_id);
+            free(set.entries);
+            close(set.epfd);
+            return -1;
+        }
+        set.count = 1;
+    } else if (events_rescan(&set) == -1) {
+        close(set.epfd);
+        return -1;
+    }
+
+    long long next_rescan = events_monotonic_ms() + EVENTS_RESCAN_MS;
+    while (!set.failed) {
+        long long wait_ms = next_rescan - events_monotonic_ms();
+        int n = epoll_wait(set.epfd, evs, EVENTS_MAX_BATCH, wait_ms > 0 ? (int)wait_ms : 0);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            nk_stderr("Error: epoll_wait failed: %s\n", strerror(errno));
+            ret = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            events_handle(&set, evs[i].data.ptr, evs[i].events);
+        }
+        if (fflush(out) == EOF) {
+            break;                  /* reader went away */
+        }
+
+        if (events_monotonic_ms() >= next_rescan) {
+            next_rescan = events_monotonic_ms() + EVENTS_RESCAN_MS;
+            if (!container_id && events_rescan(&set) == -1) {
+                ret = -1;
+                break;
+            }
+            if (container_id) {
+                (void)events_alive(&set, set.entries[0]);
+                fflush(out);
+            }
+        }
+        if (container_id && set.entries[0]->gone) {
+            break;                  /* the container's cgroup was removed */
+        }
+    }
+
+    for (size_t i = 0; i < set.count; i++) {
+        events_entry_free(set.entries[i]);
+    }
+    free(set.entries);
+    close(set.epfd);
+    return ret;
+}
@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <jansson.h>
+
+#include "nk.h"
+#include "nk_container.h"
+#include "common/state.h"
+#include "common/list.h"
+
+#define LIST_PID_MAX_FILE "/proc/sys/kernel/pid_max"
+#define LIST_PID_MAX_DEFAULT 4194304u   /* PID_MAX_LIMIT on 64-bit */
+
+/* Bitmap of the PIDs present in /proc; bits == NULL means probe with kill() */
+typedef struct list_pids {
+    uint8_t *bits;
+    size_t max;
+} list_pids_t;
+
+typedef struct list_entry {
+    const nk_container_t *container;
+    nk_container_state_t state;     /* stored state, corrected for dead init */
+    pid_t pid;
+    long long uptime;               /* seconds; -1 if not running */
+} list_entry_t;
+
+static const char *list_state_name(nk_container_state_t state) {
+    switch (state) {
+    case NK_STATE_CREATED:
+        return "created";
+    case NK_STATE_RUNNING:
+        return "running";
+    case NK_STATE_STOPPED:
+        return "stopped";
+    case NK_STATE_PAUSED:
+        return "paused";
+    default:
+        return "unknown";
+    }
+}
+
+static size_t list_pid_max(void) {
+    FILE *f = fopen(LIST_PID_MAX_FILE, "re");
+    unsigned long max = 0;
+
+    if (f) {
+        if (fscanf(f, "%lu", &max) != 1) {
+            max = 0;
+        }
+        fclose(f);
+    }
+    return max > 0 ? (size_t)max : LIST_PID_MAX_DEFAULT;
+}
+
+/* One readdir of /proc instead of a kill(pid, 0) per container */
+static void list_sweep_pids(list_pids_t *pids) {
+    struct dirent *ent;
+    DIR *d;
+
+    pids->bits = NULL;
+    pids->max = 0;
+    d = opendir("/proc");
+    if (!d) {
+        return;
+    }
+
+    pids->max = list_pid_max();
+    pids->bits = calloc(pids->max / 8 + 1, 1);
+    if (!pids->bits) {
+        closedir(d);
+        return;
+    }
+    while ((ent = readdir(d)) != NULL) {
+        char *end;
+        unsigned long pid;
+
+        if (ent->d_name[0] < '1' || ent->d_name[0] > '9') {
+            continue;
+        }
+        pid = strtoul(ent->d_name, &end, 10);
+        if (*end == '\0' && pid < pids->max) {
+            pids->bits[pid / 8] |= (uint8_t)(1u << (pid % 8));
+        }
+    }
+    closedir(d);
+}
+
+static bool list_pid_alive(const list_pids_t *pids, pid_t pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    if (!pids->bits) {
+        return kill(pid, 0) == 0 || errno == EPERM;
+    }
+    return (size_t)pid < pids->max && (pids->bits[pid / 8] & (1u << (pid % 8)));
+}
+
+static void list_format_uptime(long long secs, char *buf, size_t len) {
+    if (secs < 0) {
+        snprintf(buf, len, "-");
+    } else if (secs >= 86400) {
+        snprintf(buf, len, "%lldd%02lldh", secs / 86400, secs % 86400 / 3600);
+    } else if (secs >= 3600) {
+        snprintf(buf, len, "%lldh%02lldm", secs / 3600, secs % 3600 / 60);
+    } else if (secs >= 60) {
+        snprintf(buf, len, "%lldm%02llds", secs / 60, secs % 60);
+    } else {
+        snprintf(buf, len, "%llds", secs);
+    }
+}
+
+static int list_print_json(FILE *out, const list_entry_t *e, const char *cgroup) {
+    const nk_container_t *c = e->container;
+    json_t *obj = json_object();
+    int ret = 0;
+
+    if (!obj) {
+        return -1;
+    }
+    json_object_set_new(obj, "id", json_string(c->id));
+    json_object_set_new(obj, "state", json_string(list_state_name(e->state)));
+    json_object_set_new(obj, "pid", json_integer(e->pid));
+    json_object_set_new(obj, "bundle", json_string(c->bundle_path ? c->bundle_path : ""));
+    json_object_set_new(obj, "cgroup", json_string(cgroup));
+    json_object_set_new(obj, "uptime_s", e->uptime >= 0 ? json_integer(e->uptime) : json_null());
+    if (json_dumpf(obj, out, JSON_COMPACT) == -1) {
+        ret = -1;
+    } else {
+        fputc('\n', out);
+    }
+    json_decref(obj);
+    return ret;
+}
+
+/**
+ * nk_list_print - Load all state, sweep /proc once, then print
+ */
+int nk_list_print(FILE *out, bool json) {
+    nk_container_t **list;
+    list_entry_t *entries;
+    list_pids_t pids = {0};
+    size_t count;
+    int id_width = 2;
+    int bundle_width = 6;
+    int ret = 0;
+
+    if (nk_state_list(&list, &count) == -1) {
+        return -1;
+    }
+    entries = calloc(count ? count : 1, sizeof(*entries));
+    if (!entries) {
+        nk_state_list_free(list, count);
+        return -1;
+    }
+
+    bool need_sweep = false;
+    for (size_t i = 0; i < count; i++) {
+        need_sweep |= list[i]->init_pid > 0;
+    }
+    if (need_sweep) {
+        list_sweep_pids(&pids);
+    }
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++) {
+        const nk_container_t *c = list[i];
+        list_entry_t *e = &entries[i];
+
+        e->container = c;
+        e->state = c->state;
+        e->pid = c->init_pid;
+        e->uptime = -1;
+        if (e->pid > 0 && (e->state == NK_STATE_RUNNING || e->state == NK_STATE_CREATED) &&
+            !list_pid_alive(&pids, e->pid)) {
+            e->state = NK_STATE_STOPPED;
+        }
+        if (e->state == NK_STATE_STOPPED) {
+            e->pid = 0;
+        }
+        if (e->state == NK_STATE_RUNNING && c->started_at > 0) {
+            e->uptime = now > c->started_at ? (long long)(now - c->started_at) : 0;
+        }
+
+        int len = (int)strlen(c->id);
+        id_width = len > id_width ? len : id_width;
+        len = c->bundle_path ? (int)strlen(c->bundle_path) : 1;
+        bundle_width = len > bundle_width ? len : bundle_width;
+    }
+
+    if (!json) {
+        fprintf(out, "%-*s  %-8s  %8s  %8s  %-*s  %s\n", id_width, "ID", "STATE", "PID", "UPTIME",
+                bundle_width, "BUNDLE", "CGROUP");
+    }
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        const list_entry_t *e = &entries[i];
+        char cgroup[PATH_MAX];
+        char uptime[32];
+
+        if (nk_cgroup_path(e->container->id, cgroup, sizeof(cgroup)) == -1) {
+            cgroup[0] = '\0';
+        }
+        if (json) {
+            ret = list_print_json(out, e, cgroup);
+            continue;
+        }
+        list_format_uptime(e->uptime, uptime, sizeof(uptime));
+        fprintf(out, "%-*s  %-8s  %8d  %8s  %-*s  %s\n", id_width, e->container->id,
+                list_state_name(e->state), (int)e->pid, uptime, bundle_width,
+                e->container->bundle_path ? e->container->bundle_path : "-",
+                cgroup[0] ? cgroup : "-");
+    }
+
+    free(pids.bits);
+    free(entries);
+    nk_state_list_free(list, count);
+    return ret;
+}
@@ -6,6 +6,9 @@
 #include <strings.h>
 #include <time.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 #include "nk_log.h"
 
@@ -58,6 +61,561 @@ static const char *nk_basename(const char *path) {
     return slash ? slash + 1 : path;
 }
 
+/*
+ * Log ring: fixed-size binary records, formatted only when flushed.
+ *
+ * The runtime logs from one thread per process, so the ring is a
+ * single-producer/single-consumer queue: the writer publishes a record by
+ * advancing head, nk_log_flush() consumes up to head and advances tail.
+ * Neither side takes a lock, so a flush interrupted by a signal handler
+ * that logs cannot deadlock.
+ */
+#define LOG_RING_RECORDS 512           /* power of two */
+#define LOG_RECORD_SIZE 256
+#define LOG_MSG_MAX 1024               /* formatted message, including NUL */
+#define LOG_FLUSH_BUF 8192
+#define LOG_STR_NULL 0xffffu           /* string length marking a NULL %s */
+
+enum { LOG_REC_MESSAGE, LOG_REC_EXPLAIN };
+
+/* Integer length modifiers, normalized */
+enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_UNSUPPORTED };
+
+typedef struct {
+    uint64_t ts_ns;      /* CLOCK_REALTIME at the call */
+    const char *file;    /* Call site, from __FILE__ */
+    const char *fmt;     /* Format string; "%s" for explanations */
+    uint32_t line;
+    uint8_t level;
+    uint8_t role;
+    uint8_t kind;        /* LOG_REC_* */
+    uint8_t pad;
+    uint16_t args_len;   /* Bytes used in args[] */
+    unsigned char args[LOG_RECORD_SIZE - 38];
+} log_record_t;
+
+_Static_assert(sizeof(log_record_t) == LOG_RECORD_SIZE, "log record must stay fixed-size");
+
+static struct {
+    _Atomic uint64_t head;   /* Next record to write */
+    _Atomic uint64_t tail;   /* Next record to flush */
+    atomic_bool flushing;
+    bool atexit_registered;
+    log_record_t rec[LOG_RING_RECORDS];
+} log_ring;
+
+/* One conversion of a printf format, e.g. "%-*.3lu" */
+typedef struct {
+    const char *start;       /* The '%' */
+    const char *len_start;   /* First length modifier character */
+    const char *end;         /* One past the conversion character */
+    bool star_width;
+    bool star_prec;
+    int length;              /* LEN_* */
+    char conv;
+} log_spec_t;
+
+/*
+ * Parse the conversion starting at @p ('%'). Returns false for anything
+ * the ring cannot defer (%n, %m, %ls, long double, positional args, ...).
+ */
+static bool log_parse_spec(const char *p, log_spec_t *spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->start = p++;
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->star_width = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (*p == '$') {
+            return false;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->star_prec = true;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+    }
+
+    spec->len_start = p;
+    switch (*p) {
+    case 'h':
+        spec->length = p[1] == 'h' ? LEN_HH : LEN_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = p[1] == 'l' ? LEN_LL : LEN_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'q':
+        spec->length = LEN_LL;
+        p++;
+        break;
+    case 'z':
+        spec->length = LEN_Z;
+        p++;
+        break;
+    case 'j':
+        spec->length = LEN_J;
+        p++;
+        break;
+    case 't':
+        spec->length = LEN_T;
+        p++;
+        break;
+    case 'L':
+        spec->length = LEN_UNSUPPORTED;
+        p++;
+        break;
+    default:
+        spec->length = LEN_NONE;
+        break;
+    }
+
+    spec->conv = *p;
+    if (!*p || spec->length == LEN_UNSUPPORTED) {
+        return false;
+    }
+    spec->end = p + 1;
+
+    switch (spec->conv) {
+    case '%':
+        return !spec->star_width && !spec->star_prec && spec->length == LEN_NONE;
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        return true;
+    case 'c': case 's':
+        return spec->length == LEN_NONE;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        return spec->length == LEN_NONE || spec->length == LEN_L;
+    case 'p':
+        return spec->length == LEN_NONE;
+    default:
+        return false;
+    }
+}
+
+static bool log_put(log_record_t *rec, const void *v, size_t len) {
+    if (len > sizeof(rec->args) - rec->args_len) {
+        return false;
+    }
+    memcpy(rec->args + rec->args_len, v, len);
+    rec->args_len = (uint16_t)(rec->args_len + len);
+    return true;
+}
+
+static bool log_put_int(log_record_t *rec, int64_t v) {
+    return log_put(rec, &v, sizeof(v));
+}
+
+/* Read one integer argument, applying the truncation printf would */
+static int64_t log_arg_signed(int length, va_list *ap) {
+    switch (length) {
+    case LEN_HH: return (signed char)va_arg(*ap, int);
+    case LEN_H:  return (short)va_arg(*ap, int);
+    case LEN_L:  return va_arg(*ap, long);
+    case LEN_LL: return va_arg(*ap, long long);
+    case LEN_Z:  return va_arg(*ap, ssize_t);
+    case LEN_J:  return va_arg(*ap, intmax_t);
+    case LEN_T:  return va_arg(*ap, ptrdiff_t);
+    default:     return va_arg(*ap, int);
+    }
+}
+
+static uint64_t log_arg_unsigned(int length, va_list *ap) {
+    switch (length) {
+    case LEN_HH: return (unsigned char)va_arg(*ap, unsigned int);
+    case LEN_H:  return (unsigned short)va_arg(*ap, unsigned int);
+    case LEN_L:  return va_arg(*ap, unsigned long);
+    case LEN_LL: return va_arg(*ap, unsigned long long);
+    case LEN_Z:  return va_arg(*ap, size_t);
+    case LEN_J:  return va_arg(*ap, uintmax_t);
+    case LEN_T:  return (uint64_t)va_arg(*ap, ptrdiff_t);
+    default:     return va_arg(*ap, unsigned int);
+    }
+}
+
+/* Copy the arguments of @fmt into @rec; false if they cannot be deferred */
+static bool log_capture(log_record_t *rec, const char *fmt, va_list *ap) {
+    for (const char *p = strchr(fmt, '%'); p; p = strchr(p, '%')) {
+        log_spec_t spec;
+
+        if (!log_parse_spec(p, &spec)) {
+            return false;
+        }
+        p = spec.end;
+
+        if (spec.star_width && !log_put_int(rec, va_arg(*ap, int))) {
+            return false;
+        }
+        if (spec.star_prec && !log_put_int(rec, va_arg(*ap, int))) {
+            return false;
+        }
+
+        bool ok = true;
+        switch (spec.conv) {
+        case '%':
+            break;
+        case 'd': case 'i':
+            ok = log_put_int(rec, log_arg_signed(spec.length, ap));
+            break;
+        case 'u': case 'o': case 'x': case 'X': {
+            uint64_t v = log_arg_unsigned(spec.length, ap);
+            ok = log_put(rec, &v, sizeof(v));
+            break;
+        }
+        case 'c':
+            ok = log_put_int(rec, va_arg(*ap, int));
+            break;
+        case 'p': {
+            void *v = va_arg(*ap, void *);
+            ok = log_put(rec, &v, sizeof(v));
+            break;
+        }
+        case 's': {
+            const char *str = va_arg(*ap, const char *);
+            size_t n = str ? strlen(str) : 0;
+            uint16_t len = str ? (uint16_t)n : LOG_STR_NULL;
+
+            ok = n < LOG_STR_NULL && log_put(rec, &len, sizeof(len)) &&
+                 (!str || log_put(rec, str, n + 1));
+            break;
+        }
+        default: {
+            double v = va_arg(*ap, double);
+            ok = log_put(rec, &v, sizeof(v));
+            break;
+        }
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void log_get(const log_record_t *rec, size_t *off, void *v, size_t len) {
+    memcpy(v, rec->args + *off, len);
+    *off += len;
+}
+
+/* Append printf output to @buf, clamping at its end like vsnprintf() */
+static void log_appendf(char *buf, size_t size, size_t *pos, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void log_appendf(char *buf, size_t size, size_t *pos, const char *fmt, ...) {
+    va_list args;
+    int n;
+
+    if (*pos >= size - 1) {
+        return;
+    }
+    va_start(args, fmt);
+    n = vsnprintf(buf + *pos, size - *pos, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        *pos += (size_t)n < size - *pos ? (size_t)n : size - *pos - 1;
+    }
+}
+
+/* Format a captured record's message into @msg */
+static void log_render(const log_record_t *rec, char *msg, size_t size) {
+    const char *fmt = rec->fmt;
+    size_t pos = 0;
+    size_t off = 0;
+
+    msg[0] = '\0';
+    for (const char *p = fmt; *p;) {
+        const char *pct = strchr(p, '%');
+        log_spec_t spec;
+        char sub[64];
+        int stars[2];
+        int nstars = 0;
+
+        if (!pct) {
+            log_appendf(msg, size, &pos, "%s", p);
+            break;
+        }
+        if (pct > p) {
+            log_appendf(msg, size, &pos, "%.*s", (int)(pct - p), p);
+        }
+        if (!log_parse_spec(pct, &spec)) {
+            break;  /* not reached: log_capture() rejected the record */
+        }
+        p = spec.end;
+
+        /* Rebuild the conversion with a length modifier matching what we stored */
+        size_t prefix = (size_t)(spec.len_start - spec.start);
+        const char *mod = "";
+        if (strchr("diuoxX", spec.conv)) {
+            mod = "ll";
+        }
+        if (prefix + strlen(mod) + 2 > sizeof(sub)) {
+            break;
+        }
+        memcpy(sub, spec.start, prefix);
+        snprintf(sub + prefix, sizeof(sub) - prefix, "%s%c", mod, spec.conv);
+
+        if (spec.star_width) {
+            int64_t v;
+            log_get(rec, &off, &v, sizeof(v));
+            stars[nstars++] = (int)v;
+        }
+        if (spec.star_prec) {
+            int64_t v;
+            log_get(rec, &off, &v, sizeof(v));
+            stars[nstars++] = (int)v;
+        }
+
+/* sub is a conversion copied from a format the compiler already checked */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#define LOG_EMIT(val) \
+        do { \
+            if (nstars == 2) log_appendf(msg, size, &pos, sub, stars[0], stars[1], (val)); \
+            else if (nstars == 1) log_appendf(msg, size, &pos, sub, stars[0], (val)); \
+            else log_appendf(msg, size, &pos, sub, (val)); \
+        } while (0)
+
+        switch (spec.conv) {
+        case '%':
+            log_appendf(msg, size, &pos, "%%");
+            break;
+        case 'd': case 'i': {
+            int64_t v;
+            log_get(rec, &off, &v, sizeof(v));
+            LOG_EMIT((long long)v);
+            break;
+        }
+        case 'u': case 'o': case 'x': case 'X': {
+            uint64_t v;
+            log_get(rec, &off, &v, sizeof(v));
+            LOG_EMIT((unsigned long long)v);
+            break;
+        }
+        case 'c': {
+            int64_t v;
+            log_get(rec, &off, &v, sizeof(v));
+            LOG_EMIT((int)v);
+            break;
+        }
+        case 'p': {
+            void *v;
+            log_get(rec, &off, &v, sizeof(v));
+            LOG_EMIT(v);
+            break;
+        }
+        case 's': {
+            uint16_t len;
+            const char *str = NULL;
+            log_get(rec, &off, &len, sizeof(len));
+            if (len != LOG_STR_NULL) {
+                str = (const char *)rec->args + off;
+                off += (size_t)len + 1;
+            }
+            LOG_EMIT(str);
+            break;
+        }
+        default: {
+            double v;
+            log_get(rec, &off, &v, sizeof(v));
+            LOG_EMIT(v);
+            break;
+        }
+        }
+#undef LOG_EMIT
+#pragma GCC diagnostic pop
+    }
+}
+
+/* Write one formatted line (the pre-ring nk_log_at/nk_log_explain_at output) */
+static void log_format_line(char *out, size_t size, size_t *pos, const log_record_t *rec,
+                            const char *msg, bool tty) {
+    if (rec->kind == LOG_REC_EXPLAIN) {
+        if (tty) {
+            log_appendf(out, size, pos, "%s      │ [%s%s%s] [%s:%u] %s%s%s\n", "\033[0;90m",
+                        role_colors[rec->role], role_names[rec->role], color_reset,
+                        nk_basename(rec->file), rec->line,
+                        "\033[0;37m", msg, "\033[0m");
+        } else {
+            log_appendf(out, size, pos, "      │ [%s] [%s:%u] %s\n",
+                        role_names[rec->role], nk_basename(rec->file), rec->line, msg);
+        }
+        return;
+    }
+
+    static time_t cached_sec = -1;
+    static struct tm cached_tm;
+    time_t sec = (time_t)(rec->ts_ns / 1000000000ull);
+    if (sec != cached_sec) {
+        localtime_r(&sec, &cached_tm);
+        cached_sec = sec;
+    }
+
+    char timestamp[64];
+    snprintf(timestamp, sizeof(timestamp), "%02d:%02d:%02d.%03d",
+             cached_tm.tm_hour, cached_tm.tm_min, cached_tm.tm_sec,
+             (int)((rec->ts_ns % 1000000000ull) / 1000000));
+
+    /* Print with colors if output is a terminal */
+    if (tty) {
+        log_appendf(out, size, pos, "%s[%s]%s [%s%s%s] [%s%s%s] [%s:%u] %s%s%s\n",
+                    "\033[0;90m",  /* Dim gray for timestamp */
+                    timestamp,
+                    color_reset,
+                    role_colors[rec->role], role_names[rec->role], color_reset,
+                    level_colors[rec->level], level_names[rec->level], color_reset,
+                    nk_basename(rec->file), rec->line,
+                    "\033[0m", msg, color_reset);
+    } else {
+        log_appendf(out, size, pos, "[%s] [%s] [%s] [%s:%u] %s\n",
+                    timestamp, role_names[rec->role], level_names[rec->level],
+                    nk_basename(rec->file), rec->line, msg);
+    }
+}
+
+static void log_write_out(const char *buf, size_t len) {
+    if (len > 0) {
+        fwrite(buf, 1, len, stderr);
+    }
+}
+
+/* Format and write one record; @msg is NULL to render it from rec->args */
+static void log_emit(const log_record_t *rec, const char *msg, char *out, size_t *pos, bool tty) {
+    char line[LOG_MSG_MAX + 256];
+    char rendered[LOG_MSG_MAX];
+    size_t len = 0;
+
+    if (!msg) {
+        log_render(rec, rendered, sizeof(rendered));
+        msg = rendered;
+    }
+    log_format_line(line, sizeof(line), &len, rec, msg, tty);
+
+    if (*pos + len > LOG_FLUSH_BUF) {
+        log_write_out(out, *pos);
+        *pos = 0;
+    }
+    memcpy(out + *pos, line, len);
+    *pos += len;
+}
+
+void nk_log_flush(void) {
+    static char out[LOG_FLUSH_BUF];
+    size_t pos = 0;
+    bool expected = false;
+
+    if (!atomic_compare_exchange_strong(&log_ring.flushing, &expected, true)) {
+        return;
+    }
+
+    uint64_t tail = atomic_load_explicit(&log_ring.tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&log_ring.head, memory_order_acquire);
+    if (tail != head) {
+        bool tty = isatty(STDERR_FILENO);
+
+        for (; tail != head; tail++) {
+            log_emit(&log_ring.rec[tail % LOG_RING_RECORDS], NULL, out, &pos, tty);
+        }
+        log_write_out(out, pos);
+        atomic_store_explicit(&log_ring.tail, tail, memory_order_release);
+    }
+
+    atomic_store(&log_ring.flushing, false);
+}
+
+static void log_atexit(void) {
+    nk_log_flush();
+}
+
+/* Claim the next free record, flushing first if the ring is full */
+static log_record_t *log_reserve(void) {
+    uint64_t head = atomic_load_explicit(&log_ring.head, memory_order_relaxed);
+
+    if (!log_ring.atexit_registered) {
+        log_ring.atexit_registered = true;
+        atexit(log_atexit);
+    }
+    if (head - atomic_load_explicit(&log_ring.tail, memory_order_acquire) >= LOG_RING_RECORDS) {
+        nk_log_flush();
+        if (head - atomic_load_explicit(&log_ring.tail, memory_order_acquire) >= LOG_RING_RECORDS) {
+            return NULL;  /* Logging from inside a flush: drop */
+        }
+    }
+
+    log_record_t *rec = &log_ring.rec[head % LOG_RING_RECORDS];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    rec->role = (uint8_t)nk_log_role;
+    rec->args_len = 0;
+    return rec;
+}
+
+static void log_publish(void) {
+    atomic_fetch_add_explicit(&log_ring.head, 1, memory_order_release);
+}
+
+/* Format now, after everything already queued: arguments did not fit */
+static void log_emit_now(log_record_t *rec, const char *fmt, va_list ap) {
+    char out[LOG_MSG_MAX + 256];
+    char msg[LOG_MSG_MAX];
+    size_t pos = 0;
+
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    nk_log_flush();
+    log_emit(rec, msg, out, &pos, isatty(STDERR_FILENO));
+    log_write_out(out, pos);
+}
+
+static void log_record(uint8_t kind, nk_log_level_t level, const char *file, int line,
+                       const char *fmt, va_list ap) {
+    log_record_t *rec = log_reserve();
+    va_list capture;
+
+    if (!rec) {
+        return;
+    }
+    rec->file = file;
+    rec->line = (uint32_t)line;
+    rec->fmt = fmt;
+    rec->level = (uint8_t)level;
+    rec->kind = kind;
+
+    va_copy(capture, ap);
+    bool deferred = log_capture(rec, fmt, &capture);
+    va_end(capture);
+
+    if (!deferred) {
+        log_emit_now(rec, fmt, ap);
+        return;
+    }
+    log_publish();
+    if (level >= NK_LOG_ERROR) {
+        nk_log_flush();
+    }
+}
+
+static void log_record_args(uint8_t kind, nk_log_level_t level, const char *file, int line,
+                            const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    log_record(kind, level, file, line, fmt, args);
+    va_end(args);
+}
+
 static bool nk_parse_env_bool(const char *value, bool *out) {
     if (!value || !out) {
         return false;
@@ -189,45 +747,16 @@ void nk_log_set_role(nk_log_role_t role) {
 }
 
 void nk_log_at(nk_log_level_t level, const char *file, int line, const char *fmt, ...) {
+    va_list args;
+
     nk_log_apply_env();
     if (!nk_log_enabled || level < nk_log_level) {
         return;
     }
 
-    /* Get current time */
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-
-    struct tm tm;
-    localtime_r(&ts.tv_sec, &tm);
-
-    char timestamp[64];
-    snprintf(timestamp, sizeof(timestamp), "%02d:%02d:%02d.%03d",
-             tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(ts.tv_nsec / 1000000));
-
-    /* Format the message */
-    va_list args;
     va_start(args, fmt);
-
-    char msg[1024];
-    vsnprintf(msg, sizeof(msg), fmt, args);
-
+    log_record(LOG_REC_MESSAGE, level, file, line, fmt, args);
     va_end(args);
-
-    /* Print with colors if output is a terminal */
-    if (isatty(STDERR_FILENO)) {
-        fprintf(stderr, "%s[%s]%s [%s%s%s] [%s%s%s] [%s:%d] %s%s%s\n",
-                "\033[0;90m",  /* Dim gray for timestamp */
-                timestamp,
-                color_reset,
-                role_colors[nk_log_role], role_names[nk_log_role], color_reset,
-                level_colors[level], level_names[level], color_reset,
-                nk_basename(file), line,
-                "\033[0m", msg, color_reset);
-    } else {
-        fprintf(stderr, "[%s] [%s] [%s] [%s:%d] %s\n",
-                timestamp, role_names[nk_log_role], level_names[level], nk_basename(file), line, msg);
-    }
 }
 
 void nk_log_explain_at(const char *file, int line, const char *what, const char *why) {
@@ -248,15 +777,7 @@ void nk_log_explain_at(const char *file, int line, const char *what, const char
     }
 
     if (explanation) {
-        if (isatty(STDERR_FILENO)) {
-            fprintf(stderr, "%s      │ [%s%s%s] [%s:%d] %s%s%s\n", "\033[0;90m",
-                    role_colors[nk_log_role], role_names[nk_log_role], color_reset,
-                    nk_basename(file), line,
-                    "\033[0;37m", explanation, "\033[0m");
-        } else {
-            fprintf(stderr, "      │ [%s] [%s:%d] %s\n",
-                    role_names[nk_log_role], nk_basename(file), line, explanation);
-        }
+        log_record_args(LOG_REC_EXPLAIN, NK_LOG_INFO, file, line, "%s", explanation);
     }
 }
 
@@ -268,6 +789,9 @@ void nk_log_stderr_at(const char *file, int line, const char *fmt, ...) {
         return;
     }
 
+    /* Keep queued log lines ahead of this one */
+    nk_log_flush();
+
     if (isatty(STDERR_FILENO)) {
         fprintf(stderr, "[%s%s%s] [%s:%d] ",
                 role_colors[nk_log_role], role_names[nk_log_role], color_reset,
@@ -3,17 +3,90 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <jansson.h>
 
 #include "nk.h"
 #include "nk_log.h"
+#include "common/state.h"
+#include "common/state_table.h"
 
 #define STATE_FILE "state.json"
 #define NS_STATE_DIR_ROOT "/run/nano-sandbox"
 #define NS_STATE_DIR_USER_SUFFIX "/.local/share/nano-sandbox/run"
+#define STATE_CACHE_BUCKETS 256
+#define STATE_LOCK_DIR ".locks"
+#define STATE_SYNC_FILE ".state-sync"
+#define STATE_SYNC_WINDOW_US 1000
+#define STATE_SYNC_QUEUE 64
+#define STATE_LIST_CHUNK 64             /* state.json files a list worker claims at once */
+#define STATE_LIST_PER_THREAD 256       /* fewer files than this per thread: not worth one */
+#define STATE_LIST_MAX_THREADS 8
+#define STATE_LIST_MAX_FILE (64 * 1024)
+
+/* In-memory copy of a state.json, tagged with the file identity it came from */
+typedef struct state_cache_entry {
+    struct state_cache_entry *next;
+    char *id;
+    char *bundle_path;
+    nk_container_state_t state;
+    nk_execution_mode_t mode;
+    pid_t init_pid;
+    int64_t started_at;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} state_cache_entry_t;
+
+/* Where container state lives; NS_STATE_BACKEND=json|table */
+typedef enum {
+    STATE_BACKEND_JSON,     /* <state_dir>/<id>/state.json */
+    STATE_BACKEND_TABLE,    /* record in <state_dir>/state.tbl */
+} state_backend_t;
+
+/* Durability of state writes; NS_STATE_SYNC=none|always|group */
+typedef enum {
+    STATE_SYNC_NONE,        /* atomic rename only; survives crashes, not power loss */
+    STATE_SYNC_ALWAYS,      /* fsync file and directory on every save */
+    STATE_SYNC_GROUP,       /* one syncfs() per batch of concurrent saves */
+} state_sync_t;
+
+/* What a state update needs flushed */
+#define STATE_SYNC_CONTAINER  (1u << 0)   /* <id>/state.json and <id>/ */
+#define STATE_SYNC_STATE_DIR  (1u << 1)   /* entries of the state root */
+#define STATE_SYNC_TABLE      (1u << 2)   /* state.tbl */
+
+/* Byte-range locks in STATE_SYNC_FILE */
+#define STATE_SYNC_LOCK_QUEUE   0
+#define STATE_SYNC_LOCK_LEADER  1
+
+typedef struct state_sync_entry {
+    uint32_t what;
+    char id[252];
+} state_sync_entry_t;
+
+/* Group commit queue, shared by every runtime process via STATE_SYNC_FILE */
+typedef struct state_sync_shared {
+    _Atomic uint64_t requested;     /* last ticket handed out */
+    _Atomic uint64_t synced;        /* every ticket <= this is durable */
+    uint32_t count;                 /* queued entries (queue lock) */
+    uint32_t overflow;              /* queue was full: flush everything */
+    state_sync_entry_t queue[STATE_SYNC_QUEUE];
+    uint32_t inflight;              /* a drained batch is not yet published */
+} state_sync_shared_t;
+
+static bool state_cache_enabled = false;
+static state_cache_entry_t *state_cache[STATE_CACHE_BUCKETS];
 
 static int mkdir_p(const char *path, mode_t mode) {
     char tmp[PATH_MAX];
@@ -84,6 +157,242 @@ static const char *get_state_dir(void) {
     return "run";
 }
 
+static state_backend_t state_backend(void) {
+    const char *backend = getenv("NS_STATE_BACKEND");
+
+    if (backend && strcmp(backend, "table") == 0) {
+        return STATE_BACKEND_TABLE;
+    }
+    return STATE_BACKEND_JSON;
+}
+
+static state_sync_t state_sync_mode(void) {
+    const char *mode = getenv("NS_STATE_SYNC");
+
+    if (mode && strcmp(mode, "always") == 0) {
+        return STATE_SYNC_ALWAYS;
+    }
+    if (mode && strcmp(mode, "group") == 0) {
+        return STATE_SYNC_GROUP;
+    }
+    return STATE_SYNC_NONE;
+}
+
+static int fsync_path(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int ret;
+
+    if (fd == -1) {
+        return -1;
+    }
+    ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+/* Flush what one state update touched; missing paths were deleted since */
+static int state_sync_targets(unsigned what, const char *container_id) {
+    const char *state_dir = get_state_dir();
+    char path[PATH_MAX];
+    int ret = 0;
+
+    if ((what & STATE_SYNC_CONTAINER) && container_id) {
+        int fd;
+
+        snprintf(path, sizeof(path), "%s/%s/%s", state_dir, container_id, STATE_FILE);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            if (fdatasync(fd) == -1) {
+                ret = -1;
+            }
+            close(fd);
+        }
+        snprintf(path, sizeof(path), "%s/%s", state_dir, container_id);
+        if (fsync_path(path) == -1 && errno != ENOENT) {
+            ret = -1;
+        }
+    }
+    if ((what & STATE_SYNC_STATE_DIR) && fsync_path(state_dir) == -1) {
+        ret = -1;
+    }
+    if ((what & STATE_SYNC_TABLE) && nk_state_table_sync(state_dir) == -1) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static state_sync_shared_t *state_sync_map(const char *state_dir, int *fd_out) {
+    static state_sync_shared_t *shared;
+    static int fd = -1;
+    static char mapped_dir[PATH_MAX];
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (shared && strcmp(mapped_dir, state_dir) == 0) {
+        *fd_out = fd;
+        return shared;
+    }
+    if (snprintf(path, sizeof(path), "%s/%s", state_dir, STATE_SYNC_FILE) >= (int)sizeof(path) ||
+        strlen(state_dir) >= sizeof(mapped_dir)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    int new_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (new_fd == -1) {
+        return NULL;
+    }
+    /* Growing is idempotent, so racing creators need no lock */
+    if (fstat(new_fd, &st) == -1 ||
+        (st.st_size < (off_t)sizeof(*shared) && ftruncate(new_fd, sizeof(*shared)) == -1)) {
+        close(new_fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+    if (map == MAP_FAILED) {
+        close(new_fd);
+        return NULL;
+    }
+
+    if (shared) {
+        munmap(shared, sizeof(*shared));
+        close(fd);
+    }
+    shared = map;
+    fd = new_fd;
+    strcpy(mapped_dir, state_dir);
+    *fd_out = fd;
+    return shared;
+}
+
+/* Block on one byte of the sync file (OFD locks die with their process) */
+static int state_sync_lock(int fd, off_t byte, short type) {
+    struct flock fl = {
+        .l_type = type,
+        .l_whence = SEEK_SET,
+        .l_start = byte,
+        .l_len = 1,
+    };
+
+    while (fcntl(fd, F_OFD_SETLKW, &fl) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * state_group_commit - Queue an update and wait until it is durable
+ *
+ * Updates are appended to the queue in STATE_SYNC_FILE with a ticket.
+ * Whoever takes the leader lock first drains the queue: if others are
+ * already waiting it sleeps STATE_SYNC_WINDOW_US so more can join, then
+ * flushes every queued target once (syncfs() if the queue overflowed) and
+ * publishes the last ticket it covered. Updates queued during a flush are
+ * picked up by the next leader. The drained batch stays marked in flight
+ * until it is published, so if its leader fails or dies first the next
+ * leader runs syncfs() for it instead of publishing it unsynced.
+ */
+static int state_group_commit(unsigned what, const char *container_id) {
+    state_sync_shared_t *shared;
+    uint64_t ticket;
+    int fd;
+
+    shared = state_sync_map(get_state_dir(), &fd);
+    if (!shared) {
+        return -1;
+    }
+
+    if (state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_WRLCK) == -1) {
+        return -1;
+    }
+    size_t id_len = container_id ? strlen(container_id) : 0;
+    if (shared->count < STATE_SYNC_QUEUE && id_len < sizeof(shared->queue[0].id)) {
+        shared->queue[shared->count].what = what;
+        memcpy(shared->queue[shared->count].id, container_id ? container_id : "", id_len + 1);
+        shared->count++;
+    } else {
+        shared->overflow = 1;
+    }
+    ticket = atomic_fetch_add(&shared->requested, 1) + 1;
+    state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_UNLCK);
+
+    while (atomic_load(&shared->synced) < ticket) {
+        static state_sync_entry_t batch[STATE_SYNC_QUEUE];
+        uint32_t count;
+        bool overflow;
+        uint64_t target;
+        int ret = 0;
+
+        if (state_sync_lock(fd, STATE_SYNC_LOCK_LEADER, F_WRLCK) == -1) {
+            return -1;
+        }
+        if (atomic_load(&shared->synced) >= ticket) {
+            state_sync_lock(fd, STATE_SYNC_LOCK_LEADER, F_UNLCK);
+            break;
+        }
+
+        if (atomic_load(&shared->requested) - atomic_load(&shared->synced) > 1) {
+            usleep(STATE_SYNC_WINDOW_US);
+        }
+
+        state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_WRLCK);
+        count = shared->count;
+        overflow = shared->overflow != 0 || shared->inflight != 0;
+        memcpy(batch, shared->queue, count * sizeof(batch[0]));
+        shared->count = 0;
+        shared->overflow = 0;
+        shared->inflight = 1;
+        target = atomic_load(&shared->requested);
+        state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_UNLCK);
+
+        if (overflow) {
+            ret = syncfs(fd);
+        } else {
+            for (uint32_t i = 0; i < count; i++) {
+                bool dup = false;
+
+                batch[i].id[sizeof(batch[i].id) - 1] = '\0';
+                for (uint32_t j = 0; j < i && !dup; j++) {
+                    dup = batch[j].what == batch[i].what && strcmp(batch[j].id, batch[i].id) == 0;
+                }
+                if (!dup && state_sync_targets(batch[i].what, batch[i].id[0] ? batch[i].id : NULL) == -1) {
+                    ret = -1;
+                }
+            }
+        }
+
+        if (ret == 0) {
+            atomic_store(&shared->synced, target);
+            state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_WRLCK);
+            shared->inflight = 0;
+            state_sync_lock(fd, STATE_SYNC_LOCK_QUEUE, F_UNLCK);
+        }
+        state_sync_lock(fd, STATE_SYNC_LOCK_LEADER, F_UNLCK);
+        if (ret == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * state_commit - Make a finished state update durable per NS_STATE_SYNC
+ * @what: STATE_SYNC_* targets the update touched
+ * @container_id: Container for STATE_SYNC_CONTAINER, or NULL
+ */
+static int state_commit(unsigned what, const char *container_id) {
+    switch (state_sync_mode()) {
+    case STATE_SYNC_ALWAYS:
+        return state_sync_targets(what, container_id);
+    case STATE_SYNC_GROUP:
+        return state_group_commit(what, container_id);
+    default:
+        return 0;
+    }
+}
+
 static const char *state_to_string(nk_container_state_t state) {
     switch (state) {
     case NK_STATE_CREATED:
@@ -116,6 +425,138 @@ static nk_execution_mode_t string_to_mode(const char *str) {
     return NK_MODE_CONTAINER;
 }
 
+static size_t state_cache_bucket(const char *container_id) {
+    uint32_t hash = 2166136261u;  /* FNV-1a */
+
+    for (const unsigned char *p = (const unsigned char *)container_id; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash % STATE_CACHE_BUCKETS;
+}
+
+static void state_cache_entry_free(state_cache_entry_t *entry) {
+    if (!entry) {
+        return;
+    }
+    free(entry->id);
+    free(entry->bundle_path);
+    free(entry);
+}
+
+static state_cache_entry_t *state_cache_find(const char *container_id) {
+    state_cache_entry_t *entry = state_cache[state_cache_bucket(container_id)];
+
+    for (; entry; entry = entry->next) {
+        if (strcmp(entry->id, container_id) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void state_cache_evict(const char *container_id) {
+    state_cache_entry_t **link = &state_cache[state_cache_bucket(container_id)];
+
+    while (*link) {
+        state_cache_entry_t *entry = *link;
+        if (strcmp(entry->id, container_id) == 0) {
+            *link = entry->next;
+            state_cache_entry_free(entry);
+            return;
+        }
+        link = &entry->next;
+    }
+}
+
+static bool state_cache_is_fresh(const state_cache_entry_t *entry, const struct stat *st) {
+    return entry->dev == st->st_dev &&
+           entry->ino == st->st_ino &&
+           entry->size == st->st_size &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+           entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void state_cache_store(const nk_container_t *container, const struct stat *st) {
+    state_cache_entry_t *entry;
+
+    if (!state_cache_enabled || !container || !container->id) {
+        return;
+    }
+
+    entry = state_cache_find(container->id);
+    if (!entry) {
+        size_t bucket = state_cache_bucket(container->id);
+
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            return;
+        }
+        entry->id = strdup(container->id);
+        if (!entry->id) {
+            free(entry);
+            return;
+        }
+        entry->next = state_cache[bucket];
+        state_cache[bucket] = entry;
+    }
+
+    free(entry->bundle_path);
+    entry->bundle_path = container->bundle_path ? strdup(container->bundle_path) : NULL;
+    entry->state = container->state;
+    entry->mode = container->mode;
+    entry->init_pid = container->init_pid;
+    entry->started_at = container->started_at;
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+}
+
+static nk_container_t *state_cache_lookup(const char *container_id, const char *state_path) {
+    state_cache_entry_t *entry;
+    nk_container_t *container;
+    struct stat st;
+
+    entry = state_cache_find(container_id);
+    if (!entry) {
+        return NULL;
+    }
+    if (stat(state_path, &st) == -1 || !state_cache_is_fresh(entry, &st)) {
+        state_cache_evict(container_id);
+        return NULL;
+    }
+
+    container = calloc(1, sizeof(*container));
+    if (!container) {
+        return NULL;
+    }
+    container->id = strdup(entry->id);
+    container->bundle_path = entry->bundle_path ? strdup(entry->bundle_path) : NULL;
+    container->state = entry->state;
+    container->mode = entry->mode;
+    container->init_pid = entry->init_pid;
+    container->started_at = entry->started_at;
+    container->control_fd = -1;
+    container->state_file = strdup(state_path);
+    return container;
+}
+
+void nk_state_cache_enable(bool enabled) {
+    state_cache_enabled = enabled;
+    if (enabled) {
+        return;
+    }
+
+    for (size_t i = 0; i < STATE_CACHE_BUCKETS; i++) {
+        while (state_cache[i]) {
+            state_cache_entry_t *entry = state_cache[i];
+            state_cache[i] = entry->next;
+            state_cache_entry_free(entry);
+        }
+    }
+}
+
 static char *get_container_state_path(const char *container_id) {
     char *path = NULL;
     const char *state_dir = get_state_dir();
@@ -134,192 +575,243 @@ static char *get_container_dir(const char *container_id) {
     return path;
 }
 
-static int ensure_container_dir(const char *container_id) {
-    nk_stderr( "[ENSURE_DIR] Starting for container '%s'\n", container_id);
-    fflush(stderr);
+static char *get_container_lock_path(const char *container_id) {
+    char *path = NULL;
+    if (asprintf(&path, "%s/%s/%s.lock", get_state_dir(), STATE_LOCK_DIR, container_id) == -1) {
+        return NULL;
+    }
+    return path;
+}
+
+/**
+ * nk_state_lock - Lock <state_dir>/.locks/<id>.lock
+ *
+ * POSIX record locks rather than flock(): they belong to this process and
+ * are not inherited by the container init, which may stay parked on
+ * exec.fifo long after we return. A lock file unlinked by a concurrent
+ * delete while we waited is detected by inode and retried.
+ */
+int nk_state_lock(const char *container_id, bool wait) {
+    struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    char *path;
+    int fd;
+
+    if (!container_id) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *dir = NULL;
+    if (asprintf(&dir, "%s/%s", get_state_dir(), STATE_LOCK_DIR) == -1) {
+        return -1;
+    }
+    int ret = mkdir_p(dir, 0700);
+    free(dir);
+    if (ret == -1 || !(path = get_container_lock_path(container_id))) {
+        return -1;
+    }
+
+    for (;;) {
+        struct stat fd_st, path_st;
+
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd == -1) {
+            break;
+        }
+        while ((ret = fcntl(fd, wait ? F_SETLKW : F_SETLK, &fl)) == -1 && errno == EINTR) {
+        }
+        if (ret == -1) {
+            if (errno == EACCES) {
+                errno = EAGAIN;
+            }
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            fd = -1;
+            break;
+        }
+        if (fstat(fd, &fd_st) == 0 && stat(path, &path_st) == 0 &&
+            fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino) {
+            break;
+        }
+        close(fd);
+    }
+
+    free(path);
+    return fd;
+}
+
+/**
+ * nk_state_unlock - Release a lock from nk_state_lock()
+ *
+ * The lock file of a container that is gone (deleted, or never created) is
+ * unlinked while still locked, so stale ids do not pile up in .locks.
+ */
+void nk_state_unlock(const char *container_id, int lock_fd) {
+    if (lock_fd < 0) {
+        return;
+    }
+
+    if (container_id && !nk_state_exists(container_id)) {
+        char *lock_path = get_container_lock_path(container_id);
+        if (lock_path) {
+            unlink(lock_path);
+            free(lock_path);
+        }
+    }
+    close(lock_fd);
+}
 
+/**
+ * nk_state_file_path - Path of a file inside the container state directory
+ */
+char *nk_state_file_path(const char *container_id, const char *name) {
+    char *path = NULL;
+
+    if (!container_id || !name) {
+        return NULL;
+    }
+    if (asprintf(&path, "%s/%s/%s", get_state_dir(), container_id, name) == -1) {
+        return NULL;
+    }
+    return path;
+}
+
+/* Returns 1 if the directory was created, 0 if it already existed, -1 on error */
+static int ensure_container_dir(const char *container_id) {
     const char *state_dir = get_state_dir();
     if (mkdir_p(state_dir, 0755) == -1) {
-        nk_stderr( "[ENSURE_DIR] ERROR: Failed to create state dir %s: %s\n",
+        nk_stderr( "Error: Failed to create state dir %s: %s\n",
                 state_dir, strerror(errno));
-        fflush(stderr);
         return -1;
     }
 
     char *dir = get_container_dir(container_id);
     if (!dir) {
-        nk_stderr( "[ENSURE_DIR] ERROR: Failed to get directory path\n");
-        fflush(stderr);
         return -1;
     }
-    nk_stderr( "[ENSURE_DIR] Directory path: %s\n", dir);
-    fflush(stderr);
 
     struct stat st;
     int ret = 0;
 
-    nk_stderr( "[ENSURE_DIR] Checking if directory exists\n");
-    fflush(stderr);
     if (stat(dir, &st) == 0) {
-        nk_stderr( "[ENSURE_DIR] Path exists\n");
-        fflush(stderr);
         if (!S_ISDIR(st.st_mode)) {
-            nk_stderr( "[ENSURE_DIR] ERROR: Path exists but is not a directory\n");
-            fflush(stderr);
+            nk_stderr( "Error: %s exists but is not a directory\n", dir);
             ret = -1;
-        } else {
-            nk_stderr( "[ENSURE_DIR] Directory exists, OK\n");
-            fflush(stderr);
         }
+    } else if (mkdir(dir, 0755) == -1) {
+        nk_stderr( "Error: Failed to create directory %s: %s\n", dir, strerror(errno));
+        ret = -1;
     } else {
-        nk_stderr( "[ENSURE_DIR] Directory does not exist, creating\n");
-        fflush(stderr);
-        if (mkdir(dir, 0755) == -1) {
-            nk_stderr( "[ENSURE_DIR] ERROR: Failed to create directory: %s\n",
-                    strerror(errno));
-            fflush(stderr);
-            ret = -1;
-        } else {
-            nk_stderr( "[ENSURE_DIR] Directory created successfully\n");
-            fflush(stderr);
-        }
+        ret = 1;
     }
 
-    nk_stderr( "[ENSURE_DIR] Complete, returning %d\n", ret);
-    fflush(stderr);
     free(dir);
     return ret;
 }
 
 /**
- * nk_state_save - Save container state to disk
+ * state_json_save - Replace <state_dir>/<id>/state.json
+ *
+ * Written to a per-process temp file and renamed over, so a crash leaves
+ * either the old or the new state, never a truncated file. "always" syncs
+ * the data before the rename; "group" leaves that to the batch leader and
+ * relies on the filesystem flushing data before a rename-over (ext4, xfs).
  */
-int nk_state_save(const nk_container_t *container) {
-    nk_stderr( "[STATE_SAVE] Starting state save for container '%s'\n",
-            container ? container->id : "(null)");
-    fflush(stderr);
-
-    if (!container || !container->id) {
-        nk_stderr( "[STATE_SAVE] ERROR: Invalid container\n");
-        fflush(stderr);
+static int state_json_save(const nk_container_t *container) {
+    int created = ensure_container_dir(container->id);
+    if (created == -1) {
         return -1;
     }
 
-    nk_stderr( "[STATE_SAVE] Ensuring container directory exists\n");
-    fflush(stderr);
-    if (ensure_container_dir(container->id) == -1) {
-        nk_stderr( "[STATE_SAVE] ERROR: Failed to create container directory\n");
-        fflush(stderr);
-        return -1;
-    }
-    nk_stderr( "[STATE_SAVE] Container directory OK\n");
-    fflush(stderr);
-
-    nk_stderr( "[STATE_SAVE] Getting state path\n");
-    fflush(stderr);
     char *state_path = get_container_state_path(container->id);
-    if (!state_path) {
-        nk_stderr( "[STATE_SAVE] ERROR: Failed to get state path\n");
-        fflush(stderr);
+    char *tmp_path = NULL;
+    if (!state_path || asprintf(&tmp_path, "%s.%d.tmp", state_path, (int)getpid()) == -1) {
+        free(state_path);
         return -1;
     }
-    nk_stderr( "[STATE_SAVE] State path: %s\n", state_path);
-    fflush(stderr);
 
     /* Create JSON object */
-    nk_stderr( "[STATE_SAVE] Creating JSON object\n");
-    fflush(stderr);
     json_t *root = json_object();
     if (!root) {
-        nk_stderr( "[STATE_SAVE] ERROR: Failed to create JSON object\n");
-        fflush(stderr);
+        free(tmp_path);
         free(state_path);
         return -1;
     }
-    nk_stderr( "[STATE_SAVE] JSON object created\n");
-    fflush(stderr);
 
-    nk_stderr( "[STATE_SAVE] Populating JSON fields\n");
-    fflush(stderr);
     json_object_set_new(root, "id", json_string(container->id));
     json_object_set_new(root, "bundle_path", json_string(container->bundle_path ? container->bundle_path : ""));
     json_object_set_new(root, "state", json_string(state_to_string(container->state)));
     json_object_set_new(root, "mode", json_string(mode_to_string(container->mode)));
     json_object_set_new(root, "pid", json_integer(container->init_pid));
-    nk_stderr( "[STATE_SAVE] JSON fields populated\n");
-    fflush(stderr);
+    if (container->started_at > 0) {
+        json_object_set_new(root, "started_at", json_integer(container->started_at));
+    }
 
-    /* Write to file */
-    nk_stderr( "[STATE_SAVE] Opening file for writing: %s\n", state_path);
-    fflush(stderr);
+    /* Write to a temp file, then rename over state.json */
     int ret = 0;
-    FILE *f = fopen(state_path, "w");
+    bool sync_always = state_sync_mode() == STATE_SYNC_ALWAYS;
+    struct stat st;
+    bool have_identity = false;
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
     if (f) {
-        nk_stderr( "[STATE_SAVE] File opened, writing JSON\n");
-        fflush(stderr);
-        if (json_dumpf(root, f, JSON_INDENT(2)) == -1) {
-            nk_stderr( "[STATE_SAVE] ERROR: Failed to write JSON to file\n");
-            fflush(stderr);
+        if (json_dumpf(root, f, JSON_INDENT(2)) == -1 || fflush(f) != 0 ||
+            (sync_always && fdatasync(fd) == -1)) {
+            nk_stderr( "Error: Failed to write state file %s\n", tmp_path);
+            ret = -1;
+        }
+        have_identity = ret == 0 && state_cache_enabled && fstat(fd, &st) == 0;
+        if (fclose(f) != 0 && ret == 0) {
+            nk_stderr( "Error: Failed to write state file %s\n", tmp_path);
             ret = -1;
         }
-        nk_stderr( "[STATE_SAVE] JSON written, closing file\n");
-        fflush(stderr);
-        fclose(f);
-        nk_stderr( "[STATE_SAVE] File closed\n");
-        fflush(stderr);
+        if (ret == 0 && rename(tmp_path, state_path) == -1) {
+            nk_stderr( "Error: Failed to replace state file %s: %s\n",
+                    state_path, strerror(errno));
+            ret = -1;
+        }
+        if (ret == -1) {
+            unlink(tmp_path);
+        }
     } else {
-        nk_stderr( "[STATE_SAVE] ERROR: Failed to open file: %s\n",
-                strerror(errno));
-        fflush(stderr);
+        nk_stderr( "Error: Failed to open state file %s: %s\n",
+                tmp_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
+        }
         ret = -1;
     }
 
-    nk_stderr( "[STATE_SAVE] Cleaning up\n");
-    fflush(stderr);
-    json_decref(root);
-    free(state_path);
-    nk_stderr( "[STATE_SAVE] State save complete, returning %d\n", ret);
-    fflush(stderr);
-    return ret;
-}
-
-/**
- * nk_state_load - Load container state from disk
- */
-nk_container_t *nk_state_load(const char *container_id) {
-    if (!container_id) {
-        return NULL;
+    if (ret == 0 && state_cache_enabled) {
+        if (have_identity) {
+            state_cache_store(container, &st);
+        } else {
+            state_cache_evict(container->id);
+        }
     }
 
-    char *state_path = get_container_state_path(container_id);
-    if (!state_path) {
-        return NULL;
-    }
+    if (ret == 0) {
+        unsigned what = STATE_SYNC_CONTAINER | (created == 1 ? STATE_SYNC_STATE_DIR : 0);
 
-    /* Read JSON file */
-    FILE *f = fopen(state_path, "r");
-    if (!f) {
-        nk_stderr( "Error: Failed to open state file for reading: %s\n",
-                strerror(errno));
-        free(state_path);
-        return NULL;
+        if (state_commit(what, container->id) == -1) {
+            ret = -1;
+            nk_stderr( "Error: Failed to sync state file %s: %s\n",
+                    state_path, strerror(errno));
+        }
     }
 
-    json_error_t error;
-    json_t *root = json_loadf(f, 0, &error);
-    fclose(f);
+    json_decref(root);
+    free(tmp_path);
     free(state_path);
+    return ret;
+}
 
-    if (!root) {
-        nk_stderr( "Error: Failed to parse state file: %s at line %d\n",
-                error.text, error.line);
-        return NULL;
-    }
-
-    /* Parse JSON into container structure */
+/* Container fields of a parsed state.json; state_file is left unset */
+static nk_container_t *state_json_parse(json_t *root) {
     nk_container_t *container = calloc(1, sizeof(*container));
     if (!container) {
-        json_decref(root);
         return NULL;
     }
 
@@ -328,6 +820,7 @@ nk_container_t *nk_state_load(const char *container_id) {
     json_t *state = json_object_get(root, "state");
     json_t *mode = json_object_get(root, "mode");
     json_t *pid = json_object_get(root, "pid");
+    json_t *started_at = json_object_get(root, "started_at");
 
     if (id && json_is_string(id)) {
         container->id = strdup(json_string_value(id));
@@ -347,20 +840,74 @@ nk_container_t *nk_state_load(const char *container_id) {
     if (pid && json_is_integer(pid)) {
         container->init_pid = json_integer_value(pid);
     }
+    if (started_at && json_is_integer(started_at)) {
+        container->started_at = json_integer_value(started_at);
+    }
 
     container->control_fd = -1;
-    container->state_file = state_path = get_container_state_path(container_id);
+    return container;
+}
+
+/* Read state.json; a missing file fails silently with errno ENOENT */
+static nk_container_t *state_json_load(const char *container_id) {
+    char *state_path = get_container_state_path(container_id);
+    if (!state_path) {
+        return NULL;
+    }
 
+    if (state_cache_enabled) {
+        nk_container_t *cached = state_cache_lookup(container_id, state_path);
+        if (cached) {
+            free(state_path);
+            return cached;
+        }
+    }
+
+    /* Read JSON file */
+    FILE *f = fopen(state_path, "r");
+    if (!f) {
+        if (errno != ENOENT) {
+            nk_stderr( "Error: Failed to open state file for reading: %s\n",
+                    strerror(errno));
+        }
+        free(state_path);
+        return NULL;
+    }
+
+    struct stat file_st;
+    bool have_identity = state_cache_enabled && fstat(fileno(f), &file_st) == 0;
+
+    json_error_t error;
+    json_t *root = json_loadf(f, 0, &error);
+    fclose(f);
+    free(state_path);
+
+    if (!root) {
+        nk_stderr( "Error: Failed to parse state file: %s at line %d\n",
+                error.text, error.line);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nk_container_t *container = state_json_parse(root);
     json_decref(root);
+    if (!container) {
+        return NULL;
+    }
+    container->control_fd = -1;
+    container->state_file = state_path = get_container_state_path(container_id);
+
+    if (have_identity && container->id) {
+        state_cache_store(container, &file_st);
+    }
+
     return container;
 }
 
-/**
- * nk_state_delete - Delete container state from disk
- */
-int nk_state_delete(const char *container_id) {
-    if (!container_id) {
-        return -1;
+/* Remove state.json; 0 if it existed */
+static int state_json_delete(const char *container_id) {
+    if (state_cache_enabled) {
+        state_cache_evict(container_id);
     }
 
     char *state_path = get_container_state_path(container_id);
@@ -375,33 +922,476 @@ int nk_state_delete(const char *container_id) {
     }
 
     free(state_path);
+    return ret;
+}
+
+/* Remove state.json temp files left by a process that died mid-save */
+static void state_remove_temp_files(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+
+    if (!d) {
+        return;
+    }
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+
+        if (strncmp(ent->d_name, STATE_FILE ".", sizeof(STATE_FILE)) == 0 &&
+            len > 4 && strcmp(ent->d_name + len - 4, ".tmp") == 0) {
+            unlinkat(dirfd(d), ent->d_name, 0);
+        }
+    }
+    closedir(d);
+}
+
+static void state_container_free(nk_container_t *container) {
+    free(container->id);
+    free(container->bundle_path);
+    free(container->state_file);
+    free(container);
+}
+
+/**
+ * state_migrate - Move a container's state from the other backend
+ *
+ * Records are moved on first touch, so switching NS_STATE_BACKEND keeps
+ * existing containers. The container directory stays either way: exec.fifo
+ * and trace.json live there.
+ */
+static nk_container_t *state_migrate(const char *container_id, state_backend_t to) {
+    const char *state_dir = get_state_dir();
+    nk_container_t *container;
+
+    if (to == STATE_BACKEND_TABLE) {
+        container = state_json_load(container_id);
+        if (!container || !container->id) {
+            goto fail;
+        }
+        if (nk_state_table_save(state_dir, container) == -1) {
+            goto fail;
+        }
+        (void)state_json_delete(container_id);
+        free(container->state_file);
+        if (asprintf(&container->state_file, "%s/%s", state_dir, NK_STATE_TABLE_FILE) == -1) {
+            container->state_file = NULL;
+        }
+    } else {
+        container = nk_state_table_load(state_dir, container_id);
+        if (!container) {
+            return NULL;
+        }
+        if (state_json_save(container) == -1) {
+            goto fail;
+        }
+        (void)nk_state_table_delete(state_dir, container_id);
+        free(container->state_file);
+        container->state_file = get_container_state_path(container_id);
+    }
+
+    nk_log_debug("Moved state of '%s' to the %s store", container_id,
+                 to == STATE_BACKEND_TABLE ? "table" : "json");
+    return container;
+
+fail:
+    if (container) {
+        state_container_free(container);
+    }
+    return NULL;
+}
+
+/**
+ * nk_state_save - Save container state to disk
+ */
+int nk_state_save(const nk_container_t *container) {
+    if (!container || !container->id) {
+        return -1;
+    }
+
+    nk_log_debug("Saving state for container '%s'", container->id);
+    if (state_backend() == STATE_BACKEND_JSON) {
+        return state_json_save(container);
+    }
+
+    /* New record: exec.fifo and trace.json still need the directory */
+    if (!nk_state_table_exists(get_state_dir(), container->id) &&
+        ensure_container_dir(container->id) == -1) {
+        return -1;
+    }
+    if (nk_state_table_save(get_state_dir(), container) == -1) {
+        return -1;
+    }
+    if (state_commit(STATE_SYNC_TABLE, NULL) == -1) {
+        nk_stderr( "Error: Failed to sync state table: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * nk_state_load - Load container state from disk
+ */
+nk_container_t *nk_state_load(const char *container_id) {
+    nk_container_t *container;
+    state_backend_t backend = state_backend();
+
+    if (!container_id) {
+        return NULL;
+    }
+
+    if (backend == STATE_BACKEND_JSON) {
+        container = state_json_load(container_id);
+        if (container || errno != ENOENT) {
+            return container;
+        }
+        container = state_migrate(container_id, STATE_BACKEND_JSON);
+    } else {
+        container = nk_state_table_load(get_state_dir(), container_id);
+        if (!container && errno == ENOENT) {
+            container = state_migrate(container_id, STATE_BACKEND_TABLE);
+        }
+    }
+
+    if (!container) {
+        nk_stderr( "Error: Failed to open state file for reading: %s\n",
+                strerror(ENOENT));
+    }
+    return container;
+}
+
+/**
+ * nk_state_delete - Delete container state from disk
+ */
+int nk_state_delete(const char *container_id) {
+    if (!container_id) {
+        return -1;
+    }
+
+    /* Whichever store has it (both, if a migration was interrupted) */
+    int json_ret = state_json_delete(container_id);
+    int table_ret = nk_state_table_delete(get_state_dir(), container_id);
 
     /* Try to remove container directory */
     char *dir = get_container_dir(container_id);
     if (dir) {
-        rmdir(dir);
+        if (rmdir(dir) == -1 && errno == ENOTEMPTY) {
+            state_remove_temp_files(dir);
+            rmdir(dir);
+        }
         free(dir);
     }
 
-    return ret;
+    if (json_ret == 0 || table_ret == 0) {
+        (void)state_commit(STATE_SYNC_STATE_DIR | (table_ret == 0 ? STATE_SYNC_TABLE : 0), NULL);
+        return 0;
+    }
+    return -1;
 }
 
 /**
  * nk_state_exists - Check if container state exists
  */
 bool nk_state_exists(const char *container_id) {
+    nk_container_t *migrated;
+
     if (!container_id) {
         return false;
     }
 
-    char *state_path = get_container_state_path(container_id);
-    if (!state_path) {
+    if (state_backend() == STATE_BACKEND_TABLE) {
+        if (nk_state_table_exists(get_state_dir(), container_id)) {
+            return true;
+        }
+    } else {
+        char *state_path = get_container_state_path(container_id);
+        if (!state_path) {
+            return false;
+        }
+
+        struct stat st;
+        bool exists = (stat(state_path, &st) == 0 && S_ISREG(st.st_mode));
+
+        free(state_path);
+        if (exists) {
+            return true;
+        }
+    }
+
+    migrated = state_migrate(container_id, state_backend());
+    if (!migrated) {
         return false;
     }
+    state_container_free(migrated);
+    return true;
+}
 
+/* Parallel read of <state_dir>/<name>/state.json for nk_state_list() */
+typedef struct state_list_scan {
+    const char *state_dir;
+    int dir_fd;
+    char **names;
+    nk_container_t **found;     /* per name; NULL if skipped or failed */
+    int *error;                 /* per name; errno of a failed read, 0 otherwise */
+    size_t count;
+    _Atomic size_t next;
+} state_list_scan_t;
+
+/* Uncached, silent state.json read; safe to call from list workers */
+static nk_container_t *state_json_read_at(const state_list_scan_t *scan, const char *name) {
+    char path[NAME_MAX + sizeof("/" STATE_FILE)];
+    char buf[STATE_LIST_MAX_FILE];
+    nk_container_t *container;
+    json_error_t error;
     struct stat st;
-    bool exists = (stat(state_path, &st) == 0 && S_ISREG(st.st_mode));
+    ssize_t len;
+    json_t *root;
+    int fd;
 
-    free(state_path);
-    return exists;
+    snprintf(path, sizeof(path), "%s/%s", name, STATE_FILE);
+    fd = openat(scan->dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size >= (off_t)sizeof(buf)) {
+        close(fd);
+        errno = EFBIG;
+        return NULL;
+    }
+    len = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (len < 0) {
+        return NULL;
+    }
+
+    root = json_loadb(buf, (size_t)len, 0, &error);
+    if (!root) {
+        errno = EINVAL;
+        return NULL;
+    }
+    container = state_json_parse(root);
+    json_decref(root);
+    if (!container) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!container->id ||
+        asprintf(&container->state_file, "%s/%s", scan->state_dir, path) == -1) {
+        container->state_file = NULL;
+        state_container_free(container);
+        errno = EINVAL;
+        return NULL;
+    }
+    return container;
+}
+
+static void *state_list_worker(void *arg) {
+    state_list_scan_t *scan = arg;
+
+    for (;;) {
+        size_t begin = atomic_fetch_add_explicit(&scan->next, STATE_LIST_CHUNK,
+                                                 memory_order_relaxed);
+        size_t end = begin + STATE_LIST_CHUNK < scan->count ? begin + STATE_LIST_CHUNK : scan->count;
+
+        if (begin >= scan->count) {
+            return NULL;
+        }
+        for (size_t i = begin; i < end; i++) {
+            scan->found[i] = state_json_read_at(scan, scan->names[i]);
+            scan->error[i] = scan->found[i] ? 0 : errno;
+        }
+    }
+}
+
+/* Read all names on up to STATE_LIST_MAX_THREADS threads (this one included) */
+static void state_list_scan_run(state_list_scan_t *scan) {
+    pthread_t threads[STATE_LIST_MAX_THREADS - 1];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t want = 1 + scan->count / STATE_LIST_PER_THREAD;
+    size_t started = 0;
+
+    if (cpus > 0 && want > (size_t)cpus) {
+        want = (size_t)cpus;
+    }
+    if (want > STATE_LIST_MAX_THREADS) {
+        want = STATE_LIST_MAX_THREADS;
+    }
+
+    while (started + 1 < want &&
+           pthread_create(&threads[started], NULL, state_list_worker, scan) == 0) {
+        started++;
+    }
+    state_list_worker(scan);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static int state_list_cmp(const void *a, const void *b) {
+    const nk_container_t *const *ca = a;
+    const nk_container_t *const *cb = b;
+    return strcmp((*ca)->id, (*cb)->id);
+}
+
+/* bsearch() key comparator: container ID against a sorted list entry */
+static int state_list_key_cmp(const void *key, const void *entry) {
+    const nk_container_t *const *c = entry;
+    return strcmp(key, (*c)->id);
+}
+
+/*
+ * Container directories with a state.json, minus those in @skip (sorted).
+ * Dot entries (.locks, .spec-cache, ...) and plain files are never containers.
+ */
+static int state_list_json(const char *state_dir, nk_container_t **skip, size_t skip_count,
+                           nk_container_t ***out, size_t *count) {
+    state_list_scan_t scan = { .state_dir = state_dir };
+    size_t cap = 0;
+    size_t n = 0;
+    struct dirent *ent;
+    DIR *d;
+    int ret = -1;
+
+    *out = NULL;
+    *count = 0;
+    d = opendir(state_dir);
+    if (!d) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    scan.dir_fd = dirfd(d);
+
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.' || (ent->d_type != DT_DIR && ent->d_type != DT_UNKNOWN)) {
+            continue;
+        }
+        if (skip_count > 0 &&
+            bsearch(ent->d_name, skip, skip_count, sizeof(*skip), state_list_key_cmp)) {
+            continue;
+        }
+        if (scan.count == cap) {
+            size_t new_cap = cap ? cap * 2 : 256;
+            char **grown = realloc(scan.names, new_cap * sizeof(*scan.names));
+            if (!grown) {
+                goto out;
+            }
+            scan.names = grown;
+            cap = new_cap;
+        }
+        if (!(scan.names[scan.count] = strdup(ent->d_name))) {
+            goto out;
+        }
+        scan.count++;
+    }
+
+    scan.found = calloc(scan.count ? scan.count : 1, sizeof(*scan.found));
+    scan.error = calloc(scan.count ? scan.count : 1, sizeof(*scan.error));
+    if (!scan.found || !scan.error) {
+        goto out;
+    }
+    state_list_scan_run(&scan);
+
+    /* Compact in place; a directory without state.json belongs to the table */
+    for (size_t i = 0; i < scan.count; i++) {
+        if (scan.found[i]) {
+            scan.found[n++] = scan.found[i];
+        } else if (scan.error[i] != ENOENT && scan.error[i] != ENOTDIR) {
+            nk_stderr("Warning: Skipping unreadable state of '%s': %s\n",
+                    scan.names[i], strerror(scan.error[i]));
+        }
+    }
+    *out = scan.found;
+    *count = n;
+    scan.found = NULL;
+    ret = 0;
+
+out:
+    for (size_t i = 0; i < scan.count; i++) {
+        free(scan.names[i]);
+    }
+    free(scan.names);
+    free(scan.found);
+    free(scan.error);
+    closedir(d);
+    return ret;
+}
+
+/**
+ * nk_state_list - Both stores, merged by ID
+ *
+ * The table is read in one pass under its per-record counters. state.json
+ * files are read in parallel; with the table backend only directories the
+ * table does not know are opened at all. A container present in both
+ * stores (interrupted migration) is reported from the active one.
+ */
+int nk_state_list(nk_container_t ***out, size_t *count) {
+    const char *state_dir = get_state_dir();
+    bool table_first = state_backend() == STATE_BACKEND_TABLE;
+    nk_container_t **table_list = NULL;
+    nk_container_t **json_list = NULL;
+    nk_container_t **merged = NULL;
+    size_t table_count = 0;
+    size_t json_count = 0;
+    size_t n = 0;
+
+    *out = NULL;
+    *count = 0;
+    if (nk_state_table_list(state_dir, &table_list, &table_count) == -1) {
+        nk_stderr("Error: Failed to read state table in %s: %s\n", state_dir, strerror(errno));
+        return -1;
+    }
+    if (table_count > 1) {
+        qsort(table_list, table_count, sizeof(*table_list), state_list_cmp);
+    }
+
+    if (state_list_json(state_dir, table_first ? table_list : NULL, table_first ? table_count : 0,
+                        &json_list, &json_count) == -1) {
+        nk_stderr("Error: Failed to scan %s: %s\n", state_dir, strerror(errno));
+        nk_state_list_free(table_list, table_count);
+        return -1;
+    }
+    if (json_count > 1) {
+        qsort(json_list, json_count, sizeof(*json_list), state_list_cmp);
+    }
+
+    merged = malloc((table_count + json_count + 1) * sizeof(*merged));
+    if (!merged) {
+        nk_state_list_free(table_list, table_count);
+        nk_state_list_free(json_list, json_count);
+        return -1;
+    }
+
+    size_t t = 0;
+    size_t j = 0;
+    while (t < table_count || j < json_count) {
+        int cmp = t == table_count ? 1 : j == json_count ? -1 :
+                  strcmp(table_list[t]->id, json_list[j]->id);
+
+        if (cmp == 0) {
+            nk_container_t **stale = table_first ? &json_list[j] : &table_list[t];
+
+            state_container_free(*stale);
+            *stale = NULL;
+            merged[n++] = table_first ? table_list[t] : json_list[j];
+            t++;
+            j++;
+        } else {
+            merged[n++] = cmp < 0 ? table_list[t++] : json_list[j++];
+        }
+    }
+
+    free(table_list);
+    free(json_list);
+    *out = merged;
+    *count = n;
+    return 0;
+}
+
+/**
+ * nk_state_list_free - Free a list from nk_state_list()
+ */
+void nk_state_list_free(nk_container_t **list, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (list[i]) {
+            state_container_free(list[i]);
+        }
+    }
+    free(list);
 }
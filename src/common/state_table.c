@@ -0,0 +1,744 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nk.h"
+#include "nk_log.h"
+#include "common/state_table.h"
+
+#define STATE_TABLE_MAGIC       0x4e4b5354u   /* "NKST" */
+#define STATE_TABLE_VERSION     1
+#define STATE_TABLE_MIN_SLOTS   1024u
+#define STATE_TABLE_MIN_HEAP    (64u * 1024u)
+#define STATE_TABLE_MAX_HEAP    (1u << 30)
+#define STATE_TABLE_READ_SPINS  1024
+
+enum {
+    SLOT_EMPTY = 0,     /* never used: ends a probe chain */
+    SLOT_LIVE,
+    SLOT_DEAD,          /* deleted: keeps probe chains intact until a rebuild */
+};
+
+/* File header; counters are only modified under the writer flock */
+typedef struct state_table_header {
+    _Atomic uint32_t magic;         /* stored last when a file is initialized */
+    uint32_t version;
+    uint32_t slots;                 /* power of two */
+    uint32_t record_size;
+    uint32_t heap_size;
+    _Atomic uint32_t heap_used;
+    _Atomic uint32_t live;
+    _Atomic uint32_t used;          /* live + dead slots */
+    _Atomic uint32_t retired;       /* replaced by a rebuilt file: reopen */
+    _Atomic uint32_t writing;       /* slot + 1 while a writer holds its seq odd */
+    uint8_t reserved[24];
+} state_table_header_t;
+
+/* Record payload, copied out whole under the sequence counter */
+typedef struct state_slot {
+    uint32_t flags;
+    int32_t pid;
+    uint64_t id_hash;
+    uint32_t id_off;                /* heap offsets; strings are not NUL-terminated */
+    uint32_t bundle_off;
+    uint16_t id_len;
+    uint16_t bundle_len;            /* 0: no bundle path */
+    int8_t state;
+    uint8_t mode;
+    uint8_t reserved[2];
+    int64_t started_at;             /* was record padding: zero in older files */
+} state_slot_t;
+
+typedef struct state_record {
+    _Atomic uint32_t seq;           /* odd while a writer updates the slot */
+    uint32_t reserved;
+    state_slot_t slot;
+} __attribute__((aligned(64))) state_record_t;
+
+_Static_assert(sizeof(state_table_header_t) == 64, "state table header must be one cache line");
+_Static_assert(sizeof(state_record_t) == 64, "state record must be one cache line");
+
+/* This process's mapping of <state_dir>/state.tbl */
+typedef struct state_table {
+    char path[PATH_MAX];
+    int fd;
+    bool writable;
+    char *base;
+    size_t len;
+    state_table_header_t *hdr;
+    state_record_t *rec;
+    char *heap;
+} state_table_t;
+
+static state_table_t table = { .fd = -1 };
+
+static uint64_t state_table_hash(const char *s, size_t len) {
+    uint64_t hash = 14695981039346656037ull;  /* FNV-1a */
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 1099511628211ull;
+    }
+    return hash ? hash : 1;
+}
+
+static size_t state_table_size(uint32_t slots, uint32_t heap_size) {
+    return sizeof(state_table_header_t) + (size_t)slots * sizeof(state_record_t) + heap_size;
+}
+
+static void state_table_close(void) {
+    if (table.base) {
+        munmap(table.base, table.len);
+    }
+    if (table.fd >= 0) {
+        close(table.fd);
+    }
+    table.fd = -1;
+    table.base = NULL;
+    table.len = 0;
+    table.hdr = NULL;
+    table.rec = NULL;
+    table.heap = NULL;
+    table.path[0] = '\0';
+}
+
+/* Point the table at a mapping; -1 with errno ENOENT if it is not initialized yet */
+static int state_table_attach(char *base, size_t len) {
+    state_table_header_t *hdr = (state_table_header_t *)base;
+
+    if (len < sizeof(*hdr) ||
+        atomic_load_explicit(&hdr->magic, memory_order_acquire) != STATE_TABLE_MAGIC) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (hdr->version != STATE_TABLE_VERSION || hdr->record_size != sizeof(state_record_t) ||
+        hdr->slots == 0 || (hdr->slots & (hdr->slots - 1)) != 0 ||
+        state_table_size(hdr->slots, hdr->heap_size) != len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    table.base = base;
+    table.len = len;
+    table.hdr = hdr;
+    table.rec = (state_record_t *)(base + sizeof(*hdr));
+    table.heap = base + sizeof(*hdr) + (size_t)hdr->slots * sizeof(state_record_t);
+    return 0;
+}
+
+static void state_table_init_header(char *base, uint32_t slots, uint32_t heap_size) {
+    state_table_header_t *hdr = (state_table_header_t *)base;
+
+    hdr->version = STATE_TABLE_VERSION;
+    hdr->slots = slots;
+    hdr->record_size = sizeof(state_record_t);
+    hdr->heap_size = heap_size;
+}
+
+/* Give an empty file its initial size and header; caller holds the flock */
+static int state_table_format(int fd) {
+    size_t len = state_table_size(STATE_TABLE_MIN_SLOTS, STATE_TABLE_MIN_HEAP);
+    state_table_header_t hdr = {0};
+
+    if (ftruncate(fd, (off_t)len) == -1) {
+        return -1;
+    }
+    state_table_init_header((char *)&hdr, STATE_TABLE_MIN_SLOTS, STATE_TABLE_MIN_HEAP);
+    atomic_store_explicit(&hdr.magic, STATE_TABLE_MAGIC, memory_order_relaxed);
+    if (pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * state_table_open - Map <state_dir>/state.tbl, reusing the current mapping
+ *
+ * With @create the file is created and formatted if needed and must be
+ * writable; otherwise a missing file fails with ENOENT and an unwritable
+ * one is mapped read-only.
+ */
+static int state_table_open(const char *state_dir, bool create) {
+    char path[PATH_MAX];
+    struct stat st;
+    char *base;
+    int fd;
+    int n = snprintf(path, sizeof(path), "%s/%s", state_dir, NK_STATE_TABLE_FILE);
+
+    if (n < 0 || (size_t)n >= sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if (table.base && strcmp(table.path, path) == 0 &&
+        !atomic_load_explicit(&table.hdr->retired, memory_order_acquire) &&
+        (table.writable || !create)) {
+        return 0;
+    }
+    state_table_close();
+
+    fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    table.writable = fd >= 0;
+    if (fd == -1 && !create && errno == EACCES) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (create) {
+        int ret = 0;
+
+        if (flock(fd, LOCK_EX) == -1) {
+            close(fd);
+            return -1;
+        }
+        if (fstat(fd, &st) == 0 && st.st_size == 0) {
+            ret = state_table_format(fd);
+        }
+        flock(fd, LOCK_UN);
+        if (ret == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        errno = ENOENT;
+        return -1;
+    }
+
+    base = mmap(NULL, (size_t)st.st_size,
+                PROT_READ | (table.writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (state_table_attach(base, (size_t)st.st_size) == -1) {
+        int saved = errno;
+        munmap(base, (size_t)st.st_size);
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    table.fd = fd;
+    memcpy(table.path, path, (size_t)n + 1);
+    return 0;
+}
+
+/* Copy a slot out under its sequence counter */
+static void state_table_read_slot(uint32_t idx, state_slot_t *out) {
+    state_record_t *rec = &table.rec[idx];
+
+    for (int spin = 0; spin < STATE_TABLE_READ_SPINS; spin++) {
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+
+        if ((seq & 1) == 0) {
+            memcpy(out, &rec->slot, sizeof(*out));
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&rec->seq, memory_order_relaxed) == seq) {
+                return;
+            }
+        }
+        sched_yield();
+    }
+
+    /* Still odd: a writer died mid-update. Wait out live writers and take it as is. */
+    flock(table.fd, LOCK_SH);
+    memcpy(out, &rec->slot, sizeof(*out));
+    flock(table.fd, LOCK_UN);
+}
+
+static void state_table_write_slot(uint32_t idx, const state_slot_t *slot) {
+    state_record_t *rec = &table.rec[idx];
+    uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&table.hdr->writing, idx + 1, memory_order_relaxed);
+    atomic_store_explicit(&rec->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&rec->slot, slot, sizeof(*slot));
+    atomic_store_explicit(&rec->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&table.hdr->writing, 0, memory_order_relaxed);
+}
+
+static bool state_table_string_eq(uint32_t off, uint16_t len, const char *s, size_t s_len) {
+    return len == s_len && (size_t)off + len <= table.hdr->heap_size &&
+           memcmp(table.heap + off, s, s_len) == 0;
+}
+
+static char *state_table_strdup(uint32_t off, uint16_t len) {
+    if ((size_t)off + len > table.hdr->heap_size) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return strndup(table.heap + off, len);
+}
+
+/**
+ * state_table_find - Probe for @id
+ *
+ * Returns: Slot index with *slot filled, or -1. *reuse (if given) gets the
+ *          first empty or dead slot on the probe path, or -1.
+ */
+static long state_table_find(const char *id, size_t id_len, uint64_t hash,
+                             state_slot_t *slot, long *reuse) {
+    uint32_t mask = table.hdr->slots - 1;
+    uint32_t idx = (uint32_t)hash & mask;
+
+    if (reuse) {
+        *reuse = -1;
+    }
+    for (uint32_t n = 0; n <= mask; n++, idx = (idx + 1) & mask) {
+        state_table_read_slot(idx, slot);
+        if (slot->flags != SLOT_LIVE) {
+            if (reuse && *reuse < 0) {
+                *reuse = idx;
+            }
+            if (slot->flags == SLOT_EMPTY) {
+                return -1;
+            }
+            continue;
+        }
+        if (slot->id_hash == hash && state_table_string_eq(slot->id_off, slot->id_len, id, id_len)) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/* Copy bytes into the heap; caller checked there is room */
+static uint32_t state_table_heap_put(const char *s, size_t len) {
+    uint32_t off = atomic_load_explicit(&table.hdr->heap_used, memory_order_relaxed);
+
+    memcpy(table.heap + off, s, len);
+    atomic_store_explicit(&table.hdr->heap_used, off + (uint32_t)len, memory_order_relaxed);
+    return off;
+}
+
+/* Take the writer lock on the current (non-retired) table file */
+static int state_table_lock(const char *state_dir) {
+    for (;;) {
+        if (state_table_open(state_dir, true) == -1) {
+            return -1;
+        }
+        if (flock(table.fd, LOCK_EX) == -1) {
+            return -1;
+        }
+        if (!atomic_load_explicit(&table.hdr->retired, memory_order_acquire)) {
+            break;
+        }
+        /* Rebuilt while we waited: the lock we hold guards a dead file */
+        flock(table.fd, LOCK_UN);
+        state_table_close();
+    }
+
+    /* A writer that died mid-update left its slot odd; close it */
+    uint32_t writing = atomic_load_explicit(&table.hdr->writing, memory_order_relaxed);
+    if (writing != 0 && writing <= table.hdr->slots) {
+        state_record_t *rec = &table.rec[writing - 1];
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_relaxed);
+
+        if (seq & 1) {
+            atomic_store_explicit(&rec->seq, seq + 1, memory_order_release);
+        }
+        atomic_store_explicit(&table.hdr->writing, 0, memory_order_relaxed);
+    }
+    return 0;
+}
+
+static void state_table_unlock(void) {
+    if (table.fd >= 0) {
+        flock(table.fd, LOCK_UN);
+    }
+}
+
+/**
+ * state_table_rebuild - Replace the table with a larger, compacted copy
+ * @need_heap: Heap bytes the caller is about to append
+ *
+ * Live records are rehashed into a new file which is renamed over the old
+ * one; the old header is then marked retired so other processes reopen.
+ * Caller holds the writer lock, and holds it on the new file on return.
+ */
+static int state_table_rebuild(size_t need_heap) {
+    uint32_t live = atomic_load_explicit(&table.hdr->live, memory_order_relaxed) + 1;
+    uint32_t slots = STATE_TABLE_MIN_SLOTS;
+    size_t heap_need = need_heap;
+    size_t heap_size = STATE_TABLE_MIN_HEAP;
+    char tmp[PATH_MAX + 8];
+    char *base;
+    size_t len;
+    int fd;
+
+    for (uint32_t i = 0; i < table.hdr->slots; i++) {
+        const state_slot_t *slot = &table.rec[i].slot;
+        if (slot->flags == SLOT_LIVE) {
+            heap_need += (size_t)slot->id_len + slot->bundle_len;
+        }
+    }
+    while (slots / 2 < live) {
+        slots <<= 1;
+    }
+    while (heap_size < heap_need * 2 && heap_size < STATE_TABLE_MAX_HEAP) {
+        heap_size <<= 1;
+    }
+    if (slots == 0 || heap_size < heap_need) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", table.path);
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    len = state_table_size(slots, (uint32_t)heap_size);
+    if (flock(fd, LOCK_EX) == -1 || ftruncate(fd, (off_t)len) == -1 ||
+        (base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        int saved = errno;
+        unlink(tmp);
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    state_table_header_t *hdr = (state_table_header_t *)base;
+    state_record_t *rec = (state_record_t *)(base + sizeof(*hdr));
+    char *heap = base + sizeof(*hdr) + (size_t)slots * sizeof(state_record_t);
+    uint32_t heap_used = 0;
+    uint32_t count = 0;
+
+    state_table_init_header(base, slots, (uint32_t)heap_size);
+    for (uint32_t i = 0; i < table.hdr->slots; i++) {
+        state_slot_t slot = table.rec[i].slot;
+        uint32_t idx;
+
+        if (slot.flags != SLOT_LIVE) {
+            continue;
+        }
+        memcpy(heap + heap_used, table.heap + slot.id_off, slot.id_len);
+        slot.id_off = heap_used;
+        heap_used += slot.id_len;
+        memcpy(heap + heap_used, table.heap + slot.bundle_off, slot.bundle_len);
+        slot.bundle_off = heap_used;
+        heap_used += slot.bundle_len;
+
+        for (idx = (uint32_t)slot.id_hash & (slots - 1); rec[idx].slot.flags != SLOT_EMPTY;
+             idx = (idx + 1) & (slots - 1)) {
+        }
+        rec[idx].slot = slot;
+        count++;
+    }
+    atomic_store_explicit(&hdr->heap_used, heap_used, memory_order_relaxed);
+    atomic_store_explicit(&hdr->live, count, memory_order_relaxed);
+    atomic_store_explicit(&hdr->used, count, memory_order_relaxed);
+    atomic_store_explicit(&hdr->magic, STATE_TABLE_MAGIC, memory_order_release);
+
+    /* The new file must be complete on disk before it can replace the old one */
+    if (msync(base, len, MS_SYNC) == -1 || rename(tmp, table.path) == -1) {
+        int saved = errno;
+        munmap(base, len);
+        unlink(tmp);
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    char *slash = strrchr(table.path, '/');
+    if (slash) {
+        *slash = '\0';
+        int dir_fd = open(table.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        *slash = '/';
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+
+    nk_log_debug("Rebuilt state table %s: %u records, %u slots, %zu heap bytes",
+                 table.path, count, slots, heap_size);
+
+    /* Switch over while still holding the new file's lock */
+    atomic_store_explicit(&table.hdr->retired, 1, memory_order_release);
+    flock(table.fd, LOCK_UN);
+    munmap(table.base, table.len);
+    close(table.fd);
+    table.fd = fd;
+    table.writable = true;
+    if (state_table_attach(base, len) == -1) {
+        state_table_close();
+        return -1;
+    }
+    return 0;
+}
+
+static void state_table_container_free(nk_container_t *container) {
+    free(container->id);
+    free(container->bundle_path);
+    free(container->state_file);
+    free(container);
+}
+
+/* Copy a live slot out into a newly allocated container */
+static nk_container_t *state_table_container(const state_slot_t *slot) {
+    nk_container_t *container = calloc(1, sizeof(*container));
+
+    if (!container) {
+        return NULL;
+    }
+    container->id = state_table_strdup(slot->id_off, slot->id_len);
+    if (slot->bundle_len > 0) {
+        container->bundle_path = state_table_strdup(slot->bundle_off, slot->bundle_len);
+    }
+    container->state = (nk_container_state_t)slot->state;
+    container->mode = (nk_execution_mode_t)slot->mode;
+    container->init_pid = slot->pid;
+    container->started_at = slot->started_at;
+    container->control_fd = -1;
+    container->state_file = strdup(table.path);
+    if (!container->id || !container->state_file ||
+        (slot->bundle_len > 0 && !container->bundle_path)) {
+        state_table_container_free(container);
+        return NULL;
+    }
+    return container;
+}
+
+/**
+ * nk_state_table_load - Copy one record out of the table
+ */
+nk_container_t *nk_state_table_load(const char *state_dir, const char *container_id) {
+    size_t id_len = strlen(container_id);
+    uint64_t hash = state_table_hash(container_id, id_len);
+    state_slot_t slot;
+
+    for (;;) {
+        if (state_table_open(state_dir, false) == -1) {
+            return NULL;
+        }
+        if (state_table_find(container_id, id_len, hash, &slot, NULL) < 0) {
+            if (atomic_load_explicit(&table.hdr->retired, memory_order_acquire)) {
+                continue;
+            }
+            errno = ENOENT;
+            return NULL;
+        }
+        break;
+    }
+
+    return state_table_container(&slot);
+}
+
+/**
+ * nk_state_table_exists - Probe without copying strings
+ */
+bool nk_state_table_exists(const char *state_dir, const char *container_id) {
+    size_t id_len = strlen(container_id);
+    uint64_t hash = state_table_hash(container_id, id_len);
+    state_slot_t slot;
+
+    for (;;) {
+        if (state_table_open(state_dir, false) == -1) {
+            return false;
+        }
+        if (state_table_find(container_id, id_len, hash, &slot, NULL) >= 0) {
+            return true;
+        }
+        if (!atomic_load_explicit(&table.hdr->retired, memory_order_acquire)) {
+            return false;
+        }
+    }
+}
+
+/**
+ * nk_state_table_save - Insert or update a record in place
+ */
+int nk_state_table_save(const char *state_dir, const nk_container_t *container) {
+    const char *bundle = container->bundle_path ? container->bundle_path : "";
+    size_t id_len = strlen(container->id);
+    size_t bundle_len = strlen(bundle);
+    uint64_t hash = state_table_hash(container->id, id_len);
+    state_slot_t slot;
+    size_t need;
+    long idx;
+    long reuse;
+
+    if (id_len == 0 || id_len > UINT16_MAX || bundle_len > UINT16_MAX) {
+        nk_stderr("Error: Container ID or bundle path too long for the state table\n");
+        return -1;
+    }
+
+    if (state_table_lock(state_dir) == -1) {
+        nk_stderr("Error: Failed to open state table in %s: %s\n", state_dir, strerror(errno));
+        return -1;
+    }
+
+    idx = state_table_find(container->id, id_len, hash, &slot, &reuse);
+    bool same_bundle = idx >= 0 &&
+        state_table_string_eq(slot.bundle_off, slot.bundle_len, bundle, bundle_len);
+    need = (idx >= 0 ? 0 : id_len) + (same_bundle ? 0 : bundle_len);
+
+    bool out_of_slots = idx < 0 && (reuse < 0 || table.rec[reuse].slot.flags == SLOT_EMPTY) &&
+        (atomic_load_explicit(&table.hdr->used, memory_order_relaxed) + 1) * 4 > table.hdr->slots * 3u;
+    bool out_of_heap = atomic_load_explicit(&table.hdr->heap_used, memory_order_relaxed) + need >
+        table.hdr->heap_size;
+
+    if (out_of_slots || out_of_heap) {
+        if (state_table_rebuild(need) == -1) {
+            nk_stderr("Error: Failed to grow state table %s: %s\n", table.path, strerror(errno));
+            state_table_unlock();
+            return -1;
+        }
+        idx = state_table_find(container->id, id_len, hash, &slot, &reuse);
+    }
+
+    if (idx < 0) {
+        bool was_empty = table.rec[reuse].slot.flags == SLOT_EMPTY;
+
+        memset(&slot, 0, sizeof(slot));
+        slot.flags = SLOT_LIVE;
+        slot.id_hash = hash;
+        slot.id_off = state_table_heap_put(container->id, id_len);
+        slot.id_len = (uint16_t)id_len;
+        same_bundle = false;
+        idx = reuse;
+        atomic_fetch_add_explicit(&table.hdr->live, 1, memory_order_relaxed);
+        if (was_empty) {
+            atomic_fetch_add_explicit(&table.hdr->used, 1, memory_order_relaxed);
+        }
+    }
+    if (!same_bundle) {
+        slot.bundle_off = state_table_heap_put(bundle, bundle_len);
+        slot.bundle_len = (uint16_t)bundle_len;
+    }
+    slot.pid = container->init_pid;
+    slot.state = (int8_t)container->state;
+    slot.mode = (uint8_t)container->mode;
+    slot.started_at = container->started_at;
+
+    state_table_write_slot((uint32_t)idx, &slot);
+    state_table_unlock();
+    return 0;
+}
+
+/**
+ * nk_state_table_delete - Mark a record dead
+ */
+int nk_state_table_delete(const char *state_dir, const char *container_id) {
+    size_t id_len = strlen(container_id);
+    uint64_t hash = state_table_hash(container_id, id_len);
+    state_slot_t slot;
+    long idx;
+
+    /* Nothing to delete without a table; don't create one */
+    if (state_table_open(state_dir, false) == -1) {
+        return -1;
+    }
+    if (state_table_lock(state_dir) == -1) {
+        return -1;
+    }
+
+    idx = state_table_find(container_id, id_len, hash, &slot, NULL);
+    if (idx >= 0) {
+        slot.flags = SLOT_DEAD;
+        state_table_write_slot((uint32_t)idx, &slot);
+        atomic_fetch_sub_explicit(&table.hdr->live, 1, memory_order_relaxed);
+    }
+
+    state_table_unlock();
+    if (idx < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * nk_state_table_list - One pass over all slots, each read under its counter
+ *
+ * A rebuild that retires the file mid-scan may have moved records behind
+ * the cursor, so the scan restarts on the new file.
+ */
+int nk_state_table_list(const char *state_dir, nk_container_t ***out, size_t *count) {
+    nk_container_t **list = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+
+    *out = NULL;
+    *count = 0;
+    for (;;) {
+        if (state_table_open(state_dir, false) == -1) {
+            return errno == ENOENT ? 0 : -1;
+        }
+
+        for (uint32_t i = 0; i < table.hdr->slots; i++) {
+            state_slot_t slot;
+            nk_container_t *container;
+
+            state_table_read_slot(i, &slot);
+            if (slot.flags != SLOT_LIVE) {
+                continue;
+            }
+            if (n == cap) {
+                size_t new_cap = cap ? cap * 2 :
+                    atomic_load_explicit(&table.hdr->live, memory_order_relaxed) + 16;
+                nk_container_t **grown = realloc(list, new_cap * sizeof(*list));
+                if (!grown) {
+                    goto fail;
+                }
+                list = grown;
+                cap = new_cap;
+            }
+            if (!(container = state_table_container(&slot))) {
+                goto fail;
+            }
+            list[n++] = container;
+        }
+
+        if (!atomic_load_explicit(&table.hdr->retired, memory_order_acquire)) {
+            break;
+        }
+        while (n > 0) {
+            state_table_container_free(list[--n]);
+        }
+    }
+
+    *out = list;
+    *count = n;
+    return 0;
+
+fail:
+    while (n > 0) {
+        state_table_container_free(list[--n]);
+    }
+    free(list);
+    errno = ENOMEM;
+    return -1;
+}
+
+/**
+ * nk_state_table_sync - msync() the whole mapping; only dirty pages are written
+ */
+int nk_state_table_sync(const char *state_dir) {
+    if (state_table_open(state_dir, false) == -1) {
+        return -1;
+    }
+    return msync(table.base, table.len, MS_SYNC);
+}
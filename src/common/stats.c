@@ -0,0 +1,566 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <jansson.h>
+
+#include "nk.h"
+#include "nk_container.h"
+#include "nk_log.h"
+#include "common/state.h"
+#include "common/stats.h"
+
+/* cgroup files kept open per container */
+enum {
+    STATS_MEMORY_CURRENT,
+    STATS_MEMORY_STAT,
+    STATS_CPU_STAT,
+    STATS_IO_STAT,
+    STATS_PIDS_CURRENT,
+    STATS_FILES
+};
+
+static const char *const stats_files[STATS_FILES] = {
+    "memory.current", "memory.stat", "cpu.stat", "io.stat", "pids.current",
+};
+
+/* memory.stat is ~1.5 KiB; io.stat has one line per active device */
+#define STATS_BUF_SIZE 16384
+
+/* One reading of a container cgroup; -1 marks a value whose file is missing */
+typedef struct stats_sample {
+    int64_t memory;
+    int64_t memory_anon;
+    int64_t memory_file;
+    int64_t cpu_usage_usec;
+    int64_t cpu_user_usec;
+    int64_t cpu_system_usec;
+    int64_t cpu_throttled_usec;
+    int64_t io_read_bytes;
+    int64_t io_write_bytes;
+    int64_t pids;
+} stats_sample_t;
+
+typedef struct stats_entry {
+    char *id;
+    int fds[STATS_FILES];
+    bool has_prev;                  /* prev holds the sample of the last interval */
+    bool gone;                      /* cgroup was removed */
+    stats_sample_t prev;
+    stats_sample_t cur;
+} stats_entry_t;
+
+typedef struct stats_set {
+    stats_entry_t *entries;         /* sorted by ID */
+    size_t count;
+} stats_set_t;
+
+/* Values printed per container, in output order */
+typedef enum {
+    STAT_CPU_PERCENT,
+    STAT_CPU_USAGE,
+    STAT_CPU_USER,
+    STAT_CPU_SYSTEM,
+    STAT_CPU_THROTTLED,
+    STAT_MEMORY,
+    STAT_MEMORY_ANON,
+    STAT_MEMORY_FILE,
+    STAT_PIDS,
+    STAT_IO_READ,
+    STAT_IO_WRITE,
+    STAT_IO_READ_RATE,
+    STAT_IO_WRITE_RATE,
+    STAT_COUNT
+} stats_metric_t;
+
+static const struct {
+    const char *json;               /* NDJSON key, native unit */
+    const char *prom;               /* Prometheus name, base unit */
+    const char *help;
+    bool counter;
+    bool rate;                      /* delta over the interval, not a reading */
+    double prom_scale;
+} stats_metrics[STAT_COUNT] = {
+    [STAT_CPU_PERCENT]   = { "cpu_percent", "nk_container_cpu_percent",
+                             "CPU time used over the last interval, 100 per CPU", false, true, 1 },
+    [STAT_CPU_USAGE]     = { "cpu_usage_usec", "nk_container_cpu_usage_seconds_total",
+                             "Total CPU time", true, false, 1e-6 },
+    [STAT_CPU_USER]      = { "cpu_user_usec", "nk_container_cpu_user_seconds_total",
+                             "User CPU time", true, false, 1e-6 },
+    [STAT_CPU_SYSTEM]    = { "cpu_system_usec", "nk_container_cpu_system_seconds_total",
+                             "System CPU time", true, false, 1e-6 },
+    [STAT_CPU_THROTTLED] = { "cpu_throttled_usec", "nk_container_cpu_throttled_seconds_total",
+                             "Time throttled by cpu.max", true, false, 1e-6 },
+    [STAT_MEMORY]        = { "memory_bytes", "nk_container_memory_bytes",
+                             "memory.current", false, false, 1 },
+    [STAT_MEMORY_ANON]   = { "memory_anon_bytes", "nk_container_memory_anon_bytes",
+                             "Anonymous memory", false, false, 1 },
+    [STAT_MEMORY_FILE]   = { "memory_file_bytes", "nk_container_memory_file_bytes",
+                             "Page cache memory", false, false, 1 },
+    [STAT_PIDS]          = { "pids", "nk_container_pids",
+                             "pids.current", false, false, 1 },
+    [STAT_IO_READ]       = { "io_read_bytes", "nk_container_io_read_bytes_total",
+                             "Bytes read from block devices", true, false, 1 },
+    [STAT_IO_WRITE]      = { "io_write_bytes", "nk_container_io_write_bytes_total",
+                             "Bytes written to block devices", true, false, 1 },
+    [STAT_IO_READ_RATE]  = { "io_read_bps", "nk_container_io_read_bytes_per_second",
+                             "Read throughput over the last interval", false, true, 1 },
+    [STAT_IO_WRITE_RATE] = { "io_write_bps", "nk_container_io_write_bytes_per_second",
+                             "Write throughput over the last interval", false, true, 1 },
+};
+
+static void stats_entry_close(stats_entry_t *e) {
+    for (int i = 0; i < STATS_FILES; i++) {
+        if (e->fds[i] != -1) {
+            close(e->fds[i]);
+        }
+    }
+    free(e->id);
+}
+
+/**
+ * stats_entry_open - Open the stat files of a container cgroup once
+ */
+static int stats_entry_open(stats_entry_t *e, const char *container_id) {
+    char path[PATH_MAX];
+
+    memset(e, 0, sizeof(*e));
+    for (int i = 0; i < STATS_FILES; i++) {
+        e->fds[i] = -1;
+    }
+    if (nk_cgroup_path(container_id, path, sizeof(path)) == -1) {
+        return -1;
+    }
+    int dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir == -1) {
+        return -1;
+    }
+    /* A file is missing when its controller is not enabled for the cgroup */
+    for (int i = 0; i < STATS_FILES; i++) {
+        e->fds[i] = openat(dir, stats_files[i], O_RDONLY | O_CLOEXEC);
+    }
+    close(dir);
+
+    e->id = strdup(container_id);
+    if (!e->id || e->fds[STATS_CPU_STAT] == -1) {
+        stats_entry_close(e);
+        return -1;
+    }
+    return 0;
+}
+
+/* Re-read one open cgroup file from offset 0 */
+static ssize_t stats_pread(int fd, char *buf, size_t len) {
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+/* Value of "key value" in a flat-keyed file such as cpu.stat */
+static int64_t stats_key(const char *buf, const char *key) {
+    size_t len = strlen(key);
+
+    for (const char *p = buf; p; p = strchr(p, '\n')) {
+        p += *p == '\n';
+        if (strncmp(p, key, len) == 0 && p[len] == ' ') {
+            return strtoll(p + len + 1, NULL, 10);
+        }
+    }
+    return -1;
+}
+
+/* Sum rbytes= and wbytes= over the per-device lines of io.stat */
+static void stats_parse_io(const char *buf, stats_sample_t *s) {
+    const char *p;
+
+    s->io_read_bytes = 0;
+    s->io_write_bytes = 0;
+    for (p = buf; (p = strstr(p, "bytes=")) != NULL; p += 6) {
+        if (p > buf && p[-1] == 'r') {
+            s->io_read_bytes += strtoll(p + 6, NULL, 10);
+        } else if (p > buf && p[-1] == 'w') {
+            s->io_write_bytes += strtoll(p + 6, NULL, 10);
+        }
+    }
+}
+
+/**
+ * stats_entry_sample - pread every open file of one container into e->cur
+ */
+static void stats_entry_sample(stats_entry_t *e, char *buf) {
+    stats_sample_t *s = &e->cur;
+
+    memset(s, 0xff, sizeof(*s));    /* every value -1 */
+
+    /* cpu.stat exists in every cgroup; failing to read it means the cgroup is gone */
+    if (stats_pread(e->fds[STATS_CPU_STAT], buf, STATS_BUF_SIZE) <= 0) {
+        e->gone = true;
+        return;
+    }
+    s->cpu_usage_usec = stats_key(buf, "usage_usec");
+    s->cpu_user_usec = stats_key(buf, "user_usec");
+    s->cpu_system_usec = stats_key(buf, "system_usec");
+    s->cpu_throttled_usec = stats_key(buf, "throttled_usec");
+
+    if (stats_pread(e->fds[STATS_MEMORY_CURRENT], buf, STATS_BUF_SIZE) > 0) {
+        s->memory = strtoll(buf, NULL, 10);
+    }
+    if (stats_pread(e->fds[STATS_MEMORY_STAT], buf, STATS_BUF_SIZE) > 0) {
+        s->memory_anon = stats_key(buf, "anon");
+        s->memory_file = stats_key(buf, "file");
+    }
+    if (stats_pread(e->fds[STATS_IO_STAT], buf, STATS_BUF_SIZE) >= 0) {
+        stats_parse_io(buf, s);
+    }
+    if (stats_pread(e->fds[STATS_PIDS_CURRENT], buf, STATS_BUF_SIZE) > 0) {
+        s->pids = strtoll(buf, NULL, 10);
+    }
+}
+
+/* Delta of one counter per second over @interval_s, if both samples have it */
+static bool stats_rate(int64_t prev, int64_t cur, double interval_s, double *out) {
+    if (prev < 0 || cur < 0 || interval_s <= 0) {
+        return false;
+    }
+    *out = (double)(cur >= prev ? cur - prev : 0) / interval_s;
+    return true;
+}
+
+/**
+ * stats_value - One metric of a container; false if it is not available
+ */
+static bool stats_value(const stats_entry_t *e, stats_metric_t m, double interval_s, double *out) {
+    const stats_sample_t *s = &e->cur;
+    const stats_sample_t *p = &e->prev;
+    int64_t v;
+
+    switch (m) {
+    case STAT_CPU_PERCENT:
+        /* usage_usec per second of wall time, as a percentage */
+        if (!e->has_prev || !stats_rate(p->cpu_usage_usec, s->cpu_usage_usec, interval_s, out)) {
+            return false;
+        }
+        *out /= 1e4;
+        return true;
+    case STAT_IO_READ_RATE:
+        return e->has_prev && stats_rate(p->io_read_bytes, s->io_read_bytes, interval_s, out);
+    case STAT_IO_WRITE_RATE:
+        return e->has_prev && stats_rate(p->io_write_bytes, s->io_write_bytes, interval_s, out);
+    case STAT_CPU_USAGE:     v = s->cpu_usage_usec; break;
+    case STAT_CPU_USER:      v = s->cpu_user_usec; break;
+    case STAT_CPU_SYSTEM:    v = s->cpu_system_usec; break;
+    case STAT_CPU_THROTTLED: v = s->cpu_throttled_usec; break;
+    case STAT_MEMORY:        v = s->memory; break;
+    case STAT_MEMORY_ANON:   v = s->memory_anon; break;
+    case STAT_MEMORY_FILE:   v = s->memory_file; break;
+    case STAT_PIDS:          v = s->pids; break;
+    case STAT_IO_READ:       v = s->io_read_bytes; break;
+    case STAT_IO_WRITE:      v = s->io_write_bytes; break;
+    default:
+        return false;
+    }
+    if (v < 0) {
+        return false;
+    }
+    *out = (double)v;
+    return true;
+}
+
+static void stats_format_bytes(bool ok, double v, const char *suffix, char *buf, size_t len) {
+    static const char *const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    size_t u = 0;
+
+    if (!ok) {
+        snprintf(buf, len, "-");
+        return;
+    }
+    while (v >= 1024 && u + 1 < sizeof(units) / sizeof(units[0])) {
+        v /= 1024;
+        u++;
+    }
+    snprintf(buf, len, u == 0 ? "%.0f%s%s" : "%.1f%s%s", v, units[u], suffix);
+}
+
+static void stats_print_table(FILE *out, const stats_set_t *set, double interval_s) {
+    int id_width = 2;
+    double v = 0;
+
+    for (size_t i = 0; i < set->count; i++) {
+        int len = (int)strlen(set->entries[i].id);
+        id_width = len > id_width ? len : id_width;
+    }
+    fprintf(out, "%-*s  %7s  %10s  %10s  %10s  %6s  %12s  %12s\n", id_width, "ID", "CPU%", "MEM",
+            "ANON", "FILE", "PIDS", "READ", "WRITE");
+    for (size_t i = 0; i < set->count; i++) {
+        const stats_entry_t *e = &set->entries[i];
+        char cpu[16], mem[16], anon[16], file[16], pids[16], rd[24], wr[24];
+        bool ok;
+
+        if (stats_value(e, STAT_CPU_PERCENT, interval_s, &v)) {
+            snprintf(cpu, sizeof(cpu), "%.1f%%", v);
+        } else {
+            snprintf(cpu, sizeof(cpu), "-");
+        }
+        ok = stats_value(e, STAT_MEMORY, interval_s, &v);
+        stats_format_bytes(ok, v, "", mem, sizeof(mem));
+        ok = stats_value(e, STAT_MEMORY_ANON, interval_s, &v);
+        stats_format_bytes(ok, v, "", anon, sizeof(anon));
+        ok = stats_value(e, STAT_MEMORY_FILE, interval_s, &v);
+        stats_format_bytes(ok, v, "", file, sizeof(file));
+        if (stats_value(e, STAT_PIDS, interval_s, &v)) {
+            snprintf(pids, sizeof(pids), "%.0f", v);
+        } else {
+            snprintf(pids, sizeof(pids), "-");
+        }
+        ok = stats_value(e, STAT_IO_READ_RATE, interval_s, &v);
+        stats_format_bytes(ok, v, "/s", rd, sizeof(rd));
+        ok = stats_value(e, STAT_IO_WRITE_RATE, interval_s, &v);
+        stats_format_bytes(ok, v, "/s", wr, sizeof(wr));
+
+        fprintf(out, "%-*s  %7s  %10s  %10s  %10s  %6s  %12s  %12s\n", id_width, e->id, cpu, mem,
+                anon, file, pids, rd, wr);
+    }
+}
+
+static int stats_print_json(FILE *out, const stats_set_t *set, double interval_s,
+                            long long timestamp_ms) {
+    for (size_t i = 0; i < set->count; i++) {
+        const stats_entry_t *e = &set->entries[i];
+        json_t *obj = json_object();
+        double v = 0;
+
+        if (!obj) {
+            return -1;
+        }
+        json_object_set_new(obj, "id", json_string(e->id));
+        json_object_set_new(obj, "timestamp_ms", json_integer(timestamp_ms));
+        for (int m = 0; m < STAT_COUNT; m++) {
+            json_t *val;
+            if (!stats_value(e, (stats_metric_t)m, interval_s, &v)) {
+                val = json_null();
+            } else if (stats_metrics[m].rate) {
+                val = json_real((double)(long long)(v * 100 + 0.5) / 100);
+            } else {
+                val = json_integer((json_int_t)v);
+            }
+            json_object_set_new(obj, stats_metrics[m].json, val);
+        }
+        int ret = json_dumpf(obj, out, JSON_COMPACT);
+        json_decref(obj);
+        if (ret == -1) {
+            return -1;
+        }
+        fputc('\n', out);
+    }
+    return 0;
+}
+
+/* Label value escaping of the text exposition format */
+static void stats_prom_label(FILE *out, const char *s) {
+    for (; *s; s++) {
+        if (*s == '\\' || *s == '"') {
+            fputc('\\', out);
+            fputc(*s, out);
+        } else if (*s == '\n') {
+            fputs("\\n", out);
+        } else {
+            fputc(*s, out);
+        }
+    }
+}
+
+static void stats_print_prometheus(FILE *out, const stats_set_t *set, double interval_s) {
+    for (int m = 0; m < STAT_COUNT; m++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", stats_metrics[m].prom, stats_metrics[m].help,
+                stats_metrics[m].prom, stats_metrics[m].counter ? "counter" : "gauge");
+        for (size_t i = 0; i < set->count; i++) {
+            double v = 0;
+            if (!stats_value(&set->entries[i], (stats_metric_t)m, interval_s, &v)) {
+                continue;
+            }
+            fprintf(out, "%s{id=\"", stats_metrics[m].prom);
+            stats_prom_label(out, set->entries[i].id);
+            fprintf(out, "\"} %.15g\n", v * stats_metrics[m].prom_scale);
+        }
+    }
+}
+
+static int stats_entry_cmp(const void *key, const void *elem) {
+    return strcmp((const char *)key, ((const stats_entry_t *)elem)->id);
+}
+
+/**
+ * stats_rescan - Sync the open set with the container list
+ *
+ * Both lists are sorted by ID: existing entries keep their fds and last
+ * sample, new containers are opened, and removed ones are closed.
+ */
+static int stats_rescan(stats_set_t *set) {
+    nk_container_t **list;
+    size_t count;
+    size_t kept = 0;
+
+    if (nk_state_list(&list, &count) == -1) {
+        return -1;
+    }
+    stats_entry_t *entries = calloc(count ? count : 1, sizeof(*entries));
+    if (!entries) {
+        nk_state_list_free(list, count);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *id = list[i]->id;
+        stats_entry_t *old = set->count ? bsearch(id, set->entries, set->count,
+                                                  sizeof(*set->entries), stats_entry_cmp) : NULL;
+        if (old && !old->gone) {
+            entries[kept++] = *old;
+            old->id = NULL;         /* moved */
+        } else if (stats_entry_open(&entries[kept], id) == 0) {
+            kept++;
+        }
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->entries[i].id) {
+            stats_entry_close(&set->entries[i]);
+        }
+    }
+    free(set->entries);
+    set->entries = entries;
+    set->count = kept;
+    nk_state_list_free(list, count);
+    return 0;
+}
+
+/* Sample every open container; drop the ones whose cgroup is gone */
+static void stats_sample_all(stats_set_t *set, char *buf) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < set->count; i++) {
+        stats_entry_t *e = &set->entries[i];
+        stats_entry_sample(e, buf);
+        if (e->gone) {
+            stats_entry_close(e);
+            continue;
+        }
+        set->entries[kept++] = *e;
+    }
+    set->count = kept;
+}
+
+static double stats_elapsed_s(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/**
+ * nk_stats_run - Baseline sample, then one printed sample per interval
+ */
+int nk_stats_run(FILE *out, const char *container_id, nk_stats_format_t format,
+                 unsigned interval_ms, bool stream) {
+    stats_set_t set = {0};
+    struct timespec prev_at, now, next;
+    char *buf;
+    int ret = 0;
+
+    if (interval_ms == 0) {
+        interval_ms = NK_STATS_INTERVAL_MS;
+    }
+
+    if (container_id) {
+        if (!nk_state_exists(container_id)) {
+            nk_stderr("Error: Container '%s' not found\n", container_id);
+            return -1;
+        }
+        set.entries = calloc(1, sizeof(*set.entries));
+        if (!set.entries) {
+            return -1;
+        }
+        if (stats_entry_open(&set.entries[0], container_id) == -1) {
+            nk_stderr("Error: Container '%s' has no cgroup to sample (cgroup v2 required)\n",
+                      container_id);
+            free(set.entries);
+            return -1;
+        }
+        set.count = 1;
+    } else if (stats_rescan(&set) == -1) {
+        return -1;
+    }
+
+    buf = malloc(STATS_BUF_SIZE);
+    if (!buf) {
+        ret = -1;
+        goto out;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &prev_at);
+    stats_sample_all(&set, buf);
+    next = prev_at;
+
+    do {
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+
+        for (size_t i = 0; i < set.count; i++) {
+            set.entries[i].prev = set.entries[i].cur;
+            set.entries[i].has_prev = true;
+        }
+        if (!container_id && stats_rescan(&set) == -1) {
+            ret = -1;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        stats_sample_all(&set, buf);
+        if (container_id && set.count == 0) {
+            break;                  /* the container's cgroup was removed */
+        }
+
+        double interval_s = stats_elapsed_s(&prev_at, &now);
+        prev_at = now;
+
+        if (format == NK_STATS_JSON) {
+            struct timespec wall;
+            clock_gettime(CLOCK_REALTIME, &wall);
+            if (stats_print_json(out, &set, interval_s,
+                                 (long long)wall.tv_sec * 1000 + wall.tv_nsec / 1000000) == -1) {
+                ret = -1;
+                break;
+            }
+        } else if (format == NK_STATS_PROMETHEUS) {
+            stats_print_prometheus(out, &set, interval_s);
+        } else {
+            stats_print_table(out, &set, interval_s);
+        }
+        if (stream && format != NK_STATS_JSON) {
+            fputc('\n', out);
+        }
+        if (fflush(out) == EOF) {
+            ret = -1;               /* reader went away */
+            break;
+        }
+    } while (stream);
+
+out:
+    for (size_t i = 0; i < set.count; i++) {
+        stats_entry_close(&set.entries[i]);
+    }
+    free(set.entries);
+    free(buf);
+    return ret;
+}
@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <jansson.h>
+
+#include "nk_log.h"
+#include "common/state.h"
+#include "common/trace.h"
+
+#define TRACE_FILE "trace.json"
+
+static const struct {
+    const char *name;
+    bool child;
+} trace_phases[NK_TRACE_PHASES] = {
+    [NK_TRACE_SPEC_LOAD]      = { "spec_load",      false },
+    [NK_TRACE_CGROUP_OPEN]    = { "cgroup_open",    false },
+    [NK_TRACE_CGROUP_LIMITS]  = { "cgroup_limits",  false },
+    [NK_TRACE_CPUSET]         = { "cpuset",         false },
+    [NK_TRACE_CLONE]          = { "clone",          false },
+    [NK_TRACE_CGROUP_ATTACH]  = { "cgroup_attach",  false },
+    [NK_TRACE_OVERLAY]        = { "overlay",        true  },
+    [NK_TRACE_MAKE_PRIVATE]   = { "make_private",   true  },
+    [NK_TRACE_DEFAULT_MOUNTS] = { "default_mounts", true  },
+    [NK_TRACE_SETUP_DEV]      = { "setup_dev",      true  },
+    [NK_TRACE_PIVOT_ROOT]     = { "pivot_root",     true  },
+    [NK_TRACE_CHILD_READY]    = { "child_ready",    false },
+    [NK_TRACE_RELEASE]        = { "release",        false },
+    [NK_TRACE_STATE_SAVE]     = { "state_save",     false },
+};
+
+uint64_t nk_trace_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void nk_trace_begin(nk_trace_t *trace, nk_trace_phase_t phase) {
+    if (trace && phase < NK_TRACE_PHASES) {
+        trace->span[phase].begin_ns = nk_trace_now();
+        trace->span[phase].end_ns = 0;
+    }
+}
+
+void nk_trace_end(nk_trace_t *trace, nk_trace_phase_t phase) {
+    if (trace && phase < NK_TRACE_PHASES && trace->span[phase].begin_ns != 0) {
+        trace->span[phase].end_ns = nk_trace_now();
+    }
+}
+
+bool nk_trace_phase_in_child(nk_trace_phase_t phase) {
+    return phase < NK_TRACE_PHASES && trace_phases[phase].child;
+}
+
+static bool trace_recorded(const nk_trace_span_t *span) {
+    return span->begin_ns != 0 && span->end_ns >= span->begin_ns;
+}
+
+/* First begin and last end over all recorded phases; false if none were */
+static bool trace_bounds(const nk_trace_t *trace, uint64_t *first, uint64_t *last) {
+    bool any = false;
+
+    *first = 0;
+    *last = 0;
+    for (int i = 0; i < NK_TRACE_PHASES; i++) {
+        const nk_trace_span_t *span = &trace->span[i];
+        if (!trace_recorded(span)) {
+            continue;
+        }
+        if (!any || span->begin_ns < *first) {
+            *first = span->begin_ns;
+        }
+        if (!any || span->end_ns > *last) {
+            *last = span->end_ns;
+        }
+        any = true;
+    }
+    return any;
+}
+
+static json_t *trace_to_json(const char *container_id, const nk_trace_t *trace) {
+    json_t *root = json_object();
+    json_t *phases = json_array();
+    uint64_t first, last;
+
+    if (!root || !phases) {
+        json_decref(root);
+        json_decref(phases);
+        return NULL;
+    }
+
+    bool any = trace_bounds(trace, &first, &last);
+
+    json_object_set_new(root, "id", json_string(container_id));
+    json_object_set_new(root, "clock", json_string("monotonic"));
+    json_object_set_new(root, "total_ns", json_integer(any ? (json_int_t)(last - first) : 0));
+    for (int i = 0; i < NK_TRACE_PHASES; i++) {
+        const nk_trace_span_t *span = &trace->span[i];
+        json_t *entry;
+
+        if (!trace_recorded(span) || !(entry = json_object())) {
+            continue;
+        }
+        json_object_set_new(entry, "name", json_string(trace_phases[i].name));
+        json_object_set_new(entry, "side", json_string(trace_phases[i].child ? "child" : "parent"));
+        json_object_set_new(entry, "begin_ns", json_integer((json_int_t)span->begin_ns));
+        json_object_set_new(entry, "end_ns", json_integer((json_int_t)span->end_ns));
+        json_object_set_new(entry, "duration_ns",
+                json_integer((json_int_t)(span->end_ns - span->begin_ns)));
+        json_array_append_new(phases, entry);
+    }
+    json_object_set_new(root, "phases", phases);
+    return root;
+}
+
+/**
+ * nk_trace_save - Write trace.json next to state.json
+ */
+int nk_trace_save(const char *container_id, const nk_trace_t *trace) {
+    char *path = nk_state_file_path(container_id, TRACE_FILE);
+    json_t *root;
+    int ret = 0;
+
+    if (!path || !trace) {
+        free(path);
+        return -1;
+    }
+
+    root = trace_to_json(container_id, trace);
+    if (!root || json_dump_file(root, path, JSON_INDENT(2)) == -1) {
+        nk_log_warn("Failed to write start trace %s", path);
+        ret = -1;
+    }
+
+    json_decref(root);
+    free(path);
+    return ret;
+}
+
+/**
+ * nk_trace_load - Read trace.json back into phase spans
+ */
+int nk_trace_load(const char *container_id, nk_trace_t *trace) {
+    char *path = nk_state_file_path(container_id, TRACE_FILE);
+    json_error_t error;
+    json_t *root;
+    json_t *phases;
+    json_t *entry;
+    size_t idx;
+
+    memset(trace, 0, sizeof(*trace));
+    if (!path) {
+        return -1;
+    }
+    root = json_load_file(path, 0, &error);
+    free(path);
+    if (!root) {
+        return -1;
+    }
+
+    phases = json_object_get(root, "phases");
+    if (!json_is_array(phases)) {
+        json_decref(root);
+        return -1;
+    }
+
+    json_array_foreach(phases, idx, entry) {
+        json_t *name = json_object_get(entry, "name");
+        json_t *begin = json_object_get(entry, "begin_ns");
+        json_t *end = json_object_get(entry, "end_ns");
+
+        if (!json_is_string(name) || !json_is_integer(begin) || !json_is_integer(end)) {
+            continue;
+        }
+        for (int i = 0; i < NK_TRACE_PHASES; i++) {
+            if (strcmp(json_string_value(name), trace_phases[i].name) == 0) {
+                trace->span[i].begin_ns = (uint64_t)json_integer_value(begin);
+                trace->span[i].end_ns = (uint64_t)json_integer_value(end);
+                break;
+            }
+        }
+    }
+
+    json_decref(root);
+    return 0;
+}
+
+void nk_trace_delete(const char *container_id) {
+    char *path = nk_state_file_path(container_id, TRACE_FILE);
+
+    if (path) {
+        unlink(path);
+        free(path);
+    }
+}
+
+/**
+ * nk_trace_print - Table of phases with offsets from the first one, or JSON
+ *
+ * Phases overlap (child_ready covers the child's phases), so the total is
+ * the wall time from the first begin to the last end, not a sum.
+ */
+int nk_trace_print(FILE *out, const char *container_id, const nk_trace_t *trace, bool json) {
+    uint64_t first, last;
+
+    if (json) {
+        json_t *root = trace_to_json(container_id, trace);
+        int ret = 0;
+
+        if (!root || json_dumpf(root, out, JSON_INDENT(2)) == -1) {
+            ret = -1;
+        } else {
+            fputc('\n', out);
+        }
+        json_decref(root);
+        return ret;
+    }
+
+    if (!trace_bounds(trace, &first, &last)) {
+        fprintf(out, "No phases recorded for '%s'\n", container_id);
+        return 0;
+    }
+
+    fprintf(out, "%-16s %-7s %12s %12s\n", "PHASE", "SIDE", "OFFSET(us)", "TIME(us)");
+    for (int i = 0; i < NK_TRACE_PHASES; i++) {
+        const nk_trace_span_t *span = &trace->span[i];
+        if (!trace_recorded(span)) {
+            continue;
+        }
+        fprintf(out, "%-16s %-7s %12.1f %12.1f\n",
+                trace_phases[i].name, trace_phases[i].child ? "child" : "parent",
+                (double)(span->begin_ns - first) / 1000.0,
+                (double)(span->end_ns - span->begin_ns) / 1000.0);
+    }
+    fprintf(out, "%-16s %-7s %12s %12.1f\n", "total", "", "", (double)(last - first) / 1000.0);
+    return 0;
+}
@@ -7,13 +7,54 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <dirent.h>
+#include <signal.h>
 #include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 
 #include "nk_container.h"
 #include "nk_log.h"
+#include "common/state.h"
 
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+
+#ifndef CGROUP_ROOT
 #define CGROUP_ROOT "/sys/fs/cgroup"
-#define CGROUP_V2_CHECK "/sys/fs/cgroup/cgroup.controllers"
+#endif
+#define CGROUP_V2_CHECK CGROUP_ROOT "/cgroup.controllers"
+#define CGROUP_PARENT CGROUP_ROOT "/nano-sandbox"
+
+/* <state_dir>/<id>/ file naming the pool slot a container claimed */
+#define CGROUP_SLOT_FILE "cgroup"
+
+/* How long a delete's background reaper waits for the cgroup to empty */
+#define CGROUP_REAP_TIMEOUT_MS 5000
+
+/* Controllers enabled for containers, when the host delegates them */
+static const char *const cgroup_controllers[] = { "cpu", "memory", "pids", "io", "cpuset" };
+
+/* Cached O_DIRECTORY fd of CGROUP_PARENT (lives for the process lifetime) */
+static int cgroup_parent_fd = -1;
+
+/* One pre-created child cgroup of CGROUP_PARENT */
+typedef struct {
+    int fd;
+    char name[32];
+} cgroup_slot_t;
+
+static cgroup_slot_t *cgroup_pool = NULL;   /* LIFO stack of free slots */
+static size_t cgroup_pool_ready = 0;
+static size_t cgroup_pool_target = 0;
+static unsigned long cgroup_pool_seq = 0;
+static uint64_t cgroup_pool_hits = 0;
+static uint64_t cgroup_pool_misses = 0;
+static uint64_t cgroup_pool_created = 0;
+static uint64_t cgroup_pool_failures = 0;
 
 /**
  * nk_cgroup_is_v2 - Check if cgroups v2 is available
@@ -24,147 +65,568 @@ static int nk_cgroup_is_v2(void) {
 }
 
 /**
- * nk_cgroup_create - Create a cgroup for the container
+ * nk_cgroup_slot_name - Pool slot recorded for a container, if it claimed one
  */
-static int nk_cgroup_create(const char *container_id) {
-    char cgroup_path[PATH_MAX];
-    snprintf(cgroup_path, sizeof(cgroup_path), "%s/nano-sandbox/%s",
-             CGROUP_ROOT, container_id);
+static bool nk_cgroup_slot_name(const char *container_id, char *buf, size_t len) {
+    char *path = nk_state_file_path(container_id, CGROUP_SLOT_FILE);
+    ssize_t n = -1;
+
+    if (!path) {
+        return false;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    if (fd == -1) {
+        return false;
+    }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n <= 0 || buf[0] != '.' || memchr(buf, '/', (size_t)n)) {
+        return false;
+    }
+    buf[n] = '\0';
+    return true;
+}
 
-    /* Create parent cgroup directory */
-    char parent_dir[PATH_MAX];
-    snprintf(parent_dir, sizeof(parent_dir), "%s/nano-sandbox", CGROUP_ROOT);
+/**
+ * nk_cgroup_path - Container cgroup directory under the nano-sandbox parent
+ *
+ * That is the claimed pool slot when there is one, else the container ID.
+ */
+int nk_cgroup_path(const char *container_id, char *buf, size_t len) {
+    char slot[sizeof(((cgroup_slot_t *)0)->name)];
+    const char *name = nk_cgroup_slot_name(container_id, slot, sizeof(slot)) ? slot : container_id;
+    int n = snprintf(buf, len, "%s/%s", CGROUP_PARENT, name);
 
-    if (mkdir(parent_dir, 0755) == -1 && errno != EEXIST) {
-        nk_stderr( "Error: Failed to create %s: %s\n",
-                parent_dir, strerror(errno));
+    if (n < 0 || (size_t)n >= len) {
+        errno = ENAMETOOLONG;
         return -1;
     }
+    return 0;
+}
 
-    /* Create container cgroup directory */
-    if (mkdir(cgroup_path, 0755) == -1 && errno != EEXIST) {
-        nk_stderr( "Error: Failed to create %s: %s\n",
-                cgroup_path, strerror(errno));
-        return -1;
+/* Read a small cgroup file such as cgroup.controllers into @buf */
+static bool nk_cgroup_read(int dir_fd, const char *name, char *buf, size_t len) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    ssize_t n;
+
+    if (fd == -1) {
+        return false;
     }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    return true;
+}
 
-    /* Enable all controllers */
-    char controllers_path[PATH_MAX];
-    snprintf(controllers_path, sizeof(controllers_path),
-             "%s/cgroup.subtree_control", parent_dir);
+/* Whether a space-separated controller list contains @name */
+static bool nk_cgroup_list_has(const char *list, const char *name) {
+    size_t len = strlen(name);
 
-    int fd = open(controllers_path, O_WRONLY);
-    if (fd != -1) {
-        /* Enable common controllers */
-        const char *controllers = "+cpu +memory +pids +io +cpuset";
-        write(fd, controllers, strlen(controllers));
-        close(fd);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\n' || p[len] == '\0')) {
+            return true;
+        }
     }
+    return false;
+}
 
-    nk_log_info("Created cgroup: %s", cgroup_path);
-    return 0;
+/**
+ * nk_cgroup_enable_controllers - Enable missing controllers for container cgroups
+ *
+ * Every subtree_control write takes the global cgroup mutex and re-applies
+ * controller state across the whole subtree, so it is skipped when the
+ * parent is already set up. Only controllers the host delegates to the
+ * parent are requested: one unavailable name would fail the whole write.
+ */
+static void nk_cgroup_enable_controllers(int parent_fd) {
+    char available[256];
+    char enabled[256];
+    char request[64] = "";
+    size_t used = 0;
+
+    if (!nk_cgroup_read(parent_fd, "cgroup.controllers", available, sizeof(available)) ||
+        !nk_cgroup_read(parent_fd, "cgroup.subtree_control", enabled, sizeof(enabled))) {
+        return;
+    }
+    for (size_t i = 0; i < sizeof(cgroup_controllers) / sizeof(cgroup_controllers[0]); i++) {
+        const char *name = cgroup_controllers[i];
+        if (nk_cgroup_list_has(available, name) && !nk_cgroup_list_has(enabled, name)) {
+            used += (size_t)snprintf(request + used, sizeof(request) - used, "%s+%s",
+                                     used ? " " : "", name);
+        }
+    }
+    if (used == 0) {
+        return;
+    }
+
+    int ctl = openat(parent_fd, "cgroup.subtree_control", O_WRONLY | O_CLOEXEC);
+    if (ctl == -1 || write(ctl, request, used) == -1) {
+        nk_log_debug("Enabling controllers on %s: %s", CGROUP_PARENT, strerror(errno));
+    } else {
+        nk_log_info("Enabled controllers on %s: %s", CGROUP_PARENT, request);
+    }
+    if (ctl != -1) {
+        close(ctl);
+    }
 }
 
 /**
- * nk_cgroup_set_memory_limit - Set memory limit for container
+ * nk_cgroup_parent_fd - Open (once) the nano-sandbox parent cgroup
+ *
+ * Parent creation and controller enablement happen only on first use;
+ * later calls reuse the cached directory fd.
  */
-static int nk_cgroup_set_memory_limit(const char *container_id, uint64_t limit) {
-    if (limit == 0) {
-        return 0;  /* No limit */
+static int nk_cgroup_parent_fd(void) {
+    if (cgroup_parent_fd >= 0) {
+        return cgroup_parent_fd;
     }
 
-    char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s/nano-sandbox/%s/memory.max",
-             CGROUP_ROOT, container_id);
+    if (mkdir(CGROUP_PARENT, 0755) == -1 && errno != EEXIST) {
+        nk_stderr( "Warning: Failed to create %s: %s\n",
+                CGROUP_PARENT, strerror(errno));
+        return -1;
+    }
 
-    int fd = open(path, O_WRONLY);
+    int fd = open(CGROUP_PARENT, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
     if (fd == -1) {
-        nk_stderr( "Error: Failed to open %s: %s\n",
-                path, strerror(errno));
+        nk_stderr( "Warning: Failed to open %s: %s\n",
+                CGROUP_PARENT, strerror(errno));
         return -1;
     }
 
-    char limit_str[64];
-    snprintf(limit_str, sizeof(limit_str), "%lu", limit);
+    nk_cgroup_enable_controllers(fd);
 
-    if (write(fd, limit_str, strlen(limit_str)) == -1) {
-        nk_stderr( "Warning: Failed to set memory limit: %s\n",
-                strerror(errno));
-        close(fd);
+    cgroup_parent_fd = fd;
+    return cgroup_parent_fd;
+}
+
+/**
+ * nk_cgroup_prepare - Set up the nano-sandbox parent cgroup ahead of time
+ */
+int nk_cgroup_prepare(void) {
+    if (!nk_cgroup_is_v2()) {
         return -1;
     }
+    return nk_cgroup_parent_fd() == -1 ? -1 : 0;
+}
 
+/**
+ * nk_cgroup_claim_slot - Hand a pre-created pool slot to a container
+ *
+ * cgroup v2 refuses rename(2), so the slot keeps its name and the
+ * container records it in its state directory instead.
+ */
+static int nk_cgroup_claim_slot(const char *container_id) {
+    if (cgroup_pool_ready == 0) {
+        return -1;
+    }
+
+    cgroup_slot_t *slot = &cgroup_pool[cgroup_pool_ready - 1];
+    char *path = nk_state_file_path(container_id, CGROUP_SLOT_FILE);
+    size_t len = strlen(slot->name);
+    int fd = path ? open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+
+    if (fd == -1 || write(fd, slot->name, len) != (ssize_t)len) {
+        nk_log_debug("Cannot record cgroup slot for %s: %s", container_id, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+            unlink(path);
+        }
+        free(path);
+        return -1;
+    }
     close(fd);
-    nk_log_info("Set memory limit: %lu bytes", limit);
-    return 0;
+    free(path);
+
+    cgroup_pool_ready--;
+    nk_log_info("Claimed cgroup slot %s/%s for %s", CGROUP_PARENT, slot->name, container_id);
+    return slot->fd;
 }
 
 /**
- * nk_cgroup_set_cpu_shares - Set CPU shares for container
+ * nk_cgroup_open - Create container cgroup and open it as a directory fd
  */
-static int nk_cgroup_set_cpu_shares(const char *container_id, uint64_t shares) {
-    if (shares == 0) {
-        return 0;  /* No limit */
+int nk_cgroup_open(const char *container_id) {
+    if (!container_id || !nk_cgroup_is_v2()) {
+        return -1;
     }
 
-    char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s/nano-sandbox/%s/cpu.weight",
-             CGROUP_ROOT, container_id);
+    if (cgroup_pool_target > 0) {
+        int fd = nk_cgroup_claim_slot(container_id);
+        if (fd != -1) {
+            cgroup_pool_hits++;
+            return fd;
+        }
+        cgroup_pool_misses++;
+    }
 
-    int fd = open(path, O_WRONLY);
+    int parent = nk_cgroup_parent_fd();
+    if (parent == -1) {
+        return -1;
+    }
+
+    if (mkdirat(parent, container_id, 0755) == -1 && errno != EEXIST) {
+        nk_stderr( "Warning: Failed to create %s/%s: %s\n",
+                CGROUP_PARENT, container_id, strerror(errno));
+        return -1;
+    }
+
+    int fd = openat(parent, container_id, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
     if (fd == -1) {
-        nk_stderr( "Error: Failed to open %s: %s\n",
-                path, strerror(errno));
+        nk_stderr( "Warning: Failed to open %s/%s: %s\n",
+                CGROUP_PARENT, container_id, strerror(errno));
         return -1;
     }
 
-    char shares_str[64];
-    snprintf(shares_str, sizeof(shares_str), "%lu", shares);
+    nk_log_info("Created cgroup: %s/%s", CGROUP_PARENT, container_id);
+    return fd;
+}
 
-    if (write(fd, shares_str, strlen(shares_str)) == -1) {
-        nk_stderr( "Warning: Failed to set CPU shares: %s\n",
-                strerror(errno));
+/* Remove .pool-<pid>-N slots left behind by a runtime that died holding them */
+static void cgroup_pool_sweep(void) {
+    int parent = nk_cgroup_is_v2() ? nk_cgroup_parent_fd() : -1;
+    int dir_fd = parent == -1 ? -1 : openat(parent, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = dir_fd == -1 ? NULL : fdopendir(dir_fd);
+    struct dirent *ent;
+
+    if (!dir) {
+        if (dir_fd != -1) {
+            close(dir_fd);
+        }
+        return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        int pid;
+
+        if (sscanf(ent->d_name, ".pool-%d-", &pid) != 1 || pid <= 0 ||
+            (kill(pid, 0) == 0 || errno != ESRCH)) {
+            continue;
+        }
+        if (unlinkat(parent, ent->d_name, AT_REMOVEDIR) == 0) {
+            nk_log_info("Removed stale cgroup slot %s/%s", CGROUP_PARENT, ent->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * nk_cgroup_pool_configure - Set the number of pre-created cgroups to keep
+ */
+void nk_cgroup_pool_configure(size_t target) {
+    cgroup_slot_t *pool = NULL;
+
+    cgroup_pool_sweep();
+
+    if (target > 0 && !(pool = calloc(target, sizeof(*pool)))) {
+        nk_stderr("Warning: cannot allocate a cgroup pool of %zu\n", target);
+        target = 0;
+    }
+    nk_cgroup_pool_drain();
+    free(cgroup_pool);
+    cgroup_pool = pool;
+    cgroup_pool_target = target;
+}
+
+/**
+ * nk_cgroup_pool_enabled - Check whether the cgroup pool is active
+ */
+bool nk_cgroup_pool_enabled(void) {
+    return cgroup_pool_target > 0;
+}
+
+/**
+ * nk_cgroup_pool_refill - Create one pool slot if the pool is short
+ */
+bool nk_cgroup_pool_refill(void) {
+    if (cgroup_pool_ready >= cgroup_pool_target || !nk_cgroup_is_v2()) {
+        return false;
+    }
+
+    int parent = nk_cgroup_parent_fd();
+    if (parent == -1) {
+        cgroup_pool_failures++;
+        return false;
+    }
+
+    cgroup_slot_t *slot = &cgroup_pool[cgroup_pool_ready];
+    /* Dot names never clash with container IDs, which list hides when dotted */
+    snprintf(slot->name, sizeof(slot->name), ".pool-%d-%lu", (int)getpid(), cgroup_pool_seq++);
+    if (mkdirat(parent, slot->name, 0755) == -1) {
+        nk_log_debug("Cannot create cgroup slot %s: %s", slot->name, strerror(errno));
+        cgroup_pool_failures++;
+        return false;
+    }
+    slot->fd = openat(parent, slot->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (slot->fd == -1) {
+        unlinkat(parent, slot->name, AT_REMOVEDIR);
+        cgroup_pool_failures++;
+        return false;
+    }
+
+    cgroup_pool_ready++;
+    cgroup_pool_created++;
+    return true;
+}
+
+/**
+ * nk_cgroup_pool_print_stats - Print cgroup pool counters
+ */
+void nk_cgroup_pool_print_stats(void) {
+    uint64_t claims = cgroup_pool_hits + cgroup_pool_misses;
+
+    printf("cgroup-pool target=%zu ready=%zu hits=%llu misses=%llu hit-rate=%llu%% "
+           "created=%llu failed=%llu\n",
+           cgroup_pool_target, cgroup_pool_ready,
+           (unsigned long long)cgroup_pool_hits,
+           (unsigned long long)cgroup_pool_misses,
+           (unsigned long long)(claims ? cgroup_pool_hits * 100 / claims : 0),
+           (unsigned long long)cgroup_pool_created,
+           (unsigned long long)cgroup_pool_failures);
+}
+
+/**
+ * nk_cgroup_pool_drain - Remove every unclaimed pool slot
+ */
+void nk_cgroup_pool_drain(void) {
+    while (cgroup_pool_ready > 0) {
+        cgroup_slot_t *slot = &cgroup_pool[--cgroup_pool_ready];
+        close(slot->fd);
+        if (cgroup_parent_fd != -1) {
+            unlinkat(cgroup_parent_fd, slot->name, AT_REMOVEDIR);
+        }
+    }
+}
+
+/**
+ * nk_cgroup_attach_fd - Move a process into the cgroup behind a directory fd
+ */
+int nk_cgroup_attach_fd(int cgroup_fd, pid_t pid) {
+    char pid_str[32];
+    int len;
+
+    if (cgroup_fd < 0 || pid <= 0) {
+        return -1;
+    }
+
+    int fd = openat(cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        nk_stderr( "Error: Failed to open cgroup.procs: %s\n", strerror(errno));
+        return -1;
+    }
+
+    len = snprintf(pid_str, sizeof(pid_str), "%d", (int)pid);
+    if (write(fd, pid_str, (size_t)len) == -1) {
+        nk_stderr( "Error: Failed to add process to cgroup: %s\n", strerror(errno));
         close(fd);
         return -1;
     }
 
     close(fd);
-    nk_log_info("Set CPU weight: %lu", shares);
     return 0;
 }
 
 /**
- * nk_cgroup_set_pids_limit - Set max processes for container
+ * nk_cgroup_write - Write one knob of the cgroup behind @cgroup_fd
  */
-static int nk_cgroup_set_pids_limit(const char *container_id, uint64_t limit) {
-    if (limit == 0) {
-        return 0;  /* No limit */
+int nk_cgroup_write(int cgroup_fd, const char *knob, const char *value) {
+    size_t len = strlen(value);
+    int fd = openat(cgroup_fd, knob, O_WRONLY | O_CLOEXEC);
+
+    if (fd == -1 || write(fd, value, len) != (ssize_t)len) {
+        nk_stderr( "Error: Failed to set %s to \"%s\": %s\n", knob, value, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
     }
 
-    char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s/nano-sandbox/%s/pids.max",
-             CGROUP_ROOT, container_id);
+    close(fd);
+    nk_log_info("Set %s: %s", knob, value);
+    return 0;
+}
 
-    int fd = open(path, O_WRONLY);
-    if (fd == -1) {
-        nk_stderr( "Error: Failed to open %s: %s\n",
-                path, strerror(errno));
+/* "max" for -1 (unlimited), the value otherwise */
+static void nk_cgroup_limit_str(char *buf, size_t len, int64_t value) {
+    if (value < 0) {
+        snprintf(buf, len, "max");
+    } else {
+        snprintf(buf, len, "%lld", (long long)value);
+    }
+}
+
+/**
+ * nk_cgroup_swap_max - memory.swap.max for an OCI memory+swap limit
+ *
+ * cgroup v2 limits swap on its own, so the memory limit is subtracted.
+ * Same rules as runc: -1 means unlimited, and unlimited memory with no
+ * swap setting makes swap unlimited too.
+ */
+static int nk_cgroup_swap_max(const nk_cgroup_config_t *cfg, int64_t *swap_max) {
+    if (cfg->memory_limit == -1 && cfg->memory_swap == 0) {
+        *swap_max = -1;
+        return 0;
+    }
+    if (cfg->memory_swap == -1 || cfg->memory_swap == 0) {
+        *swap_max = cfg->memory_swap;
+        return 0;
+    }
+    if (cfg->memory_limit <= 0) {
+        nk_stderr( "Error: memory.swap is set without a memory.limit\n");
+        return -1;
+    }
+    if (cfg->memory_swap < cfg->memory_limit) {
+        nk_stderr( "Error: memory.swap (%lld) is below memory.limit (%lld)\n",
+                (long long)cfg->memory_swap, (long long)cfg->memory_limit);
         return -1;
     }
+    *swap_max = cfg->memory_swap - cfg->memory_limit;
+    return 0;
+}
 
-    char limit_str[64];
-    snprintf(limit_str, sizeof(limit_str), "%lu", limit);
+/* blkio weight 10..1000 onto io.weight 1..10000, as runc and crun map it */
+static uint64_t nk_cgroup_io_weight(uint64_t weight) {
+    weight = weight < 10 ? 10 : weight > 1000 ? 1000 : weight;
+    return 1 + ((weight - 10) * 9999) / 990;
+}
 
-    if (write(fd, limit_str, strlen(limit_str)) == -1) {
-        nk_stderr( "Warning: Failed to set PIDs limit: %s\n",
-                strerror(errno));
-        close(fd);
+/**
+ * nk_cgroup_apply_io - Write io.weight, io.max and io.latency
+ *
+ * Each file takes one "major:minor key=value" line per write.
+ */
+static int nk_cgroup_apply_io(int cgroup_fd, const nk_cgroup_config_t *cfg) {
+    char value[192];
+    int failed = 0;
+
+    if (cfg->io_weight != 0) {
+        snprintf(value, sizeof(value), "default %llu",
+                 (unsigned long long)nk_cgroup_io_weight(cfg->io_weight));
+        failed += nk_cgroup_write(cgroup_fd, "io.weight", value) == -1;
+    }
+
+    for (size_t i = 0; i < cfg->io_devices_len; i++) {
+        const nk_cgroup_io_device_t *dev = &cfg->io_devices[i];
+        const struct {
+            const char *key;
+            int64_t limit;
+        } max[] = {
+            { "rbps", dev->rbps }, { "wbps", dev->wbps },
+            { "riops", dev->riops }, { "wiops", dev->wiops },
+        };
+        int n = snprintf(value, sizeof(value), "%u:%u", dev->major, dev->minor);
+        size_t len = (size_t)n;
+
+        if (dev->weight != 0) {
+            snprintf(value + n, sizeof(value) - len, " %llu",
+                     (unsigned long long)nk_cgroup_io_weight(dev->weight));
+            failed += nk_cgroup_write(cgroup_fd, "io.weight", value) == -1;
+        }
+
+        for (size_t k = 0; k < sizeof(max) / sizeof(max[0]); k++) {
+            if (max[k].limit == 0) {
+                continue;
+            }
+            len += (size_t)snprintf(value + len, sizeof(value) - len, " %s=", max[k].key);
+            nk_cgroup_limit_str(value + len, sizeof(value) - len, max[k].limit);
+            len += strlen(value + len);
+        }
+        if (len > (size_t)n) {
+            failed += nk_cgroup_write(cgroup_fd, "io.max", value) == -1;
+        }
+
+        if (dev->latency_us != 0) {
+            snprintf(value + n, sizeof(value) - (size_t)n, " target=%llu",
+                     (unsigned long long)dev->latency_us);
+            failed += nk_cgroup_write(cgroup_fd, "io.latency", value) == -1;
+        }
+    }
+
+    return failed ? -1 : 0;
+}
+
+/**
+ * nk_cgroup_apply - Write every set limit through the cgroup dirfd
+ */
+int nk_cgroup_apply(int cgroup_fd, const nk_cgroup_config_t *cfg) {
+    char value[64];
+    int64_t swap_max = 0;
+    int failed = 0;
+
+    if (cgroup_fd < 0 || !cfg) {
         return -1;
     }
 
-    close(fd);
-    nk_log_info("Set PIDs limit: %lu", limit);
-    return 0;
+    if (cfg->memory_limit != 0) {
+        nk_cgroup_limit_str(value, sizeof(value), cfg->memory_limit);
+        failed += nk_cgroup_write(cgroup_fd, "memory.max", value) == -1;
+    }
+    if (cfg->memory_reservation != 0) {
+        nk_cgroup_limit_str(value, sizeof(value), cfg->memory_reservation);
+        failed += nk_cgroup_write(cgroup_fd, "memory.low", value) == -1;
+    }
+    if (nk_cgroup_swap_max(cfg, &swap_max) == -1) {
+        failed++;
+    } else if (swap_max != 0 || cfg->memory_swap > 0) {
+        /* swap == limit asks for no swap at all, which is memory.swap.max=0 */
+        nk_cgroup_limit_str(value, sizeof(value), swap_max);
+        failed += nk_cgroup_write(cgroup_fd, "memory.swap.max", value) == -1;
+    }
+
+    if (cfg->cpu_idle_set && (cfg->cpu_idle < 0 || cfg->cpu_idle > 1)) {
+        nk_stderr( "Error: cpu.idle must be 0 or 1, not %lld\n", (long long)cfg->cpu_idle);
+        failed++;
+    } else if (cfg->cpu_idle_set && cfg->cpu_idle == 0) {
+        /* An idle group rejects cpu.weight */
+        failed += nk_cgroup_write(cgroup_fd, "cpu.idle", "0") == -1;
+    }
+    if (cfg->cpu_shares != 0) {
+        /* shares 2..262144 onto weight 1..10000, as runc and crun map them */
+        uint64_t shares = cfg->cpu_shares < 2 ? 2 : cfg->cpu_shares > 262144 ? 262144 : cfg->cpu_shares;
+        snprintf(value, sizeof(value), "%llu",
+                 (unsigned long long)(1 + ((shares - 2) * 9999) / 262142));
+        failed += nk_cgroup_write(cgroup_fd, "cpu.weight", value) == -1;
+    }
+    if (cfg->cpu_burst_set && (cfg->cpu_quota != 0 || cfg->cpu_period != 0)) {
+        /* cpu.max is checked against the current burst, which may exceed the new quota */
+        failed += nk_cgroup_write(cgroup_fd, "cpu.max.burst", "0") == -1;
+    }
+    if (cfg->cpu_quota != 0 || cfg->cpu_period != 0) {
+        /* "$QUOTA $PERIOD"; without a period the kernel keeps its current one */
+        char current[64] = "max";
+        if (cfg->cpu_quota == 0 && nk_cgroup_read(cgroup_fd, "cpu.max", current, sizeof(current))) {
+            current[strcspn(current, " \n")] = '\0';
+        }
+        int n = cfg->cpu_quota > 0 ? snprintf(value, sizeof(value), "%lld", (long long)cfg->cpu_quota)
+                                   : snprintf(value, sizeof(value), "%s",
+                                              cfg->cpu_quota == 0 ? current : "max");
+        if (cfg->cpu_period != 0) {
+            snprintf(value + n, sizeof(value) - (size_t)n, " %llu",
+                     (unsigned long long)cfg->cpu_period);
+        }
+        failed += nk_cgroup_write(cgroup_fd, "cpu.max", value) == -1;
+    }
+    if (cfg->cpu_burst > 0) {
+        snprintf(value, sizeof(value), "%lld", (long long)cfg->cpu_burst);
+        failed += nk_cgroup_write(cgroup_fd, "cpu.max.burst", value) == -1;
+    } else if (cfg->cpu_burst_set && cfg->cpu_quota == 0 && cfg->cpu_period == 0) {
+        failed += nk_cgroup_write(cgroup_fd, "cpu.max.burst", "0") == -1;
+    }
+    if (cfg->cpu_idle_set && cfg->cpu_idle == 1) {
+        failed += nk_cgroup_write(cgroup_fd, "cpu.idle", "1") == -1;
+    }
+
+    if (cfg->pids_limit != 0) {
+        nk_cgroup_limit_str(value, sizeof(value), cfg->pids_limit);
+        failed += nk_cgroup_write(cgroup_fd, "pids.max", value) == -1;
+    }
+
+    failed += nk_cgroup_apply_io(cgroup_fd, cfg) == -1;
+
+    return failed ? -1 : 0;
 }
 
 /**
@@ -172,8 +634,11 @@ static int nk_cgroup_set_pids_limit(const char *container_id, uint64_t limit) {
  */
 static int nk_cgroup_add_process(const char *container_id, pid_t pid) {
     char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s/nano-sandbox/%s/cgroup.procs",
-             CGROUP_ROOT, container_id);
+    if (nk_cgroup_path(container_id, path, sizeof(path)) == -1 ||
+        strlen(path) + sizeof("/cgroup.procs") > sizeof(path)) {
+        return -1;
+    }
+    strcat(path, "/cgroup.procs");
 
     int fd = open(path, O_WRONLY);
     if (fd == -1) {
@@ -196,35 +661,206 @@ static int nk_cgroup_add_process(const char *container_id, pid_t pid) {
     return 0;
 }
 
+/**
+ * nk_cgroup_has_pid - Check /proc/<pid>/cgroup against the container cgroup
+ */
+int nk_cgroup_has_pid(const char *container_id, pid_t pid) {
+    char path[PATH_MAX];
+    char line[PATH_MAX + 8];
+    char want[PATH_MAX];
+    size_t want_len;
+    int ret = 0;
+
+    if (nk_cgroup_path(container_id, path, sizeof(path)) == -1 || access(path, F_OK) == -1) {
+        return -1;  /* no cgroup to check against */
+    }
+
+    /* /proc/<pid>/cgroup paths are relative to the cgroup2 mount */
+    snprintf(want, sizeof(want), "%s", path + strlen(CGROUP_ROOT));
+    want_len = strlen(want);
+
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", (int)pid);
+    FILE *f = fopen(path, "re");
+    if (!f) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "0::", 3) != 0) {
+            continue;
+        }
+        const char *cg = line + 3;
+        /* The container itself may have moved into a nested cgroup */
+        ret = strncmp(cg, want, want_len) == 0 &&
+              (cg[want_len] == '\n' || cg[want_len] == '/' || cg[want_len] == '\0');
+        break;
+    }
+    fclose(f);
+    return ret;
+}
+
+/**
+ * nk_cgroup_oom_kills - oom_kill count from the container's memory.events
+ */
+long long nk_cgroup_oom_kills(const char *container_id) {
+    char path[PATH_MAX];
+    char line[64];
+    long long count = -1;
+
+    if (nk_cgroup_path(container_id, path, sizeof(path)) == -1 ||
+        strlen(path) + sizeof("/memory.events") > sizeof(path)) {
+        return -1;
+    }
+    strcat(path, "/memory.events");
+
+    FILE *f = fopen(path, "re");
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "oom_kill %lld", &count) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+/* Signal every process listed in cgroup.procs (cgroup.kill fallback) */
+static int nk_cgroup_signal_procs(int cgroup_fd, int sig) {
+    char buf[64];
+    int fd = openat(cgroup_fd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+    FILE *f;
+
+    if (fd == -1 || !(f = fdopen(fd, "r"))) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), f)) {
+        pid_t pid = (pid_t)strtol(buf, NULL, 10);
+        if (pid > 0 && kill(pid, sig) == -1 && errno != ESRCH) {
+            nk_log_debug("Signal %d to PID %d: %s", sig, (int)pid, strerror(errno));
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * nk_cgroup_kill - Signal every process in the container cgroup
+ *
+ * SIGKILL goes through cgroup.kill (Linux 5.14+), which the kernel applies
+ * to the whole subtree atomically, so nothing can fork out of the sweep.
+ * Other signals, and older kernels, walk cgroup.procs.
+ */
+int nk_cgroup_kill(const char *container_id, int sig) {
+    char path[PATH_MAX];
+    int ret = 0;
+
+    if (!container_id || nk_cgroup_path(container_id, path, sizeof(path)) == -1) {
+        return -1;
+    }
+    int dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir == -1) {
+        return -1;
+    }
+
+    if (sig == SIGKILL) {
+        int fd = openat(dir, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+        if (fd != -1) {
+            ret = write(fd, "1", 1) == 1 ? 0 : -1;
+            close(fd);
+            if (ret == 0) {
+                nk_log_info("Killed cgroup %s via cgroup.kill", path);
+                close(dir);
+                return 0;
+            }
+        }
+        nk_log_debug("cgroup.kill unavailable for %s: %s", path, strerror(errno));
+    }
+
+    ret = nk_cgroup_signal_procs(dir, sig);
+    close(dir);
+    return ret;
+}
+
+/**
+ * nk_cgroup_reap_async - rmdir a cgroup once its last process has left
+ *
+ * A just-killed init takes a moment to leave its cgroup. A detached
+ * grandchild waits for "populated 0" in cgroup.events (the kernel wakes
+ * pollers on every change) so delete does not block on it.
+ */
+static void nk_cgroup_reap_async(const char *cgroup_path) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        nk_stderr( "Warning: Failed to remove cgroup %s: %s\n", cgroup_path, strerror(EBUSY));
+        return;
+    }
+    if (pid > 0) {
+        (void)waitpid(pid, NULL, 0);
+        return;
+    }
+    if (fork() != 0) {
+        _exit(0);
+    }
+
+    /* Do not pin the caller's sockets, pipes or pool slots */
+    (void)syscall(SYS_close_range, 3U, ~0U, 0U);
+
+    char events[PATH_MAX];
+    char buf[256];
+    struct timespec start, now;
+    snprintf(events, sizeof(events), "%s/cgroup.events", cgroup_path);
+    int fd = open(events, O_RDONLY | O_CLOEXEC);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (fd != -1) {
+        ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0) {
+            break;
+        }
+        buf[n] = '\0';
+        if (strstr(buf, "populated 0")) {
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long waited = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+        if (waited >= CGROUP_REAP_TIMEOUT_MS ||
+            poll(&pfd, 1, (int)(CGROUP_REAP_TIMEOUT_MS - waited)) <= 0) {
+            break;
+        }
+    }
+    _exit(rmdir(cgroup_path) == 0 ? 0 : 1);
+}
+
 /**
  * nk_cgroup_delete - Delete container cgroup
  */
 static int nk_cgroup_delete(const char *container_id) {
     char cgroup_path[PATH_MAX];
-    int len = snprintf(cgroup_path, sizeof(cgroup_path), "%s/nano-sandbox",
-                       CGROUP_ROOT);
-    if (len > 0 && len < (int)sizeof(cgroup_path)) {
-        snprintf(cgroup_path + len, sizeof(cgroup_path) - len, "/%s", container_id);
+    if (nk_cgroup_path(container_id, cgroup_path, sizeof(cgroup_path)) == -1) {
+        return -1;
     }
 
-    /* Remove all processes from cgroup first */
-    char procs_path[PATH_MAX];
-    len = snprintf(procs_path, sizeof(procs_path), "%s/cgroup.procs", cgroup_path);
-    (void)len;  /* Mark as intentionally unused */
-
-    int fd = open(procs_path, O_WRONLY);
-    if (fd != -1) {
-        /* Move processes to parent cgroup */
-        write(fd, "0", 1);
-        close(fd);
+    if (rmdir(cgroup_path) == -1) {
+        if (errno == EBUSY) {
+            nk_cgroup_reap_async(cgroup_path);
+        } else if (errno != ENOENT) {
+            nk_stderr( "Warning: Failed to remove cgroup %s: %s\n",
+                    cgroup_path, strerror(errno));
+        }
     }
 
-    /* Remove cgroup directory */
-    if (rmdir(cgroup_path) == -1 && errno != ENOENT) {
-        nk_stderr( "Warning: Failed to remove cgroup %s: %s\n",
-                cgroup_path, strerror(errno));
+    char *slot_file = nk_state_file_path(container_id, CGROUP_SLOT_FILE);
+    if (slot_file) {
+        unlink(slot_file);
+        free(slot_file);
     }
-
     return 0;
 }
 
@@ -246,24 +882,15 @@ int nk_container_setup_cgroups(const nk_container_ctx_t *ctx,
     nk_log_info("Setting up cgroups");
 
     /* Create cgroup */
-    if (nk_cgroup_create(container_id) == -1) {
+    int fd = nk_cgroup_open(container_id);
+    if (fd == -1) {
         return -1;
     }
 
     /* Set resource limits */
-    if (ctx->cgroup->memory_limit > 0) {
-        nk_cgroup_set_memory_limit(container_id, ctx->cgroup->memory_limit);
-    }
-
-    if (ctx->cgroup->cpu_shares > 0) {
-        nk_cgroup_set_cpu_shares(container_id, ctx->cgroup->cpu_shares);
-    }
-
-    if (ctx->cgroup->pids_limit > 0) {
-        nk_cgroup_set_pids_limit(container_id, ctx->cgroup->pids_limit);
-    }
-
-    return 0;
+    int ret = nk_cgroup_apply(fd, ctx->cgroup);
+    close(fd);
+    return ret;
 }
 
 /**
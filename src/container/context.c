@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "nk_container.h"
+#include "nk_placement.h"
+#include "nk_log.h"
+
+/**
+ * ctx_io_device - Find or add the io settings of block device @major:@minor
+ */
+static nk_cgroup_io_device_t *ctx_io_device(nk_cgroup_config_t *cg, int64_t major, int64_t minor) {
+    if (major < 0 || minor < 0 || major > UINT32_MAX || minor > UINT32_MAX) {
+        nk_stderr("Error: invalid block device %lld:%lld\n", (long long)major, (long long)minor);
+        return NULL;
+    }
+    for (size_t i = 0; i < cg->io_devices_len; i++) {
+        if (cg->io_devices[i].major == major && cg->io_devices[i].minor == minor) {
+            return &cg->io_devices[i];
+        }
+    }
+
+    nk_cgroup_io_device_t *devices = realloc(cg->io_devices,
+                                             (cg->io_devices_len + 1) * sizeof(*devices));
+    if (!devices) {
+        nk_log_error("Failed to allocate io device config");
+        return NULL;
+    }
+    cg->io_devices = devices;
+    memset(&devices[cg->io_devices_len], 0, sizeof(*devices));
+    devices[cg->io_devices_len].major = (uint32_t)major;
+    devices[cg->io_devices_len].minor = (uint32_t)minor;
+    return &devices[cg->io_devices_len++];
+}
+
+/**
+ * ctx_blkio - Merge the blockIO device lists into one entry per device
+ *
+ * A throttle rate of 0 removes the limit, as it does in cgroup v1.
+ */
+static int ctx_blkio(nk_cgroup_config_t *cg, const nk_oci_resources_t *res) {
+    cg->io_weight = res->blkio.weight;
+
+    for (int l = 0; l < NK_OCI_BLKIO_LISTS; l++) {
+        for (size_t i = 0; i < res->blkio.devices_len[l]; i++) {
+            const nk_oci_blkio_device_t *d = &res->blkio.devices[l][i];
+            nk_cgroup_io_device_t *dev = ctx_io_device(cg, d->major, d->minor);
+            int64_t rate = d->value > 0 ? d->value : -1;
+
+            if (!dev) {
+                return -1;
+            }
+            switch ((nk_oci_blkio_list_t)l) {
+            case NK_OCI_BLKIO_WEIGHT_DEVICE:
+                dev->weight = d->value > 0 ? (uint64_t)d->value : 0;
+                break;
+            case NK_OCI_BLKIO_READ_BPS:
+                dev->rbps = rate;
+                break;
+            case NK_OCI_BLKIO_WRITE_BPS:
+                dev->wbps = rate;
+                break;
+            case NK_OCI_BLKIO_READ_IOPS:
+                dev->riops = rate;
+                break;
+            case NK_OCI_BLKIO_WRITE_IOPS:
+                dev->wiops = rate;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    /* cgroup v2 has no knob for this */
+    if (res->blkio.leaf_weight != 0) {
+        nk_stderr("Warning: linux.resources.blockIO.leafWeight is not supported on cgroup v2, ignored\n");
+    }
+    return 0;
+}
+
+/**
+ * ctx_io_latency - Parse the io.latency annotation into per-device targets
+ *
+ * A device is "major:minor" or the path of a block device node, which is
+ * resolved to its major:minor with stat().
+ */
+static int ctx_io_latency(nk_cgroup_config_t *cg, const char *value) {
+    char *copy = strdup(value);
+    char *save = NULL;
+    int ret = 0;
+
+    if (!copy) {
+        nk_log_error("Failed to allocate %s annotation", NK_IO_LATENCY_ANNOTATION);
+        return -1;
+    }
+
+    for (char *entry = strtok_r(copy, ",", &save); entry && ret == 0;
+         entry = strtok_r(NULL, ",", &save)) {
+        char *target = strrchr(entry, '=');
+        unsigned major = 0, minor = 0;
+        unsigned long long us = 0;
+        char *end = NULL;
+        int used = 0;
+
+        if (target) {
+            *target++ = '\0';
+            errno = 0;
+            us = strtoull(target, &end, 10);
+        }
+        if (!target || !end || *end != '\0' || target[0] == '-' || us == 0 || errno) {
+            nk_stderr("Error: invalid %s annotation entry '%s' (<major:minor|/dev/path>=<us>)\n",
+                      NK_IO_LATENCY_ANNOTATION, entry);
+            ret = -1;
+            break;
+        }
+
+        if (entry[0] == '/') {
+            struct stat st;
+
+            if (stat(entry, &st) == -1 || !S_ISBLK(st.st_mode)) {
+                nk_stderr("Error: %s: %s is not a block device\n", NK_IO_LATENCY_ANNOTATION, entry);
+                ret = -1;
+                break;
+            }
+            major = major(st.st_rdev);
+            minor = minor(st.st_rdev);
+        } else if (sscanf(entry, "%u:%u%n", &major, &minor, &used) != 2 ||
+                   entry[used] != '\0' || entry[0] == '-') {
+            nk_stderr("Error: invalid %s annotation entry '%s' (<major:minor|/dev/path>=<us>)\n",
+                      NK_IO_LATENCY_ANNOTATION, entry);
+            ret = -1;
+            break;
+        }
+
+        nk_cgroup_io_device_t *dev = ctx_io_device(cg, major, minor);
+        if (!dev) {
+            ret = -1;
+        } else {
+            dev->latency_us = us;
+        }
+    }
+
+    free(copy);
+    return ret;
+}
+
+/**
+ * nk_container_ctx_init - Build container execution context from OCI spec
+ */
+int nk_container_ctx_init(nk_container_ctx_t *ctx, const char *bundle_path,
+                          const nk_oci_spec_t *spec) {
+    if (!ctx || !bundle_path || !spec || !spec->process || !spec->root) {
+        nk_log_error("Invalid OCI spec - missing process or root");
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->cgroup_fd = -1;
+
+    if (asprintf(&ctx->rootfs, "%s/%s", bundle_path, spec->root->path) == -1) {
+        ctx->rootfs = NULL;
+        nk_log_error("Failed to allocate rootfs path");
+        return -1;
+    }
+    ctx->rootfs_readonly = spec->root->readonly;
+    nk_log_debug("Root filesystem: %s%s", ctx->rootfs, ctx->rootfs_readonly ? " (read-only)" : "");
+
+    if (spec->linux_config && spec->linux_config->namespaces) {
+        size_t ns_count = spec->linux_config->namespaces_len;
+        ctx->namespaces = calloc(ns_count, sizeof(nk_namespace_config_t));
+        if (ctx->namespaces) {
+            for (size_t i = 0; i < ns_count; i++) {
+                const char *type = spec->linux_config->namespaces[i].type;
+                if (strcmp(type, "pid") == 0) ctx->namespaces[i].type = NK_NS_PID;
+                else if (strcmp(type, "network") == 0) ctx->namespaces[i].type = NK_NS_NETWORK;
+                else if (strcmp(type, "ipc") == 0) ctx->namespaces[i].type = NK_NS_IPC;
+                else if (strcmp(type, "uts") == 0) ctx->namespaces[i].type = NK_NS_UTS;
+                else if (strcmp(type, "mount") == 0) ctx->namespaces[i].type = NK_NS_MOUNT;
+                else if (strcmp(type, "user") == 0) ctx->namespaces[i].type = NK_NS_USER;
+                else if (strcmp(type, "cgroup") == 0) ctx->namespaces[i].type = NK_NS_CGROUP;
+
+                ctx->namespaces[i].path = spec->linux_config->namespaces[i].path;
+                ctx->namespaces[i].enable = true;
+                nk_log_debug("Namespace[%zu]: %s", i, type);
+            }
+            ctx->namespaces_len = ns_count;
+            nk_log_info("Parsed %zu namespaces", ns_count);
+        }
+    }
+
+    if (spec->linux_config && spec->linux_config->resources) {
+        const nk_oci_resources_t *res = spec->linux_config->resources;
+
+        ctx->cgroup = calloc(1, sizeof(*ctx->cgroup));
+        if (!ctx->cgroup) {
+            nk_container_ctx_release(ctx);
+            nk_log_error("Failed to allocate cgroup config");
+            return -1;
+        }
+        ctx->cgroup->memory_limit = res->memory.limit;
+        ctx->cgroup->memory_reservation = res->memory.reservation;
+        ctx->cgroup->memory_swap = res->memory.swap;
+        ctx->cgroup->cpu_shares = res->cpu.shares;
+        ctx->cgroup->cpu_quota = res->cpu.quota;
+        ctx->cgroup->cpu_period = res->cpu.period;
+        ctx->cgroup->cpu_burst = (int64_t)res->cpu.burst;
+        ctx->cgroup->cpu_idle = res->cpu.idle;
+        ctx->cgroup->cpu_burst_set = res->cpu.burst != 0;
+        ctx->cgroup->cpu_idle_set = res->cpu.idle != 0;
+        ctx->cgroup->pids_limit = res->pids_limit;
+        if (ctx_blkio(ctx->cgroup, res) == -1) {
+            nk_container_ctx_release(ctx);
+            return -1;
+        }
+
+        /* cgroup v2 has no knob for these */
+        if (res->memory.kernel != 0) {
+            nk_stderr( "Warning: linux.resources.memory.kernel is not supported on cgroup v2, ignored\n");
+        }
+        if (res->cpu.realtime_runtime != 0 || res->cpu.realtime_period != 0) {
+            nk_stderr( "Warning: linux.resources.cpu realtime limits are not supported on cgroup v2, ignored\n");
+        }
+    }
+
+    const char *latency = nk_oci_spec_get_annotation(spec, NK_IO_LATENCY_ANNOTATION);
+    if (latency) {
+        if (!ctx->cgroup && !(ctx->cgroup = calloc(1, sizeof(*ctx->cgroup)))) {
+            nk_container_ctx_release(ctx);
+            nk_log_error("Failed to allocate cgroup config");
+            return -1;
+        }
+        if (ctx_io_latency(ctx->cgroup, latency) == -1) {
+            nk_container_ctx_release(ctx);
+            return -1;
+        }
+    }
+
+    const char *cpuset = nk_oci_spec_get_annotation(spec, NK_CPUSET_ANNOTATION);
+    if (cpuset && nk_cpuset_policy_parse(cpuset, &ctx->cpuset_policy) == -1) {
+        nk_stderr("Error: invalid %s annotation '%s' (none, packed, spread or exclusive)\n",
+                  NK_CPUSET_ANNOTATION, cpuset);
+        nk_container_ctx_release(ctx);
+        return -1;
+    }
+    const char *cpus = nk_oci_spec_get_annotation(spec, NK_CPUSET_CPUS_ANNOTATION);
+    if (cpus) {
+        char *end = NULL;
+        unsigned long n = strtoul(cpus, &end, 10);
+
+        if (!end || *end != '\0' || cpus[0] == '-' || n == 0 || n > CPU_SETSIZE) {
+            nk_stderr("Error: invalid %s annotation '%s' (1-%d)\n",
+                      NK_CPUSET_CPUS_ANNOTATION, cpus, CPU_SETSIZE);
+            nk_container_ctx_release(ctx);
+            return -1;
+        }
+        ctx->cpuset_cpus = (unsigned)n;
+    }
+
+    ctx->args = spec->process->args;
+    ctx->args_len = spec->process->args_len;
+    ctx->env = spec->process->env;
+    ctx->env_len = spec->process->env_len;
+    ctx->cwd = spec->process->cwd ? spec->process->cwd : "/";
+    ctx->terminal = spec->process->terminal;
+    ctx->mounts = NULL;
+    ctx->mounts_len = 0;
+
+    return 0;
+}
+
+/**
+ * nk_container_ctx_release - Free memory owned by an execution context
+ */
+void nk_container_ctx_release(nk_container_ctx_t *ctx) {
+    if (!ctx) {
+        return;
+    }
+
+    if (ctx->cgroup_fd >= 0) {
+        close(ctx->cgroup_fd);
+        ctx->cgroup_fd = -1;
+    }
+    free(ctx->rootfs);
+    free(ctx->overlay_dir);
+    free(ctx->namespaces);
+    if (ctx->cgroup) {
+        free(ctx->cgroup->io_devices);
+    }
+    free(ctx->cgroup);
+    ctx->rootfs = NULL;
+    ctx->cgroup = NULL;
+    ctx->overlay_dir = NULL;
+    ctx->namespaces = NULL;
+    ctx->namespaces_len = 0;
+}
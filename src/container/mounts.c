@@ -9,15 +9,74 @@
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <limits.h>
+#include <stdint.h>
+#include <ftw.h>
 #include <sys/syscall.h>
 
 #include "nk_container.h"
 #include "nk_log.h"
+#include "common/state.h"
 
 #ifndef __NR_pivot_root
 #define __NR_pivot_root 155
 #endif
 
+/* New mount API (Linux 5.2+); older libcs lack the numbers and flags */
+#ifndef SYS_open_tree
+#define SYS_open_tree 428
+#endif
+#ifndef SYS_move_mount
+#define SYS_move_mount 429
+#endif
+#ifndef SYS_fsopen
+#define SYS_fsopen 430
+#endif
+#ifndef SYS_fsconfig
+#define SYS_fsconfig 431
+#endif
+#ifndef SYS_fsmount
+#define SYS_fsmount 432
+#endif
+#ifndef SYS_fspick
+#define SYS_fspick 433
+#endif
+#ifndef OPEN_TREE_CLONE
+#define OPEN_TREE_CLONE 1
+#endif
+#ifndef OPEN_TREE_CLOEXEC
+#define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif
+#ifndef FSOPEN_CLOEXEC
+#define FSOPEN_CLOEXEC 0x00000001
+#endif
+#ifndef FSPICK_CLOEXEC
+#define FSPICK_CLOEXEC 0x00000001
+#endif
+#ifndef FSPICK_EMPTY_PATH
+#define FSPICK_EMPTY_PATH 0x00000008
+#endif
+#ifndef FSMOUNT_CLOEXEC
+#define FSMOUNT_CLOEXEC 0x00000001
+#endif
+#ifndef MOUNT_ATTR_NOSUID
+#define MOUNT_ATTR_NOSUID 0x00000002
+#endif
+#ifndef FSCONFIG_SET_FLAG
+#define FSCONFIG_SET_FLAG 0
+#endif
+#ifndef FSCONFIG_SET_STRING
+#define FSCONFIG_SET_STRING 1
+#endif
+#ifndef FSCONFIG_CMD_CREATE
+#define FSCONFIG_CMD_CREATE 6
+#endif
+#ifndef FSCONFIG_CMD_RECONFIGURE
+#define FSCONFIG_CMD_RECONFIGURE 7
+#endif
+
 /* Default mounts for container */
 static const struct {
     const char *source;
@@ -25,17 +84,22 @@ static const struct {
     const char *type;
     unsigned long flags;
     const char *options;
+    bool templated;          /* Comes from the /dev template when one is attached */
 } default_mounts[] = {
-    { "proc",     "/proc",     "proc",     0,                                NULL },
-    { "sysfs",    "/sys",      "sysfs",    0,                                NULL },
-    { "tmpfs",    "/dev",      "tmpfs",    MS_NOSUID | MS_STRICTATIME,       "mode=755" },
-    { "devpts",   "/dev/pts",  "devpts",   MS_NOSUID | MS_NOEXEC,            NULL },
-    { "tmpfs",    "/dev/shm",  "tmpfs",    MS_NOSUID | MS_NODEV,             NULL },
-    { "tmpfs",    "/dev/mqueue", "tmpfs",  MS_NOSUID | MS_NODEV,             NULL },
+    { "proc",     "/proc",     "proc",     0,                                NULL,       false },
+    { "sysfs",    "/sys",      "sysfs",    0,                                NULL,       false },
+    { "tmpfs",    "/dev",      "tmpfs",    MS_NOSUID | MS_STRICTATIME,       "mode=755", true  },
+    { "devpts",   "/dev/pts",  "devpts",   MS_NOSUID | MS_NOEXEC,            NULL,       false },
+    { "tmpfs",    "/dev/shm",  "tmpfs",    MS_NOSUID | MS_NODEV,             NULL,       false },
+    { "tmpfs",    "/dev/mqueue", "tmpfs",  MS_NOSUID | MS_NODEV,             NULL,       false },
 };
 
 #define DEFAULT_MOUNTS_COUNT (sizeof(default_mounts) / sizeof(default_mounts[0]))
 
+#define NS_ROOTFS_MODE_ENV "NS_ROOTFS_MODE"
+#define NS_MOUNT_TEMPLATE_BYPASS_ENV "NS_NO_MOUNT_TEMPLATE"
+#define ROOTFS_OVERLAY_DIR "rootfs"
+
 /**
  * nk_mount_make_private - Make mount private
  */
@@ -86,103 +150,265 @@ static int nk_mount_bind(const char *source, const char *target, unsigned long f
     return 0;
 }
 
+/* Device nodes and links created in every container's /dev */
+static const struct {
+    const char *name;
+    mode_t mode;
+    unsigned int major;
+    unsigned int minor;
+} dev_nodes[] = {
+    { "null",    0666, 1, 3 },
+    { "zero",    0666, 1, 5 },
+    { "full",    0666, 1, 7 },
+    { "random",  0666, 1, 8 },
+    { "urandom", 0666, 1, 9 },
+    { "tty",     0666, 5, 0 },
+};
+
+static const struct {
+    const char *name;
+    const char *target;
+} dev_links[] = {
+    { "fd",     "/proc/self/fd" },
+    { "stdin",  "/proc/self/fd/0" },
+    { "stdout", "/proc/self/fd/1" },
+    { "stderr", "/proc/self/fd/2" },
+};
+
+/* Mount points inside /dev (see default_mounts) */
+static const char *const dev_dirs[] = { "pts", "shm", "mqueue" };
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
 /**
- * nk_mount_create_device - Create a device node
+ * nk_mount_populate_dev - Create device nodes, symlinks and mount points in a /dev dir
  */
-static int nk_mount_create_device(const char *path, unsigned int mode, int major, int minor) {
-    dev_t dev = makedev(major, minor);
-    (void)dev;  /* Will be used when device creation is completed */
+static int nk_mount_populate_dev(int dev_fd) {
+    int ret = 0;
+
+    for (size_t i = 0; i < ARRAY_LEN(dev_nodes); i++) {
+        /* fchmodat: mknodat() applies the umask */
+        if (mknodat(dev_fd, dev_nodes[i].name, S_IFCHR | dev_nodes[i].mode,
+                    makedev(dev_nodes[i].major, dev_nodes[i].minor)) == -1 ||
+            fchmodat(dev_fd, dev_nodes[i].name, dev_nodes[i].mode, 0) == -1) {
+            nk_stderr( "Error: Failed to create device /dev/%s: %s\n",
+                    dev_nodes[i].name, strerror(errno));
+            ret = -1;
+        }
+    }
 
-    if (mknod(path, S_IFCHR | mode, 0600) == -1) {
-        nk_stderr( "Error: Failed to create device %s: %s\n",
-                path, strerror(errno));
-        return -1;
+    for (size_t i = 0; i < ARRAY_LEN(dev_links); i++) {
+        if (symlinkat(dev_links[i].target, dev_fd, dev_links[i].name) == -1 && errno != EEXIST) {
+            nk_stderr( "Warning: Failed to create symlink /dev/%s: %s\n",
+                    dev_links[i].name, strerror(errno));
+        }
     }
 
-    return 0;
+    for (size_t i = 0; i < ARRAY_LEN(dev_dirs); i++) {
+        if (mkdirat(dev_fd, dev_dirs[i], 0755) == -1 && errno != EEXIST) {
+            nk_stderr( "Error: Failed to create /dev/%s: %s\n", dev_dirs[i], strerror(errno));
+            ret = -1;
+        }
+    }
+
+    return ret;
 }
 
 /**
- * nk_mount_setup_slaves - Create /dev/slurm and /dev/null if needed
+ * nk_mount_setup_dev - Populate the rootfs /dev in place (no template)
+ * @root_fd: Rootfs directory, also the confined cwd
+ * @dev_mounted: /dev is the container's own tmpfs
+ *
+ * The tmpfs is then made read-only like a template clone, so /dev behaves
+ * the same with or without ns-runtimed.
  */
-static int nk_mount_setup_dev(const char *rootfs) {
-    char path[PATH_MAX];
+static int nk_mount_setup_dev(int root_fd, bool dev_mounted) {
+    int dev_fd;
+    int ret;
 
-    /* Create /dev/null */
-    snprintf(path, sizeof(path), "%s/dev/null", rootfs);
-    nk_mount_create_device(path, 0666, 1, 3);
-
-    /* Create /dev/zero */
-    snprintf(path, sizeof(path), "%s/dev/zero", rootfs);
-    nk_mount_create_device(path, 0666, 1, 5);
+    dev_fd = openat(root_fd, "dev", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dev_fd == -1) {
+        nk_stderr( "Error: Failed to open /dev in rootfs: %s\n", strerror(errno));
+        return -1;
+    }
+    ret = nk_mount_populate_dev(dev_fd);
+    close(dev_fd);
 
-    /* Create /dev/full */
-    snprintf(path, sizeof(path), "%s/dev/full", rootfs);
-    nk_mount_create_device(path, 0666, 1, 7);
+    if (dev_mounted && mount(NULL, "dev", NULL, MS_REMOUNT | MS_RDONLY | MS_NOSUID | MS_STRICTATIME,
+                             "mode=755") == -1) {
+        nk_log_warn("Failed to make /dev read-only: %s", strerror(errno));
+        ret = -1;
+    }
+    return ret;
+}
 
-    /* Create /dev/random */
-    snprintf(path, sizeof(path), "%s/dev/random", rootfs);
-    nk_mount_create_device(path, 0666, 1, 8);
+/*
+ * /dev template: one read-only tmpfs per runtime process, populated once.
+ * Each container child attaches its own clone of it, so the tmpfs mount,
+ * the mknods and the symlinks leave the per-start path.
+ */
+static int dev_template_fd = -1;
+static bool dev_template_tried;
 
-    /* Create /dev/urandom */
-    snprintf(path, sizeof(path), "%s/dev/urandom", rootfs);
-    nk_mount_create_device(path, 0666, 1, 9);
+/* NS_NO_MOUNT_TEMPLATE, read per start so ns-runtimed honours each client's */
+static bool mount_template_bypassed(void) {
+    const char *bypass = getenv(NS_MOUNT_TEMPLATE_BYPASS_ENV);
 
-    /* Create /dev/tty */
-    snprintf(path, sizeof(path), "%s/dev/tty", rootfs);
-    nk_mount_create_device(path, 0666, 5, 0);
+    return bypass && bypass[0] != '\0' && strcmp(bypass, "0") != 0;
+}
 
-    /* Create symlinks */
-    snprintf(path, sizeof(path), "%s/dev/fd", rootfs);
-    if (symlink("/proc/self/fd", path) == -1 && errno != EEXIST) {
-        nk_stderr( "Warning: Failed to create symlink %s: %s\n", path, strerror(errno));
+/**
+ * nk_mount_template_prepare - Build the shared /dev template
+ */
+int nk_mount_template_prepare(void) {
+    int fs_fd = -1;
+    int mnt_fd = -1;
+    int pick_fd = -1;
+    int probe_fd;
+
+    if (dev_template_tried) {
+        return dev_template_fd >= 0 ? 0 : -1;
+    }
+    dev_template_tried = true;
+    if (mount_template_bypassed()) {
+        return -1;
     }
 
-    snprintf(path, sizeof(path), "%s/dev/stdin", rootfs);
-    if (symlink("/proc/self/fd/0", path) == -1 && errno != EEXIST) {
-        nk_stderr( "Warning: Failed to create symlink %s: %s\n", path, strerror(errno));
+    fs_fd = (int)syscall(SYS_fsopen, "tmpfs", FSOPEN_CLOEXEC);
+    if (fs_fd == -1 ||
+        syscall(SYS_fsconfig, fs_fd, FSCONFIG_SET_STRING, "mode", "755", 0) == -1 ||
+        syscall(SYS_fsconfig, fs_fd, FSCONFIG_CMD_CREATE, NULL, NULL, 0) == -1) {
+        goto fail;
+    }
+    mnt_fd = (int)syscall(SYS_fsmount, fs_fd, FSMOUNT_CLOEXEC, MOUNT_ATTR_NOSUID);
+    if (mnt_fd == -1 || nk_mount_populate_dev(mnt_fd) == -1) {
+        goto fail;
     }
 
-    snprintf(path, sizeof(path), "%s/dev/stdout", rootfs);
-    if (symlink("/proc/self/fd/1", path) == -1 && errno != EEXIST) {
-        nk_stderr( "Warning: Failed to create symlink %s: %s\n", path, strerror(errno));
+    /* Read-only superblock: the clones share it, so no container can write to another's /dev */
+    pick_fd = (int)syscall(SYS_fspick, mnt_fd, "", FSPICK_EMPTY_PATH | FSPICK_CLOEXEC);
+    if (pick_fd == -1 ||
+        syscall(SYS_fsconfig, pick_fd, FSCONFIG_SET_FLAG, "ro", NULL, 0) == -1 ||
+        syscall(SYS_fsconfig, pick_fd, FSCONFIG_CMD_RECONFIGURE, NULL, NULL, 0) == -1) {
+        goto fail;
     }
 
-    snprintf(path, sizeof(path), "%s/dev/stderr", rootfs);
-    if (symlink("/proc/self/fd/2", path) == -1 && errno != EEXIST) {
-        nk_stderr( "Warning: Failed to create symlink %s: %s\n", path, strerror(errno));
+    /* Cloning a detached mount needs Linux 6.15+ */
+    probe_fd = (int)syscall(SYS_open_tree, mnt_fd, "",
+                            OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC | AT_EMPTY_PATH);
+    if (probe_fd == -1) {
+        goto fail;
     }
+    close(probe_fd);
 
+    close(pick_fd);
+    close(fs_fd);
+    dev_template_fd = mnt_fd;
+    nk_log_debug("Built /dev mount template (fd %d)", mnt_fd);
     return 0;
+
+fail:
+    nk_log_debug("No /dev mount template, mounting /dev per container: %s", strerror(errno));
+    if (pick_fd >= 0) {
+        close(pick_fd);
+    }
+    if (mnt_fd >= 0) {
+        close(mnt_fd);
+    }
+    if (fs_fd >= 0) {
+        close(fs_fd);
+    }
+    return -1;
 }
 
 /**
- * nk_mount_pivot_root - Pivot to new root filesystem
+ * nk_mount_attach_dev_template - Attach a clone of the /dev template at the rootfs /dev
  */
-static int nk_mount_pivot_root(const char *new_root) {
-    /* Create directory for old root */
-    char put_old[PATH_MAX];
-    snprintf(put_old, sizeof(put_old), "%s/.pivot_old", new_root);
-
-    if (mkdir(put_old, 0700) == -1 && errno != EEXIST) {
-        nk_stderr( "Error: Failed to create %s: %s\n",
-                put_old, strerror(errno));
+static int nk_mount_attach_dev_template(int root_fd) {
+    int clone_fd;
+    int ret;
+
+    if (mkdirat(root_fd, "dev", 0755) == -1 && errno != EEXIST) {
+        nk_log_warn("Failed to create /dev in rootfs: %s", strerror(errno));
         return -1;
     }
 
-    /* Bind mount new root to itself to ensure it's a mount point */
-    if (mount(new_root, new_root, NULL, MS_BIND | MS_REC, NULL) == -1) {
+    clone_fd = (int)syscall(SYS_open_tree, dev_template_fd, "",
+                            OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC | AT_EMPTY_PATH);
+    if (clone_fd == -1) {
+        nk_log_warn("Failed to clone /dev template: %s", strerror(errno));
+        return -1;
+    }
+    ret = (int)syscall(SYS_move_mount, clone_fd, "", root_fd, "dev", MOVE_MOUNT_F_EMPTY_PATH);
+    if (ret == -1) {
+        nk_log_warn("Failed to attach /dev template: %s", strerror(errno));
+    }
+    close(clone_fd);
+    return ret;
+}
+
+/**
+ * nk_mount_enter_root - Bind the rootfs onto itself and confine lookups to it
+ *
+ * The bind gives the future root a private parent mount, as pivot_root()
+ * requires. The process then chroots into the bind: until the pivot, every
+ * path (mount targets, mkdirat() and the like relative to the returned fd,
+ * symlinks in the image) resolves as with RESOLVE_IN_ROOT, and the bundle
+ * path is walked only here. *host_root_fd keeps the way back for the pivot.
+ */
+static int nk_mount_enter_root(const char *rootfs, int *host_root_fd) {
+    int root_fd;
+
+    if (mount(rootfs, rootfs, NULL, MS_BIND | MS_REC, NULL) == -1) {
         nk_stderr( "Error: Failed to bind mount %s: %s\n",
-                new_root, strerror(errno));
+                rootfs, strerror(errno));
         return -1;
     }
 
-    /* Pivot root */
-    if (syscall(__NR_pivot_root, new_root, put_old) == -1) {
+    root_fd = open(rootfs, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        nk_stderr( "Error: Failed to open %s: %s\n", rootfs, strerror(errno));
+        return -1;
+    }
+    *host_root_fd = open("/", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (*host_root_fd == -1 || fchdir(root_fd) == -1 || chroot(".") == -1) {
+        nk_stderr( "Error: Failed to enter %s: %s\n", rootfs, strerror(errno));
+        if (*host_root_fd >= 0) {
+            close(*host_root_fd);
+        }
+        close(root_fd);
+        return -1;
+    }
+    return root_fd;
+}
+
+/**
+ * nk_mount_pivot_root - Pivot to new root filesystem
+ */
+static int nk_mount_pivot_root(int root_fd, int host_root_fd) {
+    /* pivot_root() refuses a new root that is already the process root */
+    if (fchdir(host_root_fd) == -1 || chroot(".") == -1 || fchdir(root_fd) == -1) {
+        nk_stderr( "Error: Failed to leave rootfs chroot: %s\n", strerror(errno));
+        return -1;
+    }
+
+    /*
+     * pivot_root(".", ".") stacks the old root on top of the new one, so
+     * no put_old directory is needed. A directory inside the rootfs would
+     * be shared by every container started from the same bundle, and one
+     * container's rmdir could pull it out from under another's pivot.
+     */
+    if (syscall(__NR_pivot_root, ".", ".") == -1) {
         nk_stderr( "Error: Failed to pivot_root: %s\n", strerror(errno));
         return -1;
     }
 
+    /* Unmount old root, now mounted over "." */
+    if (umount2(".", MNT_DETACH) == -1) {
+        nk_stderr( "Warning: Failed to unmount old root: %s\n",
+                strerror(errno));
+    }
+
     /* Change to new root */
     if (chdir("/") == -1) {
         nk_stderr( "Error: Failed to chdir to new root: %s\n",
@@ -190,15 +416,149 @@ static int nk_mount_pivot_root(const char *new_root) {
         return -1;
     }
 
-    /* Unmount old root */
-    if (umount2("/.pivot_old", MNT_DETACH) == -1) {
-        nk_stderr( "Warning: Failed to unmount old root: %s\n",
-                strerror(errno));
+    return 0;
+}
+
+/**
+ * rootfs_mkdirs - Create <dir>/upper, work and merged
+ */
+static int rootfs_mkdirs(const char *dir) {
+    static const char *const subdirs[] = { "upper", "work", "merged" };
+    char path[PATH_MAX];
+
+    if (mkdir(dir, 0700) == -1 && errno != EEXIST) {
+        nk_stderr( "Error: Failed to create %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, subdirs[i]);
+        if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+            nk_stderr( "Error: Failed to create %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * nk_container_rootfs_prepare - Pick the rootfs mode and create overlay dirs
+ */
+int nk_container_rootfs_prepare(nk_container_ctx_t *ctx, const char *container_id) {
+    const char *mode = getenv(NS_ROOTFS_MODE_ENV);
+
+    if (!ctx || !container_id) {
+        return -1;
+    }
+
+    ctx->rootfs_mode = NK_ROOTFS_BIND;
+    if (mode && strcmp(mode, "overlay") == 0) {
+        ctx->rootfs_mode = NK_ROOTFS_OVERLAY;
+    } else if (mode && strcmp(mode, "overlay-tmpfs") == 0) {
+        ctx->rootfs_mode = NK_ROOTFS_OVERLAY_TMPFS;
+    }
+    if (ctx->rootfs_mode == NK_ROOTFS_BIND) {
+        return 0;
+    }
+
+    /* overlayfs splits lowerdir on ':' and its options on ',' */
+    if (strpbrk(ctx->rootfs, ":,")) {
+        nk_stderr( "Error: %s=%s cannot use rootfs path %s (contains ':' or ',')\n",
+                NS_ROOTFS_MODE_ENV, mode, ctx->rootfs);
+        return -1;
     }
 
-    /* Remove old root directory */
-    rmdir("/.pivot_old");
+    free(ctx->overlay_dir);
+    ctx->overlay_dir = nk_state_file_path(container_id, ROOTFS_OVERLAY_DIR);
+    if (!ctx->overlay_dir) {
+        return -1;
+    }
 
+    /* overlay-tmpfs: the child creates the subdirectories on its tmpfs */
+    if (ctx->rootfs_mode == NK_ROOTFS_OVERLAY_TMPFS) {
+        if (mkdir(ctx->overlay_dir, 0700) == -1 && errno != EEXIST) {
+            nk_stderr( "Error: Failed to create %s: %s\n", ctx->overlay_dir, strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+    return rootfs_mkdirs(ctx->overlay_dir);
+}
+
+static int rootfs_remove_entry(const char *path, const struct stat *st, int flag,
+                               struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if ((flag == FTW_DP ? rmdir(path) : unlink(path)) == -1 && errno != ENOENT) {
+        nk_log_warn("Failed to remove %s: %s", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * nk_container_rootfs_remove - Remove <state_dir>/<id>/rootfs
+ */
+int nk_container_rootfs_remove(const char *container_id) {
+    struct stat st;
+    char *dir = nk_state_file_path(container_id, ROOTFS_OVERLAY_DIR);
+    int ret = 0;
+
+    if (!dir) {
+        return -1;
+    }
+    /* FTW_MOUNT: never descend into an overlay or tmpfs still mounted here */
+    if (lstat(dir, &st) == 0 &&
+        nftw(dir, rootfs_remove_entry, 16, FTW_DEPTH | FTW_PHYS | FTW_MOUNT) != 0) {
+        ret = -1;
+    }
+    free(dir);
+    return ret;
+}
+
+/**
+ * nk_mount_overlay - Mount the bundle rootfs as the lowerdir of an overlay
+ * @ctx: Context with an overlay rootfs_mode
+ * @merged: Filled with the overlay mount point
+ * @len: Size of @merged
+ */
+static int nk_mount_overlay(const nk_container_ctx_t *ctx, char *merged, size_t len) {
+    char opts[3 * PATH_MAX + 64];
+    bool mount_ns = false;
+
+    for (size_t i = 0; i < ctx->namespaces_len; i++) {
+        mount_ns |= ctx->namespaces[i].type == NK_NS_MOUNT && !ctx->namespaces[i].path;
+    }
+    if (!mount_ns || !ctx->overlay_dir) {
+        nk_stderr( "Error: overlay rootfs needs a new mount namespace\n");
+        return -1;
+    }
+
+    /* Keep the overlay (and tmpfs) out of the host's mount table */
+    if (mount(NULL, "/", NULL, MS_REC | MS_SLAVE, NULL) == -1) {
+        nk_stderr( "Error: Failed to make / rslave: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (ctx->rootfs_mode == NK_ROOTFS_OVERLAY_TMPFS) {
+        if (mount("tmpfs", ctx->overlay_dir, "tmpfs", MS_NOSUID | MS_NODEV, "mode=700") == -1) {
+            nk_stderr( "Error: Failed to mount tmpfs on %s: %s\n",
+                    ctx->overlay_dir, strerror(errno));
+            return -1;
+        }
+        if (rootfs_mkdirs(ctx->overlay_dir) == -1) {
+            return -1;
+        }
+    }
+
+    snprintf(merged, len, "%s/merged", ctx->overlay_dir);
+    snprintf(opts, sizeof(opts), "lowerdir=%s,upperdir=%s/upper,workdir=%s/work",
+             ctx->rootfs, ctx->overlay_dir, ctx->overlay_dir);
+    if (mount("overlay", merged, "overlay", 0, opts) == -1) {
+        nk_stderr( "Error: Failed to mount overlay on %s: %s\n", merged, strerror(errno));
+        return -1;
+    }
+
+    nk_log_debug("Overlay rootfs: lower=%s upper=%s/upper", ctx->rootfs, ctx->overlay_dir);
     return 0;
 }
 
@@ -206,6 +566,13 @@ static int nk_mount_pivot_root(const char *new_root) {
  * nk_container_setup_rootfs - Setup container root filesystem
  */
 int nk_container_setup_rootfs(const nk_container_ctx_t *ctx) {
+    char merged[PATH_MAX];
+    const char *rootfs;
+    bool dev_attached = false;
+    bool dev_mounted = false;
+    int host_root_fd;
+    int root_fd;
+
     if (!ctx || !ctx->rootfs) {
         nk_log_error("No rootfs specified");
         return -1;
@@ -214,30 +581,61 @@ int nk_container_setup_rootfs(const nk_container_ctx_t *ctx) {
     nk_log_debug("Setting up root filesystem: %s", ctx->rootfs);
     nk_log_info("Setting up rootfs: %s", ctx->rootfs);
 
+    rootfs = ctx->rootfs;
+    if (ctx->rootfs_mode != NK_ROOTFS_BIND) {
+        if (nk_log_educational) {
+            nk_log_explain_op("Mounting overlay rootfs",
+                "The bundle rootfs is the read-only lower layer shared by every container "
+                "of the bundle; this container's writes land in its own upper directory.");
+        }
+
+        nk_trace_begin(ctx->trace, NK_TRACE_OVERLAY);
+        if (nk_mount_overlay(ctx, merged, sizeof(merged)) == -1) {
+            return -1;
+        }
+        nk_trace_end(ctx->trace, NK_TRACE_OVERLAY);
+        rootfs = merged;
+    }
+
     if (nk_log_educational) {
         nk_log_explain_op("Making rootfs private mount",
             "Prevents mount propagation from host. Container's mount changes stay isolated.");
     }
 
     /* Make rootfs mount private */
-    if (nk_mount_make_private(ctx->rootfs) == -1) {
+    nk_trace_begin(ctx->trace, NK_TRACE_MAKE_PRIVATE);
+    if (nk_mount_make_private(rootfs) == -1) {
         return -1;
     }
+    root_fd = nk_mount_enter_root(rootfs, &host_root_fd);
+    if (root_fd == -1) {
+        return -1;
+    }
+    nk_trace_end(ctx->trace, NK_TRACE_MAKE_PRIVATE);
     nk_log_debug("Rootfs marked as private mount");
 
+    /* /dev from the template: one clone + move_mount instead of mount, mknods, symlinks */
+    if (dev_template_fd >= 0 && !mount_template_bypassed()) {
+        nk_trace_begin(ctx->trace, NK_TRACE_SETUP_DEV);
+        dev_attached = nk_mount_attach_dev_template(root_fd) == 0;
+        nk_trace_end(ctx->trace, NK_TRACE_SETUP_DEV);
+    }
+
     /* Mount default filesystems */
     nk_log_debug("Mounting container filesystems");
+    nk_trace_begin(ctx->trace, NK_TRACE_DEFAULT_MOUNTS);
     for (size_t i = 0; i < DEFAULT_MOUNTS_COUNT; i++) {
-        char target[PATH_MAX];
-        snprintf(target, sizeof(target), "%s%s", ctx->rootfs, default_mounts[i].target);
+        /* Relative to the confined cwd, i.e. the rootfs */
+        const char *target = default_mounts[i].target + 1;
+
+        if (dev_attached && default_mounts[i].templated) {
+            continue;
+        }
 
         /* Create target directory if it doesn't exist */
-        struct stat st;
-        if (stat(target, &st) == -1) {
-            if (mkdir(target, 0755) == -1) {
-                nk_log_warn("Failed to create %s: %s", target, strerror(errno));
-                continue;
-            }
+        if (mkdirat(root_fd, target, 0755) == -1 && errno != EEXIST) {
+            nk_log_warn("Failed to create %s: %s", default_mounts[i].target, strerror(errno));
+            continue;
         }
 
         /* Perform mount */
@@ -246,25 +644,45 @@ int nk_container_setup_rootfs(const nk_container_ctx_t *ctx) {
                   default_mounts[i].flags,
                   default_mounts[i].options) == -1) {
             nk_log_warn("Failed to mount %s to %s: %s",
-                    default_mounts[i].type, target, strerror(errno));
+                    default_mounts[i].type, default_mounts[i].target, strerror(errno));
         } else {
             nk_log_debug("Mounted %s on %s", default_mounts[i].type, default_mounts[i].target);
+            dev_mounted = dev_mounted || default_mounts[i].templated;
         }
     }
 
+    nk_trace_end(ctx->trace, NK_TRACE_DEFAULT_MOUNTS);
+
     /* Setup device nodes */
-    nk_log_debug("Creating device nodes");
-    nk_mount_setup_dev(ctx->rootfs);
+    if (!dev_attached) {
+        nk_log_debug("Creating device nodes");
+        nk_trace_begin(ctx->trace, NK_TRACE_SETUP_DEV);
+        (void)nk_mount_setup_dev(root_fd, dev_mounted);
+        nk_trace_end(ctx->trace, NK_TRACE_SETUP_DEV);
+    }
 
     /* Pivot root */
     if (nk_log_educational) {
         nk_log_explain_op("Pivoting root filesystem",
             "Atomic swap of root directory. pivot_root() is safer than chroot() for containers. "
-            "Old root becomes /.pivot_old and is unmounted.");
+            "The old root is stacked on the new one and detached.");
     }
 
-    if (nk_mount_pivot_root(ctx->rootfs) == -1) {
+    nk_trace_begin(ctx->trace, NK_TRACE_PIVOT_ROOT);
+    if (nk_mount_pivot_root(root_fd, host_root_fd) == -1) {
         nk_log_error("Failed to pivot root");
+        close(host_root_fd);
+        close(root_fd);
+        return -1;
+    }
+    close(host_root_fd);
+    close(root_fd);
+    nk_trace_end(ctx->trace, NK_TRACE_PIVOT_ROOT);
+
+    /* root.readonly: only the root mount; /proc, /dev, ... keep their flags */
+    if (ctx->rootfs_readonly &&
+        mount(NULL, "/", NULL, MS_REMOUNT | MS_BIND | MS_RDONLY, NULL) == -1) {
+        nk_stderr( "Error: Failed to remount root read-only: %s\n", strerror(errno));
         return -1;
     }
 
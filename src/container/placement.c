@@ -0,0 +1,732 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "nk_placement.h"
+#include "nk_log.h"
+#include "common/state.h"
+
+#ifndef SYSFS_CPU_ROOT
+#define SYSFS_CPU_ROOT "/sys/devices/system/cpu"
+#endif
+#ifndef SYSFS_NODE_ROOT
+#define SYSFS_NODE_ROOT "/sys/devices/system/node"
+#endif
+
+/* Allocation table: <state_dir>/.placement/cpuset, "<id> <policy> <cpus> <mems>" per line */
+#define PLACEMENT_DIR ".placement"
+#define PLACEMENT_TABLE "cpuset"
+
+/* Longest CPU list (every other CPU of CPU_SETSIZE) */
+#define PLACEMENT_LIST_MAX 8192
+
+/* Default cpu.max period when the spec sets a quota only */
+#define PLACEMENT_CPU_PERIOD 100000
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+static const char *const placement_policies[] = {
+    [NK_CPUSET_NONE] = "none",
+    [NK_CPUSET_PACKED] = "packed",
+    [NK_CPUSET_SPREAD] = "spread",
+    [NK_CPUSET_EXCLUSIVE] = "exclusive",
+};
+
+/* One NUMA node and the CPUs of it the container cgroup may use */
+typedef struct {
+    unsigned id;
+    cpu_set_t cpus;
+} placement_node_t;
+
+typedef struct {
+    placement_node_t nodes[NK_PLACEMENT_MAX_NODES];
+    size_t count;
+} placement_topology_t;
+
+/* What every other container holds */
+typedef struct {
+    unsigned short load[CPU_SETSIZE];   /* shared containers per CPU */
+    cpu_set_t exclusive;                /* CPUs of exclusive cpusets */
+} placement_usage_t;
+
+int nk_cpuset_policy_parse(const char *name, nk_cpuset_policy_t *policy) {
+    for (size_t i = 0; i < sizeof(placement_policies) / sizeof(placement_policies[0]); i++) {
+        if (name && strcmp(name, placement_policies[i]) == 0) {
+            *policy = (nk_cpuset_policy_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * placement_parse_list - Parse a kernel CPU/node list ("0-3,8,10-11")
+ *
+ * An empty list and "-" (an unplaced table entry) are the empty set.
+ */
+static int placement_parse_list(const char *s, cpu_set_t *set) {
+    CPU_ZERO(set);
+    if (strcmp(s, "-") == 0) {
+        return 0;
+    }
+
+    while (*s && *s != '\n') {
+        char *end = NULL;
+        unsigned long lo = strtoul(s, &end, 10);
+        unsigned long hi = lo;
+
+        if (end == s) {
+            return -1;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtoul(s, &end, 10);
+            if (end == s || hi < lo) {
+                return -1;
+            }
+        }
+        if (hi >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (unsigned long i = lo; i <= hi; i++) {
+            CPU_SET(i, set);
+        }
+        s = end;
+        if (*s == ',') {
+            s++;
+        } else if (*s && *s != '\n') {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Kernel list format of @set, "-" when it is empty */
+static void placement_format_list(const cpu_set_t *set, char *buf, size_t len) {
+    size_t n = 0;
+
+    buf[0] = '\0';
+    for (int i = 0; i < CPU_SETSIZE && n < len; i++) {
+        if (!CPU_ISSET(i, set)) {
+            continue;
+        }
+        int j = i;
+        while (j + 1 < CPU_SETSIZE && CPU_ISSET(j + 1, set)) {
+            j++;
+        }
+        n += (size_t)(j > i ? snprintf(buf + n, len - n, "%s%d-%d", n ? "," : "", i, j)
+                            : snprintf(buf + n, len - n, "%s%d", n ? "," : "", i));
+        i = j;
+    }
+    if (n == 0) {
+        snprintf(buf, len, "-");
+    }
+}
+
+/* Read a small sysfs/cgroupfs file relative to @dirfd; -1 if it cannot be read */
+static int placement_read(int dirfd, const char *path, char *buf, size_t len) {
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    ssize_t n;
+
+    if (fd == -1) {
+        return -1;
+    }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/* Read a CPU/node list file into @set; -1 if missing or malformed */
+static int placement_read_list(int dirfd, const char *path, cpu_set_t *set) {
+    char buf[PLACEMENT_LIST_MAX];
+
+    if (placement_read(dirfd, path, buf, sizeof(buf)) == -1) {
+        return -1;
+    }
+    return placement_parse_list(buf, set);
+}
+
+/**
+ * placement_topology - Online CPUs per NUMA node, as far as the parent allows
+ *
+ * The container cgroup may only use the effective cpuset of its parent, so
+ * nodes and CPUs outside it are dropped. Without NUMA (no node directory)
+ * every online CPU belongs to node 0.
+ */
+static int placement_topology(int cgroup_fd, placement_topology_t *topo) {
+    cpu_set_t online, parent, mems;
+    bool mems_limited;
+    DIR *dir;
+
+    topo->count = 0;
+    if (placement_read_list(AT_FDCWD, SYSFS_CPU_ROOT "/online", &online) == -1) {
+        nk_stderr("Error: Failed to read %s: %s\n", SYSFS_CPU_ROOT "/online", strerror(errno));
+        return -1;
+    }
+    if (placement_read_list(cgroup_fd, "../cpuset.cpus.effective", &parent) == 0 &&
+        CPU_COUNT(&parent) > 0) {
+        CPU_AND(&online, &online, &parent);
+    }
+    mems_limited = placement_read_list(cgroup_fd, "../cpuset.mems.effective", &mems) == 0 &&
+                   CPU_COUNT(&mems) > 0;
+
+    dir = opendir(SYSFS_NODE_ROOT);
+    if (dir) {
+        struct dirent *de;
+
+        while ((de = readdir(dir)) != NULL && topo->count < NK_PLACEMENT_MAX_NODES) {
+            char path[PATH_MAX];
+            unsigned id;
+            int used = 0;
+            cpu_set_t cpus;
+
+            if (sscanf(de->d_name, "node%u%n", &id, &used) != 1 || de->d_name[used] != '\0' ||
+                id >= NK_PLACEMENT_MAX_NODES || (mems_limited && !CPU_ISSET(id, &mems))) {
+                continue;
+            }
+            snprintf(path, sizeof(path), SYSFS_NODE_ROOT "/%s/cpulist", de->d_name);
+            if (placement_read_list(AT_FDCWD, path, &cpus) == -1) {
+                continue;
+            }
+            CPU_AND(&cpus, &cpus, &online);
+            if (CPU_COUNT(&cpus) == 0) {
+                continue;               /* memory-only node, or none of it is ours */
+            }
+
+            /* Keep nodes sorted by ID; readdir() order is arbitrary */
+            size_t i = topo->count++;
+            for (; i > 0 && topo->nodes[i - 1].id > id; i--) {
+                topo->nodes[i] = topo->nodes[i - 1];
+            }
+            topo->nodes[i].id = id;
+            topo->nodes[i].cpus = cpus;
+        }
+        closedir(dir);
+    }
+
+    if (topo->count == 0) {
+        topo->nodes[0].id = 0;
+        topo->nodes[0].cpus = online;
+        topo->count = CPU_COUNT(&online) > 0;
+    }
+    if (topo->count == 0) {
+        nk_stderr("Error: No CPUs available for cpuset placement\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * placement_table_open - Open and lock the allocation table
+ *
+ * POSIX record lock, like nk_state_lock(): it is not inherited by the
+ * container init cloned while it is held.
+ */
+static int placement_table_open(bool create) {
+    struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    char *path = nk_state_file_path(PLACEMENT_DIR, PLACEMENT_TABLE);
+    int fd;
+
+    if (!path) {
+        return -1;
+    }
+    if (create) {
+        char *slash = strrchr(path, '/');
+
+        *slash = '\0';
+        if (mkdir(path, 0700) == -1 && errno != EEXIST) {
+            free(path);
+            return -1;
+        }
+        *slash = '/';
+    }
+
+    fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+    free(path);
+    if (fd == -1) {
+        return -1;
+    }
+    while (fcntl(fd, F_SETLKW, &fl) == -1) {
+        if (errno != EINTR) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/* Whole table as a NUL-terminated string (caller frees) */
+static char *placement_table_read(int fd) {
+    struct stat st;
+    char *buf;
+    ssize_t n;
+
+    if (fstat(fd, &st) == -1 || !(buf = malloc((size_t)st.st_size + 1))) {
+        return NULL;
+    }
+    n = pread(fd, buf, (size_t)st.st_size, 0);
+    if (n < 0) {
+        free(buf);
+        return NULL;
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+/* Split "<id> <policy> <cpus> <mems>" in place; false for a malformed line */
+static bool placement_fields(char *line, char *fields[4]) {
+    char *save = NULL;
+
+    for (int i = 0; i < 4; i++) {
+        fields[i] = strtok_r(i ? NULL : line, " ", &save);
+        if (!fields[i]) {
+            return false;
+        }
+    }
+    return strtok_r(NULL, " ", &save) == NULL;
+}
+
+/**
+ * placement_table_write - Replace the line of @container_id
+ * @entry: New "<policy> <cpus> <mems>" for it, or NULL to drop it
+ */
+static int placement_table_write(int fd, const char *table, const char *container_id,
+                                 const char *entry) {
+    size_t id_len = strlen(container_id);
+    size_t cap = strlen(table) + id_len + (entry ? strlen(entry) : 0) + 3;
+    char *buf = malloc(cap);
+    size_t n = 0;
+    int ret = 0;
+
+    if (!buf) {
+        return -1;
+    }
+    for (const char *line = table; *line;) {
+        const char *nl = strchr(line, '\n');
+        size_t len = nl ? (size_t)(nl - line) + 1 : strlen(line);
+
+        if (!(strncmp(line, container_id, id_len) == 0 && line[id_len] == ' ') && nl) {
+            memcpy(buf + n, line, len);
+            n += len;
+        }
+        line += len;
+    }
+    if (entry) {
+        n += (size_t)snprintf(buf + n, cap - n, "%s %s\n", container_id, entry);
+    }
+
+    if (pwrite(fd, buf, n, 0) != (ssize_t)n || ftruncate(fd, (off_t)n) == -1) {
+        ret = -1;
+    }
+    free(buf);
+    return ret;
+}
+
+/**
+ * placement_usage - Sum up the table, except @container_id's own line
+ * @policy: Set to the policy recorded for @container_id, if there is one
+ */
+static void placement_usage(const char *table, const char *container_id,
+                            placement_usage_t *usage, nk_cpuset_policy_t *policy) {
+    char *copy = strdup(table);
+    char *save = NULL;
+
+    memset(usage, 0, sizeof(*usage));
+    if (!copy) {
+        return;
+    }
+    for (char *line = strtok_r(copy, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *f[4];
+        nk_cpuset_policy_t p;
+        cpu_set_t cpus;
+
+        if (!placement_fields(line, f) || nk_cpuset_policy_parse(f[1], &p) == -1 ||
+            placement_parse_list(f[2], &cpus) == -1) {
+            continue;
+        }
+        if (strcmp(f[0], container_id) == 0) {
+            *policy = p;
+            continue;
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &cpus)) {
+                continue;
+            }
+            if (p == NK_CPUSET_EXCLUSIVE) {
+                CPU_SET(cpu, &usage->exclusive);
+            } else if (usage->load[cpu] < USHRT_MAX) {
+                usage->load[cpu]++;
+            }
+        }
+    }
+    free(copy);
+}
+
+/* CPUs of @node other containers may share, and their summed load */
+static unsigned placement_node_avail(const placement_node_t *node, const placement_usage_t *usage,
+                                     bool free_only, cpu_set_t *avail, unsigned long *load) {
+    *load = 0;
+    CPU_ZERO(avail);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &node->cpus) && !CPU_ISSET(cpu, &usage->exclusive) &&
+            (!free_only || usage->load[cpu] == 0)) {
+            CPU_SET(cpu, avail);
+            *load += usage->load[cpu];
+        }
+    }
+    return (unsigned)CPU_COUNT(avail);
+}
+
+/* Average load of a below b, compared without dividing */
+static bool placement_less_loaded(unsigned long load_a, unsigned avail_a,
+                                  unsigned long load_b, unsigned avail_b) {
+    return load_a * avail_b < load_b * avail_a;
+}
+
+/* Move the least-loaded CPU (lowest ID on ties) from @from to @to */
+static void placement_take_cpu(cpu_set_t *from, cpu_set_t *to, const placement_usage_t *usage) {
+    int best = -1;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, from) && (best == -1 || usage->load[cpu] < usage->load[best])) {
+            best = cpu;
+        }
+    }
+    if (best != -1) {
+        CPU_CLR(best, from);
+        CPU_SET(best, to);
+    }
+}
+
+/**
+ * placement_pick_node - CPUs on one node (packed, exclusive)
+ *
+ * The least-loaded node with @want CPUs to give wins. A packed container
+ * that fits on no node gets all it can have on the roomiest one; an
+ * exclusive one fails.
+ */
+static int placement_pick_node(const placement_topology_t *topo, const placement_usage_t *usage,
+                               nk_cpuset_policy_t policy, unsigned want,
+                               cpu_set_t *cpus, unsigned long *mems) {
+    bool exclusive = policy == NK_CPUSET_EXCLUSIVE;
+    size_t best = topo->count, roomiest = topo->count;
+    unsigned best_avail = 0, roomiest_avail = 0;
+    unsigned long best_load = 0;
+    cpu_set_t avail, best_set, roomiest_set;
+
+    if (exclusive && want == 0) {
+        want = 1;
+    }
+    for (size_t i = 0; i < topo->count; i++) {
+        unsigned long load;
+        unsigned n = placement_node_avail(&topo->nodes[i], usage, exclusive, &avail, &load);
+
+        if (n > roomiest_avail) {
+            roomiest = i;
+            roomiest_avail = n;
+            roomiest_set = avail;
+        }
+        if (n == 0 || n < want) {
+            continue;
+        }
+        if (best == topo->count || placement_less_loaded(load, n, best_load, best_avail)) {
+            best = i;
+            best_avail = n;
+            best_load = load;
+            best_set = avail;
+        }
+    }
+
+    if (best == topo->count) {
+        if (exclusive || roomiest == topo->count) {
+            nk_stderr("Error: No NUMA node has %u %sCPUs left for a %s cpuset\n", want,
+                      exclusive ? "unallocated " : "", placement_policies[policy]);
+            return -1;
+        }
+        nk_stderr("Warning: No NUMA node has %u free CPUs; using %u of node %u\n",
+                  want, roomiest_avail, topo->nodes[roomiest].id);
+        best = roomiest;
+        best_avail = roomiest_avail;
+        best_set = roomiest_set;
+        want = roomiest_avail;
+    }
+
+    CPU_ZERO(cpus);
+    for (unsigned n = want ? want : best_avail; n > 0; n--) {
+        placement_take_cpu(&best_set, cpus, usage);
+    }
+    *mems = 1ul << topo->nodes[best].id;
+    return 0;
+}
+
+/**
+ * placement_pick_spread - CPUs round-robin over nodes, least-loaded node first
+ */
+static int placement_pick_spread(const placement_topology_t *topo, const placement_usage_t *usage,
+                                 unsigned want, cpu_set_t *cpus, unsigned long *mems) {
+    cpu_set_t avail[NK_PLACEMENT_MAX_NODES];
+    unsigned long load[NK_PLACEMENT_MAX_NODES];
+    unsigned count[NK_PLACEMENT_MAX_NODES];
+    size_t order[NK_PLACEMENT_MAX_NODES];
+    unsigned total = 0;
+
+    for (size_t i = 0; i < topo->count; i++) {
+        count[i] = placement_node_avail(&topo->nodes[i], usage, false, &avail[i], &load[i]);
+        total += count[i];
+
+        size_t j = i;
+        for (; j > 0 && count[i] > 0 &&
+               (count[order[j - 1]] == 0 ||
+                placement_less_loaded(load[i], count[i], load[order[j - 1]], count[order[j - 1]]));
+             j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+    if (total == 0) {
+        nk_stderr("Error: No CPUs left for a spread cpuset\n");
+        return -1;
+    }
+    if (want > total) {
+        nk_stderr("Warning: Only %u CPUs are not held exclusively; spreading over those\n", total);
+    }
+    if (want == 0 || want > total) {
+        want = total;
+    }
+
+    CPU_ZERO(cpus);
+    *mems = 0;
+    for (unsigned picked = 0; picked < want;) {
+        for (size_t k = 0; k < topo->count && picked < want; k++) {
+            size_t i = order[k];
+
+            if (CPU_COUNT(&avail[i]) == 0) {
+                continue;
+            }
+            placement_take_cpu(&avail[i], cpus, usage);
+            *mems |= 1ul << topo->nodes[i].id;
+            picked++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * placement_partition - Best effort: make an exclusive cpuset a partition
+ *
+ * Only works when the administrator made the nano-sandbox cgroup a
+ * partition root; otherwise the container keeps a member cpuset whose
+ * exclusivity is the allocator's.
+ */
+static void placement_partition(int cgroup_fd, const char *cpus) {
+    char state[64];
+    int fd = openat(cgroup_fd, "cpuset.cpus.exclusive", O_WRONLY | O_CLOEXEC);
+
+    if (fd == -1 || write(fd, cpus, strlen(cpus)) == -1) {
+        nk_log_debug("cpuset.cpus.exclusive not set: %s", strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    close(fd);
+
+    fd = openat(cgroup_fd, "cpuset.cpus.partition", O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    if (write(fd, "root", 4) == -1 || pread(fd, state, sizeof(state) - 1, 0) <= 0 ||
+        strncmp(state, "root\n", 5) != 0) {
+        nk_log_debug("cpuset partition not available, keeping a member cpuset");
+        (void)pwrite(fd, "member", 6, 0);
+    } else {
+        nk_log_info("Container cpuset is a partition root");
+    }
+    close(fd);
+}
+
+/* Node mask as a kernel list, for cpuset.mems and the table */
+static void placement_format_nodes(unsigned long mems, char *buf, size_t len) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (unsigned i = 0; i < NK_PLACEMENT_MAX_NODES; i++) {
+        if (mems & (1ul << i)) {
+            CPU_SET(i, &set);
+        }
+    }
+    placement_format_list(&set, buf, len);
+}
+
+/**
+ * nk_placement_apply - Pick, record and write a container's cpuset
+ */
+int nk_placement_apply(const char *container_id, int cgroup_fd, nk_container_ctx_t *ctx) {
+    nk_cpuset_policy_t policy = ctx->cpuset_policy;
+    placement_topology_t *topo = NULL;
+    placement_usage_t *usage = NULL;
+    char cpus_str[PLACEMENT_LIST_MAX];
+    char mems_str[PLACEMENT_LIST_MAX];
+    char *entry = NULL;
+    char *table = NULL;
+    unsigned long mems = 0;
+    unsigned want = ctx->cpuset_cpus;
+    cpu_set_t cpus;
+    int ret = -1;
+
+    /* Without an annotation there is only work if create --cpuset left a line */
+    int fd = placement_table_open(policy != NK_CPUSET_NONE);
+    if (fd == -1) {
+        if (policy == NK_CPUSET_NONE && errno == ENOENT) {
+            return 0;
+        }
+        nk_stderr("Error: Failed to open the cpuset allocation table: %s\n", strerror(errno));
+        return -1;
+    }
+
+    topo = malloc(sizeof(*topo));
+    usage = malloc(sizeof(*usage));
+    if (!topo || !usage || !(table = placement_table_read(fd))) {
+        nk_stderr("Error: Failed to read the cpuset allocation table\n");
+        goto out;
+    }
+    placement_usage(table, container_id, usage, &policy);
+    if (policy == NK_CPUSET_NONE) {
+        ret = 0;
+        goto out;
+    }
+    if (placement_topology(cgroup_fd, topo) == -1) {
+        goto out;
+    }
+
+    /* Without an explicit count, cpu.max decides: quota/period CPUs, rounded up */
+    if (want == 0 && ctx->cgroup && ctx->cgroup->cpu_quota > 0) {
+        uint64_t period = ctx->cgroup->cpu_period ? ctx->cgroup->cpu_period : PLACEMENT_CPU_PERIOD;
+        want = (unsigned)(((uint64_t)ctx->cgroup->cpu_quota + period - 1) / period);
+    }
+
+    if ((policy == NK_CPUSET_SPREAD ? placement_pick_spread(topo, usage, want, &cpus, &mems)
+                                    : placement_pick_node(topo, usage, policy, want, &cpus, &mems)) == -1) {
+        goto out;
+    }
+    placement_format_list(&cpus, cpus_str, sizeof(cpus_str));
+    placement_format_nodes(mems, mems_str, sizeof(mems_str));
+
+    if (faccessat(cgroup_fd, "cpuset.cpus", F_OK, 0) == 0) {
+        if (nk_cgroup_write(cgroup_fd, "cpuset.cpus", cpus_str) == -1 ||
+            nk_cgroup_write(cgroup_fd, "cpuset.mems", mems_str) == -1) {
+            goto out;
+        }
+        if (policy == NK_CPUSET_EXCLUSIVE) {
+            placement_partition(cgroup_fd, cpus_str);
+        }
+    } else {
+        /* cpuset is not delegated to us: pin init, its children inherit it */
+        nk_log_info("No cpuset controller; pinning init to CPUs %s", cpus_str);
+        ctx->pin_cpus = true;
+        ctx->cpus = cpus;
+    }
+    ctx->mempolicy = policy == NK_CPUSET_SPREAD && (mems & (mems - 1)) ? MPOL_INTERLEAVE : MPOL_BIND;
+    ctx->mempolicy_nodes = mems;
+
+    if (asprintf(&entry, "%s %s %s", placement_policies[policy], cpus_str, mems_str) == -1) {
+        entry = NULL;
+        goto out;
+    }
+    if (placement_table_write(fd, table, container_id, entry) == -1) {
+        nk_stderr("Error: Failed to record the cpuset of '%s': %s\n", container_id, strerror(errno));
+        goto out;
+    }
+    nk_log_info("cpuset (%s): cpus %s, mems %s", placement_policies[policy], cpus_str, mems_str);
+    ret = 0;
+
+out:
+    free(entry);
+    free(table);
+    free(usage);
+    free(topo);
+    close(fd);
+    return ret;
+}
+
+/**
+ * nk_placement_request - Record a create/run --cpuset policy
+ */
+int nk_placement_request(const char *container_id, nk_cpuset_policy_t policy) {
+    char entry[64];
+    char *table;
+    int fd = placement_table_open(true);
+    int ret = -1;
+
+    if (fd == -1) {
+        nk_stderr("Error: Failed to open the cpuset allocation table: %s\n", strerror(errno));
+        return -1;
+    }
+    snprintf(entry, sizeof(entry), "%s - -", placement_policies[policy]);
+    table = placement_table_read(fd);
+    if (table) {
+        ret = placement_table_write(fd, table, container_id, entry);
+        free(table);
+    }
+    if (ret == -1) {
+        nk_stderr("Error: Failed to record the cpuset policy of '%s'\n", container_id);
+    }
+    close(fd);
+    return ret;
+}
+
+/**
+ * nk_placement_release - Drop a container's line from the table
+ */
+void nk_placement_release(const char *container_id) {
+    int fd = placement_table_open(false);
+    char *table;
+
+    if (fd == -1) {
+        return;
+    }
+    table = placement_table_read(fd);
+    if (table && placement_table_write(fd, table, container_id, NULL) == -1) {
+        nk_log_warn("Failed to release the cpuset of '%s'", container_id);
+    }
+    free(table);
+    close(fd);
+}
+
+/**
+ * nk_placement_set_mempolicy - Runs in the container init before execve()
+ */
+void nk_placement_set_mempolicy(const nk_container_ctx_t *ctx) {
+    if (ctx->pin_cpus && sched_setaffinity(0, sizeof(ctx->cpus), &ctx->cpus) == -1) {
+        nk_log_warn("Failed to pin init to its cpuset: %s", strerror(errno));
+    }
+    if (ctx->mempolicy != 0) {
+        unsigned long nodes = ctx->mempolicy_nodes;
+
+        /* maxnode counts one past the last bit the kernel reads */
+        if (syscall(SYS_set_mempolicy, ctx->mempolicy, &nodes,
+                    (unsigned long)NK_PLACEMENT_MAX_NODES + 1) == -1) {
+            nk_log_warn("Failed to set the memory policy of init: %s", strerror(errno));
+        }
+    }
+}
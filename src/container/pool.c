@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "nk_pool.h"
+#include "nk_oci.h"
+#include "nk_log.h"
+
+/* One pre-cloned child parked before execve() */
+typedef struct {
+    pid_t pid;
+    int launch_fd;
+} pool_child_t;
+
+/* Parked children and counters for one bundle */
+typedef struct pool_bundle {
+    struct pool_bundle *next;
+    char *bundle_path;          /* realpath of the bundle */
+    dev_t dev;                  /* config.json identity the children were built from */
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    pool_child_t *children;     /* LIFO stack of parked children */
+    size_t ready;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t spawned;
+    uint64_t discarded;
+    uint64_t spawn_failures;
+} pool_bundle_t;
+
+static size_t pool_target = 0;
+static size_t pool_refill_rate = 0;
+static pool_bundle_t *pool_bundles = NULL;
+static size_t pool_bundles_len = 0;
+static time_t pool_window_start = 0;      /* Refill rate window (CLOCK_MONOTONIC seconds) */
+static size_t pool_window_spawned = 0;
+
+/**
+ * pool_config_identity - stat() the bundle's config.json
+ */
+static int pool_config_identity(const char *bundle_path, struct stat *st) {
+    char config_path[PATH_MAX];
+    int n = snprintf(config_path, sizeof(config_path), "%s/config.json", bundle_path);
+
+    if (n < 0 || (size_t)n >= sizeof(config_path)) {
+        return -1;
+    }
+    return stat(config_path, st);
+}
+
+static bool pool_identity_matches(const pool_bundle_t *b, const struct stat *st) {
+    return b->dev == st->st_dev && b->ino == st->st_ino && b->size == st->st_size &&
+           b->mtime.tv_sec == st->st_mtim.tv_sec &&
+           b->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void pool_set_identity(pool_bundle_t *b, const struct stat *st) {
+    b->dev = st->st_dev;
+    b->ino = st->st_ino;
+    b->size = st->st_size;
+    b->mtime = st->st_mtim;
+}
+
+/**
+ * pool_child_discard - Kill and reap a parked child we no longer want
+ */
+static void pool_child_discard(pool_child_t *child) {
+    if (child->launch_fd >= 0) {
+        close(child->launch_fd);
+        child->launch_fd = -1;
+    }
+
+    /* Only signal it if it is still our unreaped child */
+    if (child->pid > 0 && waitpid(child->pid, NULL, WNOHANG) == 0) {
+        kill(child->pid, SIGKILL);
+        (void)waitpid(child->pid, NULL, 0);
+    }
+    child->pid = -1;
+}
+
+static void pool_bundle_flush(pool_bundle_t *b) {
+    while (b->ready > 0) {
+        pool_child_discard(&b->children[--b->ready]);
+        b->discarded++;
+    }
+}
+
+static pool_bundle_t *pool_bundle_find(const char *real_path) {
+    for (pool_bundle_t *b = pool_bundles; b; b = b->next) {
+        if (strcmp(b->bundle_path, real_path) == 0) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * nk_pool_configure - Set pool target size and refill rate
+ */
+void nk_pool_configure(size_t target, size_t refill_rate) {
+    pool_target = target;
+    pool_refill_rate = refill_rate ? refill_rate : target;
+
+    if (target > 0) {
+        nk_log_info("Warm pool enabled: %zu parked children per bundle, refill %zu/s",
+                pool_target, pool_refill_rate);
+    }
+}
+
+/**
+ * nk_pool_enabled - Check whether the warm pool is active
+ */
+bool nk_pool_enabled(void) {
+    return pool_target > 0;
+}
+
+/**
+ * nk_pool_track - Register bundle for refill
+ */
+void nk_pool_track(const char *bundle_path) {
+    char real_path[PATH_MAX];
+    pool_bundle_t *b;
+
+    if (!nk_pool_enabled() || !bundle_path || !realpath(bundle_path, real_path)) {
+        return;
+    }
+    if (pool_bundle_find(real_path)) {
+        return;
+    }
+    if (pool_bundles_len >= NK_POOL_MAX_BUNDLES) {
+        nk_log_debug("Warm pool full (%d bundles); not tracking %s",
+                NK_POOL_MAX_BUNDLES, real_path);
+        return;
+    }
+
+    b = calloc(1, sizeof(*b));
+    if (!b) {
+        return;
+    }
+    b->bundle_path = strdup(real_path);
+    b->children = calloc(pool_target, sizeof(*b->children));
+    if (!b->bundle_path || !b->children) {
+        free(b->bundle_path);
+        free(b->children);
+        free(b);
+        return;
+    }
+
+    b->next = pool_bundles;
+    pool_bundles = b;
+    pool_bundles_len++;
+    nk_log_debug("Warm pool tracking bundle %s", real_path);
+}
+
+/**
+ * nk_pool_claim - Launch a parked child for the bundle if one is ready
+ */
+pid_t nk_pool_claim(const char *bundle_path, const nk_container_ctx_t *ctx) {
+    char real_path[PATH_MAX];
+    struct stat st;
+    pool_bundle_t *b;
+
+    if (!nk_pool_enabled() || !bundle_path || !realpath(bundle_path, real_path)) {
+        return -1;
+    }
+    /* Parked children pivoted into the bundle rootfs itself */
+    if (ctx->rootfs_mode != NK_ROOTFS_BIND) {
+        return -1;
+    }
+
+    b = pool_bundle_find(real_path);
+    if (!b) {
+        return -1;
+    }
+
+    if (b->ready > 0 &&
+        (pool_config_identity(real_path, &st) == -1 || !pool_identity_matches(b, &st))) {
+        nk_log_info("Warm pool: config.json changed for %s; discarding %zu parked children",
+                real_path, b->ready);
+        pool_bundle_flush(b);
+    }
+
+    while (b->ready > 0) {
+        pool_child_t child = b->children[--b->ready];
+
+        /* Parked before the container id was known; move it in before execve() */
+        if (ctx->cgroup_fd >= 0 && nk_cgroup_attach_fd(ctx->cgroup_fd, child.pid) == -1) {
+            /* Outside the cgroup none of the limits would apply */
+            nk_log_warn("Warm pool: parked child %d could not join the container cgroup",
+                        (int)child.pid);
+            pool_child_discard(&child);
+            b->discarded++;
+            continue;
+        }
+
+        if (nk_container_launch(child.pid, child.launch_fd, ctx) == 0) {
+            b->hits++;
+            nk_log_info("Warm pool hit: launched parked child %d", (int)child.pid);
+            return child.pid;
+        }
+
+        /* launch_fd is closed by nk_container_launch() */
+        child.launch_fd = -1;
+        pool_child_discard(&child);
+        b->discarded++;
+    }
+
+    b->misses++;
+    nk_log_debug("Warm pool miss for %s", real_path);
+    return -1;
+}
+
+/**
+ * pool_spawn_one - Park one more child for a bundle
+ */
+static int pool_spawn_one(pool_bundle_t *b) {
+    nk_container_ctx_t ctx;
+    struct stat st;
+    int launch_fd = -1;
+
+    if (pool_config_identity(b->bundle_path, &st) == -1) {
+        return -1;
+    }
+    if (b->ready > 0 && !pool_identity_matches(b, &st)) {
+        pool_bundle_flush(b);
+    }
+
+    nk_oci_spec_t *spec = nk_oci_spec_load(b->bundle_path);
+    if (!spec) {
+        return -1;
+    }
+    if (nk_container_ctx_init(&ctx, b->bundle_path, spec) == -1) {
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
+    pid_t pid = nk_container_exec_parked(&ctx, &launch_fd);
+    nk_container_ctx_release(&ctx);
+    nk_oci_spec_free(spec);
+    if (pid == -1) {
+        return -1;
+    }
+
+    pool_set_identity(b, &st);
+    b->children[b->ready].pid = pid;
+    b->children[b->ready].launch_fd = launch_fd;
+    b->ready++;
+    b->spawned++;
+    return 0;
+}
+
+/**
+ * nk_pool_refill - Top up one tracked bundle, bounded by the refill rate
+ */
+bool nk_pool_refill(void) {
+    struct timespec now;
+
+    if (!nk_pool_enabled()) {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec != pool_window_start) {
+        pool_window_start = now.tv_sec;
+        pool_window_spawned = 0;
+    }
+    if (pool_window_spawned >= pool_refill_rate) {
+        return false;
+    }
+
+    /* Fill the emptiest bundle first so one busy bundle cannot starve the rest */
+    pool_bundle_t *target = NULL;
+    for (pool_bundle_t *b = pool_bundles; b; b = b->next) {
+        if (b->ready < pool_target && (!target || b->ready < target->ready)) {
+            target = b;
+        }
+    }
+    if (!target) {
+        return false;
+    }
+
+    if (pool_spawn_one(target) == -1) {
+        target->spawn_failures++;
+        return false;
+    }
+
+    pool_window_spawned++;
+    return true;
+}
+
+/**
+ * nk_pool_print_stats - Print pool counters
+ */
+void nk_pool_print_stats(void) {
+    printf("target=%zu refill=%zu/s bundles=%zu\n",
+           pool_target, pool_refill_rate, pool_bundles_len);
+    printf("%-6s %-6s %-8s %-8s %-8s %-9s %-8s %s\n",
+           "READY", "TARGET", "HITS", "MISSES", "SPAWNED", "DISCARDED", "FAILED", "BUNDLE");
+    for (const pool_bundle_t *b = pool_bundles; b; b = b->next) {
+        printf("%-6zu %-6zu %-8llu %-8llu %-8llu %-9llu %-8llu %s\n",
+               b->ready, pool_target,
+               (unsigned long long)b->hits,
+               (unsigned long long)b->misses,
+               (unsigned long long)b->spawned,
+               (unsigned long long)b->discarded,
+               (unsigned long long)b->spawn_failures,
+               b->bundle_path);
+    }
+}
+
+/**
+ * nk_pool_drain - Kill every parked child and forget all bundles
+ */
+void nk_pool_drain(void) {
+    pool_bundle_t *b = pool_bundles;
+
+    while (b) {
+        pool_bundle_t *next = b->next;
+        pool_bundle_flush(b);
+        free(b->children);
+        free(b->bundle_path);
+        free(b);
+        b = next;
+    }
+    pool_bundles = NULL;
+    pool_bundles_len = 0;
+}
@@ -12,10 +12,16 @@
 #include <sys/signal.h>
 #include <sys/syscall.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
 #include <pwd.h>
 #include <grp.h>
 
 #include "nk_container.h"
+#include "nk_placement.h"
 #include "nk_log.h"
 
 /* Make cap-ng optional */
@@ -25,21 +31,92 @@
 #define CAPNG_NONE 0
 #endif
 
-/* Stack size for child process */
+/* Stack size for child process (clone() fallback only) */
 #define STACK_SIZE (1024 * 1024)
 
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+/* How long init gets to die after SIGKILL before stop gives up */
+#define STOP_KILL_WAIT_MS 5000
+/* Liveness probe interval when there is no pidfd to poll */
+#define STOP_PROBE_INTERVAL_US 10000
+
+/* struct clone_args from <linux/sched.h> (CLONE_ARGS_SIZE_VER2) */
+typedef struct {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+    uint64_t set_tid;
+    uint64_t set_tid_size;
+    uint64_t cgroup;
+} nk_clone_args_t;
+
+/* Set once clone3() is found missing so later spawns skip straight to clone() */
+static bool clone3_unsupported = false;
+
 /* Container execution context passed to child */
 typedef struct {
     const nk_container_ctx_t *ctx;
-    const char *container_id;
     const char *hostname;
     int sync_pipe[2];  /* Pipe for parent-child synchronization */
+    int launch_fd;     /* Child end of launch channel when parked, else -1 */
+    const char *exec_fifo; /* Host path of exec FIFO to park on, else NULL */
     char **env;        /* Environment variables */
 } container_exec_ctx_t;
 
 #define CHILD_SYNC_READY '1'
 #define CHILD_SYNC_ERROR '0'
 
+/* Sent once over the sync pipe when the child is ready or has failed */
+#define CHILD_SYNC_MAGIC 0x4e4b5331u  /* "NKS1" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t status;     /* CHILD_SYNC_READY or CHILD_SYNC_ERROR */
+    nk_trace_t trace;    /* Child phases; the rest are zero */
+} child_sync_msg_t;
+
+_Static_assert(sizeof(child_sync_msg_t) <= PIPE_BUF, "sync message must be one atomic write");
+
+/* Launch message sent to a parked child, followed by the string payload */
+#define LAUNCH_MAGIC 0x4e4b4c31u  /* "NKL1" */
+#define LAUNCH_MAX_PAYLOAD (256 * 1024)
+#define LAUNCH_MAX_STRINGS 4096
+#define LAUNCH_STDIO_FDS 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t payload_len;  /* cwd, args, env; each NUL-terminated */
+} launch_msg_t;
+
+static char *default_env[] = {
+    "PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin",
+    "TERM=xterm",
+    "HOME=/root",
+    NULL,
+};
+
 /**
  * nk_process_drop_capabilities - Drop capabilities
  */
@@ -104,6 +181,175 @@ static int nk_process_set_uid_gid(uid_t uid, gid_t gid) {
     return 0;
 }
 
+/**
+ * read_full - Read exactly len bytes (EOF is an error)
+ */
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * container_child_wait_launch - Park until the launch message arrives, then exec
+ *
+ * Runs after pivot_root, so cwd in the message is container-relative.
+ * The launch socket is close-on-exec: a successful execve() shows up as
+ * EOF on the parent end, a failure as a CHILD_SYNC_ERROR byte.
+ */
+static int container_child_wait_launch(int launch_fd) {
+    int fds[LAUNCH_STDIO_FDS] = { -1, -1, -1 };
+    char control[CMSG_SPACE(sizeof(fds))];
+    launch_msg_t msg;
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr mh = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    const char status = CHILD_SYNC_ERROR;
+    ssize_t n;
+
+    do {
+        n = recvmsg(launch_fd, &mh, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == 0) {
+        /* Parent dropped us (pool drained); exit quietly */
+        return 0;
+    }
+    if (n != (ssize_t)sizeof(msg) || msg.magic != LAUNCH_MAGIC ||
+        msg.payload_len == 0 || msg.payload_len > LAUNCH_MAX_PAYLOAD ||
+        msg.argc == 0 || msg.argc > LAUNCH_MAX_STRINGS || msg.envc > LAUNCH_MAX_STRINGS) {
+        nk_log_error("Malformed launch message");
+        (void)write(launch_fd, &status, 1);
+        return 1;
+    }
+
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS &&
+            c->cmsg_len == CMSG_LEN(sizeof(fds))) {
+            memcpy(fds, CMSG_DATA(c), sizeof(fds));
+        }
+    }
+
+    char *payload = malloc(msg.payload_len);
+    char **args = calloc(msg.argc + 1, sizeof(char *));
+    char **env = calloc(msg.envc + 1, sizeof(char *));
+    if (!payload || !args || !env ||
+        read_full(launch_fd, payload, msg.payload_len) == -1 ||
+        payload[msg.payload_len - 1] != '\0') {
+        nk_log_error("Failed to receive launch payload");
+        (void)write(launch_fd, &status, 1);
+        return 1;
+    }
+
+    size_t off = 0;
+    const char *cwd = payload;
+    off += strlen(payload) + 1;
+    for (uint32_t i = 0; i < msg.argc + msg.envc; i++) {
+        if (off >= msg.payload_len) {
+            nk_log_error("Truncated launch payload");
+            (void)write(launch_fd, &status, 1);
+            return 1;
+        }
+        if (i < msg.argc) {
+            args[i] = payload + off;
+        } else {
+            env[i - msg.argc] = payload + off;
+        }
+        off += strlen(payload + off) + 1;
+    }
+
+    for (int i = 0; i < LAUNCH_STDIO_FDS; i++) {
+        if (fds[i] >= 0) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+
+    if (chdir(cwd) == -1) {
+        nk_log_warn("Failed to chdir to %s: %s", cwd, strerror(errno));
+        chdir("/");
+    }
+
+    nk_log_debug("Executing: %s", args[0]);
+    nk_log_flush();
+    execve(args[0], args, env);
+
+    nk_log_error("Failed to execute %s: %s", args[0], strerror(errno));
+    (void)write(launch_fd, &status, 1);
+    return 1;
+}
+
+/**
+ * container_child_wait_fifo - Block on the exec FIFO, then return to exec
+ * @fifo_fd: O_PATH descriptor opened before pivot_root
+ *
+ * Opening the FIFO for writing blocks until `start` opens it for reading.
+ * The path is gone after pivot_root, so reopen through /proc/self/fd.
+ */
+static int container_child_wait_fifo(int fifo_fd) {
+    char fd_path[64];
+    const char byte = CHILD_SYNC_READY;
+    int fd;
+
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", fifo_fd);
+    do {
+        fd = open(fd_path, O_WRONLY | O_CLOEXEC);
+    } while (fd == -1 && errno == EINTR);
+    close(fifo_fd);
+
+    if (fd == -1) {
+        nk_log_error("Failed to open exec fifo: %s", strerror(errno));
+        return -1;
+    }
+    if (write(fd, &byte, 1) != 1) {
+        nk_log_error("Failed to signal exec fifo: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * container_child_sync - Report setup status and child phase timings to the parent
+ */
+static void container_child_sync(container_exec_ctx_t *exec_ctx, char status) {
+    child_sync_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = CHILD_SYNC_MAGIC;
+    msg.status = (uint32_t)status;
+    if (exec_ctx->ctx->trace) {
+        for (int i = 0; i < NK_TRACE_PHASES; i++) {
+            if (nk_trace_phase_in_child((nk_trace_phase_t)i)) {
+                msg.trace.span[i] = exec_ctx->ctx->trace->span[i];
+            }
+        }
+    }
+    nk_log_flush();
+    (void)write(exec_ctx->sync_pipe[1], &msg, sizeof(msg));
+    close(exec_ctx->sync_pipe[1]);
+}
+
 /**
  * container_child_fn - Child process execution function
  */
@@ -117,6 +363,18 @@ static int container_child_fn(void *arg) {
     /* Close parent end of sync pipe */
     close(exec_ctx->sync_pipe[0]);
 
+    /* Grab the exec FIFO while its host path is still reachable */
+    int fifo_fd = -1;
+    if (exec_ctx->exec_fifo) {
+        fifo_fd = open(exec_ctx->exec_fifo, O_PATH | O_CLOEXEC);
+        if (fifo_fd == -1) {
+            nk_log_error("Failed to open exec fifo %s: %s",
+                    exec_ctx->exec_fifo, strerror(errno));
+            container_child_sync(exec_ctx, CHILD_SYNC_ERROR);
+            return 1;
+        }
+    }
+
     /* Setup hostname */
     if (exec_ctx->hostname && ctx->namespaces) {
         for (size_t i = 0; i < ctx->namespaces_len; i++) {
@@ -131,9 +389,7 @@ static int container_child_fn(void *arg) {
     /* Setup root filesystem */
     nk_log_debug("Setting up root filesystem");
     if (nk_container_setup_rootfs(ctx) == -1) {
-        const char status = CHILD_SYNC_ERROR;
-        (void)write(exec_ctx->sync_pipe[1], &status, 1);
-        close(exec_ctx->sync_pipe[1]);
+        container_child_sync(exec_ctx, CHILD_SYNC_ERROR);
         return 1;
     }
     nk_log_debug("Root filesystem ready");
@@ -157,6 +413,9 @@ static int container_child_fn(void *arg) {
     /* Set resource limits */
     nk_process_set_rlimits();
 
+    /* Memory policy (and CPU pinning without cpuset) from cpuset placement */
+    nk_placement_set_mempolicy(ctx);
+
     /*
      * Detached/non-terminal workloads should not share the caller's
      * controlling terminal, otherwise a parent/session exit can deliver SIGHUP.
@@ -171,12 +430,18 @@ static int container_child_fn(void *arg) {
 
     /* Notify parent we're ready */
     nk_log_debug("Notifying parent: ready to exec");
-    const char ready = CHILD_SYNC_READY;
-    (void)write(exec_ctx->sync_pipe[1], &ready, 1);
-    close(exec_ctx->sync_pipe[1]);
+    container_child_sync(exec_ctx, CHILD_SYNC_READY);
+
+    if (exec_ctx->launch_fd >= 0) {
+        return container_child_wait_launch(exec_ctx->launch_fd);
+    }
+    if (fifo_fd >= 0 && container_child_wait_fifo(fifo_fd) == -1) {
+        return 1;
+    }
 
     /* Execute the container process */
     nk_log_debug("Executing: %s", ctx->args[0]);
+    nk_log_flush();
     if (ctx->args && ctx->args_len > 0) {
         execve(ctx->args[0], ctx->args, exec_ctx->env);
     }
@@ -192,38 +457,110 @@ static int container_child_fn(void *arg) {
     return 1;
 }
 
+/* clone() entry point: returning exits the child without running atexit */
+static int container_child_clone_fn(void *arg) {
+    int status = container_child_fn(arg);
+
+    nk_log_flush();
+    return status;
+}
+
 /**
- * nk_container_exec - Execute container process
+ * container_clone3 - clone3() the child into its cgroup, returning a pidfd
+ *
+ * No stack is passed, so the child runs fork()-style on a copy of ours.
+ * Returns the child pid, or -1 with errno set (ENOSYS when clone3 is absent).
  */
-pid_t nk_container_exec(const nk_container_ctx_t *ctx) {
-    if (!ctx || !ctx->rootfs || !ctx->args || ctx->args_len == 0) {
-        nk_log_error("Invalid container context");
-        return -1;
+static pid_t container_clone3(container_exec_ctx_t *exec_ctx, uint64_t ns_flags,
+                              int cgroup_fd, int *pidfd) {
+    nk_clone_args_t args;
+    int child_pidfd = -1;
+
+    memset(&args, 0, sizeof(args));
+    args.flags = ns_flags | CLONE_PIDFD;
+    args.pidfd = (uint64_t)(uintptr_t)&child_pidfd;
+    args.exit_signal = SIGCHLD;
+    if (cgroup_fd >= 0) {
+        args.flags |= CLONE_INTO_CGROUP;
+        args.cgroup = (uint64_t)cgroup_fd;
     }
 
-    /* Get clone flags for namespaces */
-    int clone_flags = SIGCHLD;
-    if (ctx->namespaces) {
-        clone_flags |= nk_namespace_get_clone_flags(ctx->namespaces, ctx->namespaces_len);
+    nk_log_flush();  /* the child must not inherit queued records */
+    long ret = syscall(SYS_clone3, &args, sizeof(args));
+    if (ret == 0) {
+        int status = container_child_fn(exec_ctx);
+        nk_log_flush();
+        _exit(status);
+    }
+    if (ret == -1) {
+        return -1;
     }
 
-    nk_log_debug("Clone flags: %s (0x%x)", nk_namespace_flags_to_string(clone_flags), clone_flags);
-    nk_log_info("Clone flags: %s", nk_namespace_flags_to_string(clone_flags));
+    if (pidfd) {
+        *pidfd = child_pidfd;
+    } else {
+        close(child_pidfd);
+    }
+    return (pid_t)ret;
+}
 
+/**
+ * container_clone - Legacy clone() path with a heap stack
+ */
+static pid_t container_clone(container_exec_ctx_t *exec_ctx, int clone_flags,
+                             char **stack_out) {
     if (nk_log_educational) {
         nk_log_explain_op("Allocating stack for child process",
             "clone() requires separate stack. Unlike fork(), clone can create threads with shared memory.");
     }
 
-    /* Create stack for child process */
     char *stack = malloc(STACK_SIZE);
     if (!stack) {
         nk_log_error("Failed to allocate stack");
         return -1;
     }
-    char *stack_top = stack + STACK_SIZE;
     nk_log_debug("Allocated %d byte stack at %p", STACK_SIZE, stack);
 
+    nk_log_flush();  /* the child must not inherit queued records */
+    pid_t pid = clone(container_child_clone_fn, stack + STACK_SIZE, clone_flags, exec_ctx);
+    if (pid == -1) {
+        int saved_errno = errno;
+        free(stack);
+        errno = saved_errno;
+        return -1;
+    }
+
+    *stack_out = stack;
+    return pid;
+}
+
+/**
+ * container_spawn - Clone the container child and wait until it is ready
+ * @pidfd: Out pidfd of the child, or NULL
+ * @launch_fd: Child end of the launch channel to park on, or -1
+ * @exec_fifo: Exec FIFO to park on, or NULL
+ *
+ * With neither, the child execs as soon as setup completes.
+ */
+static pid_t container_spawn(const nk_container_ctx_t *ctx, int *pidfd,
+                             int launch_fd, const char *exec_fifo) {
+    if (pidfd) {
+        *pidfd = -1;
+    }
+    if (!ctx || !ctx->rootfs || !ctx->args || ctx->args_len == 0) {
+        nk_log_error("Invalid container context");
+        return -1;
+    }
+
+    /* Get clone flags for namespaces */
+    int clone_flags = SIGCHLD;
+    if (ctx->namespaces) {
+        clone_flags |= nk_namespace_get_clone_flags(ctx->namespaces, ctx->namespaces_len);
+    }
+
+    nk_log_debug("Clone flags: %s (0x%x)", nk_namespace_flags_to_string(clone_flags), clone_flags);
+    nk_log_info("Clone flags: %s", nk_namespace_flags_to_string(clone_flags));
+
     /* Create sync pipe for parent-child coordination */
     if (nk_log_educational) {
         nk_log_explain_op("Creating sync pipe",
@@ -234,7 +571,6 @@ pid_t nk_container_exec(const nk_container_ctx_t *ctx) {
     int sync_pipe[2];
     if (pipe(sync_pipe) == -1) {
         nk_log_error("Failed to create sync pipe: %s", strerror(errno));
-        free(stack);
         return -1;
     }
     nk_log_debug("Sync pipe created: fd[%d, %d]", sync_pipe[0], sync_pipe[1]);
@@ -244,6 +580,8 @@ pid_t nk_container_exec(const nk_container_ctx_t *ctx) {
         .ctx = ctx,
         .sync_pipe[0] = sync_pipe[0],
         .sync_pipe[1] = sync_pipe[1],
+        .launch_fd = launch_fd,
+        .exec_fifo = exec_fifo,
         .env = NULL,
     };
 
@@ -252,51 +590,332 @@ pid_t nk_container_exec(const nk_container_ctx_t *ctx) {
         exec_ctx.env = ctx->env;
     } else {
         /* Default environment */
-        static char *default_env[] = {
-            "PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin",
-            "TERM=xterm",
-            "HOME=/root",
-            NULL,
-        };
         exec_ctx.env = default_env;
     }
 
     /* Clone child process */
     nk_log_set_role(NK_LOG_ROLE_PARENT);
-    pid_t pid = clone(container_child_fn, stack_top, clone_flags, &exec_ctx);
+    char *stack = NULL;
+    bool in_cgroup = false;
+    pid_t pid = -1;
+    uint64_t ns_flags = (uint64_t)(clone_flags & ~CSIGNAL);
+
+    nk_trace_begin(ctx->trace, NK_TRACE_CLONE);
+    if (!clone3_unsupported) {
+        if (nk_log_educational) {
+            nk_log_explain_op("Cloning with clone3()",
+                "CLONE_INTO_CGROUP starts the child inside its cgroup, so it is never "
+                "accounted to ours; CLONE_PIDFD returns a race-free handle to it.");
+        }
+
+        pid = container_clone3(&exec_ctx, ns_flags, ctx->cgroup_fd, pidfd);
+        in_cgroup = (pid != -1 && ctx->cgroup_fd >= 0);
+        if (pid == -1 && ctx->cgroup_fd >= 0 && errno != ENOSYS && errno != E2BIG) {
+            /* e.g. controllers enabled in a domain cgroup; attach by pid instead */
+            nk_log_debug("clone3 into cgroup failed (%s); retrying without", strerror(errno));
+            pid = container_clone3(&exec_ctx, ns_flags, -1, pidfd);
+        }
+        if (pid == -1 && (errno == ENOSYS || errno == E2BIG)) {
+            nk_log_debug("clone3 unavailable; falling back to clone()");
+            clone3_unsupported = true;
+        }
+    }
+    if (pid == -1 && clone3_unsupported) {
+        pid = container_clone(&exec_ctx, clone_flags, &stack);
+    }
     if (pid == -1) {
         nk_stderr( "Error: Failed to clone container process: %s\n",
                 strerror(errno));
         close(sync_pipe[0]);
         close(sync_pipe[1]);
-        free(stack);
         return -1;
     }
+    nk_trace_end(ctx->trace, NK_TRACE_CLONE);
+    nk_trace_begin(ctx->trace, NK_TRACE_CHILD_READY);
 
     /* Close child end of sync pipe */
     close(sync_pipe[1]);
 
-    /* Wait for child to signal ready */
-    char buf;
-    ssize_t ret = read(sync_pipe[0], &buf, 1);
-    if (ret <= 0 || buf != CHILD_SYNC_READY) {
+    /* Attach before the child finishes setup so its mounts are charged to it */
+    if (!in_cgroup && ctx->cgroup_fd >= 0) {
+        nk_trace_begin(ctx->trace, NK_TRACE_CGROUP_ATTACH);
+        if (nk_cgroup_attach_fd(ctx->cgroup_fd, pid) == -1) {
+            /* Outside the cgroup no limit applies and delete could not find it */
+            kill(pid, SIGKILL);
+            while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+            }
+            close(sync_pipe[0]);
+            if (pidfd && *pidfd >= 0) {
+                close(*pidfd);
+                *pidfd = -1;
+            }
+            free(stack);
+            return -1;
+        }
+        nk_trace_end(ctx->trace, NK_TRACE_CGROUP_ATTACH);
+    }
+
+    /* Wait for child to signal ready, along with its phase timings */
+    child_sync_msg_t msg;
+    if (read_full(sync_pipe[0], &msg, sizeof(msg)) == -1 ||
+        msg.magic != CHILD_SYNC_MAGIC || msg.status != CHILD_SYNC_READY) {
         nk_stderr( "Error: Child process failed to initialize\n");
         close(sync_pipe[0]);
         (void)waitpid(pid, NULL, 0);
+        if (pidfd && *pidfd >= 0) {
+            close(*pidfd);
+            *pidfd = -1;
+        }
         free(stack);
         return -1;
     }
     close(sync_pipe[0]);
+    nk_trace_end(ctx->trace, NK_TRACE_CHILD_READY);
 
-    /* Add child to cgroup */
-    if (exec_ctx.container_id) {
-        nk_container_add_to_cgroup(exec_ctx.container_id, pid);
+    if (ctx->trace) {
+        for (int i = 0; i < NK_TRACE_PHASES; i++) {
+            if (nk_trace_phase_in_child((nk_trace_phase_t)i)) {
+                ctx->trace->span[i] = msg.trace.span[i];
+            }
+        }
     }
 
     free(stack);
     return pid;
 }
 
+/**
+ * nk_container_spawn - Clone container process, optionally returning a pidfd
+ */
+pid_t nk_container_spawn(const nk_container_ctx_t *ctx, int *pidfd) {
+    return container_spawn(ctx, pidfd, -1, NULL);
+}
+
+/**
+ * nk_container_exec - Execute container process
+ */
+pid_t nk_container_exec(const nk_container_ctx_t *ctx) {
+    return container_spawn(ctx, NULL, -1, NULL);
+}
+
+/**
+ * nk_container_exec_parked - Prepare container process, park before execve
+ */
+pid_t nk_container_exec_parked(const nk_container_ctx_t *ctx, int *launch_fd) {
+    int sv[2];
+
+    if (!launch_fd) {
+        return -1;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+        nk_log_error("Failed to create launch channel: %s", strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = container_spawn(ctx, NULL, sv[1], NULL);
+    close(sv[1]);
+    if (pid == -1) {
+        close(sv[0]);
+        return -1;
+    }
+
+    *launch_fd = sv[0];
+    return pid;
+}
+
+/**
+ * nk_container_exec_fifo - Prepare container process, park on exec FIFO
+ */
+pid_t nk_container_exec_fifo(const nk_container_ctx_t *ctx, const char *exec_fifo) {
+    if (!exec_fifo) {
+        return -1;
+    }
+
+    if (mkfifo(exec_fifo, 0600) == -1 && errno != EEXIST) {
+        nk_log_error("Failed to create exec fifo %s: %s", exec_fifo, strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = container_spawn(ctx, NULL, -1, exec_fifo);
+    if (pid == -1) {
+        unlink(exec_fifo);
+    }
+    return pid;
+}
+
+/**
+ * nk_container_release_fifo - Release a child parked on its exec FIFO
+ */
+int nk_container_release_fifo(const char *exec_fifo, pid_t pid, int timeout_ms) {
+    struct timespec start, now;
+    char byte;
+    int fd;
+
+    if (!exec_fifo || pid <= 0) {
+        return -1;
+    }
+
+    /* Non-blocking open never waits for a writer; the parked child is one */
+    fd = open(exec_fifo, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        nk_stderr("Error: Failed to open exec fifo %s: %s\n", exec_fifo, strerror(errno));
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, 50);
+
+        if (ready > 0 && read(fd, &byte, 1) == 1) {
+            break;
+        }
+        if (ready == -1 && errno != EINTR) {
+            nk_stderr("Error: poll on exec fifo failed: %s\n", strerror(errno));
+            close(fd);
+            return -1;
+        }
+        if (kill(pid, 0) == -1 && errno == ESRCH) {
+            nk_stderr("Error: Parked container process %d is gone\n", (int)pid);
+            close(fd);
+            return -1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                          (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (timeout_ms >= 0 && elapsed_ms >= timeout_ms) {
+            nk_stderr("Error: Timed out releasing parked container process %d\n", (int)pid);
+            close(fd);
+            return -1;
+        }
+    }
+
+    close(fd);
+    unlink(exec_fifo);
+    return 0;
+}
+
+/**
+ * nk_container_launch - Send args/env/cwd + stdio to a parked child
+ */
+int nk_container_launch(pid_t pid, int launch_fd, const nk_container_ctx_t *ctx) {
+    char **env;
+    size_t envc = 0;
+    size_t len;
+    char *payload = NULL;
+    int ret = -1;
+
+    if (launch_fd < 0 || !ctx || !ctx->args || ctx->args_len == 0) {
+        if (launch_fd >= 0) {
+            close(launch_fd);
+        }
+        return -1;
+    }
+
+    env = (ctx->env && ctx->env_len > 0) ? ctx->env : default_env;
+    while (env[envc]) {
+        envc++;
+    }
+
+    const char *cwd = ctx->cwd ? ctx->cwd : "/";
+    len = strlen(cwd) + 1;
+    for (size_t i = 0; i < ctx->args_len; i++) {
+        len += strlen(ctx->args[i]) + 1;
+    }
+    for (size_t i = 0; i < envc; i++) {
+        len += strlen(env[i]) + 1;
+    }
+    if (len > LAUNCH_MAX_PAYLOAD || ctx->args_len > LAUNCH_MAX_STRINGS ||
+        envc > LAUNCH_MAX_STRINGS) {
+        nk_log_error("Process args/env too large to launch parked child");
+        goto out;
+    }
+
+    payload = malloc(len);
+    if (!payload) {
+        goto out;
+    }
+
+    size_t off = 0;
+    size_t n = strlen(cwd) + 1;
+    memcpy(payload, cwd, n);
+    off += n;
+    for (size_t i = 0; i < ctx->args_len; i++) {
+        n = strlen(ctx->args[i]) + 1;
+        memcpy(payload + off, ctx->args[i], n);
+        off += n;
+    }
+    for (size_t i = 0; i < envc; i++) {
+        n = strlen(env[i]) + 1;
+        memcpy(payload + off, env[i], n);
+        off += n;
+    }
+
+    launch_msg_t msg = {
+        .magic = LAUNCH_MAGIC,
+        .argc = (uint32_t)ctx->args_len,
+        .envc = (uint32_t)envc,
+        .payload_len = (uint32_t)len,
+    };
+    int fds[LAUNCH_STDIO_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr mh = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    memset(control, 0, sizeof(control));
+    struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+    nk_log_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    if (sendmsg(launch_fd, &mh, MSG_NOSIGNAL) != (ssize_t)sizeof(msg)) {
+        nk_log_debug("Parked child %d is gone: %s", (int)pid, strerror(errno));
+        goto out;
+    }
+
+    for (off = 0; off < len; ) {
+        ssize_t w = send(launch_fd, payload + off, len - off, MSG_NOSIGNAL);
+        if (w == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            nk_log_debug("Failed to send launch payload to %d: %s", (int)pid, strerror(errno));
+            goto out;
+        }
+        off += (size_t)w;
+    }
+
+    /* EOF: the close-on-exec launch socket went away in execve() */
+    char status;
+    ssize_t r;
+    do {
+        r = read(launch_fd, &status, 1);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == 0) {
+        ret = 0;
+    } else {
+        nk_stderr("Error: Parked container process %d failed to exec\n", (int)pid);
+    }
+
+out:
+    free(payload);
+    close(launch_fd);
+    return ret;
+}
+
 /**
  * nk_container_wait - Wait for container process to exit
  */
@@ -320,3 +939,173 @@ int nk_container_signal(pid_t pid, int sig) {
     }
     return 0;
 }
+
+/**
+ * nk_container_pidfd - pidfd_open() the init PID and check it is still ours
+ */
+int nk_container_pidfd(const char *container_id, pid_t pid) {
+    if (pid <= 0) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd == -1) {
+        return -1;
+    }
+
+    /* Readable means init has exited; only a zombie is left to reap */
+    struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+    if (poll(&pfd, 1, 0) == 1) {
+        close(pidfd);
+        errno = ESRCH;
+        return -1;
+    }
+
+    /* The pidfd pins the process, so this check cannot race with reuse */
+    if (container_id && nk_cgroup_has_pid(container_id, pid) == 0) {
+        if (kill(pid, 0) == 0 || errno == EPERM) {
+            nk_log_warn("PID %d is not in the cgroup of container '%s'; not signalling it",
+                    (int)pid, container_id);
+        }
+        close(pidfd);
+        errno = ESRCH;
+        return -1;
+    }
+    return pidfd;
+}
+
+/**
+ * nk_container_pidfd_signal - pidfd_send_signal() wrapper
+ */
+int nk_container_pidfd_signal(int pidfd, int sig) {
+    return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+}
+
+/* Signal init through its pidfd, or by PID when there is none */
+static int stop_send(int pidfd, pid_t pid, int sig) {
+    int ret = pidfd >= 0 ? nk_container_pidfd_signal(pidfd, sig) : kill(pid, sig);
+
+    if (ret == -1 && errno != ESRCH) {
+        nk_stderr("Error: Failed to send signal %d to PID %d: %s\n",
+                sig, (int)pid, strerror(errno));
+    }
+    return ret;
+}
+
+/*
+ * A PID namespace init only receives signals it has a handler for (plus
+ * SIGKILL/SIGSTOP), so SIGTERM to a shell or sleep as PID 1 is dropped.
+ */
+static bool stop_signal_ignored(pid_t pid, int sig) {
+    char path[64];
+    char line[256];
+    unsigned long long ign = 0, cgt = 0;
+    bool ns_init = false;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    if (!(f = fopen(path, "re"))) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "SigIgn: %llx", &ign) == 1 || sscanf(line, "SigCgt: %llx", &cgt) == 1) {
+            continue;
+        }
+        if (strncmp(line, "NSpid:", 6) == 0) {
+            char *last = strrchr(line, '\t');
+            ns_init = last && last != strchr(line, '\t') && strtol(last + 1, NULL, 10) == 1;
+        }
+    }
+    fclose(f);
+
+    unsigned long long mask = 1ull << (sig - 1);
+    return (ign & mask) || (ns_init && !(cgt & mask));
+}
+
+static int64_t stop_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Wait up to timeout_ms for init to exit: poll the pidfd, else probe the PID */
+static bool stop_wait_exit(int pidfd, pid_t pid, int timeout_ms) {
+    int64_t deadline = stop_now_ms() + timeout_ms;
+
+    for (;;) {
+        int64_t left = deadline - stop_now_ms();
+
+        if (pidfd >= 0) {
+            struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+            int ret = poll(&pfd, 1, left > 0 ? (int)left : 0);
+
+            if (ret > 0) {
+                return true;
+            }
+            if (ret == 0 || errno != EINTR) {
+                return false;
+            }
+            continue;
+        }
+
+        /* Reap it if it is our child, or kill(pid, 0) would see the zombie */
+        if (waitpid(pid, NULL, WNOHANG) == pid || (kill(pid, 0) == -1 && errno == ESRCH)) {
+            return true;
+        }
+        if (left <= 0) {
+            return false;
+        }
+        usleep(STOP_PROBE_INTERVAL_US);
+    }
+}
+
+/**
+ * nk_container_stop - SIGTERM, wait on the pidfd, then cgroup.kill
+ */
+int nk_container_stop(const char *container_id, pid_t pid, int grace_ms) {
+    bool exited = false;
+    int pidfd = nk_container_pidfd(container_id, pid);
+
+    if (pidfd == -1 && errno != ENOSYS) {
+        /* Init is already gone; sweep up anything it left behind */
+        (void)nk_cgroup_kill(container_id, SIGKILL);
+        return 0;
+    }
+
+    if (grace_ms > 0 && stop_signal_ignored(pid, SIGTERM)) {
+        nk_log_info("PID %d does not handle SIGTERM; killing without a grace period", (int)pid);
+    } else if (grace_ms > 0) {
+        if (stop_send(pidfd, pid, SIGTERM) == -1) {
+            exited = errno == ESRCH;
+        } else {
+            exited = stop_wait_exit(pidfd, pid, grace_ms);
+        }
+        if (!exited) {
+            nk_log_warn("Force killing...");
+        }
+    }
+
+    /* cgroup.kill takes init and everything else; without a cgroup, just init */
+    if (nk_cgroup_kill(container_id, SIGKILL) == -1 && !exited) {
+        (void)stop_send(pidfd, pid, SIGKILL);
+    }
+    if (!exited) {
+        exited = stop_wait_exit(pidfd, pid, STOP_KILL_WAIT_MS);
+    }
+
+    if (pidfd >= 0) {
+        siginfo_t info;
+
+        /* Reap init if we are its parent (the daemon); ECHILD otherwise */
+        (void)waitid(P_PIDFD, (id_t)pidfd, &info, WEXITED | WNOHANG);
+        close(pidfd);
+    }
+
+    if (!exited) {
+        nk_stderr("Error: PID %d did not exit after SIGKILL\n", (int)pid);
+        return -1;
+    }
+    return 0;
+}
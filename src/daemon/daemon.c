@@ -0,0 +1,680 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "nk_daemon.h"
+#include "nk_container.h"
+#include "nk_oci.h"
+#include "nk_log.h"
+#include "common/state.h"
+
+#define NK_DAEMON_MAGIC 0x4e4b4431u  /* "NKD1" */
+#define NK_DAEMON_VERSION 2
+#define NK_DAEMON_MAX_PAYLOAD (64 * 1024)
+#define NK_DAEMON_MAX_ARGS 256
+#define NK_DAEMON_MAX_ENV 64
+#define NK_DAEMON_STDIO_FDS 3
+#define NK_DAEMON_POLL_MS 1000
+
+/*
+ * Wire format (client -> daemon):
+ *   nk_daemon_request_t header, carrying the client's stdin/stdout/stderr
+ *   as SCM_RIGHTS ancillary data, followed by payload_len bytes holding
+ *   the client cwd, argv[0..argc-1] and then envc NS_* "NAME=value"
+ *   entries, each NUL-terminated.
+ *
+ * Reply (daemon -> client): nk_daemon_reply_t.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t payload_len;
+    int32_t log_level;
+    uint8_t log_enabled;
+    uint8_t log_educational;
+    uint8_t reserved[2];
+} nk_daemon_request_t;
+
+typedef struct {
+    uint32_t magic;
+    int32_t exit_code;
+} nk_daemon_reply_t;
+
+static volatile sig_atomic_t daemon_stop = 0;
+static nk_daemon_idle_fn daemon_idle_fn = NULL;
+
+void nk_daemon_set_idle_handler(nk_daemon_idle_fn fn) {
+    daemon_idle_fn = fn;
+}
+
+static void daemon_signal_handler(int sig) {
+    (void)sig;
+    daemon_stop = 1;
+}
+
+static int daemon_socket_path(const char *state_dir, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    int n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s",
+                     state_dir, NK_DAEMON_SOCKET_NAME);
+    if (n < 0 || (size_t)n >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * NS_* settings are read with getenv() while a command runs, so they travel
+ * with the request. NS_RUN_DIR is left alone: it picked the socket, so both
+ * sides already agree on the state dir.
+ */
+static bool daemon_env_forwarded(const char *entry) {
+    return strncmp(entry, "NS_", 3) == 0 && strncmp(entry, "NS_RUN_DIR=", 11) != 0 &&
+           strchr(entry, '=') != NULL;
+}
+
+bool nk_daemon_is_bypassed(void) {
+    const char *env = getenv(NK_DAEMON_BYPASS_ENV);
+    return env && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Client side                                                               */
+/* ------------------------------------------------------------------------ */
+
+static int send_request(int sock, const nk_daemon_request_t *req) {
+    int fds[NK_DAEMON_STDIO_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {
+        .iov_base = (void *)req,
+        .iov_len = sizeof(*req),
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    memset(control, 0, sizeof(control));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+
+    if (n != (ssize_t)sizeof(*req)) {
+        return -1;
+    }
+    return 0;
+}
+
+int nk_daemon_forward(const char *state_dir, int argc, char *argv[], int *exit_code) {
+    struct sockaddr_un addr;
+    char cwd[PATH_MAX];
+    char *payload = NULL;
+    size_t payload_len = 0;
+    int sock;
+
+    if (!state_dir || argc <= 0 || !argv) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (daemon_socket_path(state_dir, &addr) == -1) {
+        return 1;
+    }
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        return 1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        /* No daemon (or a stale socket): run the command in-process */
+        close(sock);
+        return 1;
+    }
+
+    if (!getcwd(cwd, sizeof(cwd))) {
+        nk_log_error("Failed to resolve working directory: %s", strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    uint32_t envc = 0;
+    payload_len = strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++) {
+        payload_len += strlen(argv[i]) + 1;
+    }
+    for (char **env = environ; *env; env++) {
+        if (daemon_env_forwarded(*env)) {
+            payload_len += strlen(*env) + 1;
+            envc++;
+        }
+    }
+    if (payload_len > NK_DAEMON_MAX_PAYLOAD || argc > NK_DAEMON_MAX_ARGS ||
+        envc > NK_DAEMON_MAX_ENV) {
+        nk_log_error("Command line too large to forward to ns-runtimed");
+        close(sock);
+        return -1;
+    }
+
+    payload = malloc(payload_len);
+    if (!payload) {
+        close(sock);
+        return -1;
+    }
+
+    size_t off = 0;
+    size_t len = strlen(cwd) + 1;
+    memcpy(payload + off, cwd, len);
+    off += len;
+    for (int i = 0; i < argc; i++) {
+        len = strlen(argv[i]) + 1;
+        memcpy(payload + off, argv[i], len);
+        off += len;
+    }
+    for (char **env = environ; *env; env++) {
+        if (daemon_env_forwarded(*env)) {
+            len = strlen(*env) + 1;
+            memcpy(payload + off, *env, len);
+            off += len;
+        }
+    }
+
+    nk_log_apply_env();
+    nk_daemon_request_t req = {
+        .magic = NK_DAEMON_MAGIC,
+        .version = NK_DAEMON_VERSION,
+        .argc = (uint32_t)argc,
+        .envc = envc,
+        .payload_len = (uint32_t)payload_len,
+        .log_level = (int32_t)nk_log_level,
+        .log_enabled = nk_log_enabled ? 1 : 0,
+        .log_educational = nk_log_educational ? 1 : 0,
+    };
+
+    /* Our own buffered output must land before the daemon writes to the same fds */
+    nk_log_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    nk_daemon_reply_t reply;
+    if (send_request(sock, &req) == -1 ||
+        write_full(sock, payload, payload_len) == -1 ||
+        read_full(sock, &reply, sizeof(reply)) == -1) {
+        nk_log_error("Lost connection to ns-runtimed: %s", strerror(errno));
+        free(payload);
+        close(sock);
+        return -1;
+    }
+
+    free(payload);
+    close(sock);
+
+    if (reply.magic != NK_DAEMON_MAGIC) {
+        nk_log_error("Malformed reply from ns-runtimed");
+        return -1;
+    }
+
+    if (exit_code) {
+        *exit_code = reply.exit_code;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Daemon side                                                               */
+/* ------------------------------------------------------------------------ */
+
+static int recv_request(int conn, nk_daemon_request_t *req, int fds[NK_DAEMON_STDIO_FDS]) {
+    char control[CMSG_SPACE(sizeof(int) * NK_DAEMON_STDIO_FDS)];
+    struct iovec iov = {
+        .iov_base = req,
+        .iov_len = sizeof(*req),
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    for (int i = 0; i < NK_DAEMON_STDIO_FDS; i++) {
+        fds[i] = -1;
+    }
+
+    ssize_t n;
+    do {
+        n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+
+    if (n != (ssize_t)sizeof(*req)) {
+        return -1;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int) * NK_DAEMON_STDIO_FDS)) {
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * NK_DAEMON_STDIO_FDS);
+        }
+    }
+
+    if (req->magic != NK_DAEMON_MAGIC || req->version != NK_DAEMON_VERSION ||
+        req->argc == 0 || req->argc > NK_DAEMON_MAX_ARGS || req->envc > NK_DAEMON_MAX_ENV ||
+        req->payload_len == 0 || req->payload_len > NK_DAEMON_MAX_PAYLOAD) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Split the payload into cwd + argv + env; argv[argc] and env[envc] are NULL */
+static int unpack_payload(char *payload, size_t len, uint32_t argc, uint32_t envc,
+                          const char **cwd, char **argv, char **env) {
+    size_t off = 0;
+
+    if (payload[len - 1] != '\0') {
+        return -1;
+    }
+
+    *cwd = payload;
+    off = strlen(payload) + 1;
+
+    for (uint32_t i = 0; i < argc; i++) {
+        if (off >= len) {
+            return -1;
+        }
+        argv[i] = payload + off;
+        off += strlen(payload + off) + 1;
+    }
+    argv[argc] = NULL;
+
+    for (uint32_t i = 0; i < envc; i++) {
+        if (off >= len || !daemon_env_forwarded(payload + off)) {
+            return -1;
+        }
+        env[i] = payload + off;
+        off += strlen(payload + off) + 1;
+    }
+    env[envc] = NULL;
+    return 0;
+}
+
+/*
+ * Swap our NS_* variables for @env. The previous set is returned as
+ * strdup()ed "NAME=value" entries for the call that puts it back.
+ */
+static char **swap_env(char *const *env) {
+    size_t n = 0;
+    char **saved;
+
+    for (char **e = environ; *e; e++) {
+        n += daemon_env_forwarded(*e);
+    }
+    saved = calloc(n + 1, sizeof(*saved));
+    if (!saved) {
+        return NULL;
+    }
+
+    n = 0;
+    for (char **e = environ; *e; e++) {
+        if (daemon_env_forwarded(*e) && (saved[n] = strdup(*e)) != NULL) {
+            n++;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        saved[i][strcspn(saved[i], "=")] = '\0';
+        unsetenv(saved[i]);
+        saved[i][strlen(saved[i])] = '=';
+    }
+
+    for (size_t i = 0; env[i]; i++) {
+        char *eq = strchr(env[i], '=');
+
+        *eq = '\0';
+        setenv(env[i], eq + 1, 1);
+        *eq = '=';
+    }
+    return saved;
+}
+
+/* Drop the request's NS_* variables and restore ours from swap_env() */
+static void restore_env(char *const *env, char **saved) {
+    for (size_t i = 0; env[i]; i++) {
+        char *eq = strchr(env[i], '=');
+
+        *eq = '\0';
+        unsetenv(env[i]);
+        *eq = '=';
+    }
+    for (size_t i = 0; saved && saved[i]; i++) {
+        char *eq = strchr(saved[i], '=');
+
+        *eq = '\0';
+        setenv(saved[i], eq + 1, 1);
+        free(saved[i]);
+    }
+    free(saved);
+}
+
+/*
+ * Run one request with the client's stdio, cwd, NS_* environment and log
+ * configuration in place, then restore the daemon's own.
+ */
+static int serve_request(const nk_daemon_request_t *req, int client_fds[NK_DAEMON_STDIO_FDS],
+                         const char *cwd, int argc, char **argv, char **env,
+                         nk_daemon_handler_t handler, int home_dir_fd) {
+    int saved_fds[NK_DAEMON_STDIO_FDS];
+    char **saved_env;
+    nk_log_level_t saved_level = nk_log_level;
+    bool saved_enabled = nk_log_enabled;
+    bool saved_educational = nk_log_educational;
+    int ret;
+
+    nk_log_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int i = 0; i < NK_DAEMON_STDIO_FDS; i++) {
+        saved_fds[i] = fcntl(i, F_DUPFD_CLOEXEC, NK_DAEMON_STDIO_FDS);
+        if (client_fds[i] >= 0) {
+            dup2(client_fds[i], i);
+        }
+    }
+
+    if (chdir(cwd) == -1) {
+        nk_stderr("Error: ns-runtimed cannot enter client directory %s: %s\n",
+                cwd, strerror(errno));
+        ret = 1;
+    } else if (!(saved_env = swap_env(env))) {
+        nk_stderr("Error: ns-runtimed cannot apply the client environment\n");
+        ret = 1;
+    } else {
+        nk_log_set_level((nk_log_level_t)req->log_level);
+        nk_log_enable(req->log_enabled != 0);
+        nk_log_set_educational(req->log_educational != 0);
+
+        ret = handler(argc, argv);
+        restore_env(env, saved_env);
+    }
+
+    nk_log_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int i = 0; i < NK_DAEMON_STDIO_FDS; i++) {
+        if (saved_fds[i] >= 0) {
+            dup2(saved_fds[i], i);
+            close(saved_fds[i]);
+        }
+    }
+
+    if (fchdir(home_dir_fd) == -1) {
+        nk_log_warn("ns-runtimed failed to restore working directory: %s", strerror(errno));
+    }
+
+    nk_log_set_level(saved_level);
+    nk_log_enable(saved_enabled);
+    nk_log_set_educational(saved_educational);
+    return ret;
+}
+
+static void handle_connection(int conn, nk_daemon_handler_t handler, int home_dir_fd) {
+    nk_daemon_request_t req;
+    int client_fds[NK_DAEMON_STDIO_FDS];
+    char *argv[NK_DAEMON_MAX_ARGS + 1];
+    char *env[NK_DAEMON_MAX_ENV + 1];
+    const char *cwd = NULL;
+    char *payload = NULL;
+    nk_daemon_reply_t reply = {
+        .magic = NK_DAEMON_MAGIC,
+        .exit_code = 1,
+    };
+
+    if (recv_request(conn, &req, client_fds) == -1) {
+        nk_log_warn("Dropping malformed ns-runtimed request: %s", strerror(errno));
+        goto out;
+    }
+
+    payload = malloc(req.payload_len);
+    if (!payload || read_full(conn, payload, req.payload_len) == -1 ||
+        unpack_payload(payload, req.payload_len, req.argc, req.envc, &cwd, argv, env) == -1) {
+        nk_log_warn("Dropping ns-runtimed request with bad payload");
+        goto out;
+    }
+
+    nk_log_debug("ns-runtimed: serving '%s'", req.argc > 1 ? argv[1] : argv[0]);
+    reply.exit_code = serve_request(&req, client_fds, cwd, (int)req.argc, argv, env,
+                                    handler, home_dir_fd);
+
+    (void)write_full(conn, &reply, sizeof(reply));
+
+out:
+    for (int i = 0; i < NK_DAEMON_STDIO_FDS; i++) {
+        if (client_fds[i] >= 0) {
+            close(client_fds[i]);
+        }
+    }
+    free(payload);
+}
+
+/* Run background work in small steps until a client shows up */
+static void run_idle_work(int listen_fd) {
+    if (!daemon_idle_fn) {
+        return;
+    }
+
+    while (!daemon_stop) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 0) != 0) {
+            return;
+        }
+        if (!daemon_idle_fn()) {
+            return;
+        }
+    }
+}
+
+/* Detached containers are our children while the daemon runs; reap them */
+static void reap_children(void) {
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        nk_log_debug("ns-runtimed: reaped child %d", (int)pid);
+    }
+}
+
+static int bind_socket(const char *state_dir) {
+    struct sockaddr_un addr;
+    int sock;
+
+    if (daemon_socket_path(state_dir, &addr) == -1) {
+        nk_log_error("Socket path too long for state dir %s", state_dir);
+        return -1;
+    }
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) {
+        nk_log_error("Failed to create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    /* Refuse to start twice; otherwise clear a stale socket file */
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        nk_log_error("ns-runtimed is already running on %s", addr.sun_path);
+        close(sock);
+        return -1;
+    }
+    if (unlink(addr.sun_path) == -1 && errno != ENOENT) {
+        nk_log_error("Failed to remove stale socket %s: %s", addr.sun_path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    mode_t old_mask = umask(0077);
+    int ret = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (ret == -1) {
+        nk_log_error("Failed to bind %s: %s", addr.sun_path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    if (listen(sock, SOMAXCONN) == -1) {
+        nk_log_error("Failed to listen on %s: %s", addr.sun_path, strerror(errno));
+        unlink(addr.sun_path);
+        close(sock);
+        return -1;
+    }
+
+    nk_log_info("ns-runtimed listening on %s", addr.sun_path);
+    return sock;
+}
+
+int nk_daemon_serve(const char *state_dir, nk_daemon_handler_t handler) {
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    int home_dir_fd;
+    int listen_fd;
+
+    if (!state_dir || !handler) {
+        return -1;
+    }
+
+    if (nk_log_educational) {
+        nk_log_explain_op("Starting ns-runtimed",
+            "A long-lived daemon keeps container state and parsed OCI specs in memory. "
+            "CLI invocations forward their arguments over a Unix socket instead of "
+            "re-reading state.json and config.json in a fresh process every time.");
+    }
+
+    home_dir_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (home_dir_fd == -1) {
+        nk_log_error("Failed to open working directory: %s", strerror(errno));
+        return -1;
+    }
+
+    listen_fd = bind_socket(state_dir);
+    if (listen_fd == -1) {
+        close(home_dir_fd);
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    nk_state_cache_enable(true);
+    nk_oci_spec_cache_enable(true);
+    (void)nk_mount_template_prepare();
+
+    while (!daemon_stop) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        nk_log_flush();
+        int ready = poll(&pfd, 1, NK_DAEMON_POLL_MS);
+
+        reap_children();
+
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            nk_log_error("poll failed: %s", strerror(errno));
+            break;
+        }
+        if (ready == 0) {
+            run_idle_work(listen_fd);
+            continue;
+        }
+
+        int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (conn == -1) {
+            if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+                nk_log_warn("accept failed: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        handle_connection(conn, handler, home_dir_fd);
+        close(conn);
+        reap_children();
+        run_idle_work(listen_fd);
+    }
+
+    nk_log_info("ns-runtimed shutting down");
+    nk_oci_spec_cache_enable(false);
+    nk_state_cache_enable(false);
+
+    if (daemon_socket_path(state_dir, &addr) == 0) {
+        unlink(addr.sun_path);
+    }
+    close(listen_fd);
+    close(home_dir_fd);
+    return 0;
+}
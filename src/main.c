@@ -6,19 +6,40 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <limits.h>
+#include <time.h>
 
 #include "nk.h"
 #include "nk_oci.h"
 #include "nk_container.h"
 #include "nk_log.h"
+#include "nk_batch.h"
+#include "nk_daemon.h"
+#include "nk_pool.h"
+#include "nk_placement.h"
+#include "common/list.h"
 #include "common/state.h"
+#include "common/stats.h"
+#include "common/events.h"
+#include "common/trace.h"
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
 
 #define NS_STATE_DIR_ROOT "/run/nano-sandbox"
 #define NS_STATE_DIR_USER_SUFFIX "/.local/share/nano-sandbox/run"
+#define NS_EXEC_FIFO_NAME "exec.fifo"
+#define NS_EXEC_FIFO_TIMEOUT_MS 10000
+#define NS_SPEC_IMAGE_DIR_NAME ".spec-cache"
+#define NS_SPEC_IMAGE_BYPASS_ENV "NS_NO_SPEC_IMAGE"
+#define NS_STOP_TIMEOUT_ENV "NS_STOP_TIMEOUT_MS"
+#define NS_STOP_TIMEOUT_DEFAULT_MS 10000
 
 static int mkdir_p(const char *path, mode_t mode) {
     char tmp[PATH_MAX];
@@ -65,22 +86,16 @@ static const char *get_state_dir(void) {
     int n;
 
     if (dir && dir[0] != '\0') {
-        nk_stderr( "[GET_STATE_DIR] NS_RUN_DIR=%s\n", dir);
-        fflush(stderr);
         return dir;
     }
 
     /* Backward compatibility for older scripts */
     dir = getenv("NK_RUN_DIR");
     if (dir && dir[0] != '\0') {
-        nk_stderr( "[GET_STATE_DIR] NK_RUN_DIR=%s (compat)\n", dir);
-        fflush(stderr);
         return dir;
     }
 
     if (geteuid() == 0) {
-        nk_stderr( "[GET_STATE_DIR] default (root): %s\n", NS_STATE_DIR_ROOT);
-        fflush(stderr);
         return NS_STATE_DIR_ROOT;
     }
 
@@ -88,14 +103,10 @@ static const char *get_state_dir(void) {
     if (home && home[0] != '\0') {
         n = snprintf(user_dir, sizeof(user_dir), "%s%s", home, NS_STATE_DIR_USER_SUFFIX);
         if (n > 0 && (size_t)n < sizeof(user_dir)) {
-            nk_stderr( "[GET_STATE_DIR] default (user): %s\n", user_dir);
-            fflush(stderr);
             return user_dir;
         }
     }
 
-    nk_stderr( "[GET_STATE_DIR] fallback: run\n");
-    fflush(stderr);
     return "run";
 }
 
@@ -107,7 +118,16 @@ static void print_usage(const char *prog_name) {
     nk_stderr( "  run [options] <container-id>      Create + start (Docker-style)\n");
     nk_stderr( "  exec [options] <container-id>     Run a command in a running container\n");
     nk_stderr( "  delete <container-id>             Delete a container\n");
-    nk_stderr( "  state <container-id>              Query container state\n\n");
+    nk_stderr( "  kill [--all] <container-id> [sig] Send a signal to a container (default: TERM)\n");
+    nk_stderr( "  update [options] <container-id>   Change CPU limits of a running container\n");
+    nk_stderr( "  state <container-id>              Query container state\n");
+    nk_stderr( "  trace [--json] <container-id>     Show per-phase timings of the last start\n");
+    nk_stderr( "  list [--json]                     List containers (alias: ps)\n");
+    nk_stderr( "  stats [options] <id>|--all        Stream cgroup CPU, memory, IO and PID usage\n");
+    nk_stderr( "  events [options] <id>|--all       Stream OOM, pids.max and PSI pressure events (NDJSON)\n");
+    nk_stderr( "  batch [--workers=N] <manifest>    Run NDJSON create/start/delete ops ('-': stdin)\n");
+    nk_stderr( "  daemon [--warm-pool=N]            Run ns-runtimed (serves lifecycle commands)\n");
+    nk_stderr( "  pool                              Show ns-runtimed warm and cgroup pool statistics\n\n");
     nk_stderr( "Options:\n");
     nk_stderr( "  -b, --bundle=<path>    Path to container bundle directory (default: .)\n");
     nk_stderr( "                         Bundle must contain: config.json and rootfs/\n");
@@ -117,6 +137,24 @@ static void print_usage(const char *prog_name) {
     nk_stderr( "  -d, --detach           Detached mode: return after start (start/run)\n");
     nk_stderr( "  -x, --exec=<command>   Command for exec (default: interactive /bin/sh)\n");
     nk_stderr( "      --rm               Remove container when attached run exits\n");
+    nk_stderr( "      --park             create: set up the init process now, start only releases it\n");
+    nk_stderr( "      --cpuset=<policy>  create/run: none|packed|spread|exclusive CPU and NUMA placement\n");
+    nk_stderr( "      --warm-pool=<n>    daemon: keep n pre-cloned children per bundle\n");
+    nk_stderr( "      --warm-refill=<n>  daemon: max children spawned per second (default: pool size)\n");
+    nk_stderr( "      --cgroup-pool=<n>  daemon: keep n pre-created container cgroups\n");
+    nk_stderr( "      --json             trace: emit JSON; list/batch: one JSON object per line\n");
+    nk_stderr( "      --workers=<n>      batch: worker processes (default: one per CPU)\n");
+    nk_stderr( "      --all              kill: signal every process in the container cgroup;\n");
+    nk_stderr( "                         stats/events: every container\n");
+    nk_stderr( "      --prometheus       stats: Prometheus text format (--json: NDJSON)\n");
+    nk_stderr( "      --interval=<ms>    stats: time between samples (default: 1000)\n");
+    nk_stderr( "      --no-stream        stats: print one sample and exit\n");
+    nk_stderr( "      --pressure=<s>/<w> events: PSI trigger, s ms stalled per w ms (default: 200/2000)\n");
+    nk_stderr( "      --cpu-shares=<n>   update: CPU shares, mapped onto cpu.weight (2-262144)\n");
+    nk_stderr( "      --cpu-quota=<us>   update: cpu.max quota per period, or max\n");
+    nk_stderr( "      --cpu-period=<us>  update: cpu.max period (1000-1000000)\n");
+    nk_stderr( "      --cpu-burst=<us>   update: cpu.max.burst, run time above quota a period may borrow\n");
+    nk_stderr( "      --cpu-idle=<0|1>   update: cpu.idle, 1 schedules the container as SCHED_IDLE\n");
     nk_stderr( "  -V, --verbose          Enable verbose logging\n");
     nk_stderr( "  -q, --quiet            Disable all logging\n");
     nk_stderr( "      --log-level=<lvl>  Set log level: debug|info|warn|error\n");
@@ -132,17 +170,25 @@ static void print_usage(const char *prog_name) {
     nk_stderr( "  exec -x '<cmd>'       Run one command inside running container\n");
     nk_stderr( "  shell as PID 1        Exit-prone: if process args are /bin/sh, exit stops container\n");
     nk_stderr( "  keepalive/app PID 1   Preferred: container stays running for exec sessions\n");
+    nk_stderr( "  ns-runtimed running   create/state/delete and detached start/run are served\n");
+    nk_stderr( "                        by the daemon (set NS_NO_DAEMON=1 to bypass)\n");
     nk_stderr( "\n");
     nk_stderr( "Examples:\n");
     nk_stderr( "  %s create --bundle=/usr/local/share/nano-sandbox/bundle my-container\n", prog_name);
     nk_stderr( "  %s start my-container\n", prog_name);
     nk_stderr( "  %s start -a my-container\n", prog_name);
+    nk_stderr( "  %s create --park --bundle=/usr/local/share/nano-sandbox/bundle my-container\n", prog_name);
     nk_stderr( "  %s run --bundle=/usr/local/share/nano-sandbox/bundle my-container\n", prog_name);
     nk_stderr( "  %s run -d --bundle=/usr/local/share/nano-sandbox/bundle my-container\n", prog_name);
     nk_stderr( "  %s exec my-container\n", prog_name);
     nk_stderr( "  %s exec -x 'ps -ef' my-container\n", prog_name);
     nk_stderr( "  # Exit-prone only when bundle process is an interactive shell (/bin/sh)\n");
+    nk_stderr( "  %s trace my-container\n", prog_name);
+    nk_stderr( "  %s list --json\n", prog_name);
+    nk_stderr( "  %s batch --workers=8 wave.ndjson\n", prog_name);
+    nk_stderr( "  %s kill my-container KILL\n", prog_name);
     nk_stderr( "  %s delete my-container\n", prog_name);
+    nk_stderr( "  %s daemon &\n", prog_name);
     nk_stderr( "\n");
     nk_stderr( "Setup test bundle:\n");
     nk_stderr( "  ./scripts/setup-rootfs.sh\n");
@@ -260,6 +306,38 @@ static void log_oci_start_summary(const nk_container_t *container, const nk_oci_
     }
 }
 
+static const struct {
+    const char *name;
+    int sig;
+} signal_names[] = {
+    { "HUP",  SIGHUP  }, { "INT",  SIGINT  }, { "QUIT",  SIGQUIT  }, { "KILL", SIGKILL },
+    { "USR1", SIGUSR1 }, { "USR2", SIGUSR2 }, { "PIPE",  SIGPIPE  }, { "ALRM", SIGALRM },
+    { "TERM", SIGTERM }, { "CONT", SIGCONT }, { "STOP",  SIGSTOP  }, { "TSTP", SIGTSTP },
+    { "WINCH", SIGWINCH },
+};
+
+/* Signal by number, or by name with or without the SIG prefix; -1 if unknown */
+static int parse_signal(const char *value) {
+    char *end = NULL;
+    long sig;
+
+    errno = 0;
+    sig = strtol(value, &end, 10);
+    if (end != value && *end == '\0') {
+        return (errno == 0 && sig > 0 && sig < NSIG) ? (int)sig : -1;
+    }
+
+    if (strncasecmp(value, "SIG", 3) == 0) {
+        value += 3;
+    }
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++) {
+        if (strcasecmp(value, signal_names[i].name) == 0) {
+            return signal_names[i].sig;
+        }
+    }
+    return -1;
+}
+
 int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
     if (argc < 2) {
         return -1;
@@ -295,6 +373,23 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
         {"detach",      no_argument,       0, 'd'},
         {"exec",        required_argument, 0, 'x'},
         {"rm",          no_argument,       0,  1 },
+        {"warm-pool",   required_argument, 0,  2 },
+        {"warm-refill", required_argument, 0,  3 },
+        {"park",        no_argument,       0,  4 },
+        {"json",        no_argument,       0,  5 },
+        {"all",         no_argument,       0,  6 },
+        {"workers",     required_argument, 0,  7 },
+        {"cgroup-pool", required_argument, 0,  8 },
+        {"prometheus",  no_argument,       0,  9 },
+        {"interval",    required_argument, 0, 10 },
+        {"no-stream",   no_argument,       0, 11 },
+        {"pressure",    required_argument, 0, 12 },
+        {"cpuset",      required_argument, 0, 13 },
+        {"cpu-shares",  required_argument, 0, 14 },
+        {"cpu-quota",   required_argument, 0, 15 },
+        {"cpu-period",  required_argument, 0, 16 },
+        {"cpu-burst",   required_argument, 0, 17 },
+        {"cpu-idle",    required_argument, 0, 18 },
         {"verbose",     no_argument,       0, 'V'},
         {"quiet",       no_argument,       0, 'q'},
         {"log-level",   required_argument, 0, 'L'},
@@ -309,9 +404,20 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
     bool attach_set = false;
     bool detach_set = false;
     bool exec_set = false;
-    optind = 2; /* Start parsing from argv[2] */
-
-    while ((opt = getopt_long(argc, argv, "b:r:p:adx:VEhvqL:", long_options, &opt_index)) != -1) {
+    bool pool_set = false;
+    bool workers_set = false;
+    bool stats_set = false;
+    bool pressure_set = false;
+    bool update_set = false;
+    /*
+     * Parse argv[1..] with optind = 0 so getopt fully reinitializes; the
+     * daemon parses many command lines in one process.
+     */
+    int sub_argc = argc - 1;
+    char **sub_argv = argv + 1;
+    optind = 0;
+
+    while ((opt = getopt_long(sub_argc, sub_argv, "b:r:p:adx:VEhvqL:", long_options, &opt_index)) != -1) {
         switch (opt) {
         case 'b':
             free(opts->bundle_path);
@@ -346,6 +452,152 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
         case 1:
             opts->rm = true;
             break;
+        case 4:
+            opts->park = true;
+            break;
+        case 5:
+            opts->json = true;
+            break;
+        case 6:
+            opts->all = true;
+            break;
+        case 7: {
+            char *end = NULL;
+            unsigned long v;
+
+            errno = 0;
+            v = strtoul(optarg, &end, 10);
+            if (errno != 0 || !end || *end != '\0' || optarg[0] == '-' || v == 0 ||
+                v > NK_BATCH_MAX_WORKERS) {
+                nk_stderr("Error: invalid --workers value '%s' (1-%d)\n", optarg,
+                        NK_BATCH_MAX_WORKERS);
+                return -1;
+            }
+            opts->workers = (size_t)v;
+            workers_set = true;
+            break;
+        }
+        case 2:
+        case 3:
+        case 8: {
+            char *end = NULL;
+            unsigned long v;
+
+            errno = 0;
+            v = strtoul(optarg, &end, 10);
+            if (errno != 0 || !end || *end != '\0' || optarg[0] == '-' || v > 1024) {
+                nk_stderr("Error: invalid %s value '%s' (0-1024)\n",
+                        opt == 2 ? "--warm-pool" : opt == 3 ? "--warm-refill" : "--cgroup-pool",
+                        optarg);
+                return -1;
+            }
+            if (opt == 2) {
+                opts->warm_pool = (size_t)v;
+            } else if (opt == 3) {
+                opts->warm_refill = (size_t)v;
+            } else {
+                opts->cgroup_pool = (size_t)v;
+            }
+            pool_set = true;
+            break;
+        }
+        case 9:
+            opts->prometheus = true;
+            stats_set = true;
+            break;
+        case 10: {
+            char *end = NULL;
+            unsigned long v;
+
+            errno = 0;
+            v = strtoul(optarg, &end, 10);
+            if (errno != 0 || !end || *end != '\0' || optarg[0] == '-' || v < 10 ||
+                v > 3600000) {
+                nk_stderr("Error: invalid --interval value '%s' (10-3600000 ms)\n", optarg);
+                return -1;
+            }
+            opts->interval_ms = (unsigned)v;
+            stats_set = true;
+            break;
+        }
+        case 11:
+            opts->no_stream = true;
+            stats_set = true;
+            break;
+        case 12: {
+            unsigned stall = 0, window = 0;
+            int used = 0;
+
+            /* PSI accepts windows of 500 ms to 10 s, and a threshold below the window */
+            if (sscanf(optarg, "%u/%u%n", &stall, &window, &used) != 2 || optarg[used] != '\0' ||
+                window < 500 || window > 10000 || stall == 0 || stall >= window) {
+                nk_stderr("Error: invalid --pressure value '%s' (<stall_ms>/<window_ms>, "
+                          "window 500-10000)\n", optarg);
+                return -1;
+            }
+            opts->psi_stall_ms = stall;
+            opts->psi_window_ms = window;
+            pressure_set = true;
+            break;
+        }
+        case 13: {
+            nk_cpuset_policy_t policy;
+
+            if (nk_cpuset_policy_parse(optarg, &policy) == -1) {
+                nk_stderr("Error: invalid --cpuset value '%s' (none, packed, spread or exclusive)\n",
+                          optarg);
+                return -1;
+            }
+            opts->cpuset = optarg;
+            break;
+        }
+        case 14:
+        case 15:
+        case 16:
+        case 17:
+        case 18: {
+            static const struct {
+                const char *name;
+                long long min, max;
+            } limits[] = {
+                { "--cpu-shares", 2, 262144 },
+                { "--cpu-quota", 1000, LLONG_MAX },
+                { "--cpu-period", 1000, 1000000 },
+                { "--cpu-burst", 0, LLONG_MAX },
+                { "--cpu-idle", 0, 1 },
+            };
+            const char *name = limits[opt - 14].name;
+            char *end = NULL;
+            long long v;
+
+            if (opt == 15 && strcmp(optarg, "max") == 0) {
+                opts->cpu_quota = -1;
+                update_set = true;
+                break;
+            }
+            errno = 0;
+            v = strtoll(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' ||
+                v < limits[opt - 14].min || v > limits[opt - 14].max) {
+                nk_stderr("Error: invalid %s value '%s'\n", name, optarg);
+                return -1;
+            }
+            if (opt == 14) {
+                opts->cpu_shares = (uint64_t)v;
+            } else if (opt == 15) {
+                opts->cpu_quota = v;
+            } else if (opt == 16) {
+                opts->cpu_period = (uint64_t)v;
+            } else if (opt == 17) {
+                opts->cpu_burst = v;
+                opts->cpu_burst_set = true;
+            } else {
+                opts->cpu_idle = v;
+                opts->cpu_idle_set = true;
+            }
+            update_set = true;
+            break;
+        }
         case 'V':
             nk_log_set_level(NK_LOG_DEBUG);
             break;
@@ -376,9 +628,17 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
         }
     }
 
-    /* Container ID is the last non-option argument */
-    if (optind < argc) {
-        opts->container_id = argv[optind];
+    /* Container ID is the first non-option argument; kill takes a signal after it */
+    if (optind < sub_argc) {
+        opts->container_id = sub_argv[optind];
+    }
+    opts->signal = SIGTERM;
+    if (strcmp(opts->command, "kill") == 0 && optind + 1 < sub_argc) {
+        opts->signal = parse_signal(sub_argv[optind + 1]);
+        if (opts->signal == -1) {
+            nk_stderr("Error: invalid signal '%s'\n", sub_argv[optind + 1]);
+            return -1;
+        }
     }
 
     if (attach_set && detach_set) {
@@ -387,7 +647,91 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
     }
 
     /* Validate command */
-    if (strcmp(opts->command, "create") == 0) {
+    if (opts->park && strcmp(opts->command, "create") != 0) {
+        nk_stderr("Error: --park is only supported by create\n");
+        return -1;
+    }
+
+    if (strcmp(opts->command, "ps") == 0) {
+        opts->command = "list";
+    }
+
+    if (opts->json && strcmp(opts->command, "trace") != 0 && strcmp(opts->command, "list") != 0 &&
+        strcmp(opts->command, "batch") != 0 && strcmp(opts->command, "stats") != 0) {
+        nk_stderr("Error: --json is only supported by trace, list, batch and stats\n");
+        return -1;
+    }
+
+    if (workers_set && strcmp(opts->command, "batch") != 0) {
+        nk_stderr("Error: --workers is only supported by batch\n");
+        return -1;
+    }
+
+    if (opts->all && strcmp(opts->command, "kill") != 0 && strcmp(opts->command, "stats") != 0 &&
+        strcmp(opts->command, "events") != 0) {
+        nk_stderr("Error: --all is only supported by kill, stats and events\n");
+        return -1;
+    }
+
+    if (opts->cpuset && strcmp(opts->command, "create") != 0 && strcmp(opts->command, "run") != 0) {
+        nk_stderr("Error: --cpuset is only supported by create and run\n");
+        return -1;
+    }
+
+    if (update_set != (strcmp(opts->command, "update") == 0)) {
+        nk_stderr(update_set ? "Error: --cpu-* options are only supported by update\n"
+                             : "Error: update requires at least one --cpu-* option\n");
+        return -1;
+    }
+
+    if (pressure_set && strcmp(opts->command, "events") != 0) {
+        nk_stderr("Error: --pressure is only supported by events\n");
+        return -1;
+    }
+
+    if (stats_set && strcmp(opts->command, "stats") != 0) {
+        nk_stderr("Error: --prometheus/--interval/--no-stream are only supported by stats\n");
+        return -1;
+    }
+
+    if (pool_set && strcmp(opts->command, "daemon") != 0) {
+        nk_stderr("Error: --warm-pool/--warm-refill/--cgroup-pool are only supported by daemon\n");
+        return -1;
+    }
+
+    if (strcmp(opts->command, "daemon") == 0 ||
+        strcmp(opts->command, "pool") == 0 ||
+        strcmp(opts->command, "list") == 0) {
+        if (attach_set || detach_set || opts->rm || exec_set || opts->container_id) {
+            nk_stderr("Error: %s does not take a container-id or lifecycle options\n",
+                    opts->command);
+            return -1;
+        }
+    } else if (strcmp(opts->command, "stats") == 0 || strcmp(opts->command, "events") == 0) {
+        if (attach_set || detach_set || opts->rm || exec_set) {
+            nk_stderr("Error: %s does not take lifecycle options\n", opts->command);
+            return -1;
+        }
+        if (!opts->container_id == !opts->all) {
+            nk_stderr("Error: %s requires either a container-id or --all\n", opts->command);
+            return -1;
+        }
+        if (opts->json && opts->prometheus) {
+            nk_stderr("Error: --json and --prometheus are mutually exclusive\n");
+            return -1;
+        }
+    } else if (strcmp(opts->command, "batch") == 0) {
+        if (attach_set || detach_set || opts->rm || exec_set) {
+            nk_stderr("Error: batch does not take lifecycle options\n");
+            return -1;
+        }
+        if (!opts->container_id) {
+            nk_stderr("Error: batch command requires a manifest path ('-' for stdin)\n");
+            return -1;
+        }
+        opts->manifest = opts->container_id;
+        opts->container_id = NULL;
+    } else if (strcmp(opts->command, "create") == 0) {
         if (attach_set || detach_set || opts->rm) {
             nk_stderr("Error: create does not support --attach/--detach/--rm\n");
             return -1;
@@ -401,13 +745,19 @@ int nk_parse_args(int argc, char *argv[], nk_options_t *opts) {
                strcmp(opts->command, "exec") == 0 ||
                strcmp(opts->command, "resume") == 0 ||
                strcmp(opts->command, "delete") == 0 ||
-               strcmp(opts->command, "state") == 0) {
+               strcmp(opts->command, "kill") == 0 ||
+               strcmp(opts->command, "update") == 0 ||
+               strcmp(opts->command, "state") == 0 ||
+               strcmp(opts->command, "trace") == 0) {
         if (!opts->container_id) {
             nk_stderr( "Error: %s command requires container-id\n", opts->command);
             return -1;
         }
         if ((strcmp(opts->command, "delete") == 0 ||
+             strcmp(opts->command, "kill") == 0 ||
+             strcmp(opts->command, "update") == 0 ||
              strcmp(opts->command, "state") == 0 ||
+             strcmp(opts->command, "trace") == 0 ||
              strcmp(opts->command, "resume") == 0) &&
             (attach_set || detach_set || opts->rm)) {
             nk_stderr("Error: %s does not support --attach/--detach/--rm\n", opts->command);
@@ -511,6 +861,163 @@ static int write_container_pid_file(const char *pid_file, const char *container_
     return ret;
 }
 
+static int is_pid_alive(pid_t pid) {
+    if (pid <= 0) {
+        return 0;
+    }
+    if (kill(pid, 0) == 0) {
+        return 1;
+    }
+    return errno == EPERM;
+}
+
+/*
+ * Create and open the container cgroup, then write the linux.resources
+ * limits through its fd so they hold before the init process exists.
+ */
+static int open_container_cgroup(nk_container_ctx_t *ctx, const char *container_id,
+                                 nk_trace_t *trace) {
+    nk_trace_begin(trace, NK_TRACE_CGROUP_OPEN);
+    ctx->cgroup_fd = nk_cgroup_open(container_id);
+    nk_trace_end(trace, NK_TRACE_CGROUP_OPEN);
+
+    if (ctx->cgroup_fd != -1) {
+        nk_trace_begin(trace, NK_TRACE_CPUSET);
+        if (nk_placement_apply(container_id, ctx->cgroup_fd, ctx) == -1) {
+            nk_log_error("Failed to place '%s' on a cpuset", container_id);
+            close(ctx->cgroup_fd);
+            ctx->cgroup_fd = -1;
+            (void)nk_cgroup_cleanup(container_id);
+            return -1;
+        }
+        nk_trace_end(trace, NK_TRACE_CPUSET);
+    } else if (ctx->cpuset_policy != NK_CPUSET_NONE) {
+        nk_stderr("Warning: No cgroup v2 for '%s'; cpuset placement is not applied\n",
+                  container_id);
+    }
+
+    if (!ctx->cgroup) {
+        return 0;
+    }
+    if (ctx->cgroup_fd == -1) {
+        nk_stderr("Warning: No cgroup v2 for '%s'; linux.resources limits are not applied\n",
+                  container_id);
+        return 0;
+    }
+
+    nk_trace_begin(trace, NK_TRACE_CGROUP_LIMITS);
+    if (nk_cgroup_apply(ctx->cgroup_fd, ctx->cgroup) == -1) {
+        nk_log_error("Failed to apply linux.resources limits");
+        close(ctx->cgroup_fd);
+        ctx->cgroup_fd = -1;
+        (void)nk_cgroup_cleanup(container_id);
+        return -1;
+    }
+    nk_trace_end(trace, NK_TRACE_CGROUP_LIMITS);
+    return 0;
+}
+
+/*
+ * create --park: run the whole start-time setup now (clone, namespaces,
+ * rootfs, pivot_root) and leave the init process blocked on exec.fifo.
+ */
+static int park_container_process(nk_container_t *container, const nk_oci_spec_t *spec,
+                                  nk_trace_t *trace) {
+    nk_container_ctx_t ctx;
+    char *fifo;
+    pid_t pid;
+
+    if (container->mode == NK_MODE_VM) {
+        nk_log_error("--park is not supported in VM mode");
+        return -1;
+    }
+
+    nk_log_step(5, "Preparing parked init process");
+    if (nk_log_educational) {
+        nk_log_explain("Parking init process",
+            "The container process is cloned and fully set up now, then blocks opening "
+            "exec.fifo. 'start' only has to read the fifo to let it execve().");
+    }
+
+    fifo = nk_state_file_path(container->id, NS_EXEC_FIFO_NAME);
+    if (!fifo) {
+        return -1;
+    }
+    if (nk_container_ctx_init(&ctx, container->bundle_path, spec) == -1) {
+        free(fifo);
+        return -1;
+    }
+    if (nk_container_rootfs_prepare(&ctx, container->id) == -1) {
+        nk_container_ctx_release(&ctx);
+        free(fifo);
+        return -1;
+    }
+
+    ctx.trace = trace;
+    if (open_container_cgroup(&ctx, container->id, trace) == -1) {
+        nk_container_ctx_release(&ctx);
+        free(fifo);
+        return -1;
+    }
+
+    pid = nk_container_exec_fifo(&ctx, fifo);
+    nk_container_ctx_release(&ctx);
+    if (pid == -1) {
+        (void)nk_cgroup_cleanup(container->id);
+        free(fifo);
+        return -1;
+    }
+
+    container->init_pid = pid;
+    nk_trace_begin(trace, NK_TRACE_STATE_SAVE);
+    if (nk_state_save(container) == -1) {
+        nk_log_error("Failed to persist parked PID %d", (int)pid);
+        kill(pid, SIGKILL);
+        /* Reap it, so it is neither left a zombie nor keeps the cgroup busy */
+        while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+        }
+        (void)nk_cgroup_cleanup(container->id);
+        unlink(fifo);
+        free(fifo);
+        return -1;
+    }
+
+    nk_trace_end(trace, NK_TRACE_STATE_SAVE);
+    (void)nk_trace_save(container->id, trace);
+
+    nk_log_info("Parked init process %d on %s", (int)pid, fifo);
+    free(fifo);
+    return 0;
+}
+
+/*
+ * Record that init process @pid exited, unless the container changed while
+ * we were not holding its lock (deleted, recreated, restarted). Returns 0
+ * once the stored state no longer claims @pid is running.
+ */
+static int mark_stopped_if_unchanged(const char *container_id, pid_t pid, bool wait) {
+    int lock_fd = nk_state_lock(container_id, wait);
+    int ret = 0;
+
+    if (lock_fd == -1) {
+        return -1;
+    }
+
+    nk_container_t *container = nk_state_load(container_id);
+    if (container && container->state == NK_STATE_RUNNING && container->init_pid == pid) {
+        container->state = NK_STATE_STOPPED;
+        container->init_pid = 0;
+        if (nk_state_save(container) == -1) {
+            nk_log_warn("Failed to persist stopped state for '%s'", container_id);
+            ret = -1;
+        }
+    }
+
+    nk_container_free(container);
+    nk_state_unlock(container_id, lock_fd);
+    return ret;
+}
+
 int nk_container_create(const nk_options_t *opts) {
     nk_log_info("Creating container '%s' (mode: %s)",
             opts->container_id,
@@ -540,11 +1047,14 @@ int nk_container_create(const nk_options_t *opts) {
     /* Load OCI spec from bundle */
     nk_log_debug("Step 2: Loading OCI spec from bundle: %s", opts->bundle_path);
     nk_log_step(1, "Loading OCI spec from bundle");
+    nk_trace_t trace = {0};
+    nk_trace_begin(&trace, NK_TRACE_SPEC_LOAD);
     nk_oci_spec_t *spec = nk_oci_spec_load(opts->bundle_path);
     if (!spec) {
         nk_log_error("Failed to load OCI spec from %s", opts->bundle_path);
         return -1;
     }
+    nk_trace_end(&trace, NK_TRACE_SPEC_LOAD);
     nk_log_debug("Step 2 complete (spec loaded)");
     nk_log_debug("OCI spec loaded successfully");
 
@@ -562,12 +1072,27 @@ int nk_container_create(const nk_options_t *opts) {
     nk_log_info("Bundle: %s", opts->bundle_path);
     nk_log_info("Root: %s", spec->root ? spec->root->path : "none");
 
+    /* Step 1 was only a fast path: a concurrent create may have won since */
+    int lock_fd = nk_state_lock(opts->container_id, true);
+    if (lock_fd == -1) {
+        nk_log_error("Failed to lock container '%s': %s", opts->container_id, strerror(errno));
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+    if (nk_state_exists(opts->container_id)) {
+        nk_log_error("Container '%s' already exists", opts->container_id);
+        nk_state_unlock(opts->container_id, lock_fd);
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
     /* Create container structure */
     nk_log_debug("Step 4: Creating container metadata structure");
     nk_log_step(3, "Creating container metadata");
     nk_container_t *container = calloc(1, sizeof(*container));
     if (!container) {
         nk_log_error("Step 4 failed (calloc returned NULL)");
+        nk_state_unlock(opts->container_id, lock_fd);
         nk_oci_spec_free(spec);
         return -1;
     }
@@ -588,62 +1113,68 @@ int nk_container_create(const nk_options_t *opts) {
     if (nk_state_save(container) == -1) {
         nk_log_error("Step 5 failed (nk_state_save returned -1)");
         nk_log_error("Failed to save container state");
+        nk_state_unlock(opts->container_id, lock_fd);
         nk_container_free(container);
         nk_oci_spec_free(spec);
         return -1;
     }
     nk_log_debug("Step 5 complete (state saved)");
 
+    nk_cpuset_policy_t cpuset_policy;
+    if (opts->cpuset && (nk_cpuset_policy_parse(opts->cpuset, &cpuset_policy) == -1 ||
+                         nk_placement_request(opts->container_id, cpuset_policy) == -1)) {
+        (void)nk_state_delete(container->id);
+        nk_state_unlock(opts->container_id, lock_fd);
+        nk_container_free(container);
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
+    if (opts->park && park_container_process(container, spec, &trace) == -1) {
+        nk_log_error("Failed to prepare parked container process");
+        (void)nk_cgroup_cleanup(container->id);
+        nk_placement_release(container->id);
+        (void)nk_container_rootfs_remove(container->id);
+        (void)nk_state_delete(container->id);
+        nk_state_unlock(opts->container_id, lock_fd);
+        nk_container_free(container);
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+    nk_state_unlock(opts->container_id, lock_fd);
+
     nk_log_debug("Step 6: Cleaning up and returning");
     nk_oci_spec_free(spec);
     nk_container_free(container);
 
+    /* ns-runtimed: keep parked children ready for this bundle's start */
+    nk_pool_track(opts->bundle_path);
+
     nk_log_info("Status: created");
     nk_log_debug("Create complete");
 
     return 0;
 }
 
-int nk_container_start(const char *container_id, bool attach, int *container_exit_code) {
-    int exit_code = 0;
-
-    nk_log_info("Starting container '%s'%s",
-            container_id, attach ? " (attach mode)" : " (detached mode)");
-
-    if (nk_log_educational) {
-        nk_log_explain("Starting container",
-            "Container start creates isolated process(es) using clone() with namespaces. "
-            "Parent process monitors, child process runs in isolated environment.");
-    }
-
-    /* Load container state */
-    nk_log_step(1, "Loading container state");
-    nk_container_t *container = nk_state_load(container_id);
-    if (!container) {
-        nk_log_error("Container '%s' not found", container_id);
-        return -1;
-    }
-    nk_log_debug("Container state loaded: id=%s, state=%d", container->id, container->state);
-
-    if (container->state != NK_STATE_CREATED) {
-        nk_log_error("Container is in wrong state: %d (expected CREATED)", container->state);
-        nk_container_free(container);
-        return -1;
-    }
-
+/*
+ * Load the spec and clone a fresh container process (or claim a warm one).
+ * *pidfd is set when the child was cloned with CLONE_PIDFD, else -1.
+ */
+static pid_t spawn_container_process(const nk_container_t *container, int *pidfd,
+                                     nk_trace_t *trace) {
     /* Load OCI spec */
     nk_log_step(2, "Loading OCI spec");
+    nk_trace_begin(trace, NK_TRACE_SPEC_LOAD);
     nk_oci_spec_t *spec = nk_oci_spec_load(container->bundle_path);
     if (!spec) {
         nk_log_error("Failed to load OCI spec");
-        nk_container_free(container);
         return -1;
     }
+    nk_trace_end(trace, NK_TRACE_SPEC_LOAD);
 
     if (!spec->process || !spec->root) {
         nk_log_error("Invalid OCI spec - missing process or root");
         nk_oci_spec_free(spec);
-        nk_container_free(container);
         return -1;
     }
 
@@ -653,69 +1184,207 @@ int nk_container_start(const char *container_id, bool attach, int *container_exi
     if (container->mode == NK_MODE_VM) {
         nk_log_error("VM mode not yet implemented (Phase 3)");
         nk_oci_spec_free(spec);
-        nk_container_free(container);
         return -1;
     }
 
     /* Build container context from OCI spec */
     nk_log_step(4, "Building container execution context");
-    nk_container_ctx_t ctx = {0};
-
-    char rootfs_path[PATH_MAX];
-    snprintf(rootfs_path, sizeof(rootfs_path), "%s/%s",
-             container->bundle_path, spec->root->path);
-    ctx.rootfs = rootfs_path;
-    nk_log_debug("Root filesystem: %s", ctx.rootfs);
-
-    if (spec->linux_config && spec->linux_config->namespaces) {
-        size_t ns_count = spec->linux_config->namespaces_len;
-        ctx.namespaces = calloc(ns_count, sizeof(nk_namespace_config_t));
-        if (ctx.namespaces) {
-            for (size_t i = 0; i < ns_count; i++) {
-                const char *type = spec->linux_config->namespaces[i].type;
-                if (strcmp(type, "pid") == 0) ctx.namespaces[i].type = NK_NS_PID;
-                else if (strcmp(type, "network") == 0) ctx.namespaces[i].type = NK_NS_NETWORK;
-                else if (strcmp(type, "ipc") == 0) ctx.namespaces[i].type = NK_NS_IPC;
-                else if (strcmp(type, "uts") == 0) ctx.namespaces[i].type = NK_NS_UTS;
-                else if (strcmp(type, "mount") == 0) ctx.namespaces[i].type = NK_NS_MOUNT;
-                else if (strcmp(type, "user") == 0) ctx.namespaces[i].type = NK_NS_USER;
-                else if (strcmp(type, "cgroup") == 0) ctx.namespaces[i].type = NK_NS_CGROUP;
-
-                ctx.namespaces[i].path = spec->linux_config->namespaces[i].path;
-                ctx.namespaces[i].enable = true;
-                nk_log_debug("Namespace[%zu]: %s", i, type);
+    nk_container_ctx_t ctx;
+    if (nk_container_ctx_init(&ctx, container->bundle_path, spec) == -1) {
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+    if (nk_container_rootfs_prepare(&ctx, container->id) == -1) {
+        nk_container_ctx_release(&ctx);
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
+    ctx.trace = trace;
+    if (open_container_cgroup(&ctx, container->id, trace) == -1) {
+        nk_container_ctx_release(&ctx);
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
+    nk_log_info("Executing: %s", ctx.args[0]);
+
+    nk_log_step(5, "Executing container process");
+
+    /*
+     * ns-runtimed warm pool: release an already-isolated child if one is
+     * parked. A placed container needs its mempolicy set in init before
+     * execve(), which a child parked before placement never did.
+     */
+    pid_t pid = -1;
+    if (ctx.cpuset_policy == NK_CPUSET_NONE) {
+        pid = nk_pool_claim(container->bundle_path, &ctx);
+    }
+    if (pid == -1) {
+        if (nk_log_educational) {
+            nk_log_explain("Calling clone3()",
+                "clone3() creates the new process with isolated namespaces directly inside "
+                "its cgroup (CLONE_INTO_CGROUP) and returns a pidfd for it (CLONE_PIDFD).");
+        }
+        pid = nk_container_spawn(&ctx, pidfd);
+    }
+    nk_pool_track(container->bundle_path);
+    if (pid == -1) {
+        nk_log_error("Failed to execute container");
+    }
+
+    nk_container_ctx_release(&ctx);
+    nk_oci_spec_free(spec);
+    if (pid == -1) {
+        /* The next start would claim another slot and lose track of this one */
+        (void)nk_cgroup_cleanup(container->id);
+    }
+    return pid;
+}
+
+/* Release a process parked by 'create --park': all setup is already done */
+static pid_t release_parked_process(nk_container_t *container, nk_trace_t *trace) {
+    pid_t pid = container->init_pid;
+    char *fifo = nk_state_file_path(container->id, NS_EXEC_FIFO_NAME);
+
+    nk_log_step(2, "Releasing parked container process");
+    if (nk_log_educational) {
+        nk_log_explain("Opening exec fifo",
+            "The init process was created, isolated and pivoted during 'create' and is "
+            "blocked opening exec.fifo for writing. Reading the fifo releases it to execve().");
+    }
+
+    nk_trace_begin(trace, NK_TRACE_RELEASE);
+    if (!fifo || nk_container_release_fifo(fifo, pid, NS_EXEC_FIFO_TIMEOUT_MS) == -1) {
+        nk_log_error("Failed to release parked process %d", (int)pid);
+        if (!is_pid_alive(pid)) {
+            container->state = NK_STATE_STOPPED;
+            container->init_pid = 0;
+            if (nk_state_save(container) == -1) {
+                nk_log_warn("Failed to persist stopped state for '%s'", container->id);
+            }
+        }
+        free(fifo);
+        return -1;
+    }
+    nk_trace_end(trace, NK_TRACE_RELEASE);
+
+    free(fifo);
+    return pid;
+}
+
+/*
+ * Wait for the container process. A process parked by an earlier 'create'
+ * is not our child, so its exit status cannot be collected.
+ */
+static int wait_container_process(pid_t pid, int pidfd, int *exit_code) {
+    int wait_status = 0;
+
+    *exit_code = 0;
+    nk_log_flush();  /* the wait may last as long as the container */
+    if (pidfd >= 0) {
+        siginfo_t info;
+
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_PIDFD, (id_t)pidfd, &info, WEXITED) == 0) {
+            if (info.si_code == CLD_EXITED) {
+                *exit_code = info.si_status;
+                nk_log_info("Container process exited with code %d", *exit_code);
+            } else {
+                *exit_code = 128 + info.si_status;
+                nk_log_warn("Container process killed by signal %d", info.si_status);
             }
-            ctx.namespaces_len = ns_count;
-            nk_log_info("Parsed %zu namespaces", ns_count);
+            return 0;
+        }
+        if (errno != EINVAL) {
+            nk_stderr("Error: Failed to wait for container: %s\n", strerror(errno));
+            return -1;
         }
+        /* Kernel without P_PIDFD (< 5.4): fall through to waitpid() */
     }
 
-    ctx.args = spec->process->args;
-    ctx.args_len = spec->process->args_len;
-    ctx.env = spec->process->env;
-    ctx.env_len = spec->process->env_len;
-    ctx.cwd = spec->process->cwd ? spec->process->cwd : "/";
-    ctx.terminal = spec->process->terminal;
-    ctx.mounts = NULL;
-    ctx.mounts_len = 0;
+    if (waitpid(pid, &wait_status, 0) == -1) {
+        if (errno != ECHILD) {
+            nk_stderr("Error: Failed to wait for container: %s\n", strerror(errno));
+            return -1;
+        }
 
-    nk_cgroup_config_t cg_cfg = {0};
-    ctx.cgroup = &cg_cfg;
+        nk_log_warn("PID %d was created by another process; exit code is not available", (int)pid);
+        int fd = nk_container_pidfd(NULL, pid);
+        if (fd >= 0) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
 
-    nk_log_info("Executing: %s", ctx.args[0]);
+            while (poll(&pfd, 1, -1) == -1 && errno == EINTR) {
+            }
+            close(fd);
+            return 0;
+        }
+        /* No pidfd_open (< 5.3): probe until it is gone */
+        bool probe = errno == ENOSYS;
+        while (probe && is_pid_alive(pid)) {
+            usleep(100000);
+        }
+        return 0;
+    }
+
+    if (WIFEXITED(wait_status)) {
+        *exit_code = WEXITSTATUS(wait_status);
+        nk_log_info("Container process exited with code %d", *exit_code);
+    } else if (WIFSIGNALED(wait_status)) {
+        *exit_code = 128 + WTERMSIG(wait_status);
+        nk_log_warn("Container process killed by signal %d", WTERMSIG(wait_status));
+    }
+    return 0;
+}
+
+int nk_container_start(const char *container_id, bool attach, int *container_exit_code) {
+    int exit_code = 0;
+
+    nk_log_info("Starting container '%s'%s",
+            container_id, attach ? " (attach mode)" : " (detached mode)");
 
-    nk_log_step(5, "Executing container process");
     if (nk_log_educational) {
-        nk_log_explain("Calling clone()",
-            "clone() system call creates new process with isolated namespaces. "
-            "Returns in both parent (gets PID) and child (gets 0).");
+        nk_log_explain("Starting container",
+            "Container start creates isolated process(es) using clone() with namespaces. "
+            "Parent process monitors, child process runs in isolated environment.");
+    }
+
+    /* Held from the CREATED check to the RUNNING save: one start wins */
+    int lock_fd = nk_state_lock(container_id, true);
+    if (lock_fd == -1) {
+        nk_log_error("Failed to lock container '%s': %s", container_id, strerror(errno));
+        return -1;
+    }
+
+    /* Load container state */
+    nk_log_step(1, "Loading container state");
+    nk_container_t *container = nk_state_load(container_id);
+    if (!container) {
+        nk_log_error("Container '%s' not found", container_id);
+        nk_state_unlock(container_id, lock_fd);
+        return -1;
     }
+    nk_log_debug("Container state loaded: id=%s, state=%d", container->id, container->state);
 
-    pid_t pid = nk_container_exec(&ctx);
+    if (container->state != NK_STATE_CREATED) {
+        nk_log_error("Container is in wrong state: %d (expected CREATED)", container->state);
+        nk_state_unlock(container_id, lock_fd);
+        nk_container_free(container);
+        return -1;
+    }
+
+    /* Parked children were set up by 'create': keep the phases it traced */
+    nk_trace_t trace = {0};
+    int pidfd = -1;
+    pid_t pid;
+    if (container->init_pid > 0) {
+        (void)nk_trace_load(container->id, &trace);
+        pid = release_parked_process(container, &trace);
+    } else {
+        pid = spawn_container_process(container, &pidfd, &trace);
+    }
     if (pid == -1) {
-        nk_log_error("Failed to execute container");
-        free(ctx.namespaces);
-        nk_oci_spec_free(spec);
+        nk_state_unlock(container_id, lock_fd);
         nk_container_free(container);
         return -1;
     }
@@ -724,17 +1393,22 @@ int nk_container_start(const char *container_id, bool attach, int *container_exi
 
     container->state = NK_STATE_RUNNING;
     container->init_pid = pid;
+    container->started_at = (int64_t)time(NULL);
+    nk_trace_begin(&trace, NK_TRACE_STATE_SAVE);
     if (nk_state_save(container) == -1) {
         nk_stderr("Warning: Failed to save container state\n");
     }
-
-    free(ctx.namespaces);
-    nk_oci_spec_free(spec);
+    nk_trace_end(&trace, NK_TRACE_STATE_SAVE);
+    (void)nk_trace_save(container->id, &trace);
+    nk_state_unlock(container_id, lock_fd);
 
     nk_log_info("Status: running (PID: %d)", (int)pid);
 
     if (!attach) {
         nk_log_info("Mode: detached (like docker start)");
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
         nk_container_free(container);
         if (container_exit_code) {
             *container_exit_code = 0;
@@ -743,26 +1417,26 @@ int nk_container_start(const char *container_id, bool attach, int *container_exi
     }
 
     nk_log_info("Mode: attached (waiting for container process)");
-    int wait_status = 0;
-    if (nk_container_wait(pid, &wait_status) == -1) {
+    int wait_ret = wait_container_process(pid, pidfd, &exit_code);
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+    if (wait_ret == -1) {
         nk_container_free(container);
         return -1;
     }
 
-    if (WIFEXITED(wait_status)) {
-        exit_code = WEXITSTATUS(wait_status);
-        nk_log_info("Container process exited with code %d", exit_code);
-    } else if (WIFSIGNALED(wait_status)) {
-        exit_code = 128 + WTERMSIG(wait_status);
-        nk_log_warn("Container process killed by signal %d", WTERMSIG(wait_status));
-    }
-
-    container->state = NK_STATE_STOPPED;
-    container->init_pid = 0;
-    if (nk_state_save(container) == -1) {
-        nk_stderr("Warning: Failed to persist stopped state\n");
-    }
     nk_container_free(container);
+    mark_stopped_if_unchanged(container_id, pid, true);
+
+    /* A SIGKILL from the OOM killer otherwise looks like any other kill */
+    if (exit_code == 128 + SIGKILL) {
+        long long oom_kills = nk_cgroup_oom_kills(container_id);
+        if (oom_kills > 0) {
+            nk_stderr("Warning: container '%s' hit memory.max: %lld OOM kill(s) in its cgroup\n",
+                      container_id, oom_kills);
+        }
+    }
 
     nk_log_info("Status: stopped (exit code: %d)", exit_code);
     if (container_exit_code) {
@@ -803,16 +1477,6 @@ int nk_container_run(const nk_options_t *opts) {
     return opts->attach ? exit_code : 0;
 }
 
-static int is_pid_alive(pid_t pid) {
-    if (pid <= 0) {
-        return 0;
-    }
-    if (kill(pid, 0) == 0) {
-        return 1;
-    }
-    return errno == EPERM;
-}
-
 static int is_procfs_available(void) {
     return access("/proc/self/ns/pid", R_OK) == 0;
 }
@@ -838,10 +1502,10 @@ static void update_stopped_state_if_dead(nk_container_t *container) {
 
     nk_log_warn("Container '%s' init process %d is gone; updating state to stopped",
             container->id, (int)container->init_pid);
-    container->state = NK_STATE_STOPPED;
-    container->init_pid = 0;
-    if (nk_state_save(container) == -1) {
-        nk_log_warn("Failed to persist stopped state for '%s'", container->id);
+    /* Opportunistic: whoever holds the lock is changing the state anyway */
+    if (mark_stopped_if_unchanged(container->id, container->init_pid, false) == 0) {
+        container->state = NK_STATE_STOPPED;
+        container->init_pid = 0;
     }
 }
 
@@ -910,6 +1574,7 @@ int nk_container_resume(const char *container_id, const char *exec_cmd) {
     char *const *argv = (exec_cmd && exec_cmd[0] != '\0') ? nsenter_exec : nsenter_interactive;
     nk_log_info("Entering namespaces of PID %d via nsenter", (int)container->init_pid);
 
+    nk_log_flush();  /* the helper must not inherit queued records */
     pid_t child = fork();
     if (child == -1) {
         nk_log_error("Failed to fork resume helper: %s", strerror(errno));
@@ -943,41 +1608,169 @@ int nk_container_resume(const char *container_id, const char *exec_cmd) {
     return exit_code;
 }
 
+/* Grace period between SIGTERM and cgroup.kill on delete */
+static int stop_timeout_ms(void) {
+    const char *env = getenv(NS_STOP_TIMEOUT_ENV);
+    char *end = NULL;
+    long ms;
+
+    if (!env || env[0] == '\0') {
+        return NS_STOP_TIMEOUT_DEFAULT_MS;
+    }
+    errno = 0;
+    ms = strtol(env, &end, 10);
+    if (errno != 0 || *end != '\0' || ms < 0 || ms > INT_MAX) {
+        nk_stderr("Warning: Ignoring invalid %s='%s'\n", NS_STOP_TIMEOUT_ENV, env);
+        return NS_STOP_TIMEOUT_DEFAULT_MS;
+    }
+    return (int)ms;
+}
+
+int nk_container_update(const nk_options_t *opts) {
+    const char *container_id = opts->container_id;
+    nk_cgroup_config_t cfg = {
+        .cpu_shares = opts->cpu_shares,
+        .cpu_quota = opts->cpu_quota,
+        .cpu_period = opts->cpu_period,
+        .cpu_burst = opts->cpu_burst,
+        .cpu_idle = opts->cpu_idle,
+        .cpu_burst_set = opts->cpu_burst_set,
+        .cpu_idle_set = opts->cpu_idle_set,
+    };
+    char path[PATH_MAX];
+    int ret = -1;
+
+    int lock_fd = nk_state_lock(container_id, true);
+    if (lock_fd == -1) {
+        nk_stderr("Error: Failed to lock container '%s': %s\n", container_id, strerror(errno));
+        return -1;
+    }
+
+    nk_container_t *container = nk_state_load(container_id);
+    if (!container) {
+        nk_stderr("Error: Container '%s' not found\n", container_id);
+    } else if (container->state != NK_STATE_RUNNING && container->state != NK_STATE_CREATED) {
+        nk_stderr("Error: Container '%s' is not running\n", container_id);
+    } else {
+        int fd = nk_cgroup_path(container_id, path, sizeof(path)) == -1 ? -1 :
+                 open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+            nk_stderr("Error: Container '%s' has no cgroup\n", container_id);
+        } else {
+            ret = nk_cgroup_apply(fd, &cfg);
+            close(fd);
+        }
+    }
+
+    nk_state_unlock(container_id, lock_fd);
+    nk_container_free(container);
+    return ret;
+}
+
+int nk_container_kill(const char *container_id, int sig, bool all) {
+    nk_log_info("Sending signal %d to container '%s'%s", sig, container_id,
+            all ? " (all processes)" : "");
+
+    int lock_fd = nk_state_lock(container_id, true);
+    if (lock_fd == -1) {
+        nk_stderr("Error: Failed to lock container '%s': %s\n", container_id, strerror(errno));
+        return -1;
+    }
+
+    nk_container_t *container = nk_state_load(container_id);
+    if (!container) {
+        nk_stderr("Error: Container '%s' not found\n", container_id);
+        nk_state_unlock(container_id, lock_fd);
+        return -1;
+    }
+
+    int ret = -1;
+    if ((container->state != NK_STATE_RUNNING && container->state != NK_STATE_CREATED) ||
+        container->init_pid <= 0) {
+        nk_stderr("Error: Container '%s' is not running\n", container_id);
+        goto out;
+    }
+
+    int pidfd = nk_container_pidfd(container_id, container->init_pid);
+    if (pidfd >= 0) {
+        ret = nk_container_pidfd_signal(pidfd, sig);
+        close(pidfd);
+    } else if (errno == ENOSYS) {
+        ret = kill(container->init_pid, sig);
+    }
+    if (ret == -1) {
+        if (errno == ESRCH) {
+            nk_stderr("Error: Container '%s' is not running\n", container_id);
+        } else {
+            nk_stderr("Error: Failed to send signal %d to PID %d: %s\n",
+                    sig, (int)container->init_pid, strerror(errno));
+        }
+    }
+    if (ret == 0 && all && nk_cgroup_kill(container_id, sig) == -1 && errno != ENOENT) {
+        nk_stderr("Warning: Failed to signal the cgroup of '%s': %s\n",
+                container_id, strerror(errno));
+    }
+
+out:
+    /* Unlock first: the state update below takes the same lock */
+    nk_state_unlock(container_id, lock_fd);
+    if (ret == -1) {
+        update_stopped_state_if_dead(container);
+    }
+    nk_container_free(container);
+    return ret;
+}
+
 int nk_container_delete(const char *container_id) {
     nk_log_info("Deleting container '%s'", container_id);
 
+    int lock_fd = nk_state_lock(container_id, true);
+    if (lock_fd == -1) {
+        nk_stderr("Error: Failed to lock container '%s': %s\n", container_id, strerror(errno));
+        return -1;
+    }
+
     /* Load container state */
     nk_container_t *container = nk_state_load(container_id);
     if (!container) {
         nk_stderr( "Error: Container '%s' not found\n", container_id);
+        nk_state_unlock(container_id, lock_fd);
         return -1;
     }
 
+    /* Parked by 'create --park': nothing has exec'd yet, just kill it */
+    if (container->state == NK_STATE_CREATED && container->init_pid > 0) {
+        nk_log_info("Killing parked init process (PID: %d)", container->init_pid);
+        (void)nk_container_stop(container_id, container->init_pid, 0);
+    }
+
+    char *fifo = nk_state_file_path(container_id, NS_EXEC_FIFO_NAME);
+    if (fifo) {
+        unlink(fifo);
+        free(fifo);
+    }
+    nk_trace_delete(container_id);
+
     /* Stop container if running */
     if (container->state == NK_STATE_RUNNING && container->init_pid > 0) {
         nk_log_info("Stopping container (PID: %d)", container->init_pid);
-
-        /* Send SIGTERM first */
-        if (nk_container_signal(container->init_pid, SIGTERM) == 0) {
-            /* Wait a bit for graceful shutdown */
-            usleep(100000);  /* 100ms */
-
-            /* Check if process still exists */
-            if (kill(container->init_pid, 0) == 0) {
-                /* Force kill if still running */
-                nk_log_warn("Force killing...");
-                nk_container_signal(container->init_pid, SIGKILL);
-            }
-        }
+        (void)nk_container_stop(container_id, container->init_pid, stop_timeout_ms());
     }
 
     /* Cleanup cgroups */
     nk_cgroup_cleanup(container_id);
+    nk_placement_release(container_id);
+
+    /* Overlay upper/work dirs (NS_ROOTFS_MODE=overlay) */
+    if (nk_container_rootfs_remove(container_id) == -1) {
+        nk_stderr( "Warning: Failed to remove overlay rootfs of '%s'\n", container_id);
+    }
 
     /* Delete state file */
     if (nk_state_delete(container_id) == -1) {
         nk_stderr( "Warning: Failed to delete state file\n");
     }
+    nk_state_unlock(container_id, lock_fd);
 
     nk_container_free(container);
 
@@ -1014,48 +1807,234 @@ void nk_container_free(nk_container_t *container) {
     free(container);
 }
 
-int main(int argc, char *argv[]) {
+static int run_command(nk_options_t *opts, const char *prog_name);
+
+/* Parse and run one CLI invocation; also the ns-runtimed request handler */
+static int dispatch_argv(int argc, char *argv[]) {
     nk_options_t opts;
-    nk_log_set_role(NK_LOG_ROLE_PARENT);
+    int ret;
 
+    memset(&opts, 0, sizeof(opts));
     if (nk_parse_args(argc, argv, &opts) == -1) {
         print_usage(argv[0]);
+        free(opts.bundle_path);
+        free(opts.pid_file);
+        free(opts.resume_exec);
+        return 1;
+    }
+
+    ret = run_command(&opts, argv[0]);
+
+    /* Cleanup options */
+    free(opts.bundle_path);
+    free(opts.pid_file);
+    free(opts.resume_exec);
+
+    return ret;
+}
+
+/* Daemon request handler: never serve "daemon" recursively */
+static int daemon_handle_request(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "daemon") == 0) {
+        nk_stderr("Error: ns-runtimed is already running\n");
+        return 1;
+    }
+    return dispatch_argv(argc, argv);
+}
+
+/*
+ * Commands that do not need to own the caller's terminal or wait on the
+ * container process can be served by ns-runtimed.
+ */
+static bool is_daemon_command(const nk_options_t *opts) {
+    if (strcmp(opts->command, "create") == 0 ||
+        strcmp(opts->command, "delete") == 0 ||
+        strcmp(opts->command, "state") == 0 ||
+        strcmp(opts->command, "pool") == 0) {
+        return true;
+    }
+    if (strcmp(opts->command, "start") == 0 ||
+        strcmp(opts->command, "run") == 0) {
+        return !opts->attach;
+    }
+    return false;
+}
+
+static bool daemon_idle(void) {
+    bool cgroup_work = nk_cgroup_pool_refill();
+    return nk_pool_refill() || cgroup_work;
+}
+
+static int run_daemon(const nk_options_t *opts) {
+    int ret;
+
+    if (ensure_state_dir() == -1) {
+        return 1;
+    }
+
+    nk_pool_configure(opts->warm_pool, opts->warm_refill);
+    nk_cgroup_pool_configure(opts->cgroup_pool);
+    nk_daemon_set_idle_handler(daemon_idle);
+
+    ret = nk_daemon_serve(get_state_dir(), daemon_handle_request) == 0 ? 0 : 1;
+
+    nk_pool_drain();
+    nk_cgroup_pool_drain();
+    return ret;
+}
+
+static int show_pool_stats(void) {
+    if (!nk_pool_enabled() && !nk_cgroup_pool_enabled()) {
+        nk_stderr("Error: no pool is enabled (run ns-runtimed with --warm-pool=N "
+                  "or --cgroup-pool=N)\n");
+        return 1;
+    }
+    if (nk_pool_enabled()) {
+        nk_pool_print_stats();
+    }
+    if (nk_cgroup_pool_enabled()) {
+        nk_cgroup_pool_print_stats();
+    }
+    return 0;
+}
+
+/* Runs one batch manifest operation, in a batch worker process */
+static int batch_exec(const nk_batch_op_t *op) {
+    switch (op->kind) {
+    case NK_BATCH_CREATE: {
+        nk_options_t create = {
+            .command = "create",
+            .container_id = op->id,
+            .bundle_path = op->bundle,
+            .mode = NK_MODE_CONTAINER,
+            .park = op->park,
+        };
+        return nk_container_create(&create);
+    }
+    case NK_BATCH_START: {
+        int exit_code = 0;
+        return nk_container_start(op->id, false, &exit_code);
+    }
+    case NK_BATCH_DELETE:
+        return nk_container_delete(op->id);
+    }
+    return -1;
+}
+
+static int run_batch(const nk_options_t *opts) {
+    if (ensure_state_dir() == -1) {
+        return 1;
+    }
+    return nk_batch_run(stdout, opts->manifest, opts->bundle_path, opts->workers, opts->json,
+                        batch_exec) == 0 ? 0 : 1;
+}
+
+static bool spec_images_enabled = false;
+
+/*
+ * Keep compiled spec images in <state_dir>/.spec-cache unless NS_NO_SPEC_IMAGE
+ * is set. Checked per command: ns-runtimed serves clients with their own env.
+ */
+static void enable_spec_images(void) {
+    char dir[PATH_MAX];
+    const char *bypass = getenv(NS_SPEC_IMAGE_BYPASS_ENV);
+    int n;
+
+    if (bypass && bypass[0] != '\0' && strcmp(bypass, "0") != 0) {
+        if (spec_images_enabled) {
+            nk_oci_spec_image_dir(NULL);
+            spec_images_enabled = false;
+        }
+        return;
+    }
+    if (spec_images_enabled) {
+        return;
+    }
+
+    n = snprintf(dir, sizeof(dir), "%s/%s", get_state_dir(), NS_SPEC_IMAGE_DIR_NAME);
+    if (n > 0 && (size_t)n < sizeof(dir)) {
+        nk_oci_spec_image_dir(dir);
+        spec_images_enabled = true;
+    }
+}
+
+/* Print the phase breakdown saved by the container's last start */
+static int show_trace(const char *container_id, bool json) {
+    nk_trace_t trace;
+
+    if (!nk_state_exists(container_id)) {
+        nk_stderr("Error: Container '%s' not found\n", container_id);
         return 1;
     }
+    if (nk_trace_load(container_id, &trace) == -1) {
+        nk_stderr("Error: No start trace recorded for '%s'\n", container_id);
+        return 1;
+    }
+    return nk_trace_print(stdout, container_id, &trace, json) == 0 ? 0 : 1;
+}
 
-    if (strcmp(opts.command, "resume") == 0) {
+static int run_command(nk_options_t *opts, const char *prog_name) {
+    if (strcmp(opts->command, "resume") == 0) {
         nk_log_warn("Command 'resume' is deprecated; use 'exec' instead");
-        opts.command = "exec";
+        opts->command = "exec";
+    }
+
+    if (strcmp(opts->command, "create") == 0 || strcmp(opts->command, "start") == 0 ||
+        strcmp(opts->command, "run") == 0 || strcmp(opts->command, "daemon") == 0 ||
+        strcmp(opts->command, "batch") == 0) {
+        enable_spec_images();
     }
 
     int ret = 0;
 
-    if (strcmp(opts.command, "help") == 0) {
-        print_usage(argv[0]);
-    } else if (strcmp(opts.command, "version") == 0) {
+    if (strcmp(opts->command, "help") == 0) {
+        print_usage(prog_name);
+    } else if (strcmp(opts->command, "version") == 0) {
         print_version();
-    } else if (strcmp(opts.command, "create") == 0) {
-        ret = nk_container_create(&opts);
-    } else if (strcmp(opts.command, "start") == 0) {
+    } else if (strcmp(opts->command, "daemon") == 0) {
+        ret = run_daemon(opts);
+    } else if (strcmp(opts->command, "pool") == 0) {
+        ret = show_pool_stats();
+    } else if (strcmp(opts->command, "list") == 0) {
+        ret = nk_list_print(stdout, opts->json) == 0 ? 0 : 1;
+    } else if (strcmp(opts->command, "stats") == 0) {
+        nk_stats_format_t format = opts->json ? NK_STATS_JSON :
+                                   opts->prometheus ? NK_STATS_PROMETHEUS : NK_STATS_TABLE;
+        ret = nk_stats_run(stdout, opts->container_id, format, opts->interval_ms,
+                           !opts->no_stream) == 0 ? 0 : 1;
+    } else if (strcmp(opts->command, "events") == 0) {
+        ret = nk_events_run(stdout, opts->container_id, opts->psi_stall_ms,
+                            opts->psi_window_ms) == 0 ? 0 : 1;
+    } else if (strcmp(opts->command, "batch") == 0) {
+        ret = run_batch(opts);
+    } else if (strcmp(opts->command, "create") == 0) {
+        ret = nk_container_create(opts);
+    } else if (strcmp(opts->command, "start") == 0) {
         int exit_code = 0;
-        ret = nk_container_start(opts.container_id, opts.attach, &exit_code);
-        if (ret == 0 && opts.pid_file && opts.detach) {
-            ret = write_container_pid_file(opts.pid_file, opts.container_id);
+        ret = nk_container_start(opts->container_id, opts->attach, &exit_code);
+        if (ret == 0 && opts->pid_file && opts->detach) {
+            ret = write_container_pid_file(opts->pid_file, opts->container_id);
         }
-        if (ret == 0 && opts.attach) {
+        if (ret == 0 && opts->attach) {
             ret = exit_code;
         }
-    } else if (strcmp(opts.command, "run") == 0) {
-        ret = nk_container_run(&opts);
-        if (ret == 0 && opts.pid_file && opts.detach) {
-            ret = write_container_pid_file(opts.pid_file, opts.container_id);
+    } else if (strcmp(opts->command, "run") == 0) {
+        ret = nk_container_run(opts);
+        if (ret == 0 && opts->pid_file && opts->detach) {
+            ret = write_container_pid_file(opts->pid_file, opts->container_id);
         }
-    } else if (strcmp(opts.command, "exec") == 0) {
-        ret = nk_container_resume(opts.container_id, opts.resume_exec);
-    } else if (strcmp(opts.command, "delete") == 0) {
-        ret = nk_container_delete(opts.container_id);
-    } else if (strcmp(opts.command, "state") == 0) {
-        nk_container_state_t state = nk_container_state(opts.container_id);
+    } else if (strcmp(opts->command, "exec") == 0) {
+        ret = nk_container_resume(opts->container_id, opts->resume_exec);
+    } else if (strcmp(opts->command, "delete") == 0) {
+        ret = nk_container_delete(opts->container_id);
+    } else if (strcmp(opts->command, "kill") == 0) {
+        ret = nk_container_kill(opts->container_id, opts->signal, opts->all) == 0 ? 0 : 1;
+    } else if (strcmp(opts->command, "update") == 0) {
+        ret = nk_container_update(opts) == 0 ? 0 : 1;
+    } else if (strcmp(opts->command, "trace") == 0) {
+        ret = show_trace(opts->container_id, opts->json);
+    } else if (strcmp(opts->command, "state") == 0) {
+        nk_container_state_t state = nk_container_state(opts->container_id);
         const char *state_str;
 
         switch (state) {
@@ -1084,6 +2063,54 @@ int main(int argc, char *argv[]) {
         printf("%s\n", state_str);
     }
 
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    nk_options_t opts;
+    char *daemon_argv[argc + 2];
+    const char *base;
+    int ret = 0;
+
+    nk_log_set_role(NK_LOG_ROLE_PARENT);
+
+    /* Invoked as ns-runtimed: behave like "ns-runtime daemon ..." */
+    base = strrchr(argv[0], '/');
+    base = base ? base + 1 : argv[0];
+    if (strcmp(base, "ns-runtimed") == 0) {
+        daemon_argv[0] = argv[0];
+        daemon_argv[1] = "daemon";
+        for (int i = 1; i < argc; i++) {
+            daemon_argv[i + 1] = argv[i];
+        }
+        daemon_argv[argc + 1] = NULL;
+        argc++;
+        argv = daemon_argv;
+    }
+
+    if (nk_parse_args(argc, argv, &opts) == -1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (is_daemon_command(&opts) && !nk_daemon_is_bypassed()) {
+        int exit_code = 0;
+        int fwd = nk_daemon_forward(get_state_dir(), argc, argv, &exit_code);
+
+        if (fwd == 0) {
+            ret = exit_code;
+            goto out;
+        }
+        if (fwd == -1) {
+            ret = 1;
+            goto out;
+        }
+        /* No daemon listening: fall through and run locally */
+    }
+
+    ret = run_command(&opts, argv[0]);
+
+out:
     /* Cleanup options */
     free(opts.bundle_path);
     free(opts.pid_file);
@@ -0,0 +1,1473 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "oci/parser.h"
+#include "common/arena.h"
+
+/*
+ * Schema-specialized config.json parser.
+ *
+ * The parser walks the document once and writes the fields nano-sandbox
+ * consumes straight into nk_oci_spec_t; everything else is validated and
+ * skipped. It never reports a syntax error itself: any input it is not
+ * certain jansson would accept with the same meaning makes it bail out so
+ * nk_oci_spec_load() reparses with jansson, which then produces the usual
+ * "Failed to parse config.json" message. Every helper returns false for
+ * that bail-out case.
+ *
+ * Everything is decoded into the spec's arena. Arrays are staged on a
+ * scratch stack until their length is known and then copied into the
+ * arena in one piece, so every array in the result is exactly sized.
+ */
+
+#define STREAM_MAX_DEPTH 512       /* Deeper documents go to jansson */
+#define STREAM_MAX_NUMBER 128      /* Longer number tokens go to jansson */
+
+typedef struct {
+    const char *p;
+    const char *end;
+    int depth;
+    bool missing_args;             /* NK_OCI_MISSING_ARGS */
+    bool missing_root_path;        /* NK_OCI_MISSING_ROOT_PATH */
+    nk_arena_t *arena;             /* Arena of the spec being built */
+    char *dec;                     /* Scratch for strings that need decoding */
+    size_t dec_len;
+    size_t dec_cap;
+    char *stack;                   /* Scratch for array elements being collected */
+    size_t stack_len;
+    size_t stack_cap;
+} oci_stream_t;
+
+/*
+ * Object key: points into the input, or into s->dec if it contained
+ * escapes (then valid only until the next string is decoded).
+ */
+typedef struct {
+    const char *str;
+    size_t len;
+    bool decoded;
+} stream_key_t;
+
+#define KEY_IS(k, lit) ((k)->len == sizeof(lit) - 1 && memcmp((k)->str, lit, sizeof(lit) - 1) == 0)
+
+/* ---- Structural scanning ---------------------------------------------- */
+
+/**
+ * scan_ws - Return the first non-whitespace byte at or after @p
+ */
+static inline const char *scan_ws(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    /* Indentation in generated configs comes in long runs */
+    while (end - p >= 16 && *p == ' ') {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(ws) ^ 0xFFFFu;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * scan_plain - Return the first byte that ends a plain ASCII string run
+ *
+ * Stops at '"', '\\', control characters and non-ASCII bytes (which need
+ * UTF-8 validation), or at @end.
+ */
+static inline const char *scan_plain(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x20);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* Signed compare: bytes >= 0x80 are negative, so they count as < 0x20 */
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                              _mm_cmpeq_epi8(v, bslash)),
+                                 _mm_cmplt_epi8(v, ctl));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80) {
+            return p;
+        }
+        p++;
+    }
+    return end;
+}
+
+static inline bool stream_peek(oci_stream_t *s, char *c) {
+    s->p = scan_ws(s->p, s->end);
+    if (s->p >= s->end) {
+        return false;
+    }
+    *c = *s->p;
+    return true;
+}
+
+static inline bool stream_expect(oci_stream_t *s, char c) {
+    char got;
+
+    if (!stream_peek(s, &got) || got != c) {
+        return false;
+    }
+    s->p++;
+    return true;
+}
+
+/* ---- Strings ---------------------------------------------------------- */
+
+/**
+ * utf8_valid_len - Length of the valid UTF-8 sequence at @p, 0 if invalid
+ *
+ * Rejects what jansson rejects: overlong forms, surrogates, > U+10FFFF.
+ */
+static size_t utf8_valid_len(const unsigned char *p, const unsigned char *end) {
+    unsigned char c = p[0];
+    uint32_t cp;
+    size_t n;
+
+    if (c < 0x80) {
+        return 1;
+    } else if (c < 0xC2) {
+        return 0;
+    } else if (c < 0xE0) {
+        n = 2;
+        cp = c & 0x1F;
+    } else if (c < 0xF0) {
+        n = 3;
+        cp = c & 0x0F;
+    } else if (c < 0xF5) {
+        n = 4;
+        cp = c & 0x07;
+    } else {
+        return 0;
+    }
+
+    if ((size_t)(end - p) < n) {
+        return 0;
+    }
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    if (n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) {
+        return 0;
+    }
+    if (n == 4 && (cp < 0x10000 || cp > 0x10FFFF)) {
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * dec_append - Append decoded bytes to the scratch buffer (no-op if !keep)
+ */
+static bool dec_append(oci_stream_t *s, bool keep, const char *src, size_t n) {
+    if (!keep || n == 0) {
+        return true;
+    }
+    if (s->dec_len + n > s->dec_cap) {
+        size_t cap = s->dec_cap ? s->dec_cap * 2 : 256;
+        while (cap < s->dec_len + n) {
+            cap *= 2;
+        }
+        char *dec = realloc(s->dec, cap);
+        if (!dec) {
+            return false;
+        }
+        s->dec = dec;
+        s->dec_cap = cap;
+    }
+    memcpy(s->dec + s->dec_len, src, n);
+    s->dec_len += n;
+    return true;
+}
+
+static bool parse_hex4(const char *p, const char *end, uint32_t *out) {
+    uint32_t v = 0;
+
+    if (end - p < 4) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (uint32_t)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (uint32_t)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (uint32_t)(c - 'A' + 10);
+        else return false;
+    }
+    *out = v;
+    return true;
+}
+
+/**
+ * decode_escape - Decode the escape at @p (just past the backslash)
+ *
+ * Returns: Pointer past the escape, or NULL if jansson would reject it
+ */
+static const char *decode_escape(oci_stream_t *s, const char *p, bool keep) {
+    const char *end = s->end;
+    char out[4];
+    size_t n = 1;
+    uint32_t cp;
+
+    if (p >= end) {
+        return NULL;
+    }
+
+    switch (*p) {
+    case '"': case '\\': case '/': out[0] = *p; break;
+    case 'b': out[0] = '\b'; break;
+    case 'f': out[0] = '\f'; break;
+    case 'n': out[0] = '\n'; break;
+    case 'r': out[0] = '\r'; break;
+    case 't': out[0] = '\t'; break;
+    case 'u':
+        if (!parse_hex4(p + 1, end, &cp)) {
+            return NULL;
+        }
+        p += 4;
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            uint32_t low;
+            if (end - p < 3 || p[1] != '\\' || p[2] != 'u' ||
+                !parse_hex4(p + 3, end, &low) || low < 0xDC00 || low > 0xDFFF) {
+                return NULL;
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+        } else if ((cp >= 0xDC00 && cp <= 0xDFFF) || cp == 0) {
+            /* Lone low surrogate, or \u0000 (jansson needs JSON_ALLOW_NUL) */
+            return NULL;
+        }
+
+        if (cp < 0x80) {
+            out[0] = (char)cp;
+        } else if (cp < 0x800) {
+            out[0] = (char)(0xC0 | (cp >> 6));
+            out[1] = (char)(0x80 | (cp & 0x3F));
+            n = 2;
+        } else if (cp < 0x10000) {
+            out[0] = (char)(0xE0 | (cp >> 12));
+            out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = (char)(0x80 | (cp & 0x3F));
+            n = 3;
+        } else {
+            out[0] = (char)(0xF0 | (cp >> 18));
+            out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+            out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            out[3] = (char)(0x80 | (cp & 0x3F));
+            n = 4;
+        }
+        break;
+    default:
+        return NULL;
+    }
+
+    return dec_append(s, keep, out, n) ? p + 1 : NULL;
+}
+
+/**
+ * stream_string_slow - Decode a string containing escapes or non-ASCII bytes
+ * @start: First byte after the opening quote
+ * @stop: First byte scan_plain() stopped at
+ * @keep: Decode into s->dec (otherwise only validate)
+ */
+static bool stream_string_slow(oci_stream_t *s, const char *start, const char *stop, bool keep) {
+    const char *p = stop;
+
+    s->dec_len = 0;
+    if (!dec_append(s, keep, start, (size_t)(stop - start))) {
+        return false;
+    }
+
+    while (p && p < s->end) {
+        unsigned char c = (unsigned char)*p;
+
+        if (c == '"') {
+            s->p = p + 1;
+            return true;
+        }
+
+        if (c == '\\') {
+            p = decode_escape(s, p + 1, keep);
+        } else if (c < 0x20) {
+            p = NULL;
+        } else if (c >= 0x80) {
+            size_t n = utf8_valid_len((const unsigned char *)p, (const unsigned char *)s->end);
+            p = (n && dec_append(s, keep, p, n)) ? p + n : NULL;
+        } else {
+            const char *run = scan_plain(p, s->end);
+            p = dec_append(s, keep, p, (size_t)(run - p)) ? run : NULL;
+        }
+    }
+    return false;
+}
+
+/**
+ * stream_string_span - Parse the string at s->p
+ * @str: Receives the contents (in the input or s->dec), or NULL to skip
+ * @len: Receives the length of the contents
+ * @decoded: Set if the contents live in s->dec
+ */
+static bool stream_string_span(oci_stream_t *s, const char **str, size_t *len, bool *decoded) {
+    const char *start = s->p + 1;
+    const char *stop = scan_plain(start, s->end);
+
+    if (stop < s->end && *stop == '"') {
+        if (str) {
+            *str = start;
+            *len = (size_t)(stop - start);
+            *decoded = false;
+        }
+        s->p = stop + 1;
+        return true;
+    }
+
+    if (!stream_string_slow(s, start, stop, str != NULL)) {
+        return false;
+    }
+    if (str) {
+        *str = s->dec;
+        *len = s->dec_len;
+        *decoded = true;
+    }
+    return true;
+}
+
+/**
+ * stream_string - Parse the string at s->p into the arena (or just skip it)
+ */
+static bool stream_string(oci_stream_t *s, char **out) {
+    const char *str;
+    size_t len;
+    bool decoded;
+
+    if (!out) {
+        return stream_string_span(s, NULL, NULL, NULL);
+    }
+    if (!stream_string_span(s, &str, &len, &decoded)) {
+        return false;
+    }
+    *out = nk_arena_strndup(s->arena, str, len);
+    return *out != NULL;
+}
+
+/* ---- Containers and scalars ------------------------------------------- */
+
+static bool stream_skip_value(oci_stream_t *s);
+
+static bool stream_enter(oci_stream_t *s, char open) {
+    if (!stream_expect(s, open) || ++s->depth > STREAM_MAX_DEPTH) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * stream_object_next - Advance to the next member of an object
+ * @count: Members seen so far in this object
+ * @key: Receives the member key
+ * @done: Set once the closing brace has been consumed
+ *
+ * On success with !*done, s->p is positioned at the member value, which is
+ * guaranteed to be inside the input, so callers may peek at *s->p.
+ */
+static bool stream_object_next(oci_stream_t *s, size_t *count, stream_key_t *key, bool *done) {
+    char c;
+
+    *done = false;
+    if (!stream_peek(s, &c)) {
+        return false;
+    }
+    if (c == '}') {
+        s->p++;
+        s->depth--;
+        *done = true;
+        return true;
+    }
+    if (*count > 0) {
+        if (c != ',') {
+            return false;
+        }
+        s->p++;
+        if (!stream_peek(s, &c)) {
+            return false;
+        }
+    }
+    if (c != '"' || !stream_string_span(s, &key->str, &key->len, &key->decoded)) {
+        return false;
+    }
+    if (!stream_expect(s, ':')) {
+        return false;
+    }
+    s->p = scan_ws(s->p, s->end);
+    if (s->p >= s->end) {
+        return false;
+    }
+    (*count)++;
+    return true;
+}
+
+/**
+ * stream_array_next - Advance to the next element of an array
+ */
+static bool stream_array_next(oci_stream_t *s, size_t *count, bool *done) {
+    char c;
+
+    *done = false;
+    if (!stream_peek(s, &c)) {
+        return false;
+    }
+    if (c == ']') {
+        s->p++;
+        s->depth--;
+        *done = true;
+        return true;
+    }
+    if (*count > 0) {
+        if (c != ',') {
+            return false;
+        }
+        s->p = scan_ws(s->p + 1, s->end);
+        if (s->p >= s->end) {
+            return false;
+        }
+    }
+    (*count)++;
+    return true;
+}
+
+/**
+ * stream_number - Validate a JSON number, returning its value if integral
+ *
+ * Integers outside json_int_t and reals that overflow are errors in jansson.
+ */
+static bool stream_number(oci_stream_t *s, bool *is_int, long long *ival) {
+    const char *start = s->p;
+    const char *p = s->p;
+    const char *end = s->end;
+    bool integer = true;
+    char buf[STREAM_MAX_NUMBER];
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p >= end || !IS_DIGIT(*p)) {
+        return false;
+    }
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && IS_DIGIT(*p)) p++;
+    }
+    if (p < end && *p == '.') {
+        integer = false;
+        p++;
+        if (p >= end || !IS_DIGIT(*p)) {
+            return false;
+        }
+        while (p < end && IS_DIGIT(*p)) p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        integer = false;
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p >= end || !IS_DIGIT(*p)) {
+            return false;
+        }
+        while (p < end && IS_DIGIT(*p)) p++;
+    }
+#undef IS_DIGIT
+
+    size_t n = (size_t)(p - start);
+    if (n >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, start, n);
+    buf[n] = '\0';
+
+    errno = 0;
+    if (integer) {
+        long long v = strtoll(buf, NULL, 10);
+        if (errno == ERANGE) {
+            return false;
+        }
+        *ival = v;
+    } else {
+        double d = strtod(buf, NULL);
+        if (errno == ERANGE && isinf(d)) {
+            return false;
+        }
+        *ival = 0;
+    }
+
+    *is_int = integer;
+    s->p = p;
+    return true;
+}
+
+static bool stream_literal(oci_stream_t *s, const char *lit, size_t len) {
+    if ((size_t)(s->end - s->p) < len || memcmp(s->p, lit, len) != 0) {
+        return false;
+    }
+    s->p += len;
+    return true;
+}
+
+static bool stream_skip_value(oci_stream_t *s) {
+    stream_key_t key;
+    size_t count = 0;
+    bool done = false;
+    bool is_int;
+    long long ival;
+    char c;
+
+    if (!stream_peek(s, &c)) {
+        return false;
+    }
+
+    switch (c) {
+    case '"':
+        return stream_string(s, NULL);
+    case '{':
+        if (!stream_enter(s, '{')) {
+            return false;
+        }
+        while (stream_object_next(s, &count, &key, &done) && !done) {
+            if (!stream_skip_value(s)) {
+                return false;
+            }
+        }
+        return done;
+    case '[':
+        if (!stream_enter(s, '[')) {
+            return false;
+        }
+        while (stream_array_next(s, &count, &done) && !done) {
+            if (!stream_skip_value(s)) {
+                return false;
+            }
+        }
+        return done;
+    case 't':
+        return stream_literal(s, "true", 4);
+    case 'f':
+        return stream_literal(s, "false", 5);
+    case 'n':
+        return stream_literal(s, "null", 4);
+    default:
+        return stream_number(s, &is_int, &ival);
+    }
+}
+
+/* Value is a string: decode into *dst. Anything else is skipped, like json_is_string() */
+static bool stream_string_opt(oci_stream_t *s, char **dst) {
+    return *s->p == '"' ? stream_string(s, dst) : stream_skip_value(s);
+}
+
+/* json_is_true(): only the literal true counts */
+static bool stream_true(oci_stream_t *s, bool *dst) {
+    const char *start = s->p;
+
+    if (!stream_skip_value(s)) {
+        return false;
+    }
+    *dst = (s->p - start == 4 && memcmp(start, "true", 4) == 0);
+    return true;
+}
+
+/* json_integer_value(): integers keep their value, every other type reads as 0 */
+static bool stream_integer(oci_stream_t *s, long long *dst) {
+    bool is_int = false;
+
+    *dst = 0;
+    if (*s->p == '-' || (*s->p >= '0' && *s->p <= '9')) {
+        if (!stream_number(s, &is_int, dst)) {
+            return false;
+        }
+        if (!is_int) {
+            *dst = 0;
+        }
+        return true;
+    }
+    return stream_skip_value(s);
+}
+
+/**
+ * stack_push - Stage one array element on the scratch stack
+ */
+static bool stack_push(oci_stream_t *s, const void *elem, size_t size) {
+    if (s->stack_len + size > s->stack_cap) {
+        size_t cap = s->stack_cap ? s->stack_cap * 2 : 512;
+        while (cap < s->stack_len + size) {
+            cap *= 2;
+        }
+        char *stack = realloc(s->stack, cap);
+        if (!stack) {
+            return false;
+        }
+        s->stack = stack;
+        s->stack_cap = cap;
+    }
+    memcpy(s->stack + s->stack_len, elem, size);
+    s->stack_len += size;
+    return true;
+}
+
+/**
+ * stack_commit - Move the elements staged since @mark into one arena array
+ * @tail: Extra zeroed bytes after the elements (NULL terminators)
+ */
+static void *stack_commit(oci_stream_t *s, size_t mark, size_t tail) {
+    size_t n = s->stack_len - mark;
+    char *dst = nk_arena_alloc(s->arena, n + tail);
+
+    if (dst && n > 0) {
+        memcpy(dst, s->stack + mark, n);
+    }
+    s->stack_len = mark;
+    return dst;
+}
+
+/**
+ * stream_strv - Parse an array into a string vector
+ * @terminate: Keep a trailing NULL slot (args/env are passed to execve)
+ *
+ * Non-string elements become NULL slots but still count, as in the DOM path.
+ */
+static bool stream_strv(oci_stream_t *s, char ***vec, size_t *len, bool terminate) {
+    size_t mark = s->stack_len;
+    size_t count = 0;
+    bool done = false;
+
+    if (!stream_enter(s, '[')) {
+        return false;
+    }
+
+    for (;;) {
+        char *str = NULL;
+
+        if (!stream_array_next(s, &count, &done)) {
+            return false;
+        }
+        if (done) {
+            break;
+        }
+        if (!stream_string_opt(s, &str) || !stack_push(s, &str, sizeof(str))) {
+            return false;
+        }
+    }
+
+    *len = (s->stack_len - mark) / sizeof(char *);
+    *vec = stack_commit(s, mark, terminate ? sizeof(char *) : 0);
+    return *vec != NULL;
+}
+
+/* ---- OCI sections ----------------------------------------------------- */
+
+static bool stream_user(oci_stream_t *s, nk_oci_process_t *proc) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    long long v;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (stream_object_next(s, &count, &key, &done)) {
+        if (done) {
+            return true;
+        }
+
+        unsigned bit = KEY_IS(&key, "uid") ? 1u : KEY_IS(&key, "gid") ? 2u : 0u;
+        if (bit & seen) {
+            return false;   /* Duplicate key: jansson keeps the last one */
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            if (!stream_integer(s, &v)) return false;
+            proc->uid = (uid_t)v;
+        } else if (bit == 2u) {
+            if (!stream_integer(s, &v)) return false;
+            proc->gid = (gid_t)v;
+        } else if (!stream_skip_value(s)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+enum {
+    PROC_TERMINAL = 1u << 0,
+    PROC_CONSOLE = 1u << 1,
+    PROC_USER = 1u << 2,
+    PROC_ARGS = 1u << 3,
+    PROC_ENV = 1u << 4,
+    PROC_CWD = 1u << 5,
+    PROC_NNP = 1u << 6,
+};
+
+static bool stream_process(oci_stream_t *s, nk_oci_spec_t *spec) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool have_args = false;
+    bool ok = true;
+
+    /* A non-object "process" has no args: the DOM path reports exactly that */
+    if (*s->p != '{') {
+        if (!stream_skip_value(s)) {
+            return false;
+        }
+        s->missing_args = true;
+        return true;
+    }
+
+    nk_oci_process_t *proc = nk_arena_alloc(s->arena, sizeof(*proc));
+    if (!proc || !stream_enter(s, '{')) {
+        return false;
+    }
+    spec->process = proc;
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "terminal") ? PROC_TERMINAL :
+                       KEY_IS(&key, "consoleSize") ? PROC_CONSOLE :
+                       KEY_IS(&key, "user") ? PROC_USER :
+                       KEY_IS(&key, "args") ? PROC_ARGS :
+                       KEY_IS(&key, "env") ? PROC_ENV :
+                       KEY_IS(&key, "cwd") ? PROC_CWD :
+                       KEY_IS(&key, "noNewPrivileges") ? PROC_NNP : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        switch (bit) {
+        case PROC_TERMINAL:
+            ok = stream_true(s, &proc->terminal);
+            break;
+        case PROC_CONSOLE:
+            ok = stream_string_opt(s, &proc->console_size);
+            break;
+        case PROC_USER:
+            ok = stream_user(s, proc);
+            break;
+        case PROC_ARGS:
+            if (*s->p == '[') {
+                have_args = true;
+                ok = stream_strv(s, &proc->args, &proc->args_len, true);
+            } else {
+                ok = stream_skip_value(s);
+            }
+            break;
+        case PROC_ENV:
+            ok = *s->p == '[' ? stream_strv(s, &proc->env, &proc->env_len, true) :
+                                stream_skip_value(s);
+            break;
+        case PROC_CWD:
+            ok = stream_string_opt(s, &proc->cwd);
+            break;
+        case PROC_NNP:
+            ok = stream_true(s, &proc->no_new_privileges);
+            break;
+        default:
+            ok = stream_skip_value(s);
+            break;
+        }
+    }
+    if (!ok || !done) {
+        return false;
+    }
+
+    if (!have_args) {
+        s->missing_args = true;
+        spec->process = NULL;
+        return true;
+    }
+    if (!proc->cwd) {
+        proc->cwd = nk_arena_strdup(s->arena, "/");
+    }
+    return proc->cwd != NULL;
+}
+
+static bool stream_root(oci_stream_t *s, nk_oci_spec_t *spec) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    if (*s->p != '{') {
+        if (!stream_skip_value(s)) {
+            return false;
+        }
+        s->missing_root_path = true;
+        return true;
+    }
+
+    nk_oci_root_t *root = nk_arena_alloc(s->arena, sizeof(*root));
+    if (!root || !stream_enter(s, '{')) {
+        return false;
+    }
+    spec->root = root;
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "path") ? 1u : KEY_IS(&key, "readonly") ? 2u : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            ok = stream_string_opt(s, &root->path);
+        } else if (bit == 2u) {
+            ok = stream_true(s, &root->readonly);
+        } else {
+            ok = stream_skip_value(s);
+        }
+    }
+    if (!ok || !done) {
+        return false;
+    }
+
+    if (!root->path) {
+        s->missing_root_path = true;
+        spec->root = NULL;
+    }
+    return true;
+}
+
+/**
+ * stream_mount - Parse one mounts[] entry into @m
+ */
+static bool stream_mount(oci_stream_t *s, nk_oci_mount_t *m) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "destination") ? 1u :
+                       KEY_IS(&key, "type") ? 2u :
+                       KEY_IS(&key, "source") ? 4u :
+                       KEY_IS(&key, "options") ? 8u : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        switch (bit) {
+        case 1u: ok = stream_string_opt(s, &m->destination); break;
+        case 2u: ok = stream_string_opt(s, &m->type); break;
+        case 4u: ok = stream_string_opt(s, &m->source); break;
+        case 8u:
+            ok = *s->p == '[' ? stream_strv(s, &m->options, &m->options_len, false) :
+                                stream_skip_value(s);
+            break;
+        default: ok = stream_skip_value(s); break;
+        }
+    }
+    return ok && done;
+}
+
+static bool stream_mounts(oci_stream_t *s, nk_oci_spec_t *spec) {
+    size_t mark = s->stack_len;
+    size_t count = 0;
+    bool done = false;
+
+    if (*s->p != '[') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '[')) {
+        return false;
+    }
+
+    for (;;) {
+        nk_oci_mount_t m = {0};
+
+        if (!stream_array_next(s, &count, &done)) {
+            return false;
+        }
+        if (done) {
+            break;
+        }
+        if (!stream_mount(s, &m)) {
+            return false;
+        }
+        /* Entries without a destination are dropped */
+        if (m.destination && !stack_push(s, &m, sizeof(m))) {
+            return false;
+        }
+    }
+
+    spec->mounts_len = (s->stack_len - mark) / sizeof(nk_oci_mount_t);
+    spec->mounts = stack_commit(s, mark, 0);
+    return spec->mounts != NULL;
+}
+
+/**
+ * stream_namespace - Parse one linux.namespaces[] entry
+ */
+static bool stream_namespace(oci_stream_t *s, nk_oci_namespace_t *ns) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "type") ? 1u : KEY_IS(&key, "path") ? 2u : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            ok = stream_string_opt(s, &ns->type);
+        } else if (bit == 2u) {
+            ok = stream_string_opt(s, &ns->path);
+        } else {
+            ok = stream_skip_value(s);
+        }
+    }
+    return ok && done;
+}
+
+static bool stream_namespaces(oci_stream_t *s, nk_oci_linux_t *linux_cfg) {
+    size_t mark = s->stack_len;
+    size_t count = 0;
+    bool done = false;
+
+    if (!stream_enter(s, '[')) {
+        return false;
+    }
+
+    for (;;) {
+        nk_oci_namespace_t ns = {0};
+
+        if (!stream_array_next(s, &count, &done)) {
+            return false;
+        }
+        if (done) {
+            break;
+        }
+        if (!stream_namespace(s, &ns)) {
+            return false;
+        }
+        /* Entries without a type are dropped */
+        if (ns.type && !stack_push(s, &ns, sizeof(ns))) {
+            return false;
+        }
+    }
+
+    linux_cfg->namespaces_len = (s->stack_len - mark) / sizeof(nk_oci_namespace_t);
+    linux_cfg->namespaces = stack_commit(s, mark, 0);
+    return linux_cfg->namespaces != NULL;
+}
+
+/* One integer member of a resources sub-object */
+typedef struct {
+    const char *key;
+    size_t key_len;
+    int64_t *dst;                  /* uint64_t fields are stored through it too */
+} stream_int_field_t;
+
+#define INT_FIELD(name, field) { name, sizeof(name) - 1, (int64_t *)&(field) }
+
+/**
+ * stream_int_fields - Parse an object whose known members are all integers
+ *
+ * Non-object values are skipped, as json_is_object() would.
+ */
+static bool stream_int_fields(oci_stream_t *s, const stream_int_field_t *fields, size_t n) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    long long v;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (stream_object_next(s, &count, &key, &done) && !done) {
+        size_t i = 0;
+
+        while (i < n && !(key.len == fields[i].key_len &&
+                          memcmp(key.str, fields[i].key, key.len) == 0)) {
+            i++;
+        }
+        if (i == n) {
+            if (!stream_skip_value(s)) {
+                return false;
+            }
+            continue;
+        }
+        if (seen & (1u << i)) {
+            return false;
+        }
+        seen |= 1u << i;
+
+        if (!stream_integer(s, &v)) {
+            return false;
+        }
+        *fields[i].dst = (int64_t)v;
+    }
+    return done;
+}
+
+/**
+ * stream_blkio_devices - Parse one blockIO device list
+ * @value: Member holding the entry's value ("weight" or "rate")
+ *
+ * Entries that are not objects are dropped, as in the DOM path.
+ */
+static bool stream_blkio_devices(oci_stream_t *s, const char *value,
+                                 nk_oci_blkio_device_t **devices, size_t *len) {
+    size_t mark = s->stack_len;
+    size_t count = 0;
+    bool done = false;
+
+    if (*s->p != '[') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '[')) {
+        return false;
+    }
+
+    for (;;) {
+        nk_oci_blkio_device_t dev = {0};
+        const stream_int_field_t fields[] = {
+            INT_FIELD("major", dev.major),
+            INT_FIELD("minor", dev.minor),
+            { value, strlen(value), &dev.value },
+        };
+
+        if (!stream_array_next(s, &count, &done)) {
+            return false;
+        }
+        if (done) {
+            break;
+        }
+        if (*s->p != '{') {
+            if (!stream_skip_value(s)) {
+                return false;
+            }
+            continue;
+        }
+        if (!stream_int_fields(s, fields, sizeof(fields) / sizeof(fields[0])) ||
+            !stack_push(s, &dev, sizeof(dev))) {
+            return false;
+        }
+    }
+
+    *len = (s->stack_len - mark) / sizeof(nk_oci_blkio_device_t);
+    *devices = stack_commit(s, mark, 0);
+    return *devices != NULL;
+}
+
+static bool stream_blkio(oci_stream_t *s, nk_oci_resources_t *res) {
+    static const struct {
+        const char *list;
+        size_t list_len;
+        const char *value;
+    } lists[NK_OCI_BLKIO_LISTS] = {
+#define BLKIO_LIST(id, name, value) [id] = { name, sizeof(name) - 1, value }
+        BLKIO_LIST(NK_OCI_BLKIO_WEIGHT_DEVICE, "weightDevice", "weight"),
+        BLKIO_LIST(NK_OCI_BLKIO_READ_BPS, "throttleReadBpsDevice", "rate"),
+        BLKIO_LIST(NK_OCI_BLKIO_WRITE_BPS, "throttleWriteBpsDevice", "rate"),
+        BLKIO_LIST(NK_OCI_BLKIO_READ_IOPS, "throttleReadIOPSDevice", "rate"),
+        BLKIO_LIST(NK_OCI_BLKIO_WRITE_IOPS, "throttleWriteIOPSDevice", "rate"),
+#undef BLKIO_LIST
+    };
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+    long long v;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "weight") ? 1u :
+                       KEY_IS(&key, "leafWeight") ? 2u : 0u;
+        int l = 0;
+
+        while (!bit && l < NK_OCI_BLKIO_LISTS &&
+               !(key.len == lists[l].list_len && memcmp(key.str, lists[l].list, key.len) == 0)) {
+            l++;
+        }
+        if (!bit && l < NK_OCI_BLKIO_LISTS) {
+            bit = 4u << l;
+        }
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            ok = stream_integer(s, &v);
+            res->blkio.weight = (uint64_t)v;
+        } else if (bit == 2u) {
+            ok = stream_integer(s, &v);
+            res->blkio.leaf_weight = v;
+        } else if (bit) {
+            ok = stream_blkio_devices(s, lists[l].value, &res->blkio.devices[l],
+                                      &res->blkio.devices_len[l]);
+        } else {
+            ok = stream_skip_value(s);
+        }
+    }
+    return ok && done;
+}
+
+static bool stream_resources(oci_stream_t *s, nk_oci_linux_t *linux_cfg) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    nk_oci_resources_t *res = nk_arena_alloc(s->arena, sizeof(*res));
+    if (!res || !stream_enter(s, '{')) {
+        return false;
+    }
+    linux_cfg->resources = res;
+
+    const stream_int_field_t memory[] = {
+        INT_FIELD("limit", res->memory.limit),
+        INT_FIELD("reservation", res->memory.reservation),
+        INT_FIELD("swap", res->memory.swap),
+        INT_FIELD("kernel", res->memory.kernel),
+    };
+    const stream_int_field_t cpu[] = {
+        INT_FIELD("shares", res->cpu.shares),
+        INT_FIELD("quota", res->cpu.quota),
+        INT_FIELD("period", res->cpu.period),
+        INT_FIELD("burst", res->cpu.burst),
+        INT_FIELD("idle", res->cpu.idle),
+        INT_FIELD("realtimeRuntime", res->cpu.realtime_runtime),
+        INT_FIELD("realtimePeriod", res->cpu.realtime_period),
+    };
+    const stream_int_field_t pids[] = {
+        INT_FIELD("limit", res->pids_limit),
+    };
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "memory") ? 1u :
+                       KEY_IS(&key, "cpu") ? 2u :
+                       KEY_IS(&key, "pids") ? 4u :
+                       KEY_IS(&key, "blockIO") ? 8u : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            ok = stream_int_fields(s, memory, sizeof(memory) / sizeof(memory[0]));
+        } else if (bit == 2u) {
+            ok = stream_int_fields(s, cpu, sizeof(cpu) / sizeof(cpu[0]));
+        } else if (bit == 4u) {
+            ok = stream_int_fields(s, pids, sizeof(pids) / sizeof(pids[0]));
+        } else if (bit == 8u) {
+            ok = stream_blkio(s, res);
+        } else {
+            /* devices, hugepage limits etc. are not consumed yet */
+            ok = stream_skip_value(s);
+        }
+    }
+    return ok && done;
+}
+
+#undef INT_FIELD
+
+static bool stream_linux(oci_stream_t *s, nk_oci_spec_t *spec) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    /* The DOM path allocates linux_config for any "linux" value */
+    spec->linux_config = nk_arena_alloc(s->arena, sizeof(*spec->linux_config));
+    if (!spec->linux_config) {
+        return false;
+    }
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "namespaces") ? 1u :
+                       KEY_IS(&key, "rootfsPropagation") ? 2u :
+                       KEY_IS(&key, "resources") ? 4u : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        if (bit == 1u) {
+            ok = *s->p == '[' ? stream_namespaces(s, spec->linux_config) :
+                                stream_skip_value(s);
+        } else if (bit == 2u) {
+            ok = stream_string_opt(s, &spec->linux_config->rootfs_propagation);
+        } else if (bit == 4u) {
+            ok = stream_resources(s, spec->linux_config);
+        } else {
+            /* devices, seccomp etc. are not consumed yet */
+            ok = stream_skip_value(s);
+        }
+    }
+    return ok && done;
+}
+
+/* One annotations member; ann is NULL for non-string values */
+typedef struct {
+    const char *key;
+    size_t key_len;
+    char *ann;
+} stream_ann_t;
+
+static int ann_key_cmp(const void *a, const void *b) {
+    const stream_ann_t *x = a;
+    const stream_ann_t *y = b;
+    int r = memcmp(x->key, y->key, x->key_len < y->key_len ? x->key_len : y->key_len);
+
+    if (r != 0) {
+        return r;
+    }
+    return (x->key_len > y->key_len) - (x->key_len < y->key_len);
+}
+
+/**
+ * stream_annotations - Parse annotations into "key=value" strings
+ *
+ * jansson keeps only the last of duplicate keys; such documents go to it.
+ */
+static bool stream_annotations(oci_stream_t *s, nk_oci_spec_t *spec) {
+    stream_key_t key;
+    size_t mark = s->stack_len;
+    size_t count = 0;
+    bool done = false;
+
+    if (*s->p != '{') {
+        return stream_skip_value(s);
+    }
+    if (!stream_enter(s, '{')) {
+        return false;
+    }
+
+    while (stream_object_next(s, &count, &key, &done) && !done) {
+        stream_ann_t a = { .key = key.str, .key_len = key.len };
+
+        /* A decoded key lives in s->dec, which the value would overwrite */
+        if (key.decoded && !(a.key = nk_arena_strndup(s->arena, key.str, key.len))) {
+            return false;
+        }
+
+        if (*s->p == '"') {
+            const char *value;
+            size_t value_len;
+            bool decoded;
+
+            if (!stream_string_span(s, &value, &value_len, &decoded)) {
+                return false;
+            }
+            a.ann = nk_arena_alloc(s->arena, a.key_len + value_len + 2);
+            if (!a.ann) {
+                return false;
+            }
+            memcpy(a.ann, a.key, a.key_len);
+            a.ann[a.key_len] = '=';
+            memcpy(a.ann + a.key_len + 1, value, value_len);
+        } else if (!stream_skip_value(s)) {
+            return false;
+        }
+
+        if (!stack_push(s, &a, sizeof(a))) {
+            return false;
+        }
+    }
+    if (!done) {
+        return false;
+    }
+
+    stream_ann_t *members = (stream_ann_t *)(s->stack + mark);
+    size_t n = (s->stack_len - mark) / sizeof(stream_ann_t);
+    size_t strings = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        strings += members[i].ann != NULL;
+    }
+    spec->annotations = nk_arena_alloc(s->arena, strings * sizeof(char *));
+    if (!spec->annotations) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (members[i].ann) {
+            spec->annotations[spec->annotations_len++] = members[i].ann;
+        }
+    }
+
+    bool unique = true;
+    if (n > 1) {
+        qsort(members, n, sizeof(*members), ann_key_cmp);
+        for (size_t i = 1; i < n && unique; i++) {
+            unique = ann_key_cmp(&members[i - 1], &members[i]) != 0;
+        }
+    }
+    s->stack_len = mark;
+    return unique;
+}
+
+enum {
+    SPEC_VERSION = 1u << 0,
+    SPEC_PROCESS = 1u << 1,
+    SPEC_ROOT = 1u << 2,
+    SPEC_HOSTNAME = 1u << 3,
+    SPEC_MOUNTS = 1u << 4,
+    SPEC_LINUX = 1u << 5,
+    SPEC_ANNOTATIONS = 1u << 6,
+};
+
+static bool stream_spec(oci_stream_t *s, nk_oci_spec_t *spec) {
+    stream_key_t key;
+    size_t count = 0;
+    unsigned seen = 0;
+    bool done = false;
+    bool ok = true;
+
+    if (!stream_enter(s, '{')) {
+        return false;   /* Top-level arrays etc. are left to jansson */
+    }
+
+    while (ok && stream_object_next(s, &count, &key, &done) && !done) {
+        unsigned bit = KEY_IS(&key, "ociVersion") ? SPEC_VERSION :
+                       KEY_IS(&key, "process") ? SPEC_PROCESS :
+                       KEY_IS(&key, "root") ? SPEC_ROOT :
+                       KEY_IS(&key, "hostname") ? SPEC_HOSTNAME :
+                       KEY_IS(&key, "mounts") ? SPEC_MOUNTS :
+                       KEY_IS(&key, "linux") ? SPEC_LINUX :
+                       KEY_IS(&key, "annotations") ? SPEC_ANNOTATIONS : 0u;
+        if (bit & seen) {
+            return false;
+        }
+        seen |= bit;
+
+        switch (bit) {
+        case SPEC_VERSION: ok = stream_string_opt(s, &spec->oci_version); break;
+        case SPEC_PROCESS: ok = stream_process(s, spec); break;
+        case SPEC_ROOT: ok = stream_root(s, spec); break;
+        case SPEC_HOSTNAME: ok = stream_string_opt(s, &spec->hostname); break;
+        case SPEC_MOUNTS: ok = stream_mounts(s, spec); break;
+        case SPEC_LINUX: ok = stream_linux(s, spec); break;
+        case SPEC_ANNOTATIONS: ok = stream_annotations(s, spec); break;
+        default: ok = stream_skip_value(s); break;
+        }
+    }
+    return ok && done;
+}
+
+/**
+ * nk_oci_stream_parse - Parse config.json without a DOM
+ */
+int nk_oci_stream_parse(const char *json, size_t len, nk_oci_spec_t **spec_out,
+                        unsigned *missing) {
+    oci_stream_t s = {
+        .p = json,
+        .end = json + len,
+    };
+
+    /* Decoded strings never outgrow their JSON; the slack covers structs */
+    nk_oci_spec_t *spec = nk_oci_spec_new(len + len / 2 + 512);
+    if (!spec) {
+        return -1;
+    }
+    s.arena = nk_oci_spec_arena(spec);
+
+    bool ok = stream_spec(&s, spec) && scan_ws(s.p, s.end) == s.end;
+    free(s.dec);
+    free(s.stack);
+    if (!ok) {
+        nk_oci_spec_free(spec);
+        return -1;
+    }
+
+    *missing = (s.missing_args ? NK_OCI_MISSING_ARGS : 0) |
+               (s.missing_root_path ? NK_OCI_MISSING_ROOT_PATH : 0);
+    *spec_out = spec;
+    return 0;
+}
@@ -5,12 +5,62 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "nk_oci.h"
 #include "nk_log.h"
+#include "oci/parser.h"
+#include "oci/spec_image.h"
 
 #define CONFIG_JSON "config.json"
 
+/* Parsed spec kept in memory, tagged with the config.json identity it came from */
+typedef struct spec_cache_entry {
+    struct spec_cache_entry *next;
+    char *bundle_path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    nk_oci_spec_t *spec;
+} spec_cache_entry_t;
+
+/* A spec and the arena holding every string and array it points to */
+typedef struct {
+    nk_arena_t arena;
+    nk_oci_spec_t spec;
+} spec_block_t;
+
+static bool spec_cache_enabled = false;
+static spec_cache_entry_t *spec_cache_head = NULL;
+
+static spec_block_t *spec_block(nk_oci_spec_t *spec) {
+    return (spec_block_t *)((char *)spec - offsetof(spec_block_t, spec));
+}
+
+/**
+ * nk_oci_spec_new - Allocate an empty spec with its own arena
+ */
+nk_oci_spec_t *nk_oci_spec_new(size_t size_hint) {
+    spec_block_t *block = malloc(sizeof(*block) + size_hint);
+    if (!block) {
+        return NULL;
+    }
+    memset(block, 0, sizeof(*block));
+    nk_arena_init(&block->arena, block + 1, size_hint);
+    return &block->spec;
+}
+
+/**
+ * nk_oci_spec_arena - Arena backing a spec from nk_oci_spec_new()
+ */
+nk_arena_t *nk_oci_spec_arena(nk_oci_spec_t *spec) {
+    return &spec_block(spec)->arena;
+}
+
 static char *load_json_file(const char *path) {
     FILE *f = fopen(path, "r");
     if (!f) {
@@ -53,8 +103,22 @@ static char *load_json_file(const char *path) {
     return content;
 }
 
-static nk_oci_process_t *parse_process(json_t *proc_obj) {
-    nk_oci_process_t *proc = calloc(1, sizeof(*proc));
+/**
+ * spec_report_missing - Print errors for missing required fields
+ *
+ * Shared by both parsers so their output is byte-for-byte the same.
+ */
+static void spec_report_missing(unsigned missing) {
+    if (missing & NK_OCI_MISSING_ARGS) {
+        nk_stderr( "Error: Process args is required\n");
+    }
+    if (missing & NK_OCI_MISSING_ROOT_PATH) {
+        nk_stderr( "Error: Root path is required\n");
+    }
+}
+
+static nk_oci_process_t *parse_process(nk_arena_t *arena, json_t *proc_obj) {
+    nk_oci_process_t *proc = nk_arena_alloc(arena, sizeof(*proc));
     if (!proc) {
         return NULL;
     }
@@ -68,7 +132,7 @@ static nk_oci_process_t *parse_process(json_t *proc_obj) {
     /* Parse console size */
     json_t *console_size = json_object_get(proc_obj, "consoleSize");
     if (console_size && json_is_string(console_size)) {
-        proc->console_size = strdup(json_string_value(console_size));
+        proc->console_size = nk_arena_strdup(arena, json_string_value(console_size));
     }
 
     /* Parse user */
@@ -83,22 +147,20 @@ static nk_oci_process_t *parse_process(json_t *proc_obj) {
     /* Parse args (required) */
     json_t *args = json_object_get(proc_obj, "args");
     if (!args || !json_is_array(args)) {
-        nk_stderr( "Error: Process args is required\n");
-        free(proc);
+        spec_report_missing(NK_OCI_MISSING_ARGS);
         return NULL;
     }
 
     size_t args_len = json_array_size(args);
-    proc->args = calloc(args_len + 1, sizeof(char *));
+    proc->args = nk_arena_alloc(arena, (args_len + 1) * sizeof(char *));
     if (!proc->args) {
-        free(proc);
         return NULL;
     }
 
     for (size_t i = 0; i < args_len; i++) {
         json_t *arg = json_array_get(args, i);
         if (json_is_string(arg)) {
-            proc->args[i] = strdup(json_string_value(arg));
+            proc->args[i] = nk_arena_strdup(arena, json_string_value(arg));
         }
     }
     proc->args_len = args_len;
@@ -107,12 +169,12 @@ static nk_oci_process_t *parse_process(json_t *proc_obj) {
     json_t *env = json_object_get(proc_obj, "env");
     if (env && json_is_array(env)) {
         size_t env_len = json_array_size(env);
-        proc->env = calloc(env_len + 1, sizeof(char *));
+        proc->env = nk_arena_alloc(arena, (env_len + 1) * sizeof(char *));
         if (proc->env) {
             for (size_t i = 0; i < env_len; i++) {
                 json_t *e = json_array_get(env, i);
                 if (json_is_string(e)) {
-                    proc->env[i] = strdup(json_string_value(e));
+                    proc->env[i] = nk_arena_strdup(arena, json_string_value(e));
                 }
             }
             proc->env_len = env_len;
@@ -122,9 +184,9 @@ static nk_oci_process_t *parse_process(json_t *proc_obj) {
     /* Parse cwd */
     json_t *cwd = json_object_get(proc_obj, "cwd");
     if (cwd && json_is_string(cwd)) {
-        proc->cwd = strdup(json_string_value(cwd));
+        proc->cwd = nk_arena_strdup(arena, json_string_value(cwd));
     } else {
-        proc->cwd = strdup("/");
+        proc->cwd = nk_arena_strdup(arena, "/");
     }
 
     /* Parse noNewPrivileges */
@@ -136,8 +198,8 @@ static nk_oci_process_t *parse_process(json_t *proc_obj) {
     return proc;
 }
 
-static nk_oci_root_t *parse_root(json_t *root_obj) {
-    nk_oci_root_t *root = calloc(1, sizeof(*root));
+static nk_oci_root_t *parse_root(nk_arena_t *arena, json_t *root_obj) {
+    nk_oci_root_t *root = nk_arena_alloc(arena, sizeof(*root));
     if (!root) {
         return NULL;
     }
@@ -145,11 +207,10 @@ static nk_oci_root_t *parse_root(json_t *root_obj) {
     /* Parse path (required) */
     json_t *path = json_object_get(root_obj, "path");
     if (!path || !json_is_string(path)) {
-        nk_stderr( "Error: Root path is required\n");
-        free(root);
+        spec_report_missing(NK_OCI_MISSING_ROOT_PATH);
         return NULL;
     }
-    root->path = strdup(json_string_value(path));
+    root->path = nk_arena_strdup(arena, json_string_value(path));
 
     /* Parse readonly */
     json_t *readonly = json_object_get(root_obj, "readonly");
@@ -160,8 +221,88 @@ static nk_oci_root_t *parse_root(json_t *root_obj) {
     return root;
 }
 
-static nk_oci_linux_t *parse_linux(json_t *linux_obj) {
-    nk_oci_linux_t *linux_cfg = calloc(1, sizeof(*linux_cfg));
+/* json_integer_value() of a member: non-integers and missing members read as 0 */
+static json_int_t member_int(json_t *obj, const char *key) {
+    return json_integer_value(json_object_get(obj, key));
+}
+
+/* blockIO member of each device list, and the member holding its value */
+static const struct {
+    const char *list;
+    const char *value;
+} blkio_lists[NK_OCI_BLKIO_LISTS] = {
+    [NK_OCI_BLKIO_WEIGHT_DEVICE] = { "weightDevice", "weight" },
+    [NK_OCI_BLKIO_READ_BPS]      = { "throttleReadBpsDevice", "rate" },
+    [NK_OCI_BLKIO_WRITE_BPS]     = { "throttleWriteBpsDevice", "rate" },
+    [NK_OCI_BLKIO_READ_IOPS]     = { "throttleReadIOPSDevice", "rate" },
+    [NK_OCI_BLKIO_WRITE_IOPS]    = { "throttleWriteIOPSDevice", "rate" },
+};
+
+static void parse_blkio(nk_arena_t *arena, json_t *blkio_obj, nk_oci_resources_t *res) {
+    res->blkio.weight = (uint64_t)member_int(blkio_obj, "weight");
+    res->blkio.leaf_weight = member_int(blkio_obj, "leafWeight");
+
+    for (int l = 0; l < NK_OCI_BLKIO_LISTS; l++) {
+        json_t *list = json_object_get(blkio_obj, blkio_lists[l].list);
+        if (!list || !json_is_array(list)) {
+            continue;
+        }
+        size_t len = json_array_size(list);
+        res->blkio.devices[l] = nk_arena_alloc(arena, len * sizeof(nk_oci_blkio_device_t));
+        for (size_t i = 0; res->blkio.devices[l] && i < len; i++) {
+            json_t *dev = json_array_get(list, i);
+
+            /* Entries that are not objects are dropped */
+            if (json_is_object(dev)) {
+                nk_oci_blkio_device_t *slot = &res->blkio.devices[l][res->blkio.devices_len[l]++];
+                slot->major = member_int(dev, "major");
+                slot->minor = member_int(dev, "minor");
+                slot->value = member_int(dev, blkio_lists[l].value);
+            }
+        }
+    }
+}
+
+static nk_oci_resources_t *parse_resources(nk_arena_t *arena, json_t *res_obj) {
+    nk_oci_resources_t *res = nk_arena_alloc(arena, sizeof(*res));
+    if (!res) {
+        return NULL;
+    }
+
+    json_t *memory = json_object_get(res_obj, "memory");
+    if (memory && json_is_object(memory)) {
+        res->memory.limit = member_int(memory, "limit");
+        res->memory.reservation = member_int(memory, "reservation");
+        res->memory.swap = member_int(memory, "swap");
+        res->memory.kernel = member_int(memory, "kernel");
+    }
+
+    json_t *cpu = json_object_get(res_obj, "cpu");
+    if (cpu && json_is_object(cpu)) {
+        res->cpu.shares = (uint64_t)member_int(cpu, "shares");
+        res->cpu.quota = member_int(cpu, "quota");
+        res->cpu.period = (uint64_t)member_int(cpu, "period");
+        res->cpu.burst = (uint64_t)member_int(cpu, "burst");
+        res->cpu.idle = member_int(cpu, "idle");
+        res->cpu.realtime_runtime = member_int(cpu, "realtimeRuntime");
+        res->cpu.realtime_period = (uint64_t)member_int(cpu, "realtimePeriod");
+    }
+
+    json_t *pids = json_object_get(res_obj, "pids");
+    if (pids && json_is_object(pids)) {
+        res->pids_limit = member_int(pids, "limit");
+    }
+
+    json_t *blkio = json_object_get(res_obj, "blockIO");
+    if (blkio && json_is_object(blkio)) {
+        parse_blkio(arena, blkio, res);
+    }
+
+    return res;
+}
+
+static nk_oci_linux_t *parse_linux(nk_arena_t *arena, json_t *linux_obj) {
+    nk_oci_linux_t *linux_cfg = nk_arena_alloc(arena, sizeof(*linux_cfg));
     if (!linux_cfg) {
         return NULL;
     }
@@ -170,7 +311,7 @@ static nk_oci_linux_t *parse_linux(json_t *linux_obj) {
     json_t *namespaces = json_object_get(linux_obj, "namespaces");
     if (namespaces && json_is_array(namespaces)) {
         size_t ns_len = json_array_size(namespaces);
-        linux_cfg->namespaces = calloc(ns_len, sizeof(nk_oci_namespace_t));
+        linux_cfg->namespaces = nk_arena_alloc(arena, ns_len * sizeof(nk_oci_namespace_t));
         if (linux_cfg->namespaces) {
             for (size_t i = 0; i < ns_len; i++) {
                 json_t *ns = json_array_get(namespaces, i);
@@ -178,11 +319,11 @@ static nk_oci_linux_t *parse_linux(json_t *linux_obj) {
                 json_t *path = json_object_get(ns, "path");
 
                 if (type && json_is_string(type)) {
-                    linux_cfg->namespaces[i].type = strdup(json_string_value(type));
+                    nk_oci_namespace_t *slot = &linux_cfg->namespaces[linux_cfg->namespaces_len++];
+                    slot->type = nk_arena_strdup(arena, json_string_value(type));
                     if (path && json_is_string(path)) {
-                        linux_cfg->namespaces[i].path = strdup(json_string_value(path));
+                        slot->path = nk_arena_strdup(arena, json_string_value(path));
                     }
-                    linux_cfg->namespaces_len++;
                 }
             }
         }
@@ -191,56 +332,278 @@ static nk_oci_linux_t *parse_linux(json_t *linux_obj) {
     /* Parse rootfs propagation */
     json_t *prop = json_object_get(linux_obj, "rootfsPropagation");
     if (prop && json_is_string(prop)) {
-        linux_cfg->rootfs_propagation = strdup(json_string_value(prop));
+        linux_cfg->rootfs_propagation = nk_arena_strdup(arena, json_string_value(prop));
     }
 
-    /* TODO: Parse resources */
+    /* Parse resources */
+    json_t *resources = json_object_get(linux_obj, "resources");
+    if (resources && json_is_object(resources)) {
+        linux_cfg->resources = parse_resources(arena, resources);
+    }
 
     return linux_cfg;
 }
 
-nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
-    char config_path[PATH_MAX];
-    snprintf(config_path, sizeof(config_path), "%s/%s", bundle_path, CONFIG_JSON);
+static char **strv_dup(nk_arena_t *arena, char *const *src, size_t len, size_t alloc_len) {
+    char **dst = nk_arena_alloc(arena, alloc_len * sizeof(char *));
+    if (!dst) {
+        return NULL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = nk_arena_strdup(arena, src[i]);
+    }
+    return dst;
+}
 
-    /* Check if bundle directory exists */
-    struct stat st;
-    if (stat(bundle_path, &st) != 0) {
-        if (errno == ENOENT) {
-            nk_stderr( "Error: Bundle directory does not exist: %s\n", bundle_path);
-            nk_stderr( "\n");
-            nk_stderr( "A bundle is a directory containing:\n");
-            nk_stderr( "  config.json    - OCI container specification\n");
-            nk_stderr( "  rootfs/        - Container root filesystem\n");
-            nk_stderr( "\n");
-            nk_stderr( "Usage: ns-runtime create --bundle=<bundle-path> <container-id>\n");
-            nk_stderr( "\n");
-            nk_stderr( "Example:\n");
-            nk_stderr( "  ns-runtime create --bundle=./tests/bundle my-container\n");
-            nk_stderr( "\n");
-            nk_stderr( "To setup a test bundle:\n");
-            nk_stderr( "  ./scripts/setup-rootfs.sh\n");
-        } else {
-            nk_stderr( "Error: Cannot access bundle directory %s: %s\n",
-                    bundle_path, strerror(errno));
+static size_t str_size(const char *s) {
+    return s ? strlen(s) + 1 : 0;
+}
+
+static size_t strv_size(char *const *v, size_t len) {
+    size_t size = (len + 1) * sizeof(char *);
+    for (size_t i = 0; i < len; i++) {
+        size += str_size(v[i]);
+    }
+    return size;
+}
+
+/**
+ * spec_arena_size - Upper bound of the arena bytes a copy of @src needs
+ */
+static size_t spec_arena_size(const nk_oci_spec_t *src) {
+    /* Alignment padding: at most 7 bytes per aligned allocation */
+    size_t size = 256 + str_size(src->oci_version) + str_size(src->hostname);
+
+    if (src->process) {
+        const nk_oci_process_t *p = src->process;
+        size += sizeof(*p) + 8 * 8;
+        size += strv_size(p->args, p->args_len) + strv_size(p->env, p->env_len);
+        size += str_size(p->cwd) + str_size(p->user) + str_size(p->console_size);
+        size += p->additional_gids_len * sizeof(gid_t);
+    }
+    if (src->root) {
+        size += sizeof(*src->root) + str_size(src->root->path);
+    }
+    size += src->mounts_len * sizeof(nk_oci_mount_t);
+    for (size_t i = 0; i < src->mounts_len; i++) {
+        const nk_oci_mount_t *m = &src->mounts[i];
+        size += 8 + str_size(m->destination) + str_size(m->type) + str_size(m->source);
+        size += strv_size(m->options, m->options_len);
+    }
+    if (src->linux_config) {
+        const nk_oci_linux_t *l = src->linux_config;
+        size += sizeof(*l) + sizeof(nk_oci_resources_t) + str_size(l->rootfs_propagation);
+        for (int i = 0; l->resources && i < NK_OCI_BLKIO_LISTS; i++) {
+            size += 8 + l->resources->blkio.devices_len[i] * sizeof(nk_oci_blkio_device_t);
+        }
+        size += l->namespaces_len * sizeof(nk_oci_namespace_t);
+        for (size_t i = 0; i < l->namespaces_len; i++) {
+            size += str_size(l->namespaces[i].type) + str_size(l->namespaces[i].path);
         }
-        return NULL;
     }
+    return size + strv_size(src->annotations, src->annotations_len);
+}
 
-    if (!S_ISDIR(st.st_mode)) {
-        nk_stderr( "Error: Bundle path is not a directory: %s\n", bundle_path);
+/**
+ * nk_oci_spec_dup - Deep copy a parsed spec into one arena
+ */
+static nk_oci_spec_t *nk_oci_spec_dup(const nk_oci_spec_t *src) {
+    nk_oci_spec_t *spec = nk_oci_spec_new(spec_arena_size(src));
+    if (!spec) {
         return NULL;
     }
+    nk_arena_t *arena = nk_oci_spec_arena(spec);
 
-    /* Load and parse JSON */
-    char *json_content = load_json_file(config_path);
-    if (!json_content) {
-        return NULL;
+    spec->oci_version = nk_arena_strdup(arena, src->oci_version);
+    spec->hostname = nk_arena_strdup(arena, src->hostname);
+
+    if (src->process) {
+        const nk_oci_process_t *p = src->process;
+        spec->process = nk_arena_alloc(arena, sizeof(*spec->process));
+        if (!spec->process) {
+            goto fail;
+        }
+        *spec->process = *p;
+        spec->process->args = p->args ? strv_dup(arena, p->args, p->args_len, p->args_len + 1) : NULL;
+        spec->process->env = p->env ? strv_dup(arena, p->env, p->env_len, p->env_len + 1) : NULL;
+        spec->process->cwd = nk_arena_strdup(arena, p->cwd);
+        spec->process->user = nk_arena_strdup(arena, p->user);
+        spec->process->console_size = nk_arena_strdup(arena, p->console_size);
+        spec->process->additional_gids = NULL;
+        spec->process->additional_gids_len = 0;
+        if (p->additional_gids && p->additional_gids_len > 0) {
+            spec->process->additional_gids = nk_arena_alloc(arena, p->additional_gids_len * sizeof(gid_t));
+            if (spec->process->additional_gids) {
+                memcpy(spec->process->additional_gids, p->additional_gids,
+                       p->additional_gids_len * sizeof(gid_t));
+                spec->process->additional_gids_len = p->additional_gids_len;
+            }
+        }
     }
 
+    if (src->root) {
+        spec->root = nk_arena_alloc(arena, sizeof(*spec->root));
+        if (!spec->root) {
+            goto fail;
+        }
+        spec->root->path = nk_arena_strdup(arena, src->root->path);
+        spec->root->readonly = src->root->readonly;
+    }
+
+    if (src->mounts && src->mounts_len > 0) {
+        spec->mounts = nk_arena_alloc(arena, src->mounts_len * sizeof(nk_oci_mount_t));
+        if (!spec->mounts) {
+            goto fail;
+        }
+        for (size_t i = 0; i < src->mounts_len; i++) {
+            const nk_oci_mount_t *m = &src->mounts[i];
+            spec->mounts[i].destination = nk_arena_strdup(arena, m->destination);
+            spec->mounts[i].type = nk_arena_strdup(arena, m->type);
+            spec->mounts[i].source = nk_arena_strdup(arena, m->source);
+            if (m->options && m->options_len > 0) {
+                spec->mounts[i].options = strv_dup(arena, m->options, m->options_len, m->options_len);
+                if (spec->mounts[i].options) {
+                    spec->mounts[i].options_len = m->options_len;
+                }
+            }
+            spec->mounts_len++;
+        }
+    }
+
+    if (src->linux_config) {
+        const nk_oci_linux_t *l = src->linux_config;
+        spec->linux_config = nk_arena_alloc(arena, sizeof(*spec->linux_config));
+        if (!spec->linux_config) {
+            goto fail;
+        }
+        if (l->namespaces && l->namespaces_len > 0) {
+            spec->linux_config->namespaces = nk_arena_alloc(arena, l->namespaces_len * sizeof(nk_oci_namespace_t));
+            if (!spec->linux_config->namespaces) {
+                goto fail;
+            }
+            for (size_t i = 0; i < l->namespaces_len; i++) {
+                spec->linux_config->namespaces[i].type = nk_arena_strdup(arena, l->namespaces[i].type);
+                spec->linux_config->namespaces[i].path = nk_arena_strdup(arena, l->namespaces[i].path);
+                spec->linux_config->namespaces_len++;
+            }
+        }
+        if (l->resources) {
+            spec->linux_config->resources = nk_arena_alloc(arena, sizeof(*l->resources));
+            if (!spec->linux_config->resources) {
+                goto fail;
+            }
+            nk_oci_resources_t *res = spec->linux_config->resources;
+            *res = *l->resources;
+            for (int i = 0; i < NK_OCI_BLKIO_LISTS; i++) {
+                size_t size = res->blkio.devices_len[i] * sizeof(nk_oci_blkio_device_t);
+                res->blkio.devices[i] = NULL;
+                res->blkio.devices_len[i] = 0;
+                if (l->resources->blkio.devices[i] && size > 0) {
+                    res->blkio.devices[i] = nk_arena_alloc(arena, size);
+                    if (!res->blkio.devices[i]) {
+                        goto fail;
+                    }
+                    memcpy(res->blkio.devices[i], l->resources->blkio.devices[i], size);
+                    res->blkio.devices_len[i] = l->resources->blkio.devices_len[i];
+                }
+            }
+        }
+        spec->linux_config->rootfs_propagation = nk_arena_strdup(arena, l->rootfs_propagation);
+    }
+
+    if (src->annotations && src->annotations_len > 0) {
+        spec->annotations = strv_dup(arena, src->annotations, src->annotations_len,
+                                     src->annotations_len);
+        if (spec->annotations) {
+            spec->annotations_len = src->annotations_len;
+        }
+    }
+
+    return spec;
+
+fail:
+    nk_oci_spec_free(spec);
+    return NULL;
+}
+
+static void spec_cache_entry_free(spec_cache_entry_t *entry) {
+    if (!entry) {
+        return;
+    }
+    free(entry->bundle_path);
+    nk_oci_spec_free(entry->spec);
+    free(entry);
+}
+
+static spec_cache_entry_t *spec_cache_find(const char *bundle_path) {
+    for (spec_cache_entry_t *entry = spec_cache_head; entry; entry = entry->next) {
+        if (strcmp(entry->bundle_path, bundle_path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool spec_cache_is_fresh(const spec_cache_entry_t *entry, const struct stat *st) {
+    return entry->dev == st->st_dev &&
+           entry->ino == st->st_ino &&
+           entry->size == st->st_size &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+           entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void spec_cache_store(const char *bundle_path, const struct stat *st,
+                             const nk_oci_spec_t *spec) {
+    spec_cache_entry_t *entry = spec_cache_find(bundle_path);
+    nk_oci_spec_t *copy = nk_oci_spec_dup(spec);
+
+    if (!copy) {
+        return;
+    }
+
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            nk_oci_spec_free(copy);
+            return;
+        }
+        entry->bundle_path = strdup(bundle_path);
+        if (!entry->bundle_path) {
+            nk_oci_spec_free(copy);
+            free(entry);
+            return;
+        }
+        entry->next = spec_cache_head;
+        spec_cache_head = entry;
+    }
+
+    nk_oci_spec_free(entry->spec);
+    entry->spec = copy;
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+}
+
+void nk_oci_spec_cache_enable(bool enabled) {
+    spec_cache_enabled = enabled;
+    if (enabled) {
+        return;
+    }
+
+    while (spec_cache_head) {
+        spec_cache_entry_t *entry = spec_cache_head;
+        spec_cache_head = entry->next;
+        spec_cache_entry_free(entry);
+    }
+}
+
+/**
+ * nk_oci_jansson_parse - Parse config.json through a jansson DOM
+ */
+nk_oci_spec_t *nk_oci_jansson_parse(const char *json) {
     json_error_t error;
-    json_t *root = json_loads(json_content, 0, &error);
-    free(json_content);
+    json_t *root = json_loads(json, 0, &error);
 
     if (!root) {
         nk_stderr( "Error: Failed to parse config.json: %s at line %d\n",
@@ -248,41 +611,42 @@ nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
         return NULL;
     }
 
-    nk_oci_spec_t *spec = calloc(1, sizeof(*spec));
+    nk_oci_spec_t *spec = nk_oci_spec_new(strlen(json) + 512);
     if (!spec) {
         json_decref(root);
         return NULL;
     }
+    nk_arena_t *arena = nk_oci_spec_arena(spec);
 
     /* Parse OCI version */
     json_t *version = json_object_get(root, "ociVersion");
     if (version && json_is_string(version)) {
-        spec->oci_version = strdup(json_string_value(version));
+        spec->oci_version = nk_arena_strdup(arena, json_string_value(version));
     }
 
     /* Parse process (optional for create) */
     json_t *process = json_object_get(root, "process");
     if (process) {
-        spec->process = parse_process(process);
+        spec->process = parse_process(arena, process);
     }
 
     /* Parse root */
     json_t *root_obj = json_object_get(root, "root");
     if (root_obj) {
-        spec->root = parse_root(root_obj);
+        spec->root = parse_root(arena, root_obj);
     }
 
     /* Parse hostname */
     json_t *hostname = json_object_get(root, "hostname");
     if (hostname && json_is_string(hostname)) {
-        spec->hostname = strdup(json_string_value(hostname));
+        spec->hostname = nk_arena_strdup(arena, json_string_value(hostname));
     }
 
     /* Parse mounts */
     json_t *mounts = json_object_get(root, "mounts");
     if (mounts && json_is_array(mounts)) {
         size_t mounts_len = json_array_size(mounts);
-        spec->mounts = calloc(mounts_len, sizeof(nk_oci_mount_t));
+        spec->mounts = nk_arena_alloc(arena, mounts_len * sizeof(nk_oci_mount_t));
         if (spec->mounts) {
             for (size_t i = 0; i < mounts_len; i++) {
                 json_t *m = json_array_get(mounts, i);
@@ -292,27 +656,27 @@ nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
                 json_t *opts = json_object_get(m, "options");
 
                 if (dest && json_is_string(dest)) {
-                    spec->mounts[i].destination = strdup(json_string_value(dest));
+                    nk_oci_mount_t *slot = &spec->mounts[spec->mounts_len++];
+                    slot->destination = nk_arena_strdup(arena, json_string_value(dest));
                     if (type && json_is_string(type)) {
-                        spec->mounts[i].type = strdup(json_string_value(type));
+                        slot->type = nk_arena_strdup(arena, json_string_value(type));
                     }
                     if (src && json_is_string(src)) {
-                        spec->mounts[i].source = strdup(json_string_value(src));
+                        slot->source = nk_arena_strdup(arena, json_string_value(src));
                     }
                     if (opts && json_is_array(opts)) {
                         size_t opts_len = json_array_size(opts);
-                        spec->mounts[i].options = calloc(opts_len, sizeof(char *));
-                        if (spec->mounts[i].options) {
+                        slot->options = nk_arena_alloc(arena, opts_len * sizeof(char *));
+                        if (slot->options) {
                             for (size_t j = 0; j < opts_len; j++) {
                                 json_t *opt = json_array_get(opts, j);
                                 if (json_is_string(opt)) {
-                                    spec->mounts[i].options[j] = strdup(json_string_value(opt));
+                                    slot->options[j] = nk_arena_strdup(arena, json_string_value(opt));
                                 }
                             }
-                            spec->mounts[i].options_len = opts_len;
+                            slot->options_len = opts_len;
                         }
                     }
-                    spec->mounts_len++;
                 }
             }
         }
@@ -321,7 +685,7 @@ nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
     /* Parse Linux-specific configuration */
     json_t *linux_obj = json_object_get(root, "linux");
     if (linux_obj) {
-        spec->linux_config = parse_linux(linux_obj);
+        spec->linux_config = parse_linux(arena, linux_obj);
     }
 
     /* Parse annotations */
@@ -331,15 +695,20 @@ nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
         json_t *value;
         size_t ann_len = json_object_size(annotations);
 
-        spec->annotations = calloc(ann_len * 2, sizeof(char *));
+        spec->annotations = nk_arena_alloc(arena, ann_len * sizeof(char *));
         if (spec->annotations) {
-            size_t i = 0;
             json_object_foreach(annotations, key, value) {
                 if (json_is_string(value)) {
-                    char *ann = malloc(strlen(key) + strlen(json_string_value(value)) + 2);
-                    sprintf(ann, "%s=%s", key, json_string_value(value));
-                    spec->annotations[i++] = ann;
-                    spec->annotations_len++;
+                    size_t key_len = strlen(key);
+                    size_t value_len = strlen(json_string_value(value));
+                    char *ann = nk_arena_alloc(arena, key_len + value_len + 2);
+                    if (!ann) {
+                        break;
+                    }
+                    memcpy(ann, key, key_len);
+                    ann[key_len] = '=';
+                    memcpy(ann + key_len + 1, json_string_value(value), value_len);
+                    spec->annotations[spec->annotations_len++] = ann;
                 }
             }
         }
@@ -349,68 +718,154 @@ nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
     return spec;
 }
 
-static void nk_oci_process_free(nk_oci_process_t *proc) {
-    if (!proc) return;
+/**
+ * nk_oci_spec_parse - Streaming parser first, jansson for whatever it declines
+ */
+nk_oci_spec_t *nk_oci_spec_parse(const char *json, size_t len) {
+#ifndef NK_OCI_JANSSON_ONLY
+    nk_oci_spec_t *spec = NULL;
+    unsigned missing = 0;
 
-    for (size_t i = 0; i < proc->args_len; i++) {
-        free(proc->args[i]);
+    if (nk_oci_stream_parse(json, len, &spec, &missing) == 0) {
+        spec_report_missing(missing);
+        return spec;
     }
-    free(proc->args);
+#endif
 
-    for (size_t i = 0; i < proc->env_len; i++) {
-        free(proc->env[i]);
+    /* Like json_loads() on the file contents: stops at the first NUL */
+    char *copy = strndup(json, len);
+    if (!copy) {
+        nk_stderr( "Error: Failed to allocate memory for config\n");
+        return NULL;
     }
-    free(proc->env);
-
-    free(proc->cwd);
-    free(proc->console_size);
-    free(proc->user);
-    free(proc->additional_gids);
-    free(proc);
+    nk_oci_spec_t *parsed = nk_oci_jansson_parse(copy);
+    free(copy);
+    return parsed;
 }
 
-static void nk_oci_root_free(nk_oci_root_t *root) {
-    if (!root) return;
-    free(root->path);
-    free(root);
+/**
+ * spec_map_file - Map config.json read-only
+ *
+ * Returns NULL without printing if it cannot be mapped (missing, empty,
+ * not a regular file); load_json_file() then reports the problem.
+ */
+static void *spec_map_file(const char *config_path, size_t *len) {
+    struct stat st;
+
+    int fd = open(config_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *len = (size_t)st.st_size;
+    return map;
 }
 
-void nk_oci_spec_free(nk_oci_spec_t *spec) {
-    if (!spec) return;
+nk_oci_spec_t *nk_oci_spec_load(const char *bundle_path) {
+    char config_path[PATH_MAX];
+    snprintf(config_path, sizeof(config_path), "%s/%s", bundle_path, CONFIG_JSON);
+
+    /* Serve from the in-memory cache or compiled image when config.json is unchanged */
+    struct stat config_st;
+    bool have_identity = false;
+    if ((spec_cache_enabled || nk_spec_image_enabled()) && stat(config_path, &config_st) == 0) {
+        spec_cache_entry_t *entry = spec_cache_enabled ? spec_cache_find(bundle_path) : NULL;
+        if (entry && spec_cache_is_fresh(entry, &config_st)) {
+            return nk_oci_spec_dup(entry->spec);
+        }
+        have_identity = true;
+
+        nk_oci_spec_t *mapped = nk_spec_image_load(bundle_path, &config_st);
+        if (mapped) {
+            if (spec_cache_enabled) {
+                spec_cache_store(bundle_path, &config_st, mapped);
+            }
+            return mapped;
+        }
+    }
+
+    /* Check if bundle directory exists */
+    struct stat st;
+    if (stat(bundle_path, &st) != 0) {
+        if (errno == ENOENT) {
+            nk_stderr( "Error: Bundle directory does not exist: %s\n", bundle_path);
+            nk_stderr( "\n");
+            nk_stderr( "A bundle is a directory containing:\n");
+            nk_stderr( "  config.json    - OCI container specification\n");
+            nk_stderr( "  rootfs/        - Container root filesystem\n");
+            nk_stderr( "\n");
+            nk_stderr( "Usage: ns-runtime create --bundle=<bundle-path> <container-id>\n");
+            nk_stderr( "\n");
+            nk_stderr( "Example:\n");
+            nk_stderr( "  ns-runtime create --bundle=./tests/bundle my-container\n");
+            nk_stderr( "\n");
+            nk_stderr( "To setup a test bundle:\n");
+            nk_stderr( "  ./scripts/setup-rootfs.sh\n");
+        } else {
+            nk_stderr( "Error: Cannot access bundle directory %s: %s\n",
+                    bundle_path, strerror(errno));
+        }
+        return NULL;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        nk_stderr( "Error: Bundle path is not a directory: %s\n", bundle_path);
+        return NULL;
+    }
 
-    free(spec->oci_version);
-    nk_oci_process_free(spec->process);
-    nk_oci_root_free(spec->root);
-    free(spec->hostname);
-
-    for (size_t i = 0; i < spec->mounts_len; i++) {
-        free(spec->mounts[i].destination);
-        free(spec->mounts[i].type);
-        free(spec->mounts[i].source);
-        for (size_t j = 0; j < spec->mounts[i].options_len; j++) {
-            free(spec->mounts[i].options[j]);
+    /* Load and parse JSON */
+    nk_oci_spec_t *spec;
+    size_t map_len = 0;
+    void *map = spec_map_file(config_path, &map_len);
+    if (map) {
+        spec = nk_oci_spec_parse(map, map_len);
+        munmap(map, map_len);
+    } else {
+        char *json_content = load_json_file(config_path);
+        if (!json_content) {
+            return NULL;
         }
-        free(spec->mounts[i].options);
+        spec = nk_oci_spec_parse(json_content, strlen(json_content));
+        free(json_content);
+    }
+    if (!spec) {
+        return NULL;
     }
-    free(spec->mounts);
 
-    if (spec->linux_config) {
-        for (size_t i = 0; i < spec->linux_config->namespaces_len; i++) {
-            free(spec->linux_config->namespaces[i].type);
-            free(spec->linux_config->namespaces[i].path);
+    if (have_identity) {
+        if (spec_cache_enabled) {
+            spec_cache_store(bundle_path, &config_st, spec);
+        }
+        /* Incomplete specs are not compiled so their parse errors are reported every time */
+        if (spec->process && spec->root) {
+            nk_spec_image_store(bundle_path, &config_st, spec);
         }
-        free(spec->linux_config->namespaces);
-        free(spec->linux_config->rootfs_propagation);
-        free(spec->linux_config->resources);
-        free(spec->linux_config);
     }
+    return spec;
+}
 
-    for (size_t i = 0; i < spec->annotations_len; i++) {
-        free(spec->annotations[i]);
+void nk_oci_spec_free(nk_oci_spec_t *spec) {
+    if (!spec) return;
+
+    /* Specs mapped from a compiled image live entirely inside the mapping */
+    if (spec->image) {
+        munmap(spec->image, spec->image_len);
+        return;
     }
-    free(spec->annotations);
 
-    free(spec);
+    spec_block_t *block = spec_block(spec);
+    nk_arena_release(&block->arena);
+    free(block);
 }
 
 bool nk_oci_spec_validate(const nk_oci_spec_t *spec) {
@@ -0,0 +1,549 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "oci/spec_image.h"
+#include "nk_log.h"
+
+/*
+ * A compiled image is one flat file:
+ *
+ *   [spec_image_hdr_t][nk_oci_spec_t][nested structs, arrays, strings ...]
+ *
+ * Every pointer field holds an offset from the start of the file (0 is
+ * NULL; the header occupies offset 0 so no object can live there). Loading
+ * maps the file MAP_PRIVATE and rewrites the offsets into pointers.
+ */
+#define SPEC_IMAGE_MAGIC 0x4e4b5331u   /* "NKS1" */
+#define SPEC_IMAGE_VERSION 2u          /* Bump when nk_oci_spec_t changes */
+#define SPEC_IMAGE_SUFFIX ".spec"
+#define SPEC_IMAGE_ALIGN 8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layout;           /* Struct sizes folded together, guards ABI drift */
+    uint32_t reserved;
+    uint64_t image_len;
+    uint64_t dev;              /* config.json identity the image was built from */
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t bundle_path;      /* Offset of the bundle path string */
+    uint64_t spec;             /* Offset of nk_oci_spec_t */
+} spec_image_hdr_t;
+
+/* Growable buffer the image is serialized into; objects are addressed by offset */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} spec_image_buf_t;
+
+static char *spec_image_dir = NULL;
+
+#define IMG_PTR(off) ((void *)(uintptr_t)(off))
+
+static uint32_t spec_image_layout(void) {
+    return (uint32_t)(sizeof(nk_oci_spec_t) ^ (sizeof(nk_oci_process_t) << 8) ^
+                      (sizeof(nk_oci_mount_t) << 16) ^ (sizeof(nk_oci_linux_t) << 20) ^
+                      (sizeof(nk_oci_resources_t) << 24));
+}
+
+/**
+ * nk_oci_spec_image_dir - Set (or clear) the compiled spec image directory
+ */
+void nk_oci_spec_image_dir(const char *dir) {
+    free(spec_image_dir);
+    spec_image_dir = dir ? strdup(dir) : NULL;
+}
+
+bool nk_spec_image_enabled(void) {
+    return spec_image_dir != NULL;
+}
+
+/**
+ * spec_image_path - <dir>/<fnv1a64(bundle_path)>.spec
+ */
+static int spec_image_path(const char *bundle_path, char *buf, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+
+    for (const unsigned char *p = (const unsigned char *)bundle_path; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    int n = snprintf(buf, len, "%s/%016llx%s", spec_image_dir,
+                     (unsigned long long)hash, SPEC_IMAGE_SUFFIX);
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+/* ---- Serialization ---------------------------------------------------- */
+
+/**
+ * img_reserve - Append @size zeroed bytes, returning their offset (0 on OOM)
+ */
+static uint64_t img_reserve(spec_image_buf_t *img, size_t size) {
+    size_t off = (img->len + SPEC_IMAGE_ALIGN - 1) & ~(size_t)(SPEC_IMAGE_ALIGN - 1);
+
+    if (img->failed) {
+        return 0;
+    }
+    if (off + size > img->cap) {
+        size_t cap = img->cap ? img->cap : 4096;
+        while (cap < off + size) {
+            cap *= 2;
+        }
+        char *data = realloc(img->data, cap);
+        if (!data) {
+            img->failed = true;
+            return 0;
+        }
+        img->data = data;
+        img->cap = cap;
+    }
+
+    memset(img->data + img->len, 0, off + size - img->len);
+    img->len = off + size;
+    return off;
+}
+
+static uint64_t img_bytes(spec_image_buf_t *img, const void *src, size_t size) {
+    if (!src || size == 0) {
+        return 0;
+    }
+    uint64_t off = img_reserve(img, size);
+    if (off) {
+        memcpy(img->data + off, src, size);
+    }
+    return off;
+}
+
+static uint64_t img_str(spec_image_buf_t *img, const char *s) {
+    return s ? img_bytes(img, s, strlen(s) + 1) : 0;
+}
+
+/**
+ * img_strv - Copy a string vector; @slots >= @len leaves NULL terminators
+ */
+static uint64_t img_strv(spec_image_buf_t *img, char *const *v, size_t len, size_t slots) {
+    if (!v || slots == 0) {
+        return 0;
+    }
+
+    uint64_t off = img_reserve(img, slots * sizeof(char *));
+    for (size_t i = 0; off && i < len; i++) {
+        void *elem = IMG_PTR(img_str(img, v[i]));
+        memcpy(img->data + off + i * sizeof(char *), &elem, sizeof(elem));
+    }
+    return off;
+}
+
+static uint64_t img_process(spec_image_buf_t *img, const nk_oci_process_t *src) {
+    if (!src) {
+        return 0;
+    }
+
+    uint64_t off = img_reserve(img, sizeof(nk_oci_process_t));
+    nk_oci_process_t p = *src;
+
+    p.args = IMG_PTR(img_strv(img, src->args, src->args_len, src->args_len + 1));
+    p.env = IMG_PTR(img_strv(img, src->env, src->env_len, src->env_len + 1));
+    p.cwd = IMG_PTR(img_str(img, src->cwd));
+    p.user = IMG_PTR(img_str(img, src->user));
+    p.console_size = IMG_PTR(img_str(img, src->console_size));
+    p.additional_gids = IMG_PTR(img_bytes(img, src->additional_gids,
+                                          src->additional_gids_len * sizeof(gid_t)));
+    if (off) {
+        memcpy(img->data + off, &p, sizeof(p));
+    }
+    return off;
+}
+
+static uint64_t img_root(spec_image_buf_t *img, const nk_oci_root_t *src) {
+    if (!src) {
+        return 0;
+    }
+
+    uint64_t off = img_reserve(img, sizeof(nk_oci_root_t));
+    nk_oci_root_t r = *src;
+
+    r.path = IMG_PTR(img_str(img, src->path));
+    if (off) {
+        memcpy(img->data + off, &r, sizeof(r));
+    }
+    return off;
+}
+
+static uint64_t img_mounts(spec_image_buf_t *img, const nk_oci_mount_t *src, size_t len) {
+    if (!src || len == 0) {
+        return 0;
+    }
+
+    uint64_t off = img_reserve(img, len * sizeof(nk_oci_mount_t));
+    for (size_t i = 0; off && i < len; i++) {
+        nk_oci_mount_t m = src[i];
+
+        m.destination = IMG_PTR(img_str(img, src[i].destination));
+        m.type = IMG_PTR(img_str(img, src[i].type));
+        m.source = IMG_PTR(img_str(img, src[i].source));
+        m.options = IMG_PTR(img_strv(img, src[i].options, src[i].options_len,
+                                     src[i].options_len));
+        memcpy(img->data + off + i * sizeof(m), &m, sizeof(m));
+    }
+    return off;
+}
+
+static uint64_t img_linux(spec_image_buf_t *img, const nk_oci_linux_t *src) {
+    if (!src) {
+        return 0;
+    }
+
+    uint64_t off = img_reserve(img, sizeof(nk_oci_linux_t));
+    nk_oci_linux_t l = *src;
+
+    l.namespaces = NULL;
+    if (src->namespaces && src->namespaces_len > 0) {
+        uint64_t ns_off = img_reserve(img, src->namespaces_len * sizeof(nk_oci_namespace_t));
+        for (size_t i = 0; ns_off && i < src->namespaces_len; i++) {
+            nk_oci_namespace_t ns;
+
+            ns.type = IMG_PTR(img_str(img, src->namespaces[i].type));
+            ns.path = IMG_PTR(img_str(img, src->namespaces[i].path));
+            memcpy(img->data + ns_off + i * sizeof(ns), &ns, sizeof(ns));
+        }
+        l.namespaces = IMG_PTR(ns_off);
+    }
+    l.resources = NULL;
+    if (src->resources) {
+        uint64_t res_off = img_reserve(img, sizeof(nk_oci_resources_t));
+        nk_oci_resources_t res = *src->resources;
+
+        for (int i = 0; i < NK_OCI_BLKIO_LISTS; i++) {
+            res.blkio.devices[i] = IMG_PTR(img_bytes(img, src->resources->blkio.devices[i],
+                                                     res.blkio.devices_len[i] *
+                                                     sizeof(nk_oci_blkio_device_t)));
+        }
+        if (res_off) {
+            memcpy(img->data + res_off, &res, sizeof(res));
+        }
+        l.resources = IMG_PTR(res_off);
+    }
+    l.rootfs_propagation = IMG_PTR(img_str(img, src->rootfs_propagation));
+    if (off) {
+        memcpy(img->data + off, &l, sizeof(l));
+    }
+    return off;
+}
+
+/**
+ * spec_image_build - Serialize @spec into @img, header first
+ */
+static int spec_image_build(spec_image_buf_t *img, const char *bundle_path,
+                            const struct stat *config_st, const nk_oci_spec_t *spec) {
+    spec_image_hdr_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    (void)img_reserve(img, sizeof(hdr));
+    hdr.spec = img_reserve(img, sizeof(nk_oci_spec_t));
+    hdr.bundle_path = img_str(img, bundle_path);
+
+    nk_oci_spec_t s = *spec;
+    s.oci_version = IMG_PTR(img_str(img, spec->oci_version));
+    s.process = IMG_PTR(img_process(img, spec->process));
+    s.root = IMG_PTR(img_root(img, spec->root));
+    s.hostname = IMG_PTR(img_str(img, spec->hostname));
+    s.mounts = IMG_PTR(img_mounts(img, spec->mounts, spec->mounts_len));
+    s.linux_config = IMG_PTR(img_linux(img, spec->linux_config));
+    s.annotations = IMG_PTR(img_strv(img, spec->annotations, spec->annotations_len,
+                                     spec->annotations_len));
+    s.image = NULL;
+    s.image_len = 0;
+
+    if (img->failed) {
+        return -1;
+    }
+    memcpy(img->data + hdr.spec, &s, sizeof(s));
+
+    hdr.magic = SPEC_IMAGE_MAGIC;
+    hdr.version = SPEC_IMAGE_VERSION;
+    hdr.layout = spec_image_layout();
+    hdr.image_len = img->len;
+    hdr.dev = (uint64_t)config_st->st_dev;
+    hdr.ino = (uint64_t)config_st->st_ino;
+    hdr.size = (int64_t)config_st->st_size;
+    hdr.mtime_sec = (int64_t)config_st->st_mtim.tv_sec;
+    hdr.mtime_nsec = (int64_t)config_st->st_mtim.tv_nsec;
+    memcpy(img->data, &hdr, sizeof(hdr));
+    return 0;
+}
+
+void nk_spec_image_store(const char *bundle_path, const struct stat *config_st,
+                         const nk_oci_spec_t *spec) {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    spec_image_buf_t img = {0};
+
+    if (!spec_image_dir || !bundle_path || !config_st || !spec ||
+        spec_image_path(bundle_path, path, sizeof(path)) == -1) {
+        return;
+    }
+
+    int n = snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        return;
+    }
+
+    if (spec_image_build(&img, bundle_path, config_st, spec) == -1) {
+        nk_log_debug("Spec image: out of memory serializing %s", bundle_path);
+        free(img.data);
+        return;
+    }
+
+    if (mkdir(spec_image_dir, 0700) == -1 && errno != EEXIST) {
+        nk_log_debug("Spec image: cannot create %s: %s", spec_image_dir, strerror(errno));
+        free(img.data);
+        return;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        nk_log_debug("Spec image: cannot create %s: %s", tmp, strerror(errno));
+        free(img.data);
+        return;
+    }
+
+    size_t done = 0;
+    while (done < img.len) {
+        ssize_t w = write(fd, img.data + done, img.len - done);
+        if (w <= 0) {
+            if (w == -1 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += (size_t)w;
+    }
+    close(fd);
+    free(img.data);
+
+    /* Publish atomically so concurrent loaders never map a partial image */
+    if (done != img.len || rename(tmp, path) == -1) {
+        nk_log_debug("Spec image: failed to write %s", path);
+        unlink(tmp);
+        return;
+    }
+    nk_log_debug("Spec image: compiled %s -> %s", bundle_path, path);
+}
+
+/* ---- Loading ---------------------------------------------------------- */
+
+/**
+ * img_reloc - Turn the offset stored at @field into a pointer into @base
+ * @n: Elements that must be in bounds at the target
+ * @size: Element size (0 for a NUL-terminated string)
+ *
+ * Every count comes from the image itself, so bounds are checked by
+ * division: @n * @size could wrap around and pass.
+ */
+static bool img_reloc(void *field, char *base, size_t len, size_t n, size_t size) {
+    uintptr_t off;
+    void *ptr;
+
+    memcpy(&off, field, sizeof(off));
+    if (off == 0) {
+        return true;
+    }
+    if (off < sizeof(spec_image_hdr_t) || off >= len) {
+        return false;
+    }
+    if (size == 0) {
+        if (!memchr(base + off, '\0', len - off)) {
+            return false;
+        }
+    } else if (off % SPEC_IMAGE_ALIGN != 0 || n > (len - off) / size) {
+        return false;
+    }
+
+    ptr = base + off;
+    memcpy(field, &ptr, sizeof(ptr));
+    return true;
+}
+
+/* img_reloc() for an array whose length is stored next to it: NULL only when empty */
+static bool img_reloc_array(void *field, char *base, size_t len, size_t n, size_t size) {
+    void *ptr;
+
+    if (!img_reloc(field, base, len, n, size)) {
+        return false;
+    }
+    memcpy(&ptr, field, sizeof(ptr));
+    return ptr != NULL || n == 0;
+}
+
+/*
+ * @slots is @n, or @n + 1 for a NULL-terminated vector. The terminator must
+ * be NULL: args and env go straight to execve().
+ */
+static bool img_reloc_strv(void *field, char *base, size_t len, size_t n, size_t slots) {
+    char **v;
+
+    if (slots < n || !img_reloc_array(field, base, len, slots, sizeof(char *))) {
+        return false;
+    }
+    memcpy(&v, field, sizeof(v));
+    if (v && slots > n && v[n] != NULL) {
+        return false;
+    }
+    for (size_t i = 0; v && i < n; i++) {
+        if (!img_reloc(&v[i], base, len, 1, 0) || !v[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * spec_image_relocate - Rewrite every offset in the mapped spec to a pointer
+ */
+static bool spec_image_relocate(nk_oci_spec_t *s, char *base, size_t len) {
+    if (!img_reloc(&s->oci_version, base, len, 1, 0) ||
+        !img_reloc(&s->hostname, base, len, 1, 0) ||
+        !img_reloc(&s->process, base, len, 1, sizeof(nk_oci_process_t)) ||
+        !img_reloc(&s->root, base, len, 1, sizeof(nk_oci_root_t)) ||
+        !img_reloc_array(&s->mounts, base, len, s->mounts_len, sizeof(nk_oci_mount_t)) ||
+        !img_reloc(&s->linux_config, base, len, 1, sizeof(nk_oci_linux_t)) ||
+        !img_reloc_strv(&s->annotations, base, len, s->annotations_len, s->annotations_len)) {
+        return false;
+    }
+
+    if (s->process) {
+        nk_oci_process_t *p = s->process;
+        if (!img_reloc_strv(&p->args, base, len, p->args_len, p->args_len + 1) ||
+            !img_reloc_strv(&p->env, base, len, p->env_len, p->env_len + 1) ||
+            !img_reloc(&p->cwd, base, len, 1, 0) ||
+            !img_reloc(&p->user, base, len, 1, 0) ||
+            !img_reloc(&p->console_size, base, len, 1, 0) ||
+            !img_reloc_array(&p->additional_gids, base, len,
+                             p->additional_gids_len, sizeof(gid_t))) {
+            return false;
+        }
+    }
+
+    if (s->root && !img_reloc(&s->root->path, base, len, 1, 0)) {
+        return false;
+    }
+
+    for (size_t i = 0; s->mounts && i < s->mounts_len; i++) {
+        nk_oci_mount_t *m = &s->mounts[i];
+        if (!img_reloc(&m->destination, base, len, 1, 0) ||
+            !img_reloc(&m->type, base, len, 1, 0) ||
+            !img_reloc(&m->source, base, len, 1, 0) ||
+            !img_reloc_strv(&m->options, base, len, m->options_len, m->options_len)) {
+            return false;
+        }
+    }
+
+    if (s->linux_config) {
+        nk_oci_linux_t *l = s->linux_config;
+        if (!img_reloc_array(&l->namespaces, base, len,
+                             l->namespaces_len, sizeof(nk_oci_namespace_t)) ||
+            !img_reloc(&l->resources, base, len, 1, sizeof(nk_oci_resources_t)) ||
+            !img_reloc(&l->rootfs_propagation, base, len, 1, 0)) {
+            return false;
+        }
+        for (size_t i = 0; l->namespaces && i < l->namespaces_len; i++) {
+            if (!img_reloc(&l->namespaces[i].type, base, len, 1, 0) ||
+                !img_reloc(&l->namespaces[i].path, base, len, 1, 0)) {
+                return false;
+            }
+        }
+        for (int i = 0; l->resources && i < NK_OCI_BLKIO_LISTS; i++) {
+            if (!img_reloc_array(&l->resources->blkio.devices[i], base, len,
+                                 l->resources->blkio.devices_len[i], sizeof(nk_oci_blkio_device_t))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool spec_image_header_ok(const spec_image_hdr_t *hdr, size_t len,
+                                 const struct stat *config_st) {
+    return hdr->magic == SPEC_IMAGE_MAGIC &&
+           hdr->version == SPEC_IMAGE_VERSION &&
+           hdr->layout == spec_image_layout() &&
+           hdr->image_len == len &&
+           hdr->dev == (uint64_t)config_st->st_dev &&
+           hdr->ino == (uint64_t)config_st->st_ino &&
+           hdr->size == (int64_t)config_st->st_size &&
+           hdr->mtime_sec == (int64_t)config_st->st_mtim.tv_sec &&
+           hdr->mtime_nsec == (int64_t)config_st->st_mtim.tv_nsec &&
+           hdr->spec >= sizeof(*hdr) && hdr->spec % SPEC_IMAGE_ALIGN == 0 &&
+           hdr->spec <= len - sizeof(nk_oci_spec_t);
+}
+
+nk_oci_spec_t *nk_spec_image_load(const char *bundle_path, const struct stat *config_st) {
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (!spec_image_dir || !bundle_path || !config_st ||
+        spec_image_path(bundle_path, path, sizeof(path)) == -1) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 ||
+        (size_t)st.st_size < sizeof(spec_image_hdr_t) + sizeof(nk_oci_spec_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t len = (size_t)st.st_size;
+    char *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    spec_image_hdr_t hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+
+    uintptr_t bundle_off = (uintptr_t)hdr.bundle_path;
+    char *stored_bundle = NULL;
+    memcpy(&stored_bundle, &bundle_off, sizeof(stored_bundle));
+    if (!spec_image_header_ok(&hdr, len, config_st) ||
+        !img_reloc(&stored_bundle, base, len, 1, 0) || !stored_bundle ||
+        strcmp(stored_bundle, bundle_path) != 0) {
+        /* Stale (config.json changed) or a different bundle hashed here */
+        munmap(base, len);
+        return NULL;
+    }
+
+    nk_oci_spec_t *spec = (nk_oci_spec_t *)(base + hdr.spec);
+    if (!spec_image_relocate(spec, base, len)) {
+        nk_log_debug("Spec image: %s is corrupt, ignoring", path);
+        munmap(base, len);
+        return NULL;
+    }
+
+    spec->image = base;
+    spec->image_len = len;
+    nk_log_debug("Spec image: mapped %s for %s", path, bundle_path);
+    return spec;
+}
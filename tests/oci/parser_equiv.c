@@ -0,0 +1,260 @@
+/*
+ * Equivalence test for the streaming config.json parser.
+ *
+ * For every corpus file, every truncation of it and a set of single-byte
+ * mutations, nk_oci_spec_parse() (streaming parser with jansson fallback)
+ * must produce the same spec and the same stderr output as the jansson
+ * DOM parser alone.
+ *
+ * Usage: oci-parser-equiv <config.json>...
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nk_oci.h"
+#include "nk_log.h"
+#include "oci/parser.h"
+
+/* Bytes that most often change how a document parses */
+static const char mutations[] = { '"', '\\', '{', '}', '[', ']', ',', ':', ' ', '0', 'x', '\0',
+                                  (char)0x80, (char)0xC3 };
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void dump_str(FILE *out, const char *name, const char *s) {
+    fprintf(out, "%s=%s%s%s\n", name, s ? "\"" : "", s ? s : "(null)", s ? "\"" : "");
+}
+
+static void dump_strv(FILE *out, const char *name, char *const *v, size_t len) {
+    fprintf(out, "%s[%zu]%s\n", name, len, v ? "" : " (null)");
+    for (size_t i = 0; i < len; i++) {
+        dump_str(out, "  -", v[i]);
+    }
+}
+
+/**
+ * dump_spec - Write a canonical text form of @spec
+ *
+ * Annotations are sorted: their order follows jansson's object iteration.
+ */
+static void dump_spec(FILE *out, const nk_oci_spec_t *spec) {
+    if (!spec) {
+        fprintf(out, "spec=(null)\n");
+        return;
+    }
+
+    dump_str(out, "ociVersion", spec->oci_version);
+    dump_str(out, "hostname", spec->hostname);
+
+    if (spec->process) {
+        const nk_oci_process_t *p = spec->process;
+        fprintf(out, "process terminal=%d nnp=%d uid=%u gid=%u\n",
+                p->terminal, p->no_new_privileges, (unsigned)p->uid, (unsigned)p->gid);
+        dump_str(out, "cwd", p->cwd);
+        dump_str(out, "consoleSize", p->console_size);
+        dump_strv(out, "args", p->args, p->args_len);
+        if (p->args && p->args[p->args_len]) {
+            fprintf(out, "args not NULL-terminated\n");
+        }
+        dump_strv(out, "env", p->env, p->env_len);
+    } else {
+        fprintf(out, "process=(null)\n");
+    }
+
+    if (spec->root) {
+        fprintf(out, "root readonly=%d\n", spec->root->readonly);
+        dump_str(out, "path", spec->root->path);
+    } else {
+        fprintf(out, "root=(null)\n");
+    }
+
+    fprintf(out, "mounts[%zu]\n", spec->mounts_len);
+    for (size_t i = 0; i < spec->mounts_len; i++) {
+        const nk_oci_mount_t *m = &spec->mounts[i];
+        dump_str(out, "destination", m->destination);
+        dump_str(out, "type", m->type);
+        dump_str(out, "source", m->source);
+        dump_strv(out, "options", m->options, m->options_len);
+    }
+
+    if (spec->linux_config) {
+        const nk_oci_linux_t *l = spec->linux_config;
+        fprintf(out, "linux namespaces[%zu]\n", l->namespaces_len);
+        for (size_t i = 0; i < l->namespaces_len; i++) {
+            dump_str(out, "type", l->namespaces[i].type);
+            dump_str(out, "path", l->namespaces[i].path);
+        }
+        dump_str(out, "rootfsPropagation", l->rootfs_propagation);
+        if (l->resources) {
+            const nk_oci_resources_t *r = l->resources;
+            fprintf(out, "resources memory limit=%lld reservation=%lld swap=%lld kernel=%lld\n",
+                    (long long)r->memory.limit, (long long)r->memory.reservation,
+                    (long long)r->memory.swap, (long long)r->memory.kernel);
+            fprintf(out, "resources cpu shares=%llu quota=%lld period=%llu burst=%llu idle=%lld "
+                    "rt=%lld/%llu\n",
+                    (unsigned long long)r->cpu.shares, (long long)r->cpu.quota,
+                    (unsigned long long)r->cpu.period, (unsigned long long)r->cpu.burst,
+                    (long long)r->cpu.idle, (long long)r->cpu.realtime_runtime,
+                    (unsigned long long)r->cpu.realtime_period);
+            fprintf(out, "resources pids limit=%lld\n", (long long)r->pids_limit);
+            fprintf(out, "resources blkio weight=%llu leaf_weight=%lld\n",
+                    (unsigned long long)r->blkio.weight, (long long)r->blkio.leaf_weight);
+            for (int b = 0; b < NK_OCI_BLKIO_LISTS; b++) {
+                for (size_t i = 0; i < r->blkio.devices_len[b]; i++) {
+                    const nk_oci_blkio_device_t *d = &r->blkio.devices[b][i];
+                    fprintf(out, "resources blkio[%d][%zu] %lld:%lld value=%lld\n", b, i,
+                            (long long)d->major, (long long)d->minor, (long long)d->value);
+                }
+            }
+        } else {
+            fprintf(out, "resources=(null)\n");
+        }
+    } else {
+        fprintf(out, "linux=(null)\n");
+    }
+
+    char **ann = calloc(spec->annotations_len + 1, sizeof(char *));
+    if (ann) {
+        if (spec->annotations_len > 0) {
+            memcpy(ann, spec->annotations, spec->annotations_len * sizeof(char *));
+        }
+        qsort(ann, spec->annotations_len, sizeof(char *), cmp_str);
+        dump_strv(out, "annotations", ann, spec->annotations_len);
+        free(ann);
+    }
+}
+
+/**
+ * run_parser - Parse @json and return the spec dump plus captured stderr
+ */
+static char *run_parser(const char *json, size_t len, bool stream) {
+    FILE *out = tmpfile();
+    char *text = NULL;
+    size_t text_len = 0;
+
+    if (!out) {
+        perror("tmpfile");
+        exit(2);
+    }
+
+    fflush(stderr);
+    int saved = dup(STDERR_FILENO);
+    dup2(fileno(out), STDERR_FILENO);
+
+    nk_oci_spec_t *spec;
+    if (stream) {
+        spec = nk_oci_spec_parse(json, len);
+    } else {
+        char *copy = strndup(json, len);
+        spec = copy ? nk_oci_jansson_parse(copy) : NULL;
+        free(copy);
+    }
+
+    nk_log_flush();
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+
+    fprintf(out, "--- spec\n");
+    dump_spec(out, spec);
+    nk_oci_spec_free(spec);
+
+    fflush(out);
+    FILE *mem = open_memstream(&text, &text_len);
+    rewind(out);
+    int c;
+    while ((c = fgetc(out)) != EOF) {
+        fputc(c, mem);
+    }
+    fclose(mem);
+    fclose(out);
+    return text;
+}
+
+static int check_case(const char *file, const char *what, size_t at,
+                      const char *json, size_t len) {
+    char *expect = run_parser(json, len, false);
+    char *got = run_parser(json, len, true);
+    int failed = strcmp(expect, got) != 0;
+
+    if (failed) {
+        printf("FAIL %s: %s at %zu\n--- jansson\n%s--- stream\n%s", file, what, at, expect, got);
+    }
+    free(expect);
+    free(got);
+    return failed;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    char *buf = NULL;
+
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size >= 0 && (buf = malloc((size_t)size + 1))) {
+        *len = fread(buf, 1, (size_t)size, f);
+        buf[*len] = '\0';
+    }
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    size_t cases = 0;
+    int failures = 0;
+
+    /* The runtime's stderr messages are part of what is compared */
+    setenv("NK_LOG_ENABLED", "1", 1);
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <config.json>...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        size_t len = 0;
+        char *json = read_file(argv[i], &len);
+        if (!json) {
+            return 2;
+        }
+
+        failures += check_case(argv[i], "whole file", len, json, len);
+        cases++;
+
+        for (size_t cut = 0; cut < len; cut++) {
+            failures += check_case(argv[i], "truncated", cut, json, cut);
+            cases++;
+        }
+
+        char *mutated = malloc(len + 1);
+        if (!mutated) {
+            return 2;
+        }
+        for (size_t pos = 0; pos < len; pos++) {
+            for (size_t m = 0; m < sizeof(mutations); m++) {
+                if (json[pos] == mutations[m]) {
+                    continue;
+                }
+                memcpy(mutated, json, len + 1);
+                mutated[pos] = mutations[m];
+                failures += check_case(argv[i], "mutated", pos, mutated, len);
+                cases++;
+            }
+        }
+        free(mutated);
+        free(json);
+    }
+
+    printf("%zu cases, %d mismatches\n", cases, failures);
+    return failures ? 1 : 0;
+}